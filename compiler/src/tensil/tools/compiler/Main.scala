@@ -34,6 +34,8 @@ case class Args(
     instructionsSummary: Boolean = false,
     writeGraph: Boolean = false,
     writeProgramAssembly: Boolean = false,
+    writeBundle: Boolean = false,
+    compressBundle: Boolean = false,
     targetDir: File = new File("."),
     strategy: CompilerStrategy.Kind = CompilerStrategy.LocalIsolated,
 )
@@ -110,6 +112,16 @@ object Main extends App {
       .action((x, c) => c.copy(writeProgramAssembly = x))
       .text("Write program assembly")
 
+    opt[Boolean]("write-bundle")
+      .valueName("true|false")
+      .action((x, c) => c.copy(writeBundle = x))
+      .text("Write single-file model bundle (.tbundle), defaults to false")
+
+    opt[Boolean]("compress-bundle")
+      .valueName("true|false")
+      .action((x, c) => c.copy(compressBundle = x))
+      .text("Compress consts and program in model bundle, defaults to false")
+
     opt[File]('t', "target")
       .valueName("<dir>")
       .action((x, c) => c.copy(targetDir = x))
@@ -151,6 +163,8 @@ object Main extends App {
         printInstructionsSummary = args.instructionsSummary,
         printGraph = args.writeGraph,
         printProgramAssembly = args.writeProgramAssembly,
+        writeBundle = args.writeBundle,
+        compressBundle = args.compressBundle,
         targetPath = Some(targetDir)
       )
 
@@ -64,14 +64,14 @@ static size_t argmax(size_t size, const float *buffer) {
     return max_i;
 }
 
-#define CHANNEL_TO_FLOAT(v) ((float)v / 255.0)
+#define CHANNEL_SCALE (1.0f / 255.0f)
 
 static float channel_mean(size_t size, const u8 *buffer) {
-    float sum = 0.0;
+    uint32_t sum = 0;
     for (size_t i = 0; i < size; i++)
-        sum += CHANNEL_TO_FLOAT(buffer[i]);
+        sum += buffer[i];
 
-    return sum / (float)size;
+    return (float)sum / (float)size;
 }
 
 struct leds {
@@ -135,7 +135,17 @@ static tensil_error_t test_resnet20v2_on_cifar(struct tensil_driver *driver,
     FIL fil;
     FILINFO fno;
     UINT bytes_read;
-    tensil_error_t error = TENSIL_ERROR_NONE;
+    const struct tensil_tensor *input;
+    const struct tensil_tensor *output;
+    tensil_error_t error = tensil_model_find_input(model, "x:0", &input);
+
+    if (error)
+        return error;
+
+    error = tensil_model_find_output(model, "Identity:0", &output);
+
+    if (error)
+        return error;
 
     FRESULT res = f_stat(file_name, &fno);
     if (res)
@@ -167,6 +177,8 @@ static tensil_error_t test_resnet20v2_on_cifar(struct tensil_driver *driver,
     printf("Testing ResNet20V2 on CIFAR...\n");
 
     float total_seconds = 0;
+    const float scale[] = {CHANNEL_SCALE, CHANNEL_SCALE, CHANNEL_SCALE};
+    struct tensil_image_lut lut;
 
     if (print_images)
         console_clear_screen();
@@ -178,29 +190,30 @@ static tensil_error_t test_resnet20v2_on_cifar(struct tensil_driver *driver,
         ptr += 1;
 
         u8 *red = ptr;
-        ptr += CIFAR_PIXELS_SIZE;
+        u8 *green = red + CIFAR_PIXELS_SIZE;
+        u8 *blue = green + CIFAR_PIXELS_SIZE;
 
-        u8 *green = ptr;
-        ptr += CIFAR_PIXELS_SIZE;
+        float mean[] = {channel_mean(CIFAR_PIXELS_SIZE, red),
+                        channel_mean(CIFAR_PIXELS_SIZE, green),
+                        channel_mean(CIFAR_PIXELS_SIZE, blue)};
 
-        u8 *blue = ptr;
-        ptr += CIFAR_PIXELS_SIZE;
+        // Each image is centered on its own channel means. Since the mean
+        // shifts every entry of a channel table, tables are rebuilt for each
+        // image: 3 x 256 entries against 3 x 1024 pixels looked up.
+        error = tensil_image_lut_init(&lut, driver->arch.data_type, 3, mean,
+                                      scale);
 
-        float red_mean = channel_mean(CIFAR_PIXELS_SIZE, red);
-        float green_mean = channel_mean(CIFAR_PIXELS_SIZE, green);
-        float blue_mean = channel_mean(CIFAR_PIXELS_SIZE, blue);
+        if (error)
+            goto cleanup;
 
-        for (size_t j = 0; j < CIFAR_PIXELS_SIZE; j++) {
-            float pixel[] = {CHANNEL_TO_FLOAT(red[j]) - red_mean,
-                             CHANNEL_TO_FLOAT(green[j]) - green_mean,
-                             CHANNEL_TO_FLOAT(blue[j]) - blue_mean};
+        error = tensil_driver_load_model_input_image(
+            driver, input, &lut, TENSIL_IMAGE_LAYOUT_CHW, CIFAR_PIXELS_SIZE,
+            ptr);
 
-            error = tensil_driver_load_model_input_vector_scalars(
-                driver, model, "x:0", j, 3, pixel);
+        if (error)
+            goto cleanup;
 
-            if (error)
-                goto cleanup;
-        }
+        ptr += CIFAR_PIXELS_SIZE * 3;
 
         struct stopwatch sw;
         error = stopwatch_start(&sw);
@@ -220,7 +233,7 @@ static tensil_error_t test_resnet20v2_on_cifar(struct tensil_driver *driver,
 
         float result[CIFAR_CLASSES_SIZE];
         error = tensil_driver_get_model_output_scalars(
-            driver, model, "Identity:0", CIFAR_CLASSES_SIZE, result);
+            driver, output, CIFAR_CLASSES_SIZE, result);
 
         if (error)
             goto cleanup;
@@ -252,8 +265,8 @@ static tensil_error_t test_resnet20v2_on_cifar(struct tensil_driver *driver,
 
                 printf("\nResult:\n");
 
-                error = tensil_driver_print_model_output_vectors(driver, model,
-                                                                 "Identity:0");
+                error =
+                    tensil_driver_print_model_output_vectors(driver, output);
 
                 if (error)
                     goto cleanup;
@@ -380,6 +393,12 @@ int main() {
     printf("Testing sampling...\n");
     error = tensil_driver_run_sampling_test(&driver, false);
 
+    if (error)
+        goto cleanup;
+
+    printf("Testing ring sampling...\n");
+    error = tensil_driver_run_sampling_ring_test(&driver, false);
+
     if (error)
         goto cleanup;
 
@@ -406,6 +425,96 @@ int main() {
     printf("Testing SIMD...\n");
     error = tensil_driver_run_simd_test(&driver, true);
 
+    if (error)
+        goto cleanup;
+
+    printf("Testing conversion...\n");
+    error = tensil_driver_run_conversion_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing pipeline...\n");
+    error = tensil_driver_run_pipeline_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing segmented tensors...\n");
+    error = tensil_driver_run_segmented_tensor_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing instruction encoding...\n");
+    error = tensil_driver_run_instruction_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing fence...\n");
+    error = tensil_driver_run_fence_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing bottleneck classification...\n");
+    error = tensil_driver_run_bottleneck_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing adaptive sampling...\n");
+    error = tensil_driver_run_adaptive_sampling_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing streaming...\n");
+    error = tensil_driver_run_streaming_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing sample aggregates...\n");
+    error = tensil_driver_run_sample_aggregates_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing model bundle...\n");
+    error = tensil_driver_run_bundle_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing resident models...\n");
+    error = tensil_driver_run_residency_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing model descriptors...\n");
+    error = tensil_driver_run_model_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing program map...\n");
+    error = tensil_driver_run_program_map_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing tensor views...\n");
+    error = tensil_driver_run_tensor_view_test(&driver, true);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing image loading...\n");
+    error = tensil_driver_run_image_test(&driver, true);
+
     if (error)
         goto cleanup;
 
@@ -419,14 +528,26 @@ int main() {
 
     error = tensil_driver_load_model(&driver, &xor4_model);
 
+    if (error)
+        goto cleanup;
+
+    const struct tensil_tensor *xor4_input;
+    const struct tensil_tensor *xor4_output;
+    error = tensil_model_find_input(&xor4_model, "x", &xor4_input);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&xor4_model, "Identity", &xor4_output);
+
     if (error)
         goto cleanup;
 
     for (int x0 = 0; x0 <= 1; x0++)
         for (int x1 = 0; x1 <= 1; x1++) {
             float x[] = {x0, x1};
-            error = tensil_driver_load_model_input_scalars(&driver, &xor4_model,
-                                                           "x", 2, x);
+            error = tensil_driver_load_model_input_scalars(&driver, xor4_input,
+                                                           2, x);
 
             if (error)
                 goto cleanup;
@@ -436,13 +557,15 @@ int main() {
             if (error)
                 goto cleanup;
 
-            error = tensil_driver_print_model_output_vectors(
-                &driver, &xor4_model, "Identity");
+            error =
+                tensil_driver_print_model_output_vectors(&driver, xor4_output);
 
             if (error)
                 goto cleanup;
         }
 
+    tensil_model_free(&xor4_model);
+
     printf("ResNet20V2 ---------------------------------------\n");
 
     struct tensil_model resnet20v2_model;
@@ -454,11 +577,25 @@ int main() {
 
     error = tensil_driver_load_model(&driver, &resnet20v2_model);
 
+    if (error)
+        goto cleanup;
+
+    const struct tensil_tensor *resnet20v2_input;
+    const struct tensil_tensor *resnet20v2_output;
+    error =
+        tensil_model_find_input(&resnet20v2_model, "x:0", &resnet20v2_input);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&resnet20v2_model, "Identity:0",
+                                     &resnet20v2_output);
+
     if (error)
         goto cleanup;
 
     error = tensil_driver_load_model_input_from_file(
-        &driver, &resnet20v2_model, "x:0", "resnet_input_1x32x32x32.tdata");
+        &driver, resnet20v2_input, "resnet_input_1x32x32x32.tdata");
 
     if (error)
         goto cleanup;
@@ -475,16 +612,15 @@ int main() {
     if (error)
         goto cleanup;
 
-    error = tensil_driver_print_model_output_vectors(&driver, &resnet20v2_model,
-                                                     "Identity:0");
+    error =
+        tensil_driver_print_model_output_vectors(&driver, resnet20v2_output);
 
     if (error)
         goto cleanup;
 
     float cifar_result[CIFAR_CLASSES_SIZE];
     error = tensil_driver_get_model_output_scalars(
-        &driver, &resnet20v2_model, "Identity:0", CIFAR_CLASSES_SIZE,
-        cifar_result);
+        &driver, resnet20v2_output, CIFAR_CLASSES_SIZE, cifar_result);
 
     if (error)
         goto cleanup;
@@ -498,6 +634,8 @@ int main() {
     if (error)
         goto cleanup;
 
+    tensil_model_free(&resnet20v2_model);
+
     printf("YoloV4-tiny ---------------------------------------\n");
 
     struct tensil_model yolov4_tiny_model;
@@ -509,11 +647,33 @@ int main() {
 
     error = tensil_driver_load_model(&driver, &yolov4_tiny_model);
 
+    if (error)
+        goto cleanup;
+
+    const struct tensil_tensor *yolov4_tiny_input;
+    const struct tensil_tensor *yolov4_tiny_outputs[2];
+    error =
+        tensil_model_find_input(&yolov4_tiny_model, "x:0", &yolov4_tiny_input);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&yolov4_tiny_model,
+                                     "model/conv2d_17/BiasAdd:0",
+                                     &yolov4_tiny_outputs[0]);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&yolov4_tiny_model,
+                                     "model/conv2d_20/BiasAdd:0",
+                                     &yolov4_tiny_outputs[1]);
+
     if (error)
         goto cleanup;
 
     error = tensil_driver_load_model_input_from_file(
-        &driver, &yolov4_tiny_model, "x:0", "yolo_input_1x416x416x32.tdata");
+        &driver, yolov4_tiny_input, "yolo_input_1x416x416x32.tdata");
 
     if (error)
         goto cleanup;
@@ -529,18 +689,20 @@ int main() {
     if (error)
         goto cleanup;
 
-    error = tensil_driver_print_model_output_vectors(
-        &driver, &yolov4_tiny_model, "model/conv2d_17/BiasAdd:0");
+    error = tensil_driver_print_model_output_vectors(&driver,
+                                                     yolov4_tiny_outputs[0]);
 
     if (error)
         goto cleanup;
 
-    error = tensil_driver_print_model_output_vectors(
-        &driver, &yolov4_tiny_model, "model/conv2d_20/BiasAdd:0");
+    error = tensil_driver_print_model_output_vectors(&driver,
+                                                     yolov4_tiny_outputs[1]);
 
     if (error)
         goto cleanup;
 
+    tensil_model_free(&yolov4_tiny_model);
+
     printf("ResNet50V2 ---------------------------------------\n");
 
     error = load_imagenet_classes_from_file("imagenet_classes.txt");
@@ -557,6 +719,20 @@ int main() {
 
     error = tensil_driver_load_model(&driver, &resnet50v2_model);
 
+    if (error)
+        goto cleanup;
+
+    const struct tensil_tensor *resnet50v2_input;
+    const struct tensil_tensor *resnet50v2_output;
+    error =
+        tensil_model_find_input(&resnet50v2_model, "x:0", &resnet50v2_input);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&resnet50v2_model, "Identity:0",
+                                     &resnet50v2_output);
+
     if (error)
         goto cleanup;
 
@@ -572,7 +748,7 @@ int main() {
                  "resnet_input_1x224x224x32_%d.tdata", i);
 
         error = tensil_driver_load_model_input_from_file(
-            &driver, &resnet50v2_model, "x:0", file_name_buffer);
+            &driver, resnet50v2_input, file_name_buffer);
 
         if (error)
             goto cleanup;
@@ -582,16 +758,15 @@ int main() {
         if (error)
             goto cleanup;
 
-        error = tensil_driver_print_model_output_vectors(
-            &driver, &resnet50v2_model, "Identity:0");
+        error = tensil_driver_print_model_output_vectors(&driver,
+                                                         resnet50v2_output);
 
         if (error)
             goto cleanup;
 
         float imagenet_result[IMAGENET_CLASSES_SIZE];
         error = tensil_driver_get_model_output_scalars(
-            &driver, &resnet50v2_model, "Identity:0", IMAGENET_CLASSES_SIZE,
-            imagenet_result);
+            &driver, resnet50v2_output, IMAGENET_CLASSES_SIZE, imagenet_result);
 
         if (error)
             goto cleanup;
@@ -600,6 +775,8 @@ int main() {
         printf("%zu (%s)\n", imagenet_class, imagenet_classes[imagenet_class]);
     }
 
+    tensil_model_free(&resnet50v2_model);
+
 cleanup:
     if (error)
         tensil_error_print(error);
@@ -0,0 +1,399 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+// Host build of the driver running against the software compute unit. The
+// tensil symlink has to be resolved, same as Vitis does for board projects:
+//
+// cp -rL src build
+// gcc -O2 -mavx2 -DTENSIL_TARGET_LINUX_HOST -o tensil_host build/*.c
+//     build/tensil/*.c -lm
+//
+// Without -mavx2 the compute unit falls back to scalar kernels. Adding
+// -DTENSIL_PLATFORM_ENABLE_INTERRUPTS runs the driver in interrupt mode with
+// completion interrupts simulated by the compute unit.
+//
+// Given the .tmap file of a model followed by .tsample files saved on the
+// board, prints samples and bound per layer of the model and port
+// utilization of the whole run instead of running tests:
+//
+// tensil_host model.tmap run0.tsample run1.tsample
+//
+// Given the .tmodel manifest of a model followed by a .tsample file and
+// optionally the compute unit clock in MHz and the sample interval in cycles
+// the run was taken with, converts samples to run.json trace for Perfetto or
+// chrome://tracing and run.pprof profile:
+//
+// tensil_host model.tmodel run.tsample 100 1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tensil/driver.h"
+#include "tensil/model.h"
+#include "tensil/program_map.h"
+#include "tensil/sample_buffer.h"
+
+#include "sample_trace.h"
+
+static double elapsed_us(const struct timespec *start,
+                         const struct timespec *stop) {
+    return (double)(stop->tv_sec - start->tv_sec) * 1e6 +
+           (double)(stop->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static tensil_error_t
+tensil_driver_run_timed(struct tensil_driver *driver,
+                        const struct tensil_run_opts *run_opts) {
+    struct timespec start, stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    tensil_error_t error = tensil_driver_run(driver, run_opts);
+
+    if (error)
+        return error;
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    printf("Program run took %.2f us\n", elapsed_us(&start, &stop));
+
+    return TENSIL_ERROR_NONE;
+}
+
+static bool has_extension(const char *file_name, const char *extension) {
+    size_t length = strlen(file_name);
+    size_t extension_length = strlen(extension);
+
+    return length > extension_length &&
+           strcmp(file_name + length - extension_length, extension) == 0;
+}
+
+static tensil_error_t profile_samples(const char *map_file_name,
+                                      char **sample_file_names,
+                                      size_t sample_files_size) {
+    struct tensil_program_map map;
+    struct tensil_layer_profile profile;
+    tensil_error_t error = tensil_program_map_from_file(&map, map_file_name);
+
+    if (error)
+        return error;
+
+    error = tensil_layer_profile_init(&profile, &map);
+
+    if (error)
+        goto cleanup;
+
+    for (size_t i = 0; i < sample_files_size; i++) {
+        error = tensil_layer_profile_fold_file(
+            &profile, sample_file_names[i],
+            TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+
+        if (error)
+            goto cleanup;
+    }
+
+    tensil_layer_profile_print(&profile);
+
+    struct tensil_bottleneck_counts bottleneck =
+        profile.unmapped_counts.bottleneck;
+
+    for (size_t i = 0; i < map.layers_size; i++)
+        tensil_bottleneck_counts_merge(&bottleneck,
+                                       &profile.counts[i].bottleneck);
+
+    tensil_bottleneck_counts_print(&bottleneck);
+
+cleanup:
+    tensil_layer_profile_free(&profile);
+    tensil_program_map_free(&map);
+
+    return error;
+}
+
+static tensil_error_t convert_samples(const char *model_file_name,
+                                      const char *sample_file_name,
+                                      size_t clock_mhz,
+                                      uint32_t interval_cycles) {
+    struct sample_trace trace;
+    char file_name[FF_MAX_LFN];
+    size_t length = strlen(sample_file_name);
+    size_t extension_length = strlen(".tsample");
+
+    // Output file names replace the .tsample extension
+    if (!has_extension(sample_file_name, ".tsample") ||
+        length - extension_length + strlen(".pprof") >= FF_MAX_LFN)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Invalid sample file name %s",
+                                   sample_file_name);
+
+    size_t base_length = length - extension_length;
+    tensil_error_t error =
+        sample_trace_load(&trace, model_file_name, sample_file_name,
+                          clock_mhz, interval_cycles);
+
+    if (error)
+        return error;
+
+    memcpy(file_name, sample_file_name, base_length);
+
+    strcpy(file_name + base_length, ".json");
+    error = sample_trace_write_chrome(&trace, file_name);
+
+    if (error)
+        goto cleanup;
+
+    printf("Wrote %s\n", file_name);
+
+    strcpy(file_name + base_length, ".pprof");
+    error = sample_trace_write_pprof(&trace, file_name);
+
+    if (error)
+        goto cleanup;
+
+    printf("Wrote %s\n", file_name);
+
+cleanup:
+    sample_trace_free(&trace);
+
+    return error;
+}
+
+static const char *data_type_to_string(enum tensil_data_type type) {
+    switch (type) {
+    case TENSIL_DATA_TYPE_FP16BP8:
+    default:
+        return "FP16BP8";
+    }
+}
+
+static tensil_error_t run_model(struct tensil_driver *driver,
+                                const char *model_file_name,
+                                const char *input_file_name) {
+    struct tensil_model model;
+    tensil_error_t error =
+        has_extension(model_file_name, ".tbundle")
+            ? tensil_model_from_bundle_file(&model, model_file_name)
+            : tensil_model_from_file(&model, model_file_name);
+
+    if (error)
+        return error;
+
+    error = tensil_driver_load_model(driver, &model);
+
+    if (error)
+        goto cleanup;
+
+    if (input_file_name) {
+        error = tensil_driver_load_model_input_from_file(
+            driver, &model.input_tensors[0], input_file_name);
+
+        if (error)
+            goto cleanup;
+    }
+
+    error = tensil_driver_run_timed(driver, NULL);
+
+    if (error)
+        goto cleanup;
+
+    for (size_t i = 0; i < model.output_tensors_size; i++) {
+        error = tensil_driver_print_model_output_vectors(
+            driver, &model.output_tensors[i]);
+
+        if (error)
+            goto cleanup;
+    }
+
+cleanup:
+    tensil_model_free(&model);
+
+    return error;
+}
+
+int main(int argc, char **argv) {
+    struct tensil_driver driver;
+    tensil_error_t error;
+
+    if (argc > 2 && has_extension(argv[1], ".tmap")) {
+        error = profile_samples(argv[1], argv + 2, argc - 2);
+        goto cleanup;
+    }
+
+    if (argc > 2 && has_extension(argv[2], ".tsample")) {
+        error = convert_samples(argv[1], argv[2],
+                                argc > 3 ? (size_t)atoi(argv[3]) : 0,
+                                argc > 4 ? (uint32_t)atoi(argv[4]) : 0);
+        goto cleanup;
+    }
+
+    error = tensil_driver_init(&driver);
+
+    if (error)
+        goto cleanup;
+
+    printf("HOST ---------------------------------------\n");
+    printf("Array (vector) size:               %zu\n", driver.arch.array_size);
+    printf("Data type:                         %s\n",
+           data_type_to_string(driver.arch.data_type));
+    printf("Local memory size (vectors):       %zu\n", driver.arch.local_depth);
+    printf("Accumulator memory size (vectors): %zu\n",
+           driver.arch.accumulator_depth);
+    printf("DRAM0 size (vectors):              %zu\n", driver.arch.dram0_depth);
+    printf("DRAM1 size (vectors):              %zu\n", driver.arch.dram1_depth);
+    printf("Stride #0:                         %zu\n",
+           driver.arch.stride0_depth);
+    printf("Stride #1:                         %zu\n",
+           driver.arch.stride1_depth);
+    printf("SIMD registers:                    %zu\n",
+           driver.arch.simd_registers_depth);
+    printf("Program buffer size (bytes):       %zu\n", driver.buffer.size);
+    printf("DRAM0 size (bytes):                %zu\n", driver.dram0_size);
+    printf("DRAM1 size (bytes):                %zu\n", driver.dram1_size);
+
+    printf("Testing memory (DRAM0 -> DRAM0)...\n");
+    error = tensil_driver_run_memory_test(&driver, TENSIL_DRAM0, TENSIL_DRAM0,
+                                          false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing memory (DRAM1 -> DRAM0)...\n");
+    error = tensil_driver_run_memory_test(&driver, TENSIL_DRAM1, TENSIL_DRAM0,
+                                          false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing systolic array...\n");
+    error = tensil_driver_run_array_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing MAC kernel...\n");
+    error = tensil_emulator_run_mac_test(false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing SIMD...\n");
+    error = tensil_driver_run_simd_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing conversion...\n");
+    error = tensil_driver_run_conversion_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing pipeline...\n");
+    error = tensil_driver_run_pipeline_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing segmented tensors...\n");
+    error = tensil_driver_run_segmented_tensor_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing instruction encoding...\n");
+    error = tensil_driver_run_instruction_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing fence...\n");
+    error = tensil_driver_run_fence_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing bottleneck classification...\n");
+    error = tensil_driver_run_bottleneck_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing adaptive sampling...\n");
+    error = tensil_driver_run_adaptive_sampling_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing streaming...\n");
+    error = tensil_driver_run_streaming_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing model bundle...\n");
+    error = tensil_driver_run_bundle_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing resident models...\n");
+    error = tensil_driver_run_residency_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing model descriptors...\n");
+    error = tensil_driver_run_model_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing program map...\n");
+    error = tensil_driver_run_program_map_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing sample trace...\n");
+    error = sample_trace_run_test(false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing tensor views...\n");
+    error = tensil_driver_run_tensor_view_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing image loading...\n");
+    error = tensil_driver_run_image_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    printf("Testing sample aggregates...\n");
+    error = tensil_driver_run_sample_aggregates_test(&driver, false);
+
+    if (error)
+        goto cleanup;
+
+    if (argc > 1) {
+        printf("%s ---------------------------------------\n", argv[1]);
+
+        error = run_model(&driver, argv[1], argc > 2 ? argv[2] : NULL);
+
+        if (error)
+            goto cleanup;
+    }
+
+cleanup:
+    if (error) {
+        tensil_error_print(error);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,999 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "sample_trace.h"
+
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tensil/cJSON.h"
+#include "tensil/compression.h"
+#include "tensil/instruction.h"
+#include "tensil/model.h"
+#include "tensil/sample_buffer.h"
+
+#define OPCODES_SIZE 16
+#define UNITS_SIZE 8
+#define NO_STATE -1
+
+// Program counters outside of the program, such as the driver's config
+// instruction preceding it, share the bucket past the last instruction.
+#define DRIVER_OPCODE OPCODES_SIZE
+
+// Chrome trace lanes (thread ids) in the order they are displayed. Unit
+// lanes follow the flow of data from the instruction port to the array, in
+// reverse of the order of unit bits in the flags.
+enum trace_lane { LANE_LAYER = 1, LANE_OPCODE, LANE_UNIT0 };
+
+// Strings at fixed indices of the pprof string table, followed by opcode
+// names and then layer names
+enum profile_string {
+    STRING_EMPTY = 0,
+    STRING_SAMPLES,
+    STRING_CYCLES,
+    STRING_COUNT,
+    STRING_INSTRUCTION,
+    STRING_RUN,
+    STRING_STALL,
+    STRING_OPCODES
+};
+
+// Fields of perftools.profiles.Profile, see
+// https://github.com/google/pprof/blob/main/proto/profile.proto
+enum profile_field {
+    PROFILE_SAMPLE_TYPE = 1,
+    PROFILE_SAMPLE = 2,
+    PROFILE_LOCATION = 4,
+    PROFILE_FUNCTION = 5,
+    PROFILE_STRING_TABLE = 6,
+    PROFILE_PERIOD_TYPE = 11,
+    PROFILE_PERIOD = 12
+};
+
+enum value_type_field { VALUE_TYPE_TYPE = 1, VALUE_TYPE_UNIT };
+
+enum sample_field { SAMPLE_LOCATION_ID = 1, SAMPLE_VALUE, SAMPLE_LABEL };
+
+enum label_field { LABEL_KEY = 1, LABEL_STR };
+
+enum location_field { LOCATION_ID = 1, LOCATION_ADDRESS = 3, LOCATION_LINE };
+
+enum line_field { LINE_FUNCTION_ID = 1 };
+
+enum function_field {
+    FUNCTION_ID = 1,
+    FUNCTION_NAME,
+    FUNCTION_SYSTEM_NAME
+};
+
+enum wire_type { WIRE_VARINT = 0, WIRE_BYTES = 2 };
+
+// Order of valid and ready bit pairs in sample flags
+static const char *unit_names[UNITS_SIZE] = {
+    "Array", "Acc",      "Dataflow", "DRAM1",
+    "DRAM0", "MemPortB", "MemPortA", "Instruction"};
+
+enum unit_state { UNIT_TRANSFER = 0, UNIT_STALL, UNIT_WAIT };
+
+static const char *unit_state_names[] = {"Transfer", "Stall", "Wait"};
+
+// Output is accumulated in memory and written to the file at once. Running
+// out of memory is only checked when writing.
+struct out_buffer {
+    uint8_t *ptr;
+    size_t size;
+    size_t capacity;
+    bool is_out_of_memory;
+};
+
+static void out_reserve(struct out_buffer *out, size_t size) {
+    if (out->is_out_of_memory || out->size + size <= out->capacity)
+        return;
+
+    size_t capacity = out->capacity ? out->capacity : 4096;
+
+    while (capacity < out->size + size)
+        capacity *= 2;
+
+    uint8_t *ptr = (uint8_t *)realloc(out->ptr, capacity);
+
+    if (!ptr) {
+        out->is_out_of_memory = true;
+        return;
+    }
+
+    out->ptr = ptr;
+    out->capacity = capacity;
+}
+
+static void out_bytes(struct out_buffer *out, const void *ptr, size_t size) {
+    out_reserve(out, size);
+
+    if (out->is_out_of_memory || !size)
+        return;
+
+    memcpy(out->ptr + out->size, ptr, size);
+    out->size += size;
+}
+
+static void out_printf(struct out_buffer *out, const char *format, ...) {
+    va_list args;
+    char line[256];
+
+    va_start(args, format);
+    int size = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (size < 0)
+        return;
+
+    out_bytes(out, line,
+              (size_t)size < sizeof(line) ? (size_t)size : sizeof(line) - 1);
+}
+
+static void out_free(struct out_buffer *out) {
+    free(out->ptr);
+    memset(out, 0, sizeof(struct out_buffer));
+}
+
+static tensil_error_t out_to_file(const struct out_buffer *out,
+                                  const char *file_name) {
+    FIL fil;
+    FRESULT res;
+    UINT bytes_written;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    if (out->is_out_of_memory)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_write(&fil, out->ptr, out->size, &bytes_written);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (bytes_written != out->size)
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                    "Failed to write %s", file_name);
+
+cleanup:
+    f_close(&fil);
+
+    return error;
+}
+
+static tensil_error_t read_file(const char *file_name, size_t offset,
+                                size_t size, bool is_compressed,
+                                uint8_t **ptr) {
+    FIL fil;
+    FRESULT res;
+    UINT bytes_read;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    *ptr = (uint8_t *)malloc(size ? size : 1);
+
+    if (!*ptr)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_READ);
+    if (res) {
+        free(*ptr);
+        *ptr = NULL;
+        return TENSIL_FS_ERROR(res);
+    }
+
+    res = f_lseek(&fil, offset);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (is_compressed) {
+        error = tensil_compression_read_from_fil(&fil, *ptr, size);
+        goto cleanup;
+    }
+
+    res = f_read(&fil, *ptr, size, &bytes_read);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (bytes_read != size)
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_PROGRAM_SIZE,
+                                    "Truncated %s", file_name);
+
+cleanup:
+    if (error) {
+        free(*ptr);
+        *ptr = NULL;
+    }
+
+    f_close(&fil);
+
+    return error;
+}
+
+tensil_error_t sample_trace_load(struct sample_trace *trace,
+                                 const char *model_file_name,
+                                 const char *sample_file_name,
+                                 size_t clock_mhz, uint32_t interval_cycles) {
+    struct tensil_model model;
+    struct tensil_instruction_layout layout;
+    FILINFO fno;
+    FRESULT res;
+    char file_name[FF_MAX_LFN];
+    size_t length = strlen(model_file_name);
+    const char *extension = strrchr(model_file_name, '.');
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    memset(trace, 0, sizeof(struct sample_trace));
+    trace->clock_mhz = clock_mhz ? clock_mhz : SAMPLE_TRACE_DEFAULT_CLOCK_MHZ;
+    trace->interval_cycles =
+        interval_cycles ? interval_cycles : TENSIL_SAMPLE_INTERVAL_CYCLES;
+
+    error = (extension && strcmp(extension, ".tbundle") == 0)
+                ? tensil_model_from_bundle_file(&model, model_file_name)
+                : tensil_model_from_file(&model, model_file_name);
+
+    if (error)
+        return error;
+
+    tensil_instruction_layout_init(&layout, &model.arch);
+    trace->instruction_size_bytes = layout.instruction_size_bytes;
+    trace->instructions_size = model.prog.size / layout.instruction_size_bytes;
+
+    strcpy(file_name, model.path);
+    strcat(file_name, model.prog.file_name);
+
+    error = read_file(file_name, model.prog.file_offset, model.prog.size,
+                      model.is_compressed, &trace->program);
+
+    if (error)
+        goto cleanup;
+
+    res = f_stat(sample_file_name, &fno);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    trace->samples_size = fno.fsize / TENSIL_SAMPLE_SIZE_BYTES;
+
+    error = read_file(sample_file_name, 0,
+                      trace->samples_size * TENSIL_SAMPLE_SIZE_BYTES, false,
+                      &trace->samples);
+
+    if (error)
+        goto cleanup;
+
+    // Compiler emits model.tmap next to model.tmodel
+    if (extension &&
+        length - strlen(extension) + strlen(".tmap") < FF_MAX_LFN) {
+        strcpy(file_name, model_file_name);
+        strcpy(file_name + (extension - model_file_name), ".tmap");
+
+        if (f_stat(file_name, &fno) == FR_OK)
+            error = tensil_program_map_from_file(&trace->map, file_name);
+    }
+
+cleanup:
+    if (error)
+        sample_trace_free(trace);
+
+    tensil_model_free(&model);
+
+    return error;
+}
+
+void sample_trace_free(struct sample_trace *trace) {
+    free(trace->samples);
+    free(trace->program);
+    tensil_program_map_free(&trace->map);
+    memset(trace, 0, sizeof(struct sample_trace));
+}
+
+static uint16_t get_flags(const struct sample_trace *trace, size_t index) {
+    const uint8_t *ptr = trace->samples + index * TENSIL_SAMPLE_SIZE_BYTES;
+
+    return (uint16_t)ptr[TENSIL_SAMPLE_FLAGS_OFFSET] |
+           ((uint16_t)ptr[TENSIL_SAMPLE_FLAGS_OFFSET + 1] << 8);
+}
+
+// Returns the instruction index or instructions size for program counters
+// outside of the program.
+static size_t get_instruction(const struct sample_trace *trace,
+                              size_t index) {
+    const uint8_t *ptr = trace->samples + index * TENSIL_SAMPLE_SIZE_BYTES;
+    uint32_t program_counter = (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+                               ((uint32_t)ptr[2] << 16) |
+                               ((uint32_t)ptr[3] << 24);
+
+    if (program_counter < TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT ||
+        program_counter - TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT >=
+            trace->instructions_size)
+        return trace->instructions_size;
+
+    return program_counter - TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT;
+}
+
+static int get_opcode(const struct sample_trace *trace, size_t instruction) {
+    if (instruction == trace->instructions_size)
+        return DRIVER_OPCODE;
+
+    return trace->program[(instruction + 1) * trace->instruction_size_bytes -
+                          1] >>
+           4;
+}
+
+static int get_layer(const struct sample_trace *trace, size_t instruction) {
+    const struct tensil_program_map_layer *layer =
+        instruction == trace->instructions_size
+            ? NULL
+            : tensil_program_map_find(&trace->map, instruction);
+
+    return layer ? (int)(layer - trace->map.layers) : NO_STATE;
+}
+
+static const char *opcode_to_string(int opcode) {
+    switch (opcode) {
+    case TENSIL_OPCODE_NOOP:
+        return "NoOp";
+    case TENSIL_OPCODE_MAT_MUL:
+        return "MatMul";
+    case TENSIL_OPCODE_DATA_MOVE:
+        return "DataMove";
+    case TENSIL_OPCODE_LOAD_WEIGHT:
+        return "LoadWeight";
+    case TENSIL_OPCODE_SIMD:
+        return "SIMD";
+    case TENSIL_OPCODE_CONFIG:
+        return "Config";
+    case DRIVER_OPCODE:
+        return "Driver";
+    default:
+        return "???";
+    }
+}
+
+static bool is_stall(uint16_t flags) {
+    return (flags & TENSIL_SAMPLE_FLAG_INSTRUCTION_VALID) &&
+           !(flags & TENSIL_SAMPLE_FLAG_INSTRUCTION_READY);
+}
+
+static void out_json_string(struct out_buffer *out, const char *str) {
+    out_bytes(out, "\"", 1);
+
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+
+        if (c == '"' || c == '\\')
+            out_printf(out, "\\%c", c);
+        else if (c < 0x20)
+            out_printf(out, "\\u%04x", c);
+        else
+            out_bytes(out, str, 1);
+    }
+
+    out_bytes(out, "\"", 1);
+}
+
+static double get_time_us(const struct sample_trace *trace, size_t index) {
+    return (double)index * trace->interval_cycles / trace->clock_mhz;
+}
+
+static void write_lane_name(struct out_buffer *out, enum trace_lane lane,
+                            const char *name) {
+    out_printf(out,
+               ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"tid\":%d,\"args\":{\"name\":",
+               lane);
+    out_json_string(out, name);
+    out_printf(out, "}}");
+}
+
+static void write_slice(struct out_buffer *out,
+                        const struct sample_trace *trace, int lane,
+                        const char *name, size_t begin, size_t end) {
+    out_printf(out, ",\n{\"name\":");
+    out_json_string(out, name);
+    out_printf(out,
+               ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+               "\"dur\":%.3f,\"args\":{\"samples\":%zu}}",
+               lane, get_time_us(trace, begin),
+               get_time_us(trace, end) - get_time_us(trace, begin),
+               end - begin);
+}
+
+// Lane states are layer index, opcode or unit state of each sample
+static int get_lane_state(const struct sample_trace *trace, int lane,
+                          size_t index) {
+    if (lane == LANE_LAYER)
+        return get_layer(trace, get_instruction(trace, index));
+
+    if (lane == LANE_OPCODE)
+        return get_opcode(trace, get_instruction(trace, index));
+
+    int unit = UNITS_SIZE - 1 - (lane - LANE_UNIT0);
+    uint16_t flags = get_flags(trace, index) >> (unit * 2);
+    bool valid = flags & 1;
+    bool ready = flags & 2;
+
+    if (valid && ready)
+        return UNIT_TRANSFER;
+    else if (valid)
+        return UNIT_STALL;
+    else if (ready)
+        return UNIT_WAIT;
+    else
+        return NO_STATE;
+}
+
+static const char *get_lane_state_name(const struct sample_trace *trace,
+                                       int lane, int state) {
+    if (lane == LANE_LAYER)
+        return trace->map.layers[state].name;
+
+    if (lane == LANE_OPCODE)
+        return opcode_to_string(state);
+
+    return unit_state_names[state];
+}
+
+// Consecutive samples in the same state are merged into a single slice
+static void write_lane(struct out_buffer *out,
+                       const struct sample_trace *trace, int lane) {
+    size_t begin = 0;
+    int state = NO_STATE;
+
+    for (size_t i = 0; i <= trace->samples_size; i++) {
+        int next_state =
+            i < trace->samples_size ? get_lane_state(trace, lane, i) : NO_STATE;
+
+        if (i && next_state == state)
+            continue;
+
+        if (state != NO_STATE)
+            write_slice(out, trace, lane,
+                        get_lane_state_name(trace, lane, state), begin, i);
+
+        begin = i;
+        state = next_state;
+    }
+}
+
+tensil_error_t sample_trace_write_chrome(const struct sample_trace *trace,
+                                         const char *file_name) {
+    struct out_buffer out;
+    tensil_error_t error;
+
+    memset(&out, 0, sizeof(struct out_buffer));
+
+    out_printf(&out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                     "\"args\":{\"name\":\"Tensil\"}}");
+
+    if (trace->map.layers_size)
+        write_lane_name(&out, LANE_LAYER, "Layer");
+
+    write_lane_name(&out, LANE_OPCODE, "Opcode");
+
+    for (int k = 0; k < UNITS_SIZE; k++)
+        write_lane_name(&out, LANE_UNIT0 + k, unit_names[UNITS_SIZE - 1 - k]);
+
+    if (trace->map.layers_size)
+        write_lane(&out, trace, LANE_LAYER);
+
+    write_lane(&out, trace, LANE_OPCODE);
+
+    for (int k = 0; k < UNITS_SIZE; k++)
+        write_lane(&out, trace, LANE_UNIT0 + k);
+
+    out_printf(&out, "\n]}\n");
+
+    error = out_to_file(&out, file_name);
+    out_free(&out);
+
+    return error;
+}
+
+static void out_varint(struct out_buffer *out, uint64_t value) {
+    uint8_t bytes[10];
+    size_t size = 0;
+
+    do {
+        bytes[size] = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+        value >>= 7;
+        size++;
+    } while (value);
+
+    out_bytes(out, bytes, size);
+}
+
+static void out_uint_field(struct out_buffer *out, int field,
+                           uint64_t value) {
+    out_varint(out, (uint64_t)field << 3 | WIRE_VARINT);
+    out_varint(out, value);
+}
+
+static void out_bytes_field(struct out_buffer *out, int field,
+                            const void *ptr, size_t size) {
+    out_varint(out, (uint64_t)field << 3 | WIRE_BYTES);
+    out_varint(out, size);
+    out_bytes(out, ptr, size);
+}
+
+// Appends embedded message and resets it for reuse
+static void out_message_field(struct out_buffer *out, int field,
+                              struct out_buffer *message) {
+    if (message->is_out_of_memory)
+        out->is_out_of_memory = true;
+
+    out_bytes_field(out, field, message->ptr, message->size);
+    message->size = 0;
+}
+
+static void out_value_type(struct out_buffer *out, int field,
+                           enum profile_string type,
+                           enum profile_string unit) {
+    struct out_buffer message;
+
+    memset(&message, 0, sizeof(struct out_buffer));
+    out_uint_field(&message, VALUE_TYPE_TYPE, type);
+    out_uint_field(&message, VALUE_TYPE_UNIT, unit);
+    out_message_field(out, field, &message);
+    out_free(&message);
+}
+
+static void out_sample(struct out_buffer *out, struct out_buffer *message,
+                       struct out_buffer *label, uint64_t location_id,
+                       uint32_t count, uint32_t interval_cycles,
+                       enum profile_string instruction) {
+    if (!count)
+        return;
+
+    out_uint_field(label, LABEL_KEY, STRING_INSTRUCTION);
+    out_uint_field(label, LABEL_STR, instruction);
+
+    out_uint_field(message, SAMPLE_LOCATION_ID, location_id);
+    out_uint_field(message, SAMPLE_VALUE, count);
+    out_uint_field(message, SAMPLE_VALUE,
+                   (uint64_t)count * interval_cycles);
+    out_message_field(message, SAMPLE_LABEL, label);
+    out_message_field(out, PROFILE_SAMPLE, message);
+}
+
+static void out_function(struct out_buffer *out, struct out_buffer *message,
+                         uint64_t id, size_t name) {
+    out_uint_field(message, FUNCTION_ID, id);
+    out_uint_field(message, FUNCTION_NAME, name);
+    out_uint_field(message, FUNCTION_SYSTEM_NAME, name);
+    out_message_field(out, PROFILE_FUNCTION, message);
+}
+
+static void out_string(struct out_buffer *out, const char *str) {
+    out_bytes_field(out, PROFILE_STRING_TABLE, str, strlen(str));
+}
+
+tensil_error_t sample_trace_write_pprof(const struct sample_trace *trace,
+                                        const char *file_name) {
+    struct out_buffer out;
+    struct out_buffer message;
+    struct out_buffer line;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    // Location ids are instruction index plus one. Function ids of opcodes
+    // are opcode plus one and layer functions follow them.
+    size_t locations_size = trace->instructions_size + 1;
+    uint64_t layer_function_id = OPCODES_SIZE + 2;
+    uint32_t *counts = (uint32_t *)calloc(locations_size * 2, sizeof(uint32_t));
+
+    if (!counts)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    for (size_t i = 0; i < trace->samples_size; i++) {
+        size_t instruction = get_instruction(trace, i);
+
+        counts[instruction * 2 + is_stall(get_flags(trace, i))]++;
+    }
+
+    memset(&out, 0, sizeof(struct out_buffer));
+    memset(&message, 0, sizeof(struct out_buffer));
+    memset(&line, 0, sizeof(struct out_buffer));
+
+    out_value_type(&out, PROFILE_SAMPLE_TYPE, STRING_SAMPLES, STRING_COUNT);
+    out_value_type(&out, PROFILE_SAMPLE_TYPE, STRING_CYCLES, STRING_COUNT);
+
+    for (size_t i = 0; i < locations_size; i++) {
+        out_sample(&out, &message, &line, i + 1, counts[i * 2],
+                   trace->interval_cycles, STRING_RUN);
+        out_sample(&out, &message, &line, i + 1, counts[i * 2 + 1],
+                   trace->interval_cycles, STRING_STALL);
+    }
+
+    // Opcode is inlined into the layer, so that pprof shows layers as
+    // callers of opcodes
+    for (size_t i = 0; i < locations_size; i++) {
+        if (!counts[i * 2] && !counts[i * 2 + 1])
+            continue;
+
+        int layer = get_layer(trace, i);
+
+        out_uint_field(&message, LOCATION_ID, i + 1);
+        out_uint_field(&message, LOCATION_ADDRESS,
+                       i + TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+
+        out_uint_field(&line, LINE_FUNCTION_ID, get_opcode(trace, i) + 1);
+        out_message_field(&message, LOCATION_LINE, &line);
+
+        if (layer != NO_STATE) {
+            out_uint_field(&line, LINE_FUNCTION_ID, layer_function_id + layer);
+            out_message_field(&message, LOCATION_LINE, &line);
+        }
+
+        out_message_field(&out, PROFILE_LOCATION, &message);
+    }
+
+    for (size_t i = 0; i <= OPCODES_SIZE; i++)
+        out_function(&out, &message, i + 1, STRING_OPCODES + i);
+
+    for (size_t i = 0; i < trace->map.layers_size; i++)
+        out_function(&out, &message, layer_function_id + i,
+                     STRING_OPCODES + OPCODES_SIZE + 1 + i);
+
+    out_string(&out, "");
+    out_string(&out, "samples");
+    out_string(&out, "cycles");
+    out_string(&out, "count");
+    out_string(&out, "instruction");
+    out_string(&out, "run");
+    out_string(&out, "stall");
+
+    for (size_t i = 0; i <= OPCODES_SIZE; i++)
+        out_string(&out, opcode_to_string(i));
+
+    for (size_t i = 0; i < trace->map.layers_size; i++)
+        out_string(&out, trace->map.layers[i].name);
+
+    out_value_type(&out, PROFILE_PERIOD_TYPE, STRING_CYCLES, STRING_COUNT);
+    out_uint_field(&out, PROFILE_PERIOD, trace->interval_cycles);
+
+    if (message.is_out_of_memory || line.is_out_of_memory)
+        out.is_out_of_memory = true;
+
+    error = out_to_file(&out, file_name);
+
+    out_free(&line);
+    out_free(&message);
+    out_free(&out);
+    free(counts);
+
+    return error;
+}
+
+#define TEST_INSTRUCTIONS_SIZE 8
+#define TEST_INSTRUCTION_SIZE_BYTES 8
+#define TEST_LAYERS_SIZE 2
+#define TEST_RUNS_SIZE 5
+#define TEST_CLOCK_MHZ 100
+#define TEST_INTERVAL_CYCLES 1000
+#define TEST_CHROME_FILE_NAME "sample_trace_test.json"
+#define TEST_PPROF_FILE_NAME "sample_trace_test.pprof"
+
+static const char *ok = "\033[38;2;0;255;00mOK\033[39m";
+static const char *failed = "\033[38;2;255;0;00mFAILED\033[39m";
+
+// Instructions 6 and 7 are in no layer
+static struct tensil_program_map_layer test_layers[TEST_LAYERS_SIZE] = {
+    {"conv", 0, 3}, {"relu", 3, 6}};
+
+// Runs of samples of the same instruction or, for NO_STATE, of the driver.
+// Runs of instructions of the same layer make a single slice even when
+// their opcodes differ.
+static const int test_runs[TEST_RUNS_SIZE][2] = {
+    {0, 3}, {1, 2}, {4, 3}, {NO_STATE, 2}, {7, 4}};
+
+// Slices of the layer lane as layer, first sample and samples count
+#define TEST_SLICES_SIZE 2
+static const size_t test_slices[TEST_SLICES_SIZE][3] = {{0, 0, 5},
+                                                        {1, 5, 3}};
+
+static uint64_t in_varint(const uint8_t **ptr, const uint8_t *end) {
+    uint64_t value = 0;
+
+    for (int shift = 0; *ptr < end && shift < 64; shift += 7) {
+        uint8_t byte = *(*ptr)++;
+
+        value |= (uint64_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            break;
+    }
+
+    return value;
+}
+
+// Finds the next field of the message, which has the value when it is a
+// varint and the embedded message otherwise.
+static bool in_field(const uint8_t **ptr, const uint8_t *end, int *field,
+                     uint64_t *value, const uint8_t **message) {
+    if (*ptr >= end)
+        return false;
+
+    uint64_t key = in_varint(ptr, end);
+
+    *field = (int)(key >> 3);
+    *value = in_varint(ptr, end);
+
+    if ((key & 7) == WIRE_BYTES) {
+        if (*value > (uint64_t)(end - *ptr))
+            return false;
+
+        *message = *ptr;
+        *ptr += *value;
+    }
+
+    return true;
+}
+
+static bool is_test_chrome_valid(const struct sample_trace *trace,
+                                 const uint8_t *ptr, size_t size,
+                                 bool verbose) {
+    char *str = (char *)malloc(size + 1);
+    cJSON *json = NULL;
+    const cJSON *event = NULL;
+    size_t slices_size = 0;
+    bool is_valid = str != NULL;
+
+    if (str) {
+        memcpy(str, ptr, size);
+        str[size] = 0;
+        json = cJSON_Parse(str);
+    }
+
+    cJSON_ArrayForEach(event, cJSON_GetObjectItem(json, "traceEvents")) {
+        const cJSON *ph = cJSON_GetObjectItem(event, "ph");
+        const cJSON *tid = cJSON_GetObjectItem(event, "tid");
+
+        if (!cJSON_IsString(ph) || strcmp(ph->valuestring, "X") != 0 ||
+            !cJSON_IsNumber(tid) || tid->valueint != LANE_LAYER)
+            continue;
+
+        if (slices_size == TEST_SLICES_SIZE) {
+            is_valid = false;
+            break;
+        }
+
+        const size_t *slice = test_slices[slices_size++];
+        const cJSON *name = cJSON_GetObjectItem(event, "name");
+        const cJSON *ts = cJSON_GetObjectItem(event, "ts");
+        const cJSON *dur = cJSON_GetObjectItem(event, "dur");
+        const cJSON *samples = cJSON_GetObjectItem(
+            cJSON_GetObjectItem(event, "args"), "samples");
+        double expected_ts =
+            (double)slice[1] * trace->interval_cycles / trace->clock_mhz;
+        double expected_dur =
+            (double)slice[2] * trace->interval_cycles / trace->clock_mhz;
+
+        if (!cJSON_IsString(name) ||
+            strcmp(name->valuestring, test_layers[slice[0]].name) != 0 ||
+            !cJSON_IsNumber(ts) || ts->valuedouble != expected_ts ||
+            !cJSON_IsNumber(dur) || dur->valuedouble != expected_dur ||
+            !cJSON_IsNumber(samples) || samples->valueint != (int)slice[2]) {
+            is_valid = false;
+
+            if (verbose)
+                printf("\t unexpected slice %zu of %s\n", slices_size - 1,
+                       test_layers[slice[0]].name);
+        }
+    }
+
+    if (slices_size != TEST_SLICES_SIZE) {
+        is_valid = false;
+
+        if (verbose)
+            printf("\t %zu layer slices, expected %d\n", slices_size,
+                   TEST_SLICES_SIZE);
+    }
+
+    cJSON_Delete(json);
+    free(str);
+
+    return is_valid;
+}
+
+// Sums samples of locations per layer function, the last line of the
+// location when the opcode is inlined into a layer.
+static bool is_test_pprof_valid(const uint8_t *ptr, size_t size,
+                                const uint32_t *expected_counts,
+                                bool verbose) {
+    const uint8_t *end = ptr + size;
+    uint64_t location_functions[TEST_INSTRUCTIONS_SIZE + 2];
+    uint64_t location_counts[TEST_INSTRUCTIONS_SIZE + 2];
+    uint32_t counts[TEST_LAYERS_SIZE];
+    uint64_t layer_function_id = OPCODES_SIZE + 2;
+    int field;
+    uint64_t value;
+    const uint8_t *message = NULL;
+    bool is_valid = true;
+
+    memset(location_functions, 0, sizeof(location_functions));
+    memset(location_counts, 0, sizeof(location_counts));
+    memset(counts, 0, sizeof(counts));
+
+    while (in_field(&ptr, end, &field, &value, &message)) {
+        const uint8_t *message_ptr = message;
+        const uint8_t *message_end = message + value;
+        uint64_t id = 0;
+        uint64_t count = 0;
+        uint64_t function_id = 0;
+
+        if (field != PROFILE_SAMPLE && field != PROFILE_LOCATION)
+            continue;
+
+        while (in_field(&message_ptr, message_end, &field, &value, &message)) {
+            if (field == SAMPLE_LOCATION_ID || field == LOCATION_ID)
+                id = value;
+            else if (field == SAMPLE_VALUE && !count)
+                count = value;
+            else if (field == LOCATION_LINE) {
+                const uint8_t *line_ptr = message;
+                const uint8_t *line_end = message + value;
+                const uint8_t *line_message = NULL;
+                uint64_t line_value;
+
+                while (in_field(&line_ptr, line_end, &field, &line_value,
+                                &line_message))
+                    if (field == LINE_FUNCTION_ID)
+                        function_id = line_value;
+            }
+        }
+
+        if (!id || id > TEST_INSTRUCTIONS_SIZE + 1)
+            return false;
+
+        location_counts[id] += count;
+
+        if (function_id)
+            location_functions[id] = function_id;
+    }
+
+    for (size_t i = 1; i <= TEST_INSTRUCTIONS_SIZE + 1; i++)
+        if (location_functions[i] >= layer_function_id &&
+            location_functions[i] < layer_function_id + TEST_LAYERS_SIZE)
+            counts[location_functions[i] - layer_function_id] +=
+                (uint32_t)location_counts[i];
+
+    for (size_t i = 0; i < TEST_LAYERS_SIZE; i++)
+        if (counts[i] != expected_counts[i]) {
+            is_valid = false;
+
+            if (verbose)
+                printf("\t %u samples of %s, expected %u\n", counts[i],
+                       test_layers[i].name, expected_counts[i]);
+        }
+
+    return is_valid;
+}
+
+tensil_error_t sample_trace_run_test(bool verbose) {
+    struct sample_trace trace;
+    uint32_t expected_counts[TEST_LAYERS_SIZE];
+    uint8_t *chrome = NULL;
+    uint8_t *pprof = NULL;
+    FILINFO fno;
+    FRESULT res;
+    bool is_chrome_valid = false;
+    bool is_pprof_valid = false;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    memset(&trace, 0, sizeof(struct sample_trace));
+    memset(expected_counts, 0, sizeof(expected_counts));
+
+    for (size_t i = 0; i < TEST_RUNS_SIZE; i++)
+        trace.samples_size += test_runs[i][1];
+
+    trace.samples = (uint8_t *)calloc(trace.samples_size,
+                                      TENSIL_SAMPLE_SIZE_BYTES);
+    trace.program = (uint8_t *)calloc(TEST_INSTRUCTIONS_SIZE,
+                                      TEST_INSTRUCTION_SIZE_BYTES);
+
+    if (!trace.samples || !trace.program) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    trace.instructions_size = TEST_INSTRUCTIONS_SIZE;
+    trace.instruction_size_bytes = TEST_INSTRUCTION_SIZE_BYTES;
+    trace.map.layers = test_layers;
+    trace.map.layers_size = TEST_LAYERS_SIZE;
+    trace.clock_mhz = TEST_CLOCK_MHZ;
+    trace.interval_cycles = TEST_INTERVAL_CYCLES;
+
+    for (size_t i = 0; i < TEST_INSTRUCTIONS_SIZE; i++)
+        trace.program[(i + 1) * TEST_INSTRUCTION_SIZE_BYTES - 1] =
+            (i % 2 ? TENSIL_OPCODE_MAT_MUL : TENSIL_OPCODE_DATA_MOVE) << 4;
+
+    // Program counters of driver samples precede the program
+    for (size_t i = 0, k = 0; i < TEST_RUNS_SIZE; i++)
+        for (int j = 0; j < test_runs[i][1]; j++, k++) {
+            uint8_t *ptr = trace.samples + k * TENSIL_SAMPLE_SIZE_BYTES;
+            uint32_t program_counter =
+                test_runs[i][0] == NO_STATE
+                    ? 0
+                    : test_runs[i][0] + TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT;
+
+            memcpy(ptr, &program_counter, sizeof(uint32_t));
+        }
+
+    for (size_t i = 0; i < TEST_RUNS_SIZE; i++)
+        for (size_t j = 0; j < TEST_LAYERS_SIZE; j++)
+            if (test_runs[i][0] >= (int)test_layers[j].begin &&
+                test_runs[i][0] < (int)test_layers[j].end)
+                expected_counts[j] += test_runs[i][1];
+
+    error = sample_trace_write_chrome(&trace, TEST_CHROME_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    error = sample_trace_write_pprof(&trace, TEST_PPROF_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    res = f_stat(TEST_CHROME_FILE_NAME, &fno);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    error = read_file(TEST_CHROME_FILE_NAME, 0, fno.fsize, false, &chrome);
+
+    if (error)
+        goto cleanup;
+
+    is_chrome_valid = is_test_chrome_valid(&trace, chrome, fno.fsize, verbose);
+
+    res = f_stat(TEST_PPROF_FILE_NAME, &fno);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    error = read_file(TEST_PPROF_FILE_NAME, 0, fno.fsize, false, &pprof);
+
+    if (error)
+        goto cleanup;
+
+    is_pprof_valid =
+        is_test_pprof_valid(pprof, fno.fsize, expected_counts, verbose);
+
+    printf("%s\n", (is_chrome_valid && is_pprof_valid) ? ok : failed);
+
+cleanup:
+    // Layers are not allocated
+    memset(&trace.map, 0, sizeof(struct tensil_program_map));
+    sample_trace_free(&trace);
+
+    free(chrome);
+    free(pprof);
+
+    f_unlink(TEST_CHROME_FILE_NAME);
+    f_unlink(TEST_PPROF_FILE_NAME);
+
+    return error;
+}
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tensil/error.h"
+#include "tensil/program_map.h"
+
+#define SAMPLE_TRACE_DEFAULT_CLOCK_MHZ 100
+
+// Samples saved on the board with tensil_sample_buffer_to_file together with
+// the program they were taken of. Samples are taken every interval, which
+// gives the timeline of the run.
+struct sample_trace {
+    uint8_t *samples;
+    size_t samples_size;
+
+    uint8_t *program;
+    size_t instructions_size;
+    size_t instruction_size_bytes;
+
+    // Has no layers when there is no .tmap file next to the manifest
+    struct tensil_program_map map;
+
+    // Compute unit clock that converts cycles to trace time
+    size_t clock_mhz;
+
+    // Run option the samples were taken with, see tensil_run_opts
+    uint32_t interval_cycles;
+};
+
+// Reads the program listed in the .tmodel manifest and the program map
+// emitted next to it. Zero clock and interval stand for
+// SAMPLE_TRACE_DEFAULT_CLOCK_MHZ and TENSIL_SAMPLE_INTERVAL_CYCLES.
+tensil_error_t sample_trace_load(struct sample_trace *trace,
+                                 const char *model_file_name,
+                                 const char *sample_file_name,
+                                 size_t clock_mhz, uint32_t interval_cycles);
+
+void sample_trace_free(struct sample_trace *trace);
+
+// Writes trace event JSON as opened by Perfetto and chrome://tracing. Each
+// of the compute unit ports gets a lane of slices where it transfers (valid
+// and ready), stalls (valid, not ready) or waits (ready, not valid). Opcode
+// and layer of the sampled instruction get a lane each.
+tensil_error_t sample_trace_write_chrome(const struct sample_trace *trace,
+                                         const char *file_name);
+
+// Writes uncompressed pprof profile of samples and cycles per program
+// counter. Each program counter is a location with the opcode inlined into
+// the layer, and samples are labeled with whether the instruction stalled.
+tensil_error_t sample_trace_write_pprof(const struct sample_trace *trace,
+                                        const char *file_name);
+
+// Converts samples of a small program held in memory and checks that the
+// layer lane of the trace merges samples of a layer into slices of the
+// expected time and duration, and that the profile has the samples of each
+// layer.
+tensil_error_t sample_trace_run_test(bool verbose);
@@ -0,0 +1,204 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "adaptive_sampling.h"
+
+#include <string.h>
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+#include <stdio.h>
+#endif
+
+#include "sample_buffer.h"
+
+static uint32_t read_program_counter(const uint8_t *sample_ptr,
+                                     uint32_t program_counter_shift) {
+    uint32_t program_counter =
+        (uint32_t)sample_ptr[0] | ((uint32_t)sample_ptr[1] << 8) |
+        ((uint32_t)sample_ptr[2] << 16) | ((uint32_t)sample_ptr[3] << 24);
+
+    // Driver instructions preceding the program are outside of all ranges
+    if (program_counter < program_counter_shift)
+        return UINT32_MAX;
+
+    return program_counter - program_counter_shift;
+}
+
+void tensil_adaptive_sampling_init(struct tensil_adaptive_sampling *sampling,
+                                   uint32_t interval_cycles,
+                                   uint32_t min_interval_cycles,
+                                   uint32_t target_samples_count,
+                                   uint32_t max_samples_count) {
+    memset(sampling, 0, sizeof(struct tensil_adaptive_sampling));
+
+    // Intervals are kept in the range of the interval register
+    if (interval_cycles > TENSIL_SAMPLE_MAX_INTERVAL_CYCLES)
+        interval_cycles = TENSIL_SAMPLE_MAX_INTERVAL_CYCLES;
+
+    if (min_interval_cycles > interval_cycles)
+        min_interval_cycles = interval_cycles;
+
+    if (!min_interval_cycles)
+        min_interval_cycles = 1;
+
+    if (interval_cycles < min_interval_cycles)
+        interval_cycles = min_interval_cycles;
+
+    sampling->interval_cycles = interval_cycles;
+    sampling->min_interval_cycles = min_interval_cycles;
+    sampling->target_samples_count = target_samples_count;
+    sampling->max_samples_count = max_samples_count;
+}
+
+static void fold(struct tensil_adaptive_sampling *sampling, const uint8_t *ptr,
+                 size_t size, uint32_t program_counter_shift) {
+    size_t samples_size = size / TENSIL_SAMPLE_SIZE_BYTES;
+
+    // Whole program is the range up to the last sampled program counter
+    if (sampling->begin == sampling->end) {
+        sampling->begin = 0;
+
+        for (size_t i = 0; i < samples_size; i++) {
+            uint32_t program_counter = read_program_counter(
+                ptr + i * TENSIL_SAMPLE_SIZE_BYTES, program_counter_shift);
+
+            if (program_counter != UINT32_MAX &&
+                program_counter >= sampling->end)
+                sampling->end = program_counter + 1;
+        }
+    }
+
+    uint32_t range_size = sampling->end - sampling->begin;
+
+    memset(sampling->bin_counts, 0, sizeof(sampling->bin_counts));
+    sampling->samples_count = samples_size;
+    sampling->bins_begin = sampling->begin;
+    sampling->bin_size = (range_size + TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE - 1) /
+                         TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE;
+    sampling->bins_interval_cycles = sampling->interval_cycles;
+
+    if (!sampling->bin_size)
+        return;
+
+    for (size_t i = 0; i < samples_size; i++) {
+        uint32_t program_counter = read_program_counter(
+            ptr + i * TENSIL_SAMPLE_SIZE_BYTES, program_counter_shift);
+
+        if (program_counter >= sampling->begin &&
+            program_counter < sampling->end)
+            sampling->bin_counts[(program_counter - sampling->begin) /
+                                 sampling->bin_size]++;
+    }
+}
+
+// Narrows the range to the window of bins with most samples unless bins
+// already hold single program counters. Returns samples in the new range.
+static uint32_t narrow(struct tensil_adaptive_sampling *sampling) {
+    size_t best_index = 0;
+    uint32_t best_count = 0;
+
+    if (sampling->end - sampling->begin <= TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE) {
+        for (size_t i = 0; i < TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE; i++)
+            best_count += sampling->bin_counts[i];
+
+        return best_count;
+    }
+
+    for (size_t i = 0; i <= TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE -
+                                TENSIL_ADAPTIVE_SAMPLING_WINDOW_SIZE;
+         i++) {
+        uint32_t count = 0;
+
+        for (size_t j = 0; j < TENSIL_ADAPTIVE_SAMPLING_WINDOW_SIZE; j++)
+            count += sampling->bin_counts[i + j];
+
+        if (count > best_count) {
+            best_index = i;
+            best_count = count;
+        }
+    }
+
+    if (!best_count)
+        return 0;
+
+    uint32_t begin = sampling->begin + best_index * sampling->bin_size;
+    uint32_t end =
+        begin + TENSIL_ADAPTIVE_SAMPLING_WINDOW_SIZE * sampling->bin_size;
+
+    sampling->begin = begin;
+
+    if (end < sampling->end)
+        sampling->end = end;
+
+    return best_count;
+}
+
+void tensil_adaptive_sampling_update(struct tensil_adaptive_sampling *sampling,
+                                     const uint8_t *ptr, size_t size,
+                                     uint32_t program_counter_shift) {
+    fold(sampling, ptr, size, program_counter_shift);
+
+    sampling->runs_count++;
+
+    uint32_t hot_count = narrow(sampling);
+
+    if (!hot_count || !sampling->target_samples_count)
+        return;
+
+    // Cycles spent in the range are estimated from its samples
+    uint64_t cycles = (uint64_t)hot_count * sampling->interval_cycles;
+    uint64_t interval_cycles = cycles / sampling->target_samples_count;
+
+    if (interval_cycles < sampling->min_interval_cycles)
+        interval_cycles = sampling->min_interval_cycles;
+
+    if (sampling->max_samples_count) {
+        // Run ends less than an interval past its last sample
+        uint64_t run_cycles = ((uint64_t)sampling->samples_count + 1) *
+                              sampling->interval_cycles;
+        uint64_t budget_interval_cycles =
+            (run_cycles + sampling->max_samples_count - 1) /
+            sampling->max_samples_count;
+
+        if (interval_cycles < budget_interval_cycles)
+            interval_cycles = budget_interval_cycles;
+    }
+
+    if (interval_cycles < sampling->interval_cycles)
+        sampling->interval_cycles = interval_cycles;
+}
+
+bool tensil_adaptive_sampling_is_converged(
+    const struct tensil_adaptive_sampling *sampling) {
+    return sampling->runs_count &&
+           sampling->end - sampling->begin <=
+               TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE &&
+           sampling->interval_cycles == sampling->bins_interval_cycles;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+void tensil_adaptive_sampling_print(
+    const struct tensil_adaptive_sampling *sampling) {
+    printf("Adaptive sampling run %zu: %u samples at %u cycles "
+           "---------------------------------------\n",
+           sampling->runs_count, (unsigned int)sampling->samples_count,
+           (unsigned int)sampling->bins_interval_cycles);
+
+    for (size_t i = 0; i < TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE; i++) {
+        uint32_t begin = sampling->bins_begin + i * sampling->bin_size;
+
+        if (sampling->bin_counts[i])
+            printf("[%08u, %08u) %u\n", (unsigned int)begin,
+                   (unsigned int)(begin + sampling->bin_size),
+                   (unsigned int)sampling->bin_counts[i]);
+    }
+
+    printf("Next run samples [%08u, %08u) at %u cycles%s\n",
+           (unsigned int)sampling->begin, (unsigned int)sampling->end,
+           (unsigned int)sampling->interval_cycles,
+           tensil_adaptive_sampling_is_converged(sampling) ? ", converged"
+                                                           : "");
+}
+
+#endif
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include "platform.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE 64
+
+// Bins of the hot range kept when narrowing it after a run
+#define TENSIL_ADAPTIVE_SAMPLING_WINDOW_SIZE 16
+
+// Profiles a program over repeated runs. The first run is sampled at a
+// coarse interval over the whole program. After each run the range narrows
+// to the window of bins with most samples and the interval is refined so
+// that the range gets the target number of samples in the next run.
+//
+// The compute unit has a single sample interval, so the whole run is
+// sampled at the refined interval. The interval never gets so fine that the
+// whole run takes more than the maximum number of samples, which keeps long
+// programs within the sample buffer while short hot ranges are sampled
+// precisely.
+//
+// Program counters are counted from the start of the program, samples of
+// driver instructions preceding it are only counted towards all samples.
+struct tensil_adaptive_sampling {
+    // Interval and program counter range of the next run, the end is
+    // exclusive. Empty range stands for the whole program.
+    uint32_t interval_cycles;
+    uint32_t begin;
+    uint32_t end;
+
+    uint32_t min_interval_cycles;
+    uint32_t target_samples_count;
+
+    // Zero does not limit the number of samples
+    uint32_t max_samples_count;
+
+    // Samples of the last run over the range it was sampled with
+    uint32_t samples_count;
+    uint32_t bin_counts[TENSIL_ADAPTIVE_SAMPLING_BINS_SIZE];
+    uint32_t bins_begin;
+    uint32_t bin_size;
+    uint32_t bins_interval_cycles;
+
+    size_t runs_count;
+};
+
+// Interval and minimum interval are clamped to the range from one cycle to
+// TENSIL_SAMPLE_MAX_INTERVAL_CYCLES.
+void tensil_adaptive_sampling_init(struct tensil_adaptive_sampling *sampling,
+                                   uint32_t interval_cycles,
+                                   uint32_t min_interval_cycles,
+                                   uint32_t target_samples_count,
+                                   uint32_t max_samples_count);
+
+// Folds samples of a run in the format described in sample_buffer.h and
+// refines interval and range for the next run. Program counter shift is the
+// program counter of the first program instruction.
+void tensil_adaptive_sampling_update(struct tensil_adaptive_sampling *sampling,
+                                     const uint8_t *ptr, size_t size,
+                                     uint32_t program_counter_shift);
+
+// Refinement stops once bins hold single program counters and the interval
+// reaches its minimum or the budget of samples.
+bool tensil_adaptive_sampling_is_converged(
+    const struct tensil_adaptive_sampling *sampling);
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+// Prints samples per bin of the last run and the next interval and range.
+void tensil_adaptive_sampling_print(
+    const struct tensil_adaptive_sampling *sampling);
+
+#endif
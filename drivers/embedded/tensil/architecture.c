@@ -13,7 +13,8 @@
 #include "cJSON.h"
 #endif
 
-#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+#if defined(TENSIL_PLATFORM_ENABLE_FILE_SYSTEM) &&                             \
+    !defined(TENSIL_PLATFORM_HOST)
 #include "ff.h"
 #endif
 
@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "bottleneck.h"
+
+#include <stdbool.h>
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+#include <stdio.h>
+#endif
+
+#define UNIT_VALID(flags, unit) (((flags) >> (2 * (unit))) & 1)
+#define UNIT_READY(flags, unit) (((flags) >> (2 * (unit) + 1)) & 1)
+
+static bool is_busy(uint16_t flags, enum tensil_unit unit) {
+    return UNIT_VALID(flags, unit) && UNIT_READY(flags, unit);
+}
+
+static bool is_backpressured(uint16_t flags, enum tensil_unit unit) {
+    return UNIT_VALID(flags, unit) && !UNIT_READY(flags, unit);
+}
+
+static bool is_starved(uint16_t flags, enum tensil_unit unit) {
+    return !UNIT_VALID(flags, unit) && UNIT_READY(flags, unit);
+}
+
+void tensil_bottleneck_counts_add(struct tensil_bottleneck_counts *counts,
+                                  uint16_t flags, uint32_t count) {
+    bool is_bound = false;
+
+    counts->samples_count += count;
+
+    for (size_t i = 0; i < TENSIL_UNITS_SIZE; i++) {
+        struct tensil_unit_counts *unit_counts = &counts->units[i];
+
+        if (is_backpressured(flags, i))
+            unit_counts->backpressured_count += count;
+        else if (is_starved(flags, i))
+            unit_counts->starved_count += count;
+        else if (is_busy(flags, i))
+            unit_counts->busy_count += count;
+    }
+
+    // Compute units that are busy or backpressured have work offered
+    if (UNIT_VALID(flags, TENSIL_UNIT_ARRAY) ||
+        UNIT_VALID(flags, TENSIL_UNIT_ACC) ||
+        UNIT_VALID(flags, TENSIL_UNIT_DATAFLOW)) {
+        counts->bound_counts[TENSIL_BOUND_COMPUTE] += count;
+        is_bound = true;
+    }
+
+    if (is_backpressured(flags, TENSIL_UNIT_DRAM0) ||
+        is_backpressured(flags, TENSIL_UNIT_DRAM1)) {
+        counts->bound_counts[TENSIL_BOUND_DRAM] += count;
+        is_bound = true;
+    }
+
+    if (is_backpressured(flags, TENSIL_UNIT_MEM_PORT_A) ||
+        is_backpressured(flags, TENSIL_UNIT_MEM_PORT_B)) {
+        counts->bound_counts[TENSIL_BOUND_LOCAL_MEMORY] += count;
+        is_bound = true;
+    }
+
+    if (is_starved(flags, TENSIL_UNIT_INSTRUCTION)) {
+        counts->bound_counts[TENSIL_BOUND_INSTRUCTION_FETCH] += count;
+        is_bound = true;
+    }
+
+    if (!is_bound)
+        counts->bound_counts[TENSIL_BOUND_NONE] += count;
+}
+
+void tensil_bottleneck_counts_merge(
+    struct tensil_bottleneck_counts *counts,
+    const struct tensil_bottleneck_counts *other) {
+    counts->samples_count += other->samples_count;
+
+    for (size_t i = 0; i < TENSIL_UNITS_SIZE; i++) {
+        counts->units[i].busy_count += other->units[i].busy_count;
+        counts->units[i].backpressured_count +=
+            other->units[i].backpressured_count;
+        counts->units[i].starved_count += other->units[i].starved_count;
+    }
+
+    for (size_t i = 0; i < TENSIL_BOUNDS_SIZE; i++)
+        counts->bound_counts[i] += other->bound_counts[i];
+}
+
+enum tensil_bound
+tensil_bottleneck_classify(const struct tensil_bottleneck_counts *counts) {
+    enum tensil_bound bound = TENSIL_BOUND_NONE;
+    uint32_t best_count = 0;
+
+    for (size_t i = TENSIL_BOUND_NONE + 1; i < TENSIL_BOUNDS_SIZE; i++)
+        if (counts->bound_counts[i] > best_count) {
+            bound = (enum tensil_bound)i;
+            best_count = counts->bound_counts[i];
+        }
+
+    return bound;
+}
+
+const char *tensil_bound_to_string(enum tensil_bound bound) {
+    switch (bound) {
+    case TENSIL_BOUND_COMPUTE:
+        return "compute";
+    case TENSIL_BOUND_DRAM:
+        return "DRAM";
+    case TENSIL_BOUND_LOCAL_MEMORY:
+        return "local memory";
+    case TENSIL_BOUND_INSTRUCTION_FETCH:
+        return "instruction fetch";
+    case TENSIL_BOUND_NONE:
+    default:
+        return "-";
+    }
+}
+
+const char *tensil_unit_to_string(enum tensil_unit unit) {
+    switch (unit) {
+    case TENSIL_UNIT_ARRAY:
+        return "Array";
+    case TENSIL_UNIT_ACC:
+        return "Acc";
+    case TENSIL_UNIT_DATAFLOW:
+        return "Dataflow";
+    case TENSIL_UNIT_DRAM1:
+        return "DRAM1";
+    case TENSIL_UNIT_DRAM0:
+        return "DRAM0";
+    case TENSIL_UNIT_MEM_PORT_B:
+        return "MemPortB";
+    case TENSIL_UNIT_MEM_PORT_A:
+        return "MemPortA";
+    case TENSIL_UNIT_INSTRUCTION:
+        return "Instruction";
+    default:
+        return "???";
+    }
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+static void print_share(uint32_t count, uint32_t total_count) {
+    size_t share = total_count ? (size_t)count * 1000 / total_count : 0;
+
+    printf(" %6u.%u%%", (unsigned int)share / 10, (unsigned int)share % 10);
+}
+
+void tensil_bottleneck_counts_print(
+    const struct tensil_bottleneck_counts *counts) {
+    printf("Port utilization ---------------------------------------\n");
+    printf("%-12s %9s %9s %9s\n", "Port", "Busy", "Backpr.", "Starved");
+
+    for (size_t i = TENSIL_UNITS_SIZE; i-- > 0;) {
+        const struct tensil_unit_counts *unit_counts = &counts->units[i];
+
+        printf("%-12s", tensil_unit_to_string(i));
+        print_share(unit_counts->busy_count, counts->samples_count);
+        print_share(unit_counts->backpressured_count, counts->samples_count);
+        print_share(unit_counts->starved_count, counts->samples_count);
+        printf("\n");
+    }
+
+    printf("Bounds ---------------------------------------\n");
+
+    for (size_t i = TENSIL_BOUND_NONE + 1; i < TENSIL_BOUNDS_SIZE; i++) {
+        printf("%-18s", tensil_bound_to_string(i));
+        print_share(counts->bound_counts[i], counts->samples_count);
+        printf("\n");
+    }
+
+    printf("Bound: %s\n",
+           tensil_bound_to_string(tensil_bottleneck_classify(counts)));
+}
+
+#endif
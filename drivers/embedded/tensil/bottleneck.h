@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include "platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Ports in the order of their valid and ready bit pairs in sample flags,
+// see sample_buffer.h.
+enum tensil_unit {
+    TENSIL_UNIT_ARRAY = 0,
+    TENSIL_UNIT_ACC,
+    TENSIL_UNIT_DATAFLOW,
+    TENSIL_UNIT_DRAM1,
+    TENSIL_UNIT_DRAM0,
+    TENSIL_UNIT_MEM_PORT_B,
+    TENSIL_UNIT_MEM_PORT_A,
+    TENSIL_UNIT_INSTRUCTION,
+    TENSIL_UNITS_SIZE
+};
+
+// Resource that holds up a run or a region of the program. Ties between
+// bounds with the same share are broken in the order of the enum.
+enum tensil_bound {
+    TENSIL_BOUND_NONE = 0,
+    TENSIL_BOUND_COMPUTE,
+    TENSIL_BOUND_DRAM,
+    TENSIL_BOUND_LOCAL_MEMORY,
+    TENSIL_BOUND_INSTRUCTION_FETCH,
+    TENSIL_BOUNDS_SIZE
+};
+
+// Port is busy when valid and ready, backpressured when valid but not ready
+// and starved when ready but not valid.
+struct tensil_unit_counts {
+    uint32_t busy_count;
+    uint32_t backpressured_count;
+    uint32_t starved_count;
+};
+
+// Each sample is counted towards every bound it shows:
+//
+//   compute            array, accumulators or dataflow busy or
+//                      backpressured
+//   DRAM               DRAM0 or DRAM1 backpressured
+//   local memory       either local memory port backpressured
+//   instruction fetch  instruction port starved
+//
+// Samples that show none of them are counted towards TENSIL_BOUND_NONE.
+struct tensil_bottleneck_counts {
+    uint32_t samples_count;
+    struct tensil_unit_counts units[TENSIL_UNITS_SIZE];
+    uint32_t bound_counts[TENSIL_BOUNDS_SIZE];
+};
+
+void tensil_bottleneck_counts_add(struct tensil_bottleneck_counts *counts,
+                                  uint16_t flags, uint32_t count);
+
+void tensil_bottleneck_counts_merge(
+    struct tensil_bottleneck_counts *counts,
+    const struct tensil_bottleneck_counts *other);
+
+// Returns the bound with the largest share of samples, or
+// TENSIL_BOUND_NONE when no sample shows any.
+enum tensil_bound
+tensil_bottleneck_classify(const struct tensil_bottleneck_counts *counts);
+
+const char *tensil_bound_to_string(enum tensil_bound bound);
+
+const char *tensil_unit_to_string(enum tensil_unit unit);
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+// Prints busy, backpressured and starved shares of samples per port from
+// the instruction port to the array, followed by the share of each bound
+// and the classification.
+void tensil_bottleneck_counts_print(
+    const struct tensil_bottleneck_counts *counts);
+
+#endif
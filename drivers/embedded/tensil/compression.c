@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "compression.h"
+
+#include <malloc.h>
+#include <string.h>
+
+#if defined(TENSIL_PLATFORM_ENABLE_FILE_SYSTEM) &&                             \
+    !defined(TENSIL_PLATFORM_HOST)
+#include "ff.h"
+#endif
+
+#define LZ4_MIN_MATCH 4
+
+static tensil_error_t invalid_block(void) {
+    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_COMPRESSED_DATA,
+                               "Invalid compressed block");
+}
+
+static bool read_length(const uint8_t **src, const uint8_t *src_end,
+                        size_t *length) {
+    uint8_t byte;
+
+    do {
+        if (*src == src_end)
+            return false;
+
+        byte = *(*src)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+tensil_error_t tensil_compression_decode_block(const uint8_t *src,
+                                               size_t src_size, uint8_t *dst,
+                                               size_t dst_size) {
+    const uint8_t *src_end = src + src_size;
+    uint8_t *dst_start = dst;
+    uint8_t *dst_end = dst + dst_size;
+
+    while (src < src_end) {
+        uint8_t token = *src++;
+        size_t length = token >> 4;
+
+        if (length == 15 && !read_length(&src, src_end, &length))
+            return invalid_block();
+
+        if (length > (size_t)(src_end - src) ||
+            length > (size_t)(dst_end - dst))
+            return invalid_block();
+
+        memcpy(dst, src, length);
+        dst += length;
+        src += length;
+
+        // Last sequence has literals only
+        if (src == src_end)
+            break;
+
+        if (src_end - src < 2)
+            return invalid_block();
+
+        size_t offset = (size_t)src[0] | ((size_t)src[1] << 8);
+        src += 2;
+
+        if (offset == 0 || offset > (size_t)(dst - dst_start))
+            return invalid_block();
+
+        length = token & 0xf;
+
+        if (length == 15 && !read_length(&src, src_end, &length))
+            return invalid_block();
+
+        length += LZ4_MIN_MATCH;
+
+        if (length > (size_t)(dst_end - dst))
+            return invalid_block();
+
+        const uint8_t *match = dst - offset;
+
+        if (offset >= length) {
+            memcpy(dst, match, length);
+            dst += length;
+        } else
+            // Overlapping match repeats last offset bytes
+            while (length--)
+                *dst++ = *match++;
+    }
+
+    if (dst != dst_end)
+        return invalid_block();
+
+    return TENSIL_ERROR_NONE;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+static size_t read_word(const uint8_t *ptr) {
+    return (size_t)ptr[0] | ((size_t)ptr[1] << 8) | ((size_t)ptr[2] << 16) |
+           ((size_t)ptr[3] << 24);
+}
+
+tensil_error_t tensil_compression_read_from_fil(FIL *fil, uint8_t *dst,
+                                                size_t size) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    uint8_t header[TENSIL_COMPRESSION_BLOCK_HEADER_SIZE];
+    uint8_t *block = NULL;
+    size_t offset = 0;
+    FRESULT res;
+    UINT bytes_read;
+
+    while (offset < size) {
+        res = f_read(fil, (void *)header, TENSIL_COMPRESSION_BLOCK_HEADER_SIZE,
+                     &bytes_read);
+        if (res) {
+            error = TENSIL_FS_ERROR(res);
+            goto cleanup;
+        }
+
+        size_t stored_size = read_word(header);
+        size_t decoded_size = read_word(header + 4);
+
+        if (bytes_read != TENSIL_COMPRESSION_BLOCK_HEADER_SIZE ||
+            decoded_size == 0 ||
+            decoded_size > TENSIL_COMPRESSION_BLOCK_SIZE ||
+            decoded_size > size - offset || stored_size > decoded_size) {
+            error = invalid_block();
+            goto cleanup;
+        }
+
+        bool is_stored = stored_size == decoded_size;
+
+        if (!is_stored && !block) {
+            block = (uint8_t *)malloc(TENSIL_COMPRESSION_BLOCK_SIZE);
+
+            if (!block) {
+                error =
+                    TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                        "Out of heap memory");
+                goto cleanup;
+            }
+        }
+
+        res = f_read(fil, is_stored ? (void *)(dst + offset) : (void *)block,
+                     stored_size, &bytes_read);
+        if (res) {
+            error = TENSIL_FS_ERROR(res);
+            goto cleanup;
+        }
+
+        if (bytes_read != stored_size) {
+            error = invalid_block();
+            goto cleanup;
+        }
+
+        if (!is_stored) {
+            error = tensil_compression_decode_block(block, stored_size,
+                                                    dst + offset, decoded_size);
+
+            if (error)
+                goto cleanup;
+        }
+
+        offset += decoded_size;
+    }
+
+cleanup:
+    free(block);
+
+    return error;
+}
+
+#endif
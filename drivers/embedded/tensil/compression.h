@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+
+// Compressed sections are sequences of blocks of up to
+// TENSIL_COMPRESSION_BLOCK_SIZE decoded bytes. Each block starts with
+// little-endian 32-bit stored and decoded sizes. Block with stored size less
+// than decoded size is LZ4 encoded, otherwise it is stored as is.
+#define TENSIL_COMPRESSION_BLOCK_SIZE (1 << 16)
+#define TENSIL_COMPRESSION_BLOCK_HEADER_SIZE 8
+
+// Decodes LZ4 block of src_size bytes into exactly dst_size bytes.
+tensil_error_t tensil_compression_decode_block(const uint8_t *src,
+                                               size_t src_size, uint8_t *dst,
+                                               size_t dst_size);
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Reads compressed section of size decoded bytes from already open file.
+// Stored blocks are read straight into dst, encoded blocks are read into a
+// staging block and decoded into dst.
+tensil_error_t tensil_compression_read_from_fil(FIL *fil, uint8_t *dst,
+                                                size_t size);
+
+#endif
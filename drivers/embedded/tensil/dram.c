@@ -8,10 +8,23 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef TENSIL_PLATFORM_HOST
+#include "host.h"
+#else
 #include "xil_cache.h"
 #include "xstatus.h"
+#endif
 
-#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+#include "compression.h"
+
+#if defined(TENSIL_PLATFORM_ENABLE_FILE_SYSTEM) &&                             \
+    !defined(TENSIL_PLATFORM_HOST)
 #include "ff.h"
 #endif
 
@@ -23,31 +36,173 @@ static const float fp16bp8_min = (float)INT16_MIN / fp16bp8_ratio;
 static const float fp16bp8_error = 0.2;
 typedef int16_t fp16bp8_bits;
 
+static float fp16bp8_to_float(fp16bp8_bits x) {
+    return (float)x / fp16bp8_ratio;
+}
+
+static fp16bp8_bits float_to_fp16bp8(float x) {
+    float y = roundf(x * fp16bp8_ratio);
+
+    if (isnan(y))
+        return 0;
+
+    return y > INT16_MAX ? INT16_MAX : y < INT16_MIN ? INT16_MIN : y;
+}
+
+static void read_fp16bp8_reference(const fp16bp8_bits *ptr, size_t size,
+                                   float *buffer) {
+    for (size_t i = 0; i < size; i++)
+        buffer[i] = fp16bp8_to_float(ptr[i]);
+}
+
+static void write_fp16bp8_reference(fp16bp8_bits *ptr, size_t size,
+                                    const float *buffer) {
+    for (size_t i = 0; i < size; i++)
+        ptr[i] = float_to_fp16bp8(buffer[i]);
+}
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+static size_t read_fp16bp8_vectorized(const fp16bp8_bits *ptr, size_t size,
+                                      float *buffer) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        int16x8_t x = vld1q_s16(ptr + i);
+
+        vst1q_f32(buffer + i,
+                  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))),
+                              1 / fp16bp8_ratio));
+        vst1q_f32(buffer + i + 4,
+                  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))),
+                              1 / fp16bp8_ratio));
+    }
+
+    return i;
+}
+
+// vcvtaq rounds to nearest with ties away from zero same as roundf,
+// converts NaN to zero and saturates to 32 bits. vqmovn then saturates to
+// 16 bits.
+static size_t write_fp16bp8_vectorized(fp16bp8_bits *ptr, size_t size,
+                                       const float *buffer) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        int32x4_t lo = vcvtaq_s32_f32(
+            vmulq_n_f32(vld1q_f32(buffer + i), fp16bp8_ratio));
+        int32x4_t hi = vcvtaq_s32_f32(
+            vmulq_n_f32(vld1q_f32(buffer + i + 4), fp16bp8_ratio));
+
+        vst1q_s16(ptr + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+
+    return i;
+}
+
+#elif defined(__SSE2__)
+
+static __m128 fp16bp8_to_float_sse2(__m128i x) {
+    return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1 / fp16bp8_ratio));
+}
+
+static size_t read_fp16bp8_vectorized(const fp16bp8_bits *ptr, size_t size,
+                                      float *buffer) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(ptr + i));
+
+        // Sign extend by placing 16 bits in the upper half of 32-bit lanes
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+        _mm_storeu_ps(buffer + i, fp16bp8_to_float_sse2(lo));
+        _mm_storeu_ps(buffer + i + 4, fp16bp8_to_float_sse2(hi));
+    }
+
+    return i;
+}
+
+// SSE2 has no rounding with ties away from zero, so the value is clamped,
+// truncated and then adjusted by the sign when the exact remainder is at
+// least one half. NaN is masked to zero before clamping.
+static __m128i float_to_fp16bp8_sse2(__m128 x) {
+    __m128 y = _mm_mul_ps(x, _mm_set1_ps(fp16bp8_ratio));
+    y = _mm_and_ps(y, _mm_cmpord_ps(y, y));
+    y = _mm_min_ps(_mm_max_ps(y, _mm_set1_ps(INT16_MIN)),
+                   _mm_set1_ps(INT16_MAX));
+
+    __m128i truncated = _mm_cvttps_epi32(y);
+    __m128 remainder = _mm_sub_ps(y, _mm_cvtepi32_ps(truncated));
+
+    truncated = _mm_sub_epi32(
+        truncated,
+        _mm_castps_si128(_mm_cmpge_ps(remainder, _mm_set1_ps(0.5f))));
+    truncated = _mm_add_epi32(
+        truncated,
+        _mm_castps_si128(_mm_cmple_ps(remainder, _mm_set1_ps(-0.5f))));
+
+    return truncated;
+}
+
+static size_t write_fp16bp8_vectorized(fp16bp8_bits *ptr, size_t size,
+                                       const float *buffer) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+        _mm_storeu_si128(
+            (__m128i *)(ptr + i),
+            _mm_packs_epi32(
+                float_to_fp16bp8_sse2(_mm_loadu_ps(buffer + i)),
+                float_to_fp16bp8_sse2(_mm_loadu_ps(buffer + i + 4))));
+
+    return i;
+}
+
+#else
+
+static size_t read_fp16bp8_vectorized(const fp16bp8_bits *ptr, size_t size,
+                                      float *buffer) {
+    return 0;
+}
+
+static size_t write_fp16bp8_vectorized(fp16bp8_bits *ptr, size_t size,
+                                       const float *buffer) {
+    return 0;
+}
+
+#endif
+
 static void read_fp16bp8(const uint8_t *bank_ptr, size_t offset, size_t size,
                          float *buffer) {
     const uint8_t *base_ptr = bank_ptr + offset * FP16BP8_SIZE;
     Xil_DCacheFlushRange((UINTPTR)base_ptr, size * FP16BP8_SIZE);
 
-    for (size_t i = 0; i < size; i++) {
-        buffer[i] =
-            ((float)*((const fp16bp8_bits *)(base_ptr + i * FP16BP8_SIZE))) /
-            fp16bp8_ratio;
-    }
+    const fp16bp8_bits *ptr = (const fp16bp8_bits *)base_ptr;
+    size_t i = read_fp16bp8_vectorized(ptr, size, buffer);
+
+    read_fp16bp8_reference(ptr + i, size - i, buffer + i);
 }
 
 static void write_fp16bp8(uint8_t *bank_ptr, size_t offset, size_t size,
                           const float *buffer) {
     uint8_t *base_ptr = bank_ptr + offset * FP16BP8_SIZE;
-    memset((void *)base_ptr, 0, size * FP16BP8_SIZE);
 
-    for (size_t i = 0; i < size; i++) {
-        *((fp16bp8_bits *)(base_ptr + i * FP16BP8_SIZE)) =
-            (fp16bp8_bits)roundf(buffer[i] * fp16bp8_ratio);
-    }
+    fp16bp8_bits *ptr = (fp16bp8_bits *)base_ptr;
+    size_t i = write_fp16bp8_vectorized(ptr, size, buffer);
+
+    write_fp16bp8_reference(ptr + i, size - i, buffer + i);
 
     Xil_DCacheFlushRange((UINTPTR)base_ptr, size * FP16BP8_SIZE);
 }
 
+int16_t tensil_dram_fp16bp8_from_float(float x) {
+    return float_to_fp16bp8(x);
+}
+
+float tensil_dram_fp16bp8_to_float(int16_t x) { return fp16bp8_to_float(x); }
+
 size_t tensil_dram_sizeof_scalar(enum tensil_data_type type) {
     switch (type) {
     case TENSIL_DATA_TYPE_FP16BP8:
@@ -102,6 +257,39 @@ void tensil_dram_write_scalars(uint8_t *bank_ptr, enum tensil_data_type type,
     }
 }
 
+void tensil_dram_read_scalars_reference(const uint8_t *bank_ptr,
+                                        enum tensil_data_type type,
+                                        size_t offset, size_t size,
+                                        float *buffer) {
+    switch (type) {
+    case TENSIL_DATA_TYPE_FP16BP8:
+    default: {
+        const uint8_t *base_ptr = bank_ptr + offset * FP16BP8_SIZE;
+        Xil_DCacheFlushRange((UINTPTR)base_ptr, size * FP16BP8_SIZE);
+
+        read_fp16bp8_reference((const fp16bp8_bits *)base_ptr, size, buffer);
+        break;
+    }
+    }
+}
+
+void tensil_dram_write_scalars_reference(uint8_t *bank_ptr,
+                                         enum tensil_data_type type,
+                                         size_t offset, size_t size,
+                                         const float *buffer) {
+    switch (type) {
+    case TENSIL_DATA_TYPE_FP16BP8:
+    default: {
+        uint8_t *base_ptr = bank_ptr + offset * FP16BP8_SIZE;
+
+        write_fp16bp8_reference((fp16bp8_bits *)base_ptr, size, buffer);
+
+        Xil_DCacheFlushRange((UINTPTR)base_ptr, size * FP16BP8_SIZE);
+        break;
+    }
+    }
+}
+
 void tensil_dram_fill_random(uint8_t *bank_ptr, enum tensil_data_type type,
                              size_t offset, size_t size) {
     uint8_t *base_ptr = bank_ptr + offset * tensil_dram_sizeof_scalar(type);
@@ -175,4 +363,43 @@ tensil_error_t tensil_dram_write_scalars_from_file(uint8_t *bank_ptr,
     return TENSIL_ERROR_NONE;
 }
 
+tensil_error_t tensil_dram_write_scalars_from_fil(uint8_t *bank_ptr,
+                                                  enum tensil_data_type type,
+                                                  size_t offset, size_t size,
+                                                  FIL *fil) {
+    FRESULT res;
+    UINT bytes_read;
+    size_t sizeof_scalar = tensil_dram_sizeof_scalar(type);
+    uint8_t *base_ptr = bank_ptr + offset * sizeof_scalar;
+
+    res = f_read(fil, (void *)base_ptr, size * sizeof_scalar, &bytes_read);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    if (bytes_read != size * sizeof_scalar)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_CONSTS_SIZE,
+                                   "Unexpected end of consts");
+
+    Xil_DCacheFlushRange((UINTPTR)base_ptr, size * sizeof_scalar);
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_dram_write_scalars_from_compressed_fil(
+    uint8_t *bank_ptr, enum tensil_data_type type, size_t offset, size_t size,
+    FIL *fil) {
+    size_t sizeof_scalar = tensil_dram_sizeof_scalar(type);
+    uint8_t *base_ptr = bank_ptr + offset * sizeof_scalar;
+
+    tensil_error_t error =
+        tensil_compression_read_from_fil(fil, base_ptr, size * sizeof_scalar);
+
+    if (error)
+        return error;
+
+    Xil_DCacheFlushRange((UINTPTR)base_ptr, size * sizeof_scalar);
+
+    return TENSIL_ERROR_NONE;
+}
+
 #endif
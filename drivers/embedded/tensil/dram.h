@@ -9,6 +9,13 @@
 #include "architecture.h"
 #include "error.h"
 
+// Conversions of a single FP16BP8 scalar, same as used by functions below.
+// Out of range values saturate and NaN converts to zero.
+
+int16_t tensil_dram_fp16bp8_from_float(float x);
+
+float tensil_dram_fp16bp8_to_float(int16_t x);
+
 size_t tensil_dram_sizeof_scalar(enum tensil_data_type type);
 
 float tensil_dram_max_scalar(enum tensil_data_type type);
@@ -24,6 +31,19 @@ void tensil_dram_read_scalars(const uint8_t *bank_ptr,
 void tensil_dram_write_scalars(uint8_t *bank_ptr, enum tensil_data_type type,
                                size_t offset, size_t size, const float *buffer);
 
+// Same as above but without vectorization, used to check conformance of
+// vectorized conversions.
+
+void tensil_dram_read_scalars_reference(const uint8_t *bank_ptr,
+                                        enum tensil_data_type type,
+                                        size_t offset, size_t size,
+                                        float *buffer);
+
+void tensil_dram_write_scalars_reference(uint8_t *bank_ptr,
+                                         enum tensil_data_type type,
+                                         size_t offset, size_t size,
+                                         const float *buffer);
+
 void tensil_dram_fill_random(uint8_t *bank_ptr, enum tensil_data_type type,
                              size_t offset, size_t size);
 
@@ -41,4 +61,15 @@ tensil_error_t tensil_dram_write_scalars_from_file(uint8_t *bank_ptr,
                                                    size_t offset, size_t size,
                                                    const char *file_name);
 
+// Reads size scalars from already open file.
+tensil_error_t tensil_dram_write_scalars_from_fil(uint8_t *bank_ptr,
+                                                  enum tensil_data_type type,
+                                                  size_t offset, size_t size,
+                                                  FIL *fil);
+
+// Reads size scalars from compressed section of already open file.
+tensil_error_t tensil_dram_write_scalars_from_compressed_fil(
+    uint8_t *bank_ptr, enum tensil_data_type type, size_t offset, size_t size,
+    FIL *fil);
+
 #endif
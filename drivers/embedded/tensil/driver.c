@@ -11,19 +11,47 @@
 #include <stdio.h>
 #endif
 
+#include "adaptive_sampling.h"
+#include "compression.h"
 #include "dram.h"
 #include "instruction_buffer.h"
 #include "model.h"
+#include "program_map.h"
 #include "sample_buffer.h"
 #include "tcu.h"
 
-#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+#if defined(TENSIL_PLATFORM_ENABLE_FILE_SYSTEM) &&                             \
+    !defined(TENSIL_PLATFORM_HOST)
 #include "ff.h"
 #endif
 
+#ifdef TENSIL_PLATFORM_HOST
+#include "host.h"
+#else
+#include "xil_cache.h"
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+#include "xtime_l.h"
+#endif
+#endif
+
 #include "../architecture_params.h"
 
-#define PROGRAM_COUNTER_SHIFT 1
+// Upper bound on spins between polls when waiting for a run
+#define WAIT_MAX_BACKOFF 1024
+
+// Program counters with most samples printed in ring sampling mode
+#define SAMPLING_TOP_SIZE 16
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+static uint64_t get_time_us(void) {
+    XTime xtime;
+
+    XTime_GetTime(&xtime);
+
+    return xtime / (COUNTS_PER_SECOND / 1000000);
+}
+#endif
 
 uint8_t *
 tensil_driver_get_dram_bank_base_ptr(const struct tensil_driver *driver,
@@ -48,202 +76,326 @@ static size_t get_dram_bank_size(const struct tensil_driver *driver,
     }
 }
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-
-static tensil_error_t run_buffer_with_sampling(struct tensil_driver *driver) {
-#ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
-
-    tensil_error_t error = TENSIL_ERROR_NONE;
-    size_t instructions_run_offset = 0;
-    tensil_sample_buffer_reset(&driver->sample_buffer);
+#define FENCE_SOURCE_OFFSET(driver) ((driver)->arch.dram0_depth - 1)
+#define FENCE_TARGET_OFFSET(driver) ((driver)->arch.dram0_depth - 2)
 
-    bool instructions_busy = false;
-    bool sample_busy = false;
+static uint8_t *get_fence_ptr(struct tensil_driver *driver, size_t offset) {
+    return driver->dram0_base_ptr +
+           offset * driver->arch.array_size *
+               tensil_dram_sizeof_scalar(driver->arch.data_type);
+}
 
-    while (instructions_run_offset != driver->buffer.offset) {
-        if (!instructions_busy) {
-            error = tensil_compute_unit_start_instructions(
-                &driver->tcu, &driver->buffer, &instructions_run_offset);
+static tensil_error_t
+append_fence_instructions(struct tensil_driver *driver,
+                          struct tensil_instruction_batch *batch) {
+    size_t local_offset = driver->arch.local_depth - 1;
 
-            if (error)
-                return error;
-        }
+    tensil_error_t error = tensil_batch_append_instruction(
+        batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL,
+        local_offset, FENCE_SOURCE_OFFSET(driver), 0);
 
-        if (!sample_busy) {
-            error = tensil_compute_unit_start_sampling(&driver->tcu,
-                                                       &driver->sample_buffer);
+    if (error)
+        return error;
 
-            if (error)
-                return error;
-        }
+    error = tensil_batch_append_instruction(
+        batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0,
+        local_offset, FENCE_TARGET_OFFSET(driver), 0);
 
-        do {
-            sample_busy = tensil_compute_unit_is_sample_busy(&driver->tcu);
-            instructions_busy =
-                tensil_compute_unit_is_instructions_busy(&driver->tcu);
-        } while (sample_busy && instructions_busy);
+    return error;
+}
 
-        if (!sample_busy)
-            tensil_compute_unit_complete_sampling(&driver->tcu,
-                                                  &driver->sample_buffer);
-    }
+// Only the first word of the fence vectors is written and checked, so that
+// waiting touches a single cache line.
+static void arm_fence(struct tensil_driver *driver, struct tensil_run *run) {
+    uint8_t *source_ptr = get_fence_ptr(driver, FENCE_SOURCE_OFFSET(driver));
+    uint8_t *target_ptr = get_fence_ptr(driver, FENCE_TARGET_OFFSET(driver));
+    uint32_t sequence = ++driver->fence_sequence;
+    uint32_t stale_sequence = ~sequence;
 
-    while (tensil_compute_unit_is_instructions_busy(&driver->tcu)) {
-        if (!sample_busy) {
-            error = tensil_compute_unit_start_sampling(&driver->tcu,
-                                                       &driver->sample_buffer);
+    memcpy(source_ptr, &sequence, sizeof(uint32_t));
+    memcpy(target_ptr, &stale_sequence, sizeof(uint32_t));
 
-            if (error)
-                return error;
-        }
+    Xil_DCacheFlushRange((UINTPTR)source_ptr, sizeof(uint32_t));
+    Xil_DCacheFlushRange((UINTPTR)target_ptr, sizeof(uint32_t));
 
-        sample_busy = tensil_compute_unit_is_sample_busy(&driver->tcu);
+    run->fence_sequence = sequence;
+}
 
-        if (!sample_busy)
-            tensil_compute_unit_complete_sampling(&driver->tcu,
-                                                  &driver->sample_buffer);
-    }
+static bool is_fence_reached(struct tensil_driver *driver,
+                             const struct tensil_run *run) {
+    uint8_t *target_ptr = get_fence_ptr(driver, FENCE_TARGET_OFFSET(driver));
+    uint32_t sequence;
 
-    if (sample_busy) {
-        while (tensil_compute_unit_is_sample_busy(&driver->tcu))
-            ;
+    Xil_DCacheInvalidateRange((UINTPTR)target_ptr, sizeof(uint32_t));
+    memcpy(&sequence, target_ptr, sizeof(uint32_t));
 
-        tensil_compute_unit_complete_sampling(&driver->tcu,
-                                              &driver->sample_buffer);
-    }
+    return sequence == run->fence_sequence;
+}
 
-    return TENSIL_ERROR_NONE;
+static tensil_error_t pad_buffer(struct tensil_driver *driver,
+                                 struct tensil_instruction_batch *batch) {
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    return tensil_batch_pad_to_alignment(
+        batch,
+        tensil_compute_unit_get_instructions_data_width_bytes(&driver->tcu));
 #else
-    return TENSIL_DRIVER_ERROR(
-        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
-        "Target must specify instruction AXI DMA device, see platform.h");
+    return TENSIL_ERROR_NONE;
 #endif
 }
 
-#else
-
 static tensil_error_t
-run_buffer(struct tensil_compute_unit *tcu,
-           const struct tensil_instruction_buffer *buffer) {
-#ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
+append_preamble_instructions(struct tensil_driver *driver,
+                             struct tensil_instruction_batch *batch) {
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    // Interval is set for each run, see set_sample_interval below.
+    if (batch->buffer == &driver->buffer)
+        driver->sample_interval_offset = batch->buffer->offset;
 
-    tensil_error_t error = TENSIL_ERROR_NONE;
-    size_t instructions_run_offset = 0;
+    tensil_error_t error = tensil_batch_append_config_instruction(
+        batch, TENSIL_CONFIG_REGISTER_SAMPLE_INTERVAL,
+        driver->sample_interval_cycles);
 
-    while (instructions_run_offset != buffer->offset) {
-        error = tensil_compute_unit_start_instructions(
-            tcu, buffer, &instructions_run_offset);
+    if (error)
+        return error;
 
-        if (error)
-            return error;
+    // Since config instructions precede the program in the buffer we
+    // need to offset the program counter correspondingly in order for the
+    // sample lookup to be accurate. This assumes the config instruction
+    // is not advancing program counter after setting it, so it has to
+    // come last.
+    error = tensil_batch_append_config_instruction(
+        batch, TENSIL_CONFIG_REGISTER_PROGRAM_COUNTER,
+        TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
 
-        while (tensil_compute_unit_is_instructions_busy(tcu))
-            ;
-    }
+    if (error)
+        return error;
 
-    return TENSIL_ERROR_NONE;
+    if (batch->buffer == &driver->buffer &&
+        batch->buffer->offset != TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT *
+                                     driver->layout.instruction_size_bytes)
+        return TENSIL_DRIVER_ERROR(
+            TENSIL_ERROR_DRIVER_UNEXPECTED_PROGRAM_SIZE,
+            "Preamble of %zu instructions does not match program counter "
+            "shift %d",
+            batch->buffer->offset / driver->layout.instruction_size_bytes,
+            TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
 #else
-    return TENSIL_DRIVER_ERROR(
-        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
-        "Target must specify instruction AXI DMA device, see platform.h");
+    (void)driver;
+    (void)batch;
 #endif
+
+    return TENSIL_ERROR_NONE;
 }
 
-#endif
+static tensil_error_t
+append_postamble_instructions(struct tensil_driver *driver,
+                              struct tensil_instruction_batch *batch) {
+    // Pad before fence instructions so that the program can be run
+    // without them, see pipeline below.
+    tensil_error_t error = pad_buffer(driver, batch);
 
-static void fill_dram_vectors_with_bytes(struct tensil_driver *driver,
-                                         enum tensil_dram_bank dram_bank,
-                                         size_t offset, int byte, size_t size) {
-    uint8_t *bank_ptr = tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
+    if (error)
+        return error;
 
-    tensil_dram_fill_bytes(bank_ptr, driver->arch.data_type,
-                           offset * driver->arch.array_size, byte,
-                           size * driver->arch.array_size);
-}
+    if (batch->buffer == &driver->buffer)
+        driver->postamble_offset = batch->buffer->offset;
+
+    error = append_fence_instructions(driver, batch);
 
-static int compare_dram_vectors_bytes(struct tensil_driver *driver,
-                                      enum tensil_dram_bank dram_bank0,
-                                      enum tensil_dram_bank dram_bank1,
-                                      size_t offset0, size_t offset1,
-                                      size_t size) {
-    uint8_t *bank0_ptr =
-        tensil_driver_get_dram_bank_base_ptr(driver, dram_bank0);
-    uint8_t *bank1_ptr =
-        tensil_driver_get_dram_bank_base_ptr(driver, dram_bank1);
+    if (error)
+        return error;
 
-    return tensil_dram_compare_bytes(
-        bank0_ptr, bank1_ptr, driver->arch.data_type,
-        offset0 * driver->arch.array_size, offset1 * driver->arch.array_size,
-        size * driver->arch.array_size);
+    return pad_buffer(driver, batch);
 }
 
-static tensil_error_t append_flush_instructions(struct tensil_driver *driver) {
-    size_t probe_source_offset = driver->arch.dram0_depth - 1;
-    size_t probe_target_offset = driver->arch.dram0_depth - 2;
-    size_t local_offset = driver->arch.local_depth - 1;
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
 
-    tensil_error_t error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, local_offset, probe_source_offset,
-        0);
+// Rewrites the interval in the preamble of the program buffer, which also
+// precedes the program in pipeline runs. Streamed programs get the interval
+// when the preamble is appended to their first chunk. The buffer is left
+// alone while another run may be executing it, such runs are rejected as
+// busy on submit.
+static tensil_error_t
+set_sample_interval(struct tensil_driver *driver,
+                    const struct tensil_run_opts *run_opts) {
+    uint32_t interval_cycles = TENSIL_SAMPLE_INTERVAL_CYCLES;
+
+    if (run_opts && run_opts->adaptive_sampling)
+        interval_cycles = run_opts->adaptive_sampling->interval_cycles;
+    else if (run_opts && run_opts->sample_interval_cycles)
+        interval_cycles = run_opts->sample_interval_cycles;
+
+    // Sample interval register is 16 bits wide, zero stops sampling
+    if (!interval_cycles ||
+        interval_cycles > TENSIL_SAMPLE_MAX_INTERVAL_CYCLES)
+        return TENSIL_DRIVER_ERROR(
+            TENSIL_ERROR_DRIVER_INVALID_ARGUMENT,
+            "Sample interval of %u cycles is out of range 1 to %d",
+            (unsigned int)interval_cycles,
+            TENSIL_SAMPLE_MAX_INTERVAL_CYCLES);
 
-    if (error)
-        return error;
+    if (driver->active_run)
+        return TENSIL_ERROR_NONE;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, local_offset, probe_target_offset,
-        0);
+    driver->sample_interval_cycles = interval_cycles;
 
-    return error;
-}
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    if (driver->is_streaming)
+        return TENSIL_ERROR_NONE;
+#endif
 
-static void reset_flush_probe(struct tensil_driver *driver) {
-    size_t probe_source_offset = driver->arch.dram0_depth - 1;
-    size_t probe_target_offset = driver->arch.dram0_depth - 2;
+    tensil_instruction_set_all(
+        &driver->layout, driver->buffer.ptr, driver->sample_interval_offset,
+        TENSIL_OPCODE_CONFIG, 0,
+        ((uint64_t)interval_cycles << 4) |
+            TENSIL_CONFIG_REGISTER_SAMPLE_INTERVAL);
 
-    fill_dram_vectors_with_bytes(driver, TENSIL_DRAM0, probe_source_offset, 0,
-                                 1);
-    fill_dram_vectors_with_bytes(driver, TENSIL_DRAM0, probe_target_offset,
-                                 0xff, 1);
+    Xil_DCacheFlushRange(
+        (UINTPTR)(driver->buffer.ptr + driver->sample_interval_offset),
+        driver->layout.instruction_size_bytes);
+
+    return TENSIL_ERROR_NONE;
 }
 
-static void wait_for_flush(struct tensil_driver *driver) {
-    size_t probe_source_offset = driver->arch.dram0_depth - 1;
-    size_t probe_target_offset = driver->arch.dram0_depth - 2;
+#ifndef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+static tensil_error_t service_sampling(struct tensil_driver *driver,
+                                       struct tensil_run *run, bool is_last) {
+    if (run->sample_busy) {
+        if (is_last)
+            while (tensil_compute_unit_is_sample_busy(&driver->tcu))
+                ;
 
-    while (compare_dram_vectors_bytes(driver, TENSIL_DRAM0, TENSIL_DRAM0,
-                                      probe_source_offset, probe_target_offset,
-                                      1) != 0)
-        ;
-}
+        run->sample_busy = tensil_compute_unit_is_sample_busy(&driver->tcu);
 
-tensil_error_t tensil_driver_run(struct tensil_driver *driver,
-                                 const struct tensil_run_opts *run_opts) {
-    reset_flush_probe(driver);
+        if (!run->sample_busy)
+            tensil_compute_unit_complete_sampling(&driver->tcu,
+                                                  &driver->sample_buffer);
+    }
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-    tensil_error_t error = run_buffer_with_sampling(driver);
-#else
-    tensil_error_t error = run_buffer(&driver->tcu, &driver->buffer);
+    if (!run->sample_busy && !is_last) {
+        tensil_error_t error = tensil_compute_unit_start_sampling(
+            &driver->tcu, &driver->sample_buffer);
+
+        if (error)
+            return error;
+
+        run->sample_busy = true;
+    }
+
+    return TENSIL_ERROR_NONE;
+}
 #endif
 
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+static tensil_error_t
+print_layer_profile(struct tensil_driver *driver,
+                    const struct tensil_program_map *program_map) {
+    struct tensil_layer_profile profile;
+    const struct tensil_sample_buffer *sample_buffer = &driver->sample_buffer;
+    const struct tensil_sample_aggregates *aggregates =
+        sample_buffer->aggregates;
+    tensil_error_t error = tensil_layer_profile_init(&profile, program_map);
+
     if (error)
         return error;
 
-    wait_for_flush(driver);
+    profile.interval_cycles = driver->sample_interval_cycles;
+
+    if (aggregates) {
+        // Aggregates keep no flags per program counter, so stalls and
+        // bounds are not counted per layer in ring mode. Program counters
+        // past the end of the counts are unmapped.
+        for (size_t i = 0; i < aggregates->program_counter_counts_size; i++)
+            if (aggregates->program_counter_counts[i])
+                tensil_layer_profile_add(
+                    &profile,
+                    i < TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT
+                        ? UINT32_MAX
+                        : i - TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT,
+                    0, aggregates->program_counter_counts[i]);
+
+        uint32_t counted_count = profile.unmapped_counts.samples_count;
+
+        for (size_t i = 0; i < program_map->layers_size; i++)
+            counted_count += profile.counts[i].samples_count;
+
+        tensil_layer_profile_add(&profile, UINT32_MAX, 0,
+                                 aggregates->valid_samples_count -
+                                     counted_count);
+    } else {
+        const uint8_t *ptr =
+            tensil_sample_buffer_find_valid_samples_ptr(sample_buffer);
+
+        tensil_layer_profile_fold(
+            &profile, ptr, sample_buffer->ptr + sample_buffer->offset - ptr,
+            TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+    }
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    tensil_layer_profile_print(&profile);
+    tensil_layer_profile_free(&profile);
+
+    return TENSIL_ERROR_NONE;
+}
+#endif
+
+static tensil_error_t
+analyze_sampling(struct tensil_driver *driver,
+                 const struct tensil_run_opts *run_opts) {
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+    if (run_opts && run_opts->program_map) {
+        tensil_error_t error =
+            print_layer_profile(driver, run_opts->program_map);
+
+        if (error)
+            return error;
+    }
+#endif
+
+    // In ring mode samples are already folded into aggregates and the
+    // buffer only holds the last blocks.
+    if (driver->sample_buffer.aggregates) {
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+        if (run_opts && (run_opts->print_sampling_summary ||
+                         run_opts->print_sampling_aggregates))
+            tensil_sample_aggregates_print(driver->sample_buffer.aggregates,
+                                           SAMPLING_TOP_SIZE,
+                                           TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+#endif
+
+        return TENSIL_ERROR_NONE;
+    }
+
+    if (run_opts && run_opts->adaptive_sampling) {
+        struct tensil_adaptive_sampling *sampling = run_opts->adaptive_sampling;
+        const uint8_t *ptr =
+            tensil_sample_buffer_find_valid_samples_ptr(&driver->sample_buffer);
+
+        if (!sampling->max_samples_count)
+            sampling->max_samples_count =
+                driver->sample_buffer.size / TENSIL_SAMPLE_SIZE_BYTES;
+
+        tensil_adaptive_sampling_update(
+            sampling, ptr,
+            driver->sample_buffer.ptr + driver->sample_buffer.offset - ptr,
+            TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+        if (run_opts->print_sampling_summary)
+            tensil_adaptive_sampling_print(sampling);
+#endif
+    }
 
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
     if (run_opts && (run_opts->print_sampling_summary ||
                      run_opts->print_sampling_aggregates ||
                      run_opts->print_sampling_listing)) {
         tensil_error_t error = tensil_sample_buffer_print_analysis(
-            &driver->sample_buffer, &driver->buffer, &driver->layout,
+            &driver->sample_buffer, &driver->program, &driver->layout,
             run_opts->print_sampling_summary,
             run_opts->print_sampling_aggregates,
-            run_opts->print_sampling_listing, PROGRAM_COUNTER_SHIFT);
+            run_opts->print_sampling_listing,
+            TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
 
         if (error)
             return error;
@@ -253,7 +405,7 @@ tensil_error_t tensil_driver_run(struct tensil_driver *driver,
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
     if (run_opts && run_opts->sample_file_name) {
         tensil_error_t error = tensil_sample_buffer_to_file(
-            &driver->sample_buffer, &driver->buffer, &driver->layout,
+            &driver->sample_buffer, &driver->program, &driver->layout,
             run_opts->sample_file_name);
 
         if (error)
@@ -261,534 +413,2109 @@ tensil_error_t tensil_driver_run(struct tensil_driver *driver,
     }
 #endif
 
-#endif
     return TENSIL_ERROR_NONE;
 }
 
-tensil_error_t
-tensil_driver_setup_buffer_postamble(struct tensil_driver *driver) {
-    tensil_error_t error = append_flush_instructions(driver);
+#endif
 
-    if (error)
-        return error;
+static void finish_run(struct tensil_driver *driver, struct tensil_run *run) {
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    if (run->is_streaming && !run->is_stream_loaded)
+        f_close(&run->stream_fil);
+#endif
 
-#ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
-    error = tensil_buffer_pad_to_alignment(
-        &driver->buffer, &driver->layout,
-        tensil_compute_unit_get_instructions_data_width_bytes(&driver->tcu));
+    run->is_running = false;
+    driver->active_run = NULL;
+}
 
-    if (error)
-        return error;
-#endif
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
 
-    return TENSIL_ERROR_NONE;
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+#define STREAM_HALF_ALIGNMENT 64
+#define STREAM_RESERVED_INSTRUCTIONS 4
+
+// Room for preamble and postamble instructions together with padding
+static size_t get_reserved_size(struct tensil_driver *driver) {
+    return STREAM_RESERVED_INSTRUCTIONS *
+               driver->layout.instruction_size_bytes +
+           2 * tensil_compute_unit_get_instructions_data_width_bytes(
+                   &driver->tcu);
 }
 
-tensil_error_t
-tensil_driver_setup_buffer_preamble(struct tensil_driver *driver) {
-    tensil_buffer_reset(&driver->buffer);
+static size_t get_stream_half_size(struct tensil_driver *driver) {
+    return (driver->buffer.size / 2) & ~(size_t)(STREAM_HALF_ALIGNMENT - 1);
+}
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-    // Since config instructions precede the program in the buffer we
-    // need to offset the program counter correspondingly in order for the
-    // sample lookup to be accurate. This assumes the config instruction
-    // is not advancing program counter after setting it.
-    tensil_error_t error = tensil_buffer_append_config_instruction(
-        &driver->buffer, &driver->layout,
-        TENSIL_CONFIG_REGISTER_PROGRAM_COUNTER, PROGRAM_COUNTER_SHIFT);
+// Chunks of the program file are whole instructions and whole DMA data
+// words, so that padding is only needed around preamble and postamble.
+static size_t get_stream_chunk_size(struct tensil_driver *driver) {
+    size_t half_size = get_stream_half_size(driver);
+    size_t alignment =
+        driver->layout.instruction_size_bytes *
+        tensil_compute_unit_get_instructions_data_width_bytes(&driver->tcu);
 
-    if (error)
-        return error;
-#endif
+    if (half_size < get_reserved_size(driver) + alignment)
+        return 0;
 
-    return TENSIL_ERROR_NONE;
+    return (half_size - get_reserved_size(driver)) / alignment * alignment;
 }
 
-static tensil_error_t run_config(struct tensil_driver *driver) {
-    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+static tensil_error_t load_stream_half(struct tensil_driver *driver,
+                                       struct tensil_run *run,
+                                       size_t half_index) {
+    struct tensil_instruction_buffer *half = &run->ranges[half_index];
+    struct tensil_instruction_batch batch;
+    tensil_error_t error = TENSIL_ERROR_NONE;
 
-    if (error)
-        return error;
+    tensil_buffer_reset(half);
 
-    error = tensil_buffer_append_config_instruction(
-        &driver->buffer, &driver->layout, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET,
-        TENSIL_CONFIG_DRAM_OFFSET(driver->dram0_base_ptr));
+    if (run->stream_offset == 0) {
+        tensil_buffer_begin_batch(&batch, half, &driver->layout);
 
-    if (error)
-        return error;
+        error = append_preamble_instructions(driver, &batch);
 
-    error = tensil_buffer_append_config_instruction(
-        &driver->buffer, &driver->layout, TENSIL_CONFIG_REGISTER_DRAM1_OFFSET,
-        TENSIL_CONFIG_DRAM_OFFSET(driver->dram1_base_ptr));
+        if (error)
+            return error;
 
-    if (error)
-        return error;
+        error = pad_buffer(driver, &batch);
 
-#ifdef TENSIL_PLATFORM_DECODER_TIMEOUT
-    error = tensil_buffer_append_config_instruction(
-        &driver->buffer, &driver->layout, TENSIL_CONFIG_REGISTER_TIMEOUT,
-        driver->decoder_timeout);
+        if (error)
+            return error;
 
-    if (error)
-        return error;
-#endif
+        tensil_batch_commit(&batch);
+    }
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-    error = tensil_buffer_append_config_instruction(
-        &driver->buffer, &driver->layout,
-        TENSIL_CONFIG_REGISTER_SAMPLE_INTERVAL, TENSIL_SAMPLE_INTERVAL_CYCLES);
+    size_t chunk_size = get_stream_chunk_size(driver);
 
-    if (error)
-        return error;
-#endif
+    if (chunk_size > driver->stream_size - run->stream_offset)
+        chunk_size = driver->stream_size - run->stream_offset;
 
-    error = tensil_driver_setup_buffer_postamble(driver);
+    error = tensil_buffer_append_program_from_fil(half, &run->stream_fil,
+                                                  chunk_size);
 
     if (error)
         return error;
 
-    return tensil_driver_run(driver, NULL);
-}
+    run->stream_offset += chunk_size;
 
-tensil_error_t tensil_driver_init(struct tensil_driver *driver) {
-    memset(driver, 0, sizeof(struct tensil_driver));
+    bool is_last = run->stream_offset == driver->stream_size;
 
-    driver->arch.array_size = TENSIL_ARCHITECTURE_ARRAY_SIZE;
-    driver->arch.data_type = TENSIL_ARCHITECTURE_DATA_TYPE;
+    if (is_last) {
+        tensil_buffer_begin_batch(&batch, half, &driver->layout);
 
-    driver->arch.local_depth = TENSIL_ARCHITECTURE_LOCAL_DEPTH;
-    driver->arch.accumulator_depth = TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH;
-    driver->arch.dram0_depth = TENSIL_ARCHITECTURE_DRAM0_DEPTH;
-    driver->arch.dram1_depth = TENSIL_ARCHITECTURE_DRAM1_DEPTH;
-    driver->arch.stride0_depth = TENSIL_ARCHITECTURE_STRIDE0_DEPTH;
-    driver->arch.stride1_depth = TENSIL_ARCHITECTURE_STRIDE1_DEPTH;
-    driver->arch.simd_registers_depth =
-        TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH;
+        error = append_postamble_instructions(driver, &batch);
 
-#ifdef TENSIL_PLATFORM_DECODER_TIMEOUT
-    driver->decoder_timeout = TENSIL_PLATFORM_DECODER_TIMEOUT;
-#endif
+        if (error)
+            return error;
 
-    if (!tensil_architecture_is_valid(&driver->arch)) {
-        return TENSIL_DRIVER_ERROR(
-            TENSIL_ERROR_DRIVER_INVALID_ARCH,
-            "Invalid architecture in architecture_config.h");
+        tensil_batch_commit(&batch);
     }
 
-    tensil_instruction_layout_init(&driver->layout, &driver->arch);
+    // The half is marked loaded before the stream is, so that the interrupt
+    // handler never sees the stream loaded without its last half.
+    run->is_half_loaded[half_index] = true;
 
-#if defined(TENSIL_PLATFORM_PROG_BUFFER_BASE) &&                               \
-    defined(TENSIL_PLATFORM_PROG_BUFFER_HIGH) &&                               \
-    defined(TENSIL_PLATFORM_DRAM_BUFFER_BASE) &&                               \
-    defined(TENSIL_PLATFORM_DRAM_BUFFER_HIGH)
+    if (is_last) {
+        f_close(&run->stream_fil);
+        run->is_stream_loaded = true;
+    }
 
-    driver->buffer.ptr = (uint8_t *)TENSIL_PLATFORM_PROG_BUFFER_BASE;
-    driver->buffer.offset = 0;
-    driver->buffer.size =
-        TENSIL_PLATFORM_PROG_BUFFER_HIGH - TENSIL_PLATFORM_PROG_BUFFER_BASE;
+    return TENSIL_ERROR_NONE;
+}
 
-    if ((driver->arch.dram0_depth + driver->arch.dram1_depth) *
-            driver->arch.array_size *
-            tensil_dram_sizeof_scalar(driver->arch.data_type) >
-        TENSIL_PLATFORM_DRAM_BUFFER_HIGH - TENSIL_PLATFORM_DRAM_BUFFER_BASE)
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
-                                   "Insufficient DRAM buffers");
+// Continues the half being transferred or switches to the other half once
+// it is loaded. When the other half is not loaded yet the stream stalls
+// until the next poll loads it.
+static tensil_error_t
+submit_next_stream_instructions(struct tensil_driver *driver,
+                                struct tensil_run *run) {
+    struct tensil_instruction_buffer *half = &run->ranges[run->range_index];
 
-    driver->dram0_base_ptr = (uint8_t *)TENSIL_PLATFORM_DRAM_BUFFER_BASE;
-    driver->dram0_size = driver->arch.dram0_depth * driver->arch.array_size *
-                         tensil_dram_sizeof_scalar(driver->arch.data_type);
+    if (run->run_offset != half->offset)
+        return tensil_compute_unit_start_instructions(&driver->tcu, half,
+                                                      &run->run_offset);
 
-    driver->dram1_base_ptr = driver->dram0_base_ptr + driver->dram0_size;
-    driver->dram1_size = driver->arch.dram1_depth * driver->arch.array_size *
-                         tensil_dram_sizeof_scalar(driver->arch.data_type);
+    size_t next_half_index = run->range_index ^ 1;
 
-#else
-    return TENSIL_DRIVER_ERROR(
-        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
-        "Target must specify program and DRAM buffers, see platform.h");
-#endif
+    if (!run->is_half_loaded[next_half_index]) {
+        if (run->is_stream_loaded)
+            run->range_index = run->ranges_size;
+        else
+            run->is_stream_stalled = true;
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-#ifdef TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE
-    driver->sample_block_size = TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE;
-#else
-    return TENSIL_DRIVER_ERROR(
-        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
-        "Target must specify sample block size, see platform.h");
-#endif
-#if defined(TENSIL_PLATFORM_SAMPLE_BUFFER_BASE) &&                             \
-    defined(TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH)
+        return TENSIL_ERROR_NONE;
+    }
+
+    run->is_half_loaded[run->range_index] = false;
+    run->range_index = next_half_index;
+    run->run_offset = 0;
+
+    return tensil_compute_unit_start_instructions(
+        &driver->tcu, &run->ranges[next_half_index], &run->run_offset);
+}
+
+#endif
+
+// Starts the next chunk of instructions. Once the last chunk has completed
+// advances range index past the last range.
+static tensil_error_t submit_next_instructions(struct tensil_driver *driver,
+                                               struct tensil_run *run) {
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    if (run->is_streaming)
+        return submit_next_stream_instructions(driver, run);
+#endif
+
+    while (run->range_index != run->ranges_size) {
+        struct tensil_instruction_buffer *range =
+            &run->ranges[run->range_index];
+
+        if (run->run_offset != range->offset)
+            return tensil_compute_unit_start_instructions(&driver->tcu, range,
+                                                          &run->run_offset);
+
+        run->range_index++;
+
+        if (run->range_index != run->ranges_size)
+            run->run_offset = run->range_offsets[run->range_index];
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Loads the half that is not being transferred with the next chunk of the
+// program and resumes the stream if it has stalled waiting for it.
+static tensil_error_t load_stream(struct tensil_driver *driver,
+                                  struct tensil_run *run) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    for (size_t i = 0; i < 2 && !run->is_stream_loaded; i++)
+        if (!run->is_half_loaded[i]) {
+            error = load_stream_half(driver, run, i);
+
+            if (error)
+                return error;
+        }
+
+    if (!run->is_stream_stalled)
+        return TENSIL_ERROR_NONE;
+
+    run->is_stream_stalled = false;
+
+    error = submit_next_instructions(driver, run);
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    if (!error && run->range_index == run->ranges_size)
+        run->is_submitted = true;
+#endif
+
+    return error;
+}
+
+static tensil_error_t submit_stream(struct tensil_driver *driver,
+                                    struct tensil_run *run) {
+    size_t half_size = get_stream_half_size(driver);
+
+    for (size_t i = 0; i < 2; i++) {
+        run->ranges[i].ptr = driver->buffer.ptr + i * half_size;
+        run->ranges[i].offset = 0;
+        run->ranges[i].size = half_size;
+        run->range_offsets[i] = 0;
+        run->is_half_loaded[i] = false;
+    }
+
+    run->ranges_size = 2;
+    run->stream_offset = 0;
+    run->is_stream_loaded = false;
+    run->is_stream_stalled = false;
+
+    memset(&run->stream_fil, 0, sizeof(FIL));
+    FRESULT res = f_open(&run->stream_fil, driver->stream_file_name, FA_READ);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_lseek(&run->stream_fil, driver->stream_file_offset);
+    if (res) {
+        f_close(&run->stream_fil);
+        return TENSIL_FS_ERROR(res);
+    }
+
+    tensil_error_t error = load_stream(driver, run);
+
+    if (error && !run->is_stream_loaded)
+        f_close(&run->stream_fil);
+
+    return error;
+}
+
+#endif
+
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+
+static void handle_instructions_interrupt(void *context, bool is_error) {
+    struct tensil_driver *driver = (struct tensil_driver *)context;
+    struct tensil_run *run = driver->active_run;
+
+    if (!run || run->is_submitted || run->interrupt_error)
+        return;
+
+    tensil_error_t error = is_error ? TENSIL_XILINX_ERROR(XST_DMA_ERROR)
+                                    : submit_next_instructions(driver, run);
+
+    if (error)
+        run->interrupt_error = error;
+    else if (run->range_index == run->ranges_size)
+        run->is_submitted = true;
+}
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+
+static void handle_sample_interrupt(void *context, bool is_error) {
+    struct tensil_driver *driver = (struct tensil_driver *)context;
+    struct tensil_run *run = driver->active_run;
+
+    if (!run || !run->sample_busy)
+        return;
+
+    run->sample_busy = false;
+
+    if (is_error) {
+        run->interrupt_error = TENSIL_XILINX_ERROR(XST_DMA_ERROR);
+        return;
+    }
+
+    tensil_compute_unit_complete_sampling(&driver->tcu,
+                                          &driver->sample_buffer);
+
+    if (!run->is_sampling_stopped) {
+        run->sample_busy = true;
+
+        tensil_error_t error = tensil_compute_unit_start_sampling(
+            &driver->tcu, &driver->sample_buffer);
+
+        if (error) {
+            run->sample_busy = false;
+            run->interrupt_error = error;
+        }
+    }
+}
+
+#endif
+
+#endif
+
+static void update_program(struct tensil_driver *driver) {
+    driver->program.ptr = driver->buffer.ptr + driver->program_offset;
+    driver->program.size = driver->buffer.size - driver->program_offset;
+    driver->program.offset = driver->buffer.offset - driver->program_offset;
+}
+
+static tensil_error_t submit_run(struct tensil_driver *driver,
+                                 struct tensil_run *run,
+                                 const struct tensil_run_opts *run_opts,
+                                 tensil_run_callback_t callback,
+                                 void *context) {
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    if (driver->active_run)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_BUSY,
+                                   "Compute unit is busy with another run");
+
+    update_program(driver);
+
+    run->run_opts = run_opts;
+    run->callback = callback;
+    run->context = context;
+    run->is_running = true;
+    run->range_index = 0;
+    run->run_offset = run->range_offsets[0];
+
+    arm_fence(driver, run);
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    run->start_us = get_time_us();
+    run->timeout_us = run_opts && run_opts->timeout_us
+                          ? run_opts->timeout_us
+                          : driver->run_timeout_us;
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    run->is_submitted = false;
+    run->interrupt_error = TENSIL_ERROR_NONE;
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    run->sample_busy = false;
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    run->is_sampling_stopped = false;
+#endif
+    tensil_sample_buffer_reset(&driver->sample_buffer);
+#endif
+
+    driver->active_run = run;
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    run->sample_busy = true;
+
+    error = tensil_compute_unit_start_sampling(&driver->tcu,
+                                               &driver->sample_buffer);
+
+    if (error) {
+        run->sample_busy = false;
+        finish_run(driver, run);
+        return error;
+    }
+#endif
+
+    // Only the first chunk is started here, the following chunks are
+    // started from the completion interrupt handler.
+    error = submit_next_instructions(driver, run);
+
+    if (error) {
+        finish_run(driver, run);
+        return error;
+    }
+#endif
+
+    return tensil_driver_poll(driver, run);
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify instruction AXI DMA device, see platform.h");
+#endif
+}
+
+static tensil_error_t advance_run(struct tensil_driver *driver,
+                                  struct tensil_run *run) {
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    if (run->interrupt_error)
+        return run->interrupt_error;
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    if (run->is_streaming) {
+        error = load_stream(driver, run);
+
+        if (error)
+            return error;
+    }
+#endif
+
+    if (!run->is_submitted)
+        return TENSIL_ERROR_NONE;
+#else
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    error = service_sampling(driver, run, false);
+
+    if (error)
+        return error;
+#endif
+
+    if (run->range_index != run->ranges_size) {
+        if (!tensil_compute_unit_is_instructions_busy(&driver->tcu)) {
+            error = submit_next_instructions(driver, run);
+
+            if (error)
+                return error;
+        }
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+        if (run->is_streaming) {
+            error = load_stream(driver, run);
+
+            if (error)
+                return error;
+        }
+#endif
+
+        if (run->range_index != run->ranges_size)
+            return TENSIL_ERROR_NONE;
+    }
+#endif
+
+    // All instructions are executed once fence instructions at the end of
+    // the last range have written the sequence number.
+    if (!is_fence_reached(driver, run))
+        return TENSIL_ERROR_NONE;
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    run->is_sampling_stopped = true;
+
+    while (run->sample_busy)
+        ;
+
+    if (run->interrupt_error)
+        return run->interrupt_error;
+#else
+    error = service_sampling(driver, run, true);
+
+    if (error)
+        return error;
+#endif
+#endif
+
+    finish_run(driver, run);
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    // Analysis looks up sampled instructions in the program buffer, which
+    // only holds the tail of a streamed program
+    if (!run->is_streaming)
+#endif
+        error = analyze_sampling(driver, run->run_opts);
+
+    if (error)
+        return error;
+#endif
+
+    if (run->callback)
+        run->callback(driver, run, run->context);
+
+    return error;
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify instruction AXI DMA device, see platform.h");
+#endif
+}
+
+tensil_error_t tensil_driver_submit(struct tensil_driver *driver,
+                                    struct tensil_run *run,
+                                    const struct tensil_run_opts *run_opts,
+                                    tensil_run_callback_t callback,
+                                    void *context) {
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    tensil_error_t error = set_sample_interval(driver, run_opts);
+
+    if (error)
+        return error;
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    run->is_streaming = driver->is_streaming;
+
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    if (run->is_streaming) {
+        if (driver->active_run)
+            return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_BUSY,
+                                       "Compute unit is busy with another run");
+
+        tensil_error_t error = submit_stream(driver, run);
+
+        if (error)
+            return error;
+
+        return submit_run(driver, run, run_opts, callback, context);
+    }
+#endif
+#endif
+
+    run->ranges[0] = driver->buffer;
+    run->range_offsets[0] = 0;
+    run->ranges_size = 1;
+
+    return submit_run(driver, run, run_opts, callback, context);
+}
+
+tensil_error_t tensil_driver_poll(struct tensil_driver *driver,
+                                  struct tensil_run *run) {
+    if (!run->is_running)
+        return TENSIL_ERROR_NONE;
+
+    tensil_error_t error = advance_run(driver, run);
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    if (!error && run->is_running && run->timeout_us &&
+        get_time_us() - run->start_us > run->timeout_us)
+        error = TENSIL_DRIVER_ERROR(
+            TENSIL_ERROR_DRIVER_TIMEOUT,
+            "Compute unit did not complete run in %zu us", run->timeout_us);
+#endif
+
+    if (error)
+        finish_run(driver, run);
+
+    return error;
+}
+
+tensil_error_t tensil_driver_wait(struct tensil_driver *driver,
+                                  struct tensil_run *run) {
+    size_t backoff = 1;
+    size_t range_index = run->range_index;
+
+    while (run->is_running) {
+        tensil_error_t error = tensil_driver_poll(driver, run);
+
+        if (error)
+            return error;
+
+        // Poll right away once the next range is submitted, so that its
+        // transfer follows the previous one without delay, and back off
+        // while the compute unit is busy executing.
+        if (run->range_index != range_index) {
+            range_index = run->range_index;
+            backoff = 1;
+            continue;
+        }
+
+        for (volatile size_t i = 0; i < backoff; i++)
+            ;
+
+        if (backoff < WAIT_MAX_BACKOFF)
+            backoff <<= 1;
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_driver_run(struct tensil_driver *driver,
+                                 const struct tensil_run_opts *run_opts) {
+    struct tensil_run run;
+    tensil_error_t error =
+        tensil_driver_submit(driver, &run, run_opts, NULL, NULL);
+
+    if (error)
+        return error;
+
+    return tensil_driver_wait(driver, &run);
+}
+
+tensil_error_t
+tensil_driver_setup_buffer_postamble(struct tensil_driver *driver) {
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, &driver->buffer, &driver->layout);
+
+    tensil_error_t error = append_postamble_instructions(driver, &batch);
+
+    if (error)
+        return error;
+
+    tensil_batch_commit(&batch);
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t
+tensil_driver_setup_buffer_preamble(struct tensil_driver *driver) {
+    struct tensil_instruction_batch batch;
+
+    tensil_buffer_reset(&driver->buffer);
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    driver->is_streaming = false;
+#endif
+
+    tensil_buffer_begin_batch(&batch, &driver->buffer, &driver->layout);
+
+    tensil_error_t error = append_preamble_instructions(driver, &batch);
+
+    if (error)
+        return error;
+
+    tensil_batch_commit(&batch);
+
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t run_config(struct tensil_driver *driver) {
+    struct tensil_instruction_batch batch;
+    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        return error;
+
+    tensil_buffer_begin_batch(&batch, &driver->buffer, &driver->layout);
+
+    error = tensil_batch_append_config_instruction(
+        &batch, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET,
+        TENSIL_CONFIG_DRAM_OFFSET(driver->dram0_base_ptr));
+
+    if (error)
+        return error;
+
+    error = tensil_batch_append_config_instruction(
+        &batch, TENSIL_CONFIG_REGISTER_DRAM1_OFFSET,
+        TENSIL_CONFIG_DRAM_OFFSET(driver->dram1_base_ptr));
+
+    if (error)
+        return error;
+
+#ifdef TENSIL_PLATFORM_DECODER_TIMEOUT
+    error = tensil_batch_append_config_instruction(
+        &batch, TENSIL_CONFIG_REGISTER_TIMEOUT, driver->decoder_timeout);
+
+    if (error)
+        return error;
+#endif
+
+    tensil_batch_commit(&batch);
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+    if (error)
+        return error;
+
+    return tensil_driver_run(driver, NULL);
+}
+
+tensil_error_t tensil_driver_init(struct tensil_driver *driver) {
+    memset(driver, 0, sizeof(struct tensil_driver));
+
+    driver->arch.array_size = TENSIL_ARCHITECTURE_ARRAY_SIZE;
+    driver->arch.data_type = TENSIL_ARCHITECTURE_DATA_TYPE;
+
+    driver->arch.local_depth = TENSIL_ARCHITECTURE_LOCAL_DEPTH;
+    driver->arch.accumulator_depth = TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH;
+    driver->arch.dram0_depth = TENSIL_ARCHITECTURE_DRAM0_DEPTH;
+    driver->arch.dram1_depth = TENSIL_ARCHITECTURE_DRAM1_DEPTH;
+    driver->arch.stride0_depth = TENSIL_ARCHITECTURE_STRIDE0_DEPTH;
+    driver->arch.stride1_depth = TENSIL_ARCHITECTURE_STRIDE1_DEPTH;
+    driver->arch.simd_registers_depth =
+        TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH;
+
+#ifdef TENSIL_PLATFORM_DECODER_TIMEOUT
+    driver->decoder_timeout = TENSIL_PLATFORM_DECODER_TIMEOUT;
+#endif
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    driver->run_timeout_us = TENSIL_PLATFORM_RUN_TIMEOUT_US;
+#endif
+
+    if (!tensil_architecture_is_valid(&driver->arch)) {
+        return TENSIL_DRIVER_ERROR(
+            TENSIL_ERROR_DRIVER_INVALID_ARCH,
+            "Invalid architecture in architecture_config.h");
+    }
+
+    tensil_instruction_layout_init(&driver->layout, &driver->arch);
+
+#if defined(TENSIL_PLATFORM_PROG_BUFFER_BASE) &&                               \
+    defined(TENSIL_PLATFORM_PROG_BUFFER_HIGH) &&                               \
+    defined(TENSIL_PLATFORM_DRAM_BUFFER_BASE) &&                               \
+    defined(TENSIL_PLATFORM_DRAM_BUFFER_HIGH)
+
+#ifdef TENSIL_PLATFORM_HOST
+    int map_error = tensil_host_map_buffer(TENSIL_PLATFORM_PROG_BUFFER_BASE,
+                                           TENSIL_PLATFORM_PROG_BUFFER_HIGH);
+
+    if (!map_error)
+        map_error = tensil_host_map_buffer(TENSIL_PLATFORM_DRAM_BUFFER_BASE,
+                                           TENSIL_PLATFORM_DRAM_BUFFER_HIGH);
+
+    if (map_error)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Failed to map host buffers, errno %d",
+                                   map_error);
+#endif
+
+    driver->buffer.ptr = (uint8_t *)TENSIL_PLATFORM_PROG_BUFFER_BASE;
+    driver->buffer.offset = 0;
+    driver->buffer.size =
+        TENSIL_PLATFORM_PROG_BUFFER_HIGH - TENSIL_PLATFORM_PROG_BUFFER_BASE;
+
+    if ((driver->arch.dram0_depth + driver->arch.dram1_depth) *
+            driver->arch.array_size *
+            tensil_dram_sizeof_scalar(driver->arch.data_type) >
+        TENSIL_PLATFORM_DRAM_BUFFER_HIGH - TENSIL_PLATFORM_DRAM_BUFFER_BASE)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient DRAM buffers");
+
+    driver->dram0_base_ptr = (uint8_t *)TENSIL_PLATFORM_DRAM_BUFFER_BASE;
+    driver->dram0_size = driver->arch.dram0_depth * driver->arch.array_size *
+                         tensil_dram_sizeof_scalar(driver->arch.data_type);
+
+    driver->dram1_base_ptr = driver->dram0_base_ptr + driver->dram0_size;
+    driver->dram1_size = driver->arch.dram1_depth * driver->arch.array_size *
+                         tensil_dram_sizeof_scalar(driver->arch.data_type);
+
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify program and DRAM buffers, see platform.h");
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    driver->sample_interval_cycles = TENSIL_SAMPLE_INTERVAL_CYCLES;
+
+#ifdef TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE
+    driver->sample_block_size = TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE;
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify sample block size, see platform.h");
+#endif
+#if defined(TENSIL_PLATFORM_SAMPLE_BUFFER_BASE) &&                             \
+    defined(TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH)
 
     if (TENSIL_SAMPLE_SIZE_BYTES * driver->sample_block_size >
         TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH -
             TENSIL_PLATFORM_SAMPLE_BUFFER_BASE) {
         return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
-                                   "Insufficient sample buffer");
+                                   "Insufficient sample buffer");
+    }
+
+    driver->sample_buffer.ptr = (uint8_t *)TENSIL_PLATFORM_SAMPLE_BUFFER_BASE;
+    driver->sample_buffer.size =
+        TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH - TENSIL_PLATFORM_SAMPLE_BUFFER_BASE;
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify sample buffers, see platform.h");
+#endif
+#endif
+
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    tensil_error_t error = tensil_compute_unit_init(&driver->tcu);
+
+    if (error)
+        return error;
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify instruction AXI DMA device, see platform.h");
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    error = tensil_compute_unit_init_sampling(&driver->tcu,
+                                              driver->sample_block_size);
+
+    if (error)
+        return error;
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    error = tensil_compute_unit_init_interrupts(
+        &driver->tcu, handle_instructions_interrupt, handle_sample_interrupt,
+        driver);
+#else
+    error = tensil_compute_unit_init_interrupts(
+        &driver->tcu, handle_instructions_interrupt, NULL, driver);
+#endif
+
+    if (error)
+        return error;
+#endif
+
+    return run_config(driver);
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+
+static tensil_error_t setup_stream(struct tensil_driver *driver,
+                                   size_t expected_size, size_t size,
+                                   const char *file_name, size_t file_offset) {
+    if ((expected_size && size != expected_size) ||
+        size % driver->layout.instruction_size_bytes)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_PROGRAM_SIZE,
+                                   "Unexpected program size in %s", file_name);
+
+    if (!get_stream_chunk_size(driver))
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient buffer to stream %s",
+                                   file_name);
+
+    strcpy(driver->stream_file_name, file_name);
+    driver->stream_size = size;
+    driver->stream_file_offset = file_offset;
+    driver->is_streaming = true;
+
+    return TENSIL_ERROR_NONE;
+}
+
+#endif
+
+tensil_error_t
+tensil_driver_load_program_from_file(struct tensil_driver *driver, size_t size,
+                                     const char *file_name) {
+    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        return error;
+
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    FILINFO fno;
+    FRESULT res;
+
+    memset(&fno, 0, sizeof(FILINFO));
+    res = f_stat(file_name, &fno);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    if (fno.fsize + get_reserved_size(driver) >
+        driver->buffer.size - driver->buffer.offset)
+        return setup_stream(driver, size, fno.fsize, file_name, 0);
+#endif
+
+    error = tensil_buffer_append_program_from_file(&driver->buffer, size,
+                                                   file_name);
+
+    if (error)
+        return error;
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+    if (error)
+        return error;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_driver_load_dram_vectors_from_file(
+    struct tensil_driver *driver, enum tensil_dram_bank dram_bank,
+    size_t offset, size_t size, const char *file_name) {
+    uint8_t *bank_ptr = tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
+    size_t bank_size = get_dram_bank_size(driver, dram_bank);
+
+    if ((offset + size) * tensil_dram_sizeof_scalar(driver->arch.data_type) *
+            driver->arch.array_size >
+        bank_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Consts data too big in %s", file_name);
+
+    return tensil_dram_write_scalars_from_file(
+        bank_ptr, driver->arch.data_type, offset * driver->arch.array_size,
+        size * driver->arch.array_size, file_name);
+}
+
+// Consts are read in chunks matching compression blocks. When consts are
+// preloaded to local memory the move of each chunk runs from the tail of the
+// program buffer while the next chunk is read. The last move keeps running
+// while the program is read into the head of the buffer.
+#define LOAD_CHUNK_SIZE TENSIL_COMPRESSION_BLOCK_SIZE
+#define LOAD_BUFFER_SIZE 1024
+
+struct consts_loader {
+    struct tensil_instruction_buffer buffer;
+    struct tensil_run run;
+};
+
+static void init_consts_loader(struct tensil_driver *driver,
+                               struct consts_loader *loader) {
+    memset(loader, 0, sizeof(struct consts_loader));
+
+    loader->buffer.ptr =
+        driver->buffer.ptr + driver->buffer.size - LOAD_BUFFER_SIZE;
+    loader->buffer.size = LOAD_BUFFER_SIZE;
+}
+
+static tensil_error_t submit_consts_move(struct tensil_driver *driver,
+                                         struct consts_loader *loader,
+                                         size_t offset, size_t size) {
+    tensil_error_t error = tensil_driver_wait(driver, &loader->run);
+
+    if (error)
+        return error;
+
+    struct tensil_instruction_batch batch;
+
+    tensil_buffer_reset(&loader->buffer);
+    tensil_buffer_begin_batch(&batch, &loader->buffer, &driver->layout);
+
+    error = append_preamble_instructions(driver, &batch);
+
+    if (error)
+        return error;
+
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL,
+        offset, offset, size - 1);
+
+    if (error)
+        return error;
+
+    error = append_postamble_instructions(driver, &batch);
+
+    if (error)
+        return error;
+
+    tensil_batch_commit(&batch);
+
+    loader->run.ranges[0] = loader->buffer;
+    loader->run.range_offsets[0] = 0;
+    loader->run.ranges_size = 1;
+    loader->run.is_streaming = false;
+
+    return submit_run(driver, &loader->run, NULL, NULL, NULL);
+}
+
+// Waits for the last consts move unless the program of given size is read
+// into the buffer without reaching the tail used by the move.
+static tensil_error_t
+prepare_consts_loader_for_program(struct tensil_driver *driver,
+                                  struct consts_loader *loader,
+                                  size_t prog_size) {
+    // Preamble and postamble of the program fit in another LOAD_BUFFER_SIZE
+    if (prog_size && prog_size + 2 * LOAD_BUFFER_SIZE <= driver->buffer.size)
+        return TENSIL_ERROR_NONE;
+
+    return tensil_driver_wait(driver, &loader->run);
+}
+
+static tensil_error_t
+load_consts_from_fil(struct tensil_driver *driver, struct consts_loader *loader,
+                     const struct tensil_consts_entry *consts,
+                     bool is_compressed, bool load_to_local, FIL *fil) {
+    uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM1);
+    size_t sizeof_scalar = tensil_dram_sizeof_scalar(driver->arch.data_type);
+    size_t vector_size = driver->arch.array_size * sizeof_scalar;
+    size_t size = consts->size * vector_size;
+    size_t loaded_size = 0;
+    size_t moved_vectors = 0;
+
+    if ((consts->base + consts->size) * vector_size >
+        get_dram_bank_size(driver, TENSIL_DRAM1))
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Consts data too big");
+
+    while (loaded_size < size) {
+        size_t chunk_size = size - loaded_size;
+        size_t offset = consts->base * driver->arch.array_size +
+                        loaded_size / sizeof_scalar;
+
+        if (chunk_size > LOAD_CHUNK_SIZE)
+            chunk_size = LOAD_CHUNK_SIZE;
+
+        tensil_error_t error =
+            is_compressed
+                ? tensil_dram_write_scalars_from_compressed_fil(
+                      bank_ptr, driver->arch.data_type, offset,
+                      chunk_size / sizeof_scalar, fil)
+                : tensil_dram_write_scalars_from_fil(
+                      bank_ptr, driver->arch.data_type, offset,
+                      chunk_size / sizeof_scalar, fil);
+
+        if (error)
+            return error;
+
+        loaded_size += chunk_size;
+
+        size_t loaded_vectors = loaded_size / vector_size;
+
+        if (load_to_local && loaded_vectors > moved_vectors) {
+            error = submit_consts_move(driver, loader,
+                                       consts->base + moved_vectors,
+                                       loaded_vectors - moved_vectors);
+
+            if (error)
+                return error;
+
+            moved_vectors = loaded_vectors;
+        }
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+// Reads consts and program sections of the bundle in one pass over the file
+// straight into DRAM1 and the program buffer.
+static tensil_error_t load_model_bundle(struct tensil_driver *driver,
+                                        struct consts_loader *loader,
+                                        const struct tensil_model *model) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    char file_name[FF_MAX_LFN];
+    FIL fil;
+    FRESULT res;
+
+    strcpy(file_name, model->path);
+    strcat(file_name, model->prog.file_name);
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_READ);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_lseek(&fil, model->consts[0].file_offset);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    error = load_consts_from_fil(driver, loader, &model->consts[0],
+                                 model->is_compressed,
+                                 model->load_consts_to_local, &fil);
+
+    if (error)
+        goto cleanup;
+
+    error = prepare_consts_loader_for_program(driver, loader, model->prog.size);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        goto cleanup;
+
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
+    // Compressed program can not be streamed and has to fit the buffer
+    if (!model->is_compressed &&
+        model->prog.size + get_reserved_size(driver) >
+            driver->buffer.size - driver->buffer.offset) {
+        error = setup_stream(driver, 0, model->prog.size, file_name,
+                             model->prog.file_offset);
+        goto cleanup;
+    }
+#endif
+
+    res = f_lseek(&fil, model->prog.file_offset);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (model->is_compressed)
+        error = tensil_buffer_append_compressed_program_from_fil(
+            &driver->buffer, &fil, model->prog.size);
+    else
+        error = tensil_buffer_append_program_from_fil(&driver->buffer, &fil,
+                                                      model->prog.size);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+cleanup:
+    f_close(&fil);
+
+    return error;
+}
+
+static tensil_error_t load_model_files(struct tensil_driver *driver,
+                                       struct consts_loader *loader,
+                                       const struct tensil_model *model) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    char file_name[FF_MAX_LFN];
+    FILINFO fno;
+    FIL fil;
+    FRESULT res;
+
+    for (size_t i = 0; i < model->consts_size; i++) {
+        strcpy(file_name, model->path);
+        strcat(file_name, model->consts[i].file_name);
+
+        memset(&fno, 0, sizeof(FILINFO));
+        res = f_stat(file_name, &fno);
+        if (res)
+            return TENSIL_FS_ERROR(res);
+
+        if (fno.fsize != model->consts[i].size * driver->arch.array_size *
+                             tensil_dram_sizeof_scalar(driver->arch.data_type))
+            return TENSIL_DRIVER_ERROR(
+                TENSIL_ERROR_DRIVER_UNEXPECTED_CONSTS_SIZE,
+                "Unexpected consts size in %s", file_name);
+
+        memset(&fil, 0, sizeof(FIL));
+        res = f_open(&fil, file_name, FA_READ);
+        if (res)
+            return TENSIL_FS_ERROR(res);
+
+        error = load_consts_from_fil(driver, loader, &model->consts[i], false,
+                                     model->load_consts_to_local, &fil);
+
+        f_close(&fil);
+
+        if (error)
+            return error;
+    }
+
+    error = prepare_consts_loader_for_program(driver, loader, model->prog.size);
+
+    if (error)
+        return error;
+
+    strcpy(file_name, model->path);
+    strcat(file_name, model->prog.file_name);
+
+    return tensil_driver_load_program_from_file(driver, model->prog.size,
+                                                file_name);
+}
+
+tensil_error_t tensil_driver_load_model(struct tensil_driver *driver,
+                                        const struct tensil_model *model) {
+    if (!tensil_architecture_is_compatible(&driver->arch, &model->arch))
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INCOMPATIBLE_MODEL,
+                                   "Incompatible model");
+
+    if (driver->buffer.size < LOAD_BUFFER_SIZE)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient buffer to load model");
+
+    struct consts_loader loader;
+    init_consts_loader(driver, &loader);
+
+    tensil_error_t error = model->is_bundle
+                               ? load_model_bundle(driver, &loader, model)
+                               : load_model_files(driver, &loader, model);
+
+    // Last consts move may still be running after the program is loaded
+    tensil_error_t move_error = tensil_driver_wait(driver, &loader.run);
+
+    return error ? error : move_error;
+}
+
+#endif
+
+static tensil_error_t check_tensor(const struct tensil_driver *driver,
+                                   const struct tensil_tensor *tensor) {
+    if (tensor->end_bytes > driver->dram0_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Tensor %s is outside of DRAM0",
+                                   tensor->name);
+
+    return TENSIL_ERROR_NONE;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// File holds vectors of all segments one after another.
+tensil_error_t tensil_driver_load_model_input_from_file(
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    const char *file_name) {
+    if (input->segments_size == 1)
+        return tensil_driver_load_dram_vectors_from_file(
+            driver, TENSIL_DRAM0, input->segments[0].base,
+            input->segments[0].size, file_name);
+
+    tensil_error_t error = check_tensor(driver, input);
+
+    if (error)
+        return error;
+
+    FILINFO fno;
+    FIL fil;
+    FRESULT res;
+
+    memset(&fno, 0, sizeof(FILINFO));
+    res = f_stat(file_name, &fno);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    if (fno.fsize != input->size_bytes)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_CONSTS_SIZE,
+                                   "Unexpected input size in %s", file_name);
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_READ);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    for (size_t i = 0; i < input->segments_size && !error; i++)
+        error = tensil_dram_write_scalars_from_fil(
+            driver->dram0_base_ptr, driver->arch.data_type,
+            input->segments[i].base * driver->arch.array_size,
+            input->segments[i].size * driver->arch.array_size, &fil);
+
+    f_close(&fil);
+
+    return error;
+}
+
+#endif
+
+// Tensor of the segment must be checked with check_tensor.
+static void init_segment_view(const struct tensil_driver *driver,
+                              const struct tensil_tensor *tensor,
+                              const struct tensil_input_output_entry *segment,
+                              struct tensil_tensor_view *view) {
+    view->data_type = driver->arch.data_type;
+    view->ptr =
+        driver->dram0_base_ptr + segment->base * tensor->vector_size_bytes;
+    view->vector_stride = driver->arch.array_size;
+    view->vector_size = driver->arch.array_size;
+    view->size = segment->size;
+}
+
+static tensil_error_t
+init_contiguous_tensor_view(const struct tensil_driver *driver,
+                            const struct tensil_tensor *tensor,
+                            struct tensil_tensor_view *view) {
+    if (tensor->segments_size != 1)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_TENSOR_NOT_CONTIGUOUS,
+                                   "Tensor %s is segmented", tensor->name);
+
+    tensil_error_t error = check_tensor(driver, tensor);
+
+    if (error)
+        return error;
+
+    view->data_type = driver->arch.data_type;
+    view->ptr = driver->dram0_base_ptr + tensor->offset_bytes;
+    view->vector_stride = driver->arch.array_size;
+    view->vector_size = driver->arch.array_size;
+    view->size = tensor->size;
+
+    return TENSIL_ERROR_NONE;
+}
+
+static size_t tensor_view_size_bytes(const struct tensil_tensor_view *view) {
+    return view->size * view->vector_stride *
+           tensil_dram_sizeof_scalar(view->data_type);
+}
+
+tensil_error_t
+tensil_driver_get_model_input_view(const struct tensil_driver *driver,
+                                   const struct tensil_tensor *input,
+                                   struct tensil_tensor_view *view) {
+    return init_contiguous_tensor_view(driver, input, view);
+}
+
+tensil_error_t
+tensil_driver_get_model_output_view(const struct tensil_driver *driver,
+                                    const struct tensil_tensor *output,
+                                    struct tensil_tensor_view *view) {
+    tensil_error_t error = init_contiguous_tensor_view(driver, output, view);
+
+    if (error)
+        return error;
+
+    Xil_DCacheInvalidateRange((UINTPTR)view->ptr, tensor_view_size_bytes(view));
+
+    return TENSIL_ERROR_NONE;
+}
+
+void tensil_tensor_view_commit(const struct tensil_tensor_view *view) {
+    Xil_DCacheFlushRange((UINTPTR)view->ptr, tensor_view_size_bytes(view));
+}
+
+tensil_error_t tensil_image_lut_init(struct tensil_image_lut *lut,
+                                     enum tensil_data_type data_type,
+                                     size_t channels_size, const float *mean,
+                                     const float *scale) {
+    if (channels_size > TENSIL_MAX_IMAGE_CHANNELS)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Too many image channels %zu",
+                                   channels_size);
+
+    switch (data_type) {
+    case TENSIL_DATA_TYPE_FP16BP8:
+    default:
+        for (size_t c = 0; c < channels_size; c++)
+            for (size_t v = 0; v < 256; v++)
+                lut->values[c][v] = tensil_dram_fp16bp8_from_float(
+                    ((float)v - mean[c]) * scale[c]);
+        break;
+    }
+
+    lut->channels_size = channels_size;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_driver_load_model_input_image(
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    const struct tensil_image_lut *lut, enum tensil_image_layout layout,
+    size_t pixels_size, const uint8_t *image) {
+    size_t channels_size = lut->channels_size;
+
+    if (pixels_size > input->size || channels_size > driver->arch.array_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Image does not fit input %s", input->name);
+
+    tensil_error_t error = check_tensor(driver, input);
+
+    if (error)
+        return error;
+
+    size_t i = 0;
+
+    // Pixels continue from one segment to the next, vectors past the last
+    // pixel are zero filled as when loading scalars
+    for (size_t s = 0; s < input->segments_size; s++) {
+        struct tensil_tensor_view view;
+        init_segment_view(driver, input, &input->segments[s], &view);
+
+        int16_t *vector = (int16_t *)view.ptr;
+        size_t vector_stride_bytes = view.vector_stride * sizeof(int16_t);
+        size_t padding_size_bytes =
+            (view.vector_stride - channels_size) * sizeof(int16_t);
+
+        for (size_t j = 0; j < view.size; j++, i++) {
+            if (i >= pixels_size) {
+                memset(vector, 0, vector_stride_bytes);
+                vector += view.vector_stride;
+                continue;
+            }
+
+            if (layout == TENSIL_IMAGE_LAYOUT_HWC)
+                for (size_t c = 0; c < channels_size; c++)
+                    vector[c] = lut->values[c][image[i * channels_size + c]];
+            else
+                for (size_t c = 0; c < channels_size; c++)
+                    vector[c] = lut->values[c][image[c * pixels_size + i]];
+
+            memset(vector + channels_size, 0, padding_size_bytes);
+
+            vector += view.vector_stride;
+        }
+
+        tensil_tensor_view_commit(&view);
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+// Writes vectors_size vectors of the tensor starting at vector_offset,
+// walking the segments the vectors fall into.
+static tensil_error_t write_input_scalars(struct tensil_driver *driver,
+                                          const struct tensil_tensor *tensor,
+                                          size_t vector_offset,
+                                          size_t vectors_size, size_t size,
+                                          const float *buffer) {
+    size_t array_size = driver->arch.array_size;
+
+    if (size > vectors_size * array_size)
+        size = vectors_size * array_size;
+
+    if (vector_offset + vectors_size > tensor->size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Written data too big");
+
+    tensil_error_t error = check_tensor(driver, tensor);
+
+    if (error)
+        return error;
+
+    size_t segment_offset = 0;
+
+    for (size_t i = 0; i < tensor->segments_size && vectors_size; i++) {
+        const struct tensil_input_output_entry *segment = &tensor->segments[i];
+        size_t segment_end = segment_offset + segment->size;
+
+        if (vector_offset < segment_end) {
+            size_t segment_vector_offset = vector_offset - segment_offset;
+            size_t segment_vectors_size = segment->size - segment_vector_offset;
+
+            if (segment_vectors_size > vectors_size)
+                segment_vectors_size = vectors_size;
+
+            size_t segment_size_scalars = segment_vectors_size * array_size;
+            size_t segment_size =
+                size < segment_size_scalars ? size : segment_size_scalars;
+            size_t offset =
+                (segment->base + segment_vector_offset) * array_size;
+
+            // Scalars not provided by the caller are zero, which is all zero
+            // bits
+            tensil_dram_write_scalars(driver->dram0_base_ptr,
+                                      driver->arch.data_type, offset,
+                                      segment_size, buffer);
+            tensil_dram_fill_bytes(driver->dram0_base_ptr,
+                                   driver->arch.data_type,
+                                   offset + segment_size, 0,
+                                   segment_size_scalars - segment_size);
+
+            buffer += segment_size;
+            size -= segment_size;
+            vector_offset += segment_vectors_size;
+            vectors_size -= segment_vectors_size;
+        }
+
+        segment_offset = segment_end;
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_driver_load_model_input_scalars(
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    size_t size, const float *buffer) {
+    return write_input_scalars(driver, input, 0, input->size, size, buffer);
+}
+
+tensil_error_t tensil_driver_load_model_input_vector_scalars(
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    size_t vector_offset, size_t scalars_size, const float *buffer) {
+    return write_input_scalars(driver, input, vector_offset, 1, scalars_size,
+                               buffer);
+}
+
+tensil_error_t tensil_driver_get_model_output_scalars(
+    const struct tensil_driver *driver, const struct tensil_tensor *output,
+    size_t size, float *buffer) {
+    tensil_error_t error = check_tensor(driver, output);
+
+    if (error)
+        return error;
+
+    for (size_t i = 0; i < output->segments_size && size; i++) {
+        const struct tensil_input_output_entry *segment = &output->segments[i];
+        size_t segment_size = segment->size * driver->arch.array_size;
+
+        if (segment_size > size)
+            segment_size = size;
+
+        tensil_dram_read_scalars(driver->dram0_base_ptr, driver->arch.data_type,
+                                 segment->base * driver->arch.array_size,
+                                 segment_size, buffer);
+
+        buffer += segment_size;
+        size -= segment_size;
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+#define MAX_PRINT_OUTPUT_VECTORS 16
+
+tensil_error_t
+tensil_driver_print_model_output_vectors(const struct tensil_driver *driver,
+                                         const struct tensil_tensor *output) {
+    float *vector_buffer =
+        (float *)malloc(driver->arch.array_size * sizeof(float));
+
+    if (!vector_buffer)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    size_t j = 0;
+
+    for (size_t i = 0; i < output->segments_size; i++)
+        for (size_t k = 0; k < output->segments[i].size &&
+                           j < MAX_PRINT_OUTPUT_VECTORS;
+             k++, j++) {
+            tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                            output->segments[i].base + k, 0, 1,
+                                            vector_buffer);
+
+            printf("%s[%04zu]=", output->name, j);
+
+            for (size_t l = 0; l < driver->arch.array_size; l++)
+                printf("%9.4f ", vector_buffer[l]);
+
+            printf("\n");
+        }
+
+    free(vector_buffer);
+
+    return TENSIL_ERROR_NONE;
+}
+
+#endif
+
+tensil_error_t tensil_driver_write_dram_vectors(struct tensil_driver *driver,
+                                                enum tensil_dram_bank dram_bank,
+                                                size_t offset, size_t stride,
+                                                size_t size, float *buffer) {
+    uint8_t *bank_ptr = tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
+    size_t bank_size = get_dram_bank_size(driver, dram_bank);
+
+    if ((offset + size * (1 << stride)) *
+            tensil_dram_sizeof_scalar(driver->arch.data_type) *
+            driver->arch.array_size >
+        bank_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Written data too big");
+
+    if (stride == 0)
+        tensil_dram_write_scalars(bank_ptr, driver->arch.data_type,
+                                  offset * driver->arch.array_size,
+                                  size * driver->arch.array_size, buffer);
+    else
+        for (size_t i = 0; i < size; i++)
+            tensil_dram_write_scalars(
+                bank_ptr, driver->arch.data_type,
+                (offset + i * (1 << stride)) * driver->arch.array_size,
+                driver->arch.array_size, buffer + i * driver->arch.array_size);
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t
+tensil_driver_read_dram_vectors(const struct tensil_driver *driver,
+                                enum tensil_dram_bank dram_bank, size_t offset,
+                                size_t stride, size_t size, float *buffer) {
+    const uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
+    size_t bank_size = get_dram_bank_size(driver, dram_bank);
+
+    if ((offset + size * (1 << stride)) *
+            tensil_dram_sizeof_scalar(driver->arch.data_type) *
+            driver->arch.array_size >
+        bank_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Read data too big");
+
+    if (stride == 0)
+        tensil_dram_read_scalars(bank_ptr, driver->arch.data_type,
+                                 offset * driver->arch.array_size,
+                                 size * driver->arch.array_size, buffer);
+
+    else
+        for (size_t i = 0; i < size; i++)
+            tensil_dram_read_scalars(
+                bank_ptr, driver->arch.data_type,
+                (offset + i * (1 << stride)) * driver->arch.array_size,
+                driver->arch.array_size, buffer + i * driver->arch.array_size);
+
+    return TENSIL_ERROR_NONE;
+}
+
+#define PIPELINE_SLOT_ALIGNMENT (1 << 16)
+
+tensil_error_t tensil_driver_init_pipeline(struct tensil_driver *driver,
+                                           struct tensil_pipeline *pipeline,
+                                           size_t slots_size,
+                                           size_t slot_depth) {
+    memset(pipeline, 0, sizeof(struct tensil_pipeline));
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    if (driver->is_streaming)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Pipeline needs program loaded in buffer");
+#endif
+
+    if (slots_size == 0 || slots_size > TENSIL_MAX_PIPELINE_SLOTS)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Pipeline supports up to %d slots",
+                                   TENSIL_MAX_PIPELINE_SLOTS);
+
+    // DRAM0 offset is configured in 64K units, slots are aligned
+    // accordingly. The last two vectors of DRAM0 are the fence.
+    size_t slot_size_bytes = slot_depth * driver->arch.array_size *
+                             tensil_dram_sizeof_scalar(driver->arch.data_type);
+    slot_size_bytes = (slot_size_bytes + PIPELINE_SLOT_ALIGNMENT - 1) &
+                      ~(size_t)(PIPELINE_SLOT_ALIGNMENT - 1);
+
+    size_t fence_size_bytes =
+        2 * driver->arch.array_size *
+        tensil_dram_sizeof_scalar(driver->arch.data_type);
+
+    if (slot_size_bytes * slots_size + fence_size_bytes > driver->dram0_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient DRAM0 for %zu slots",
+                                   slots_size);
+
+    pipeline->slots_size = slots_size;
+    pipeline->slot_depth = slot_depth;
+    pipeline->slot_size_bytes = slot_size_bytes;
+
+    pipeline->buffer.ptr = driver->buffer.ptr + driver->buffer.offset;
+    pipeline->buffer.offset = 0;
+    pipeline->buffer.size = driver->buffer.size - driver->buffer.offset;
+
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, &pipeline->buffer, &driver->layout);
+
+    tensil_error_t error = tensil_batch_append_config_instruction(
+        &batch, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET,
+        TENSIL_CONFIG_DRAM_OFFSET(driver->dram0_base_ptr));
+
+    if (error)
+        return error;
+
+    error = append_fence_instructions(driver, &batch);
+
+    if (error)
+        return error;
+
+    error = pad_buffer(driver, &batch);
+
+    if (error)
+        return error;
+
+    pipeline->epilogue_size = pipeline->buffer.offset;
+
+    for (size_t i = 0; i < slots_size; i++) {
+        uint8_t *slot_ptr = driver->dram0_base_ptr + i * slot_size_bytes;
+        pipeline->prologue_offsets[i] = pipeline->buffer.offset;
+
+        error = tensil_batch_append_config_instruction(
+            &batch, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET,
+            TENSIL_CONFIG_DRAM_OFFSET(slot_ptr));
+
+        if (error)
+            return error;
+
+        error = pad_buffer(driver, &batch);
+
+        if (error)
+            return error;
+
+        pipeline->prologue_size =
+            pipeline->buffer.offset - pipeline->prologue_offsets[i];
     }
 
-    driver->sample_buffer.ptr = (uint8_t *)TENSIL_PLATFORM_SAMPLE_BUFFER_BASE;
-    driver->sample_buffer.size =
-        TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH - TENSIL_PLATFORM_SAMPLE_BUFFER_BASE;
-#else
-    return TENSIL_DRIVER_ERROR(
-        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
-        "Target must specify sample buffers, see platform.h");
-#endif
-#endif
+    tensil_batch_commit(&batch);
 
-#ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
-    tensil_error_t error = tensil_compute_unit_init(&driver->tcu);
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t
+rebase_pipeline_view(const struct tensil_driver *driver,
+                     const struct tensil_pipeline *pipeline, size_t slot,
+                     const struct tensil_tensor *tensor,
+                     struct tensil_tensor_view *view) {
+    if (slot >= pipeline->slots_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Unexpected pipeline slot %zu", slot);
+
+    size_t view_end_bytes = (uint8_t *)view->ptr - driver->dram0_base_ptr +
+                            tensor_view_size_bytes(view);
+
+    if (view_end_bytes > pipeline->slot_depth * driver->arch.array_size *
+                             tensil_dram_sizeof_scalar(driver->arch.data_type))
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Tensor %s is outside of pipeline slot",
+                                   tensor->name);
+
+    view->ptr = (uint8_t *)view->ptr + slot * pipeline->slot_size_bytes;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_driver_get_pipeline_input_view(
+    const struct tensil_driver *driver, const struct tensil_pipeline *pipeline,
+    size_t slot, const struct tensil_tensor *input,
+    struct tensil_tensor_view *view) {
+    tensil_error_t error = init_contiguous_tensor_view(driver, input, view);
 
     if (error)
         return error;
-#else
-    return TENSIL_DRIVER_ERROR(
-        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
-        "Target must specify instruction AXI DMA device, see platform.h");
+
+    return rebase_pipeline_view(driver, pipeline, slot, input, view);
+}
+
+tensil_error_t tensil_driver_get_pipeline_output_view(
+    const struct tensil_driver *driver, const struct tensil_pipeline *pipeline,
+    size_t slot, const struct tensil_tensor *output,
+    struct tensil_tensor_view *view) {
+    tensil_error_t error = init_contiguous_tensor_view(driver, output, view);
+
+    if (error)
+        return error;
+
+    error = rebase_pipeline_view(driver, pipeline, slot, output, view);
+
+    if (error)
+        return error;
+
+    Xil_DCacheInvalidateRange((UINTPTR)view->ptr, tensor_view_size_bytes(view));
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_driver_submit_pipeline(
+    struct tensil_driver *driver, const struct tensil_pipeline *pipeline,
+    size_t slot, struct tensil_run *run,
+    const struct tensil_run_opts *run_opts, tensil_run_callback_t callback,
+    void *context) {
+    if (slot >= pipeline->slots_size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Unexpected pipeline slot %zu", slot);
+
+    run->ranges[0] = pipeline->buffer;
+    run->range_offsets[0] = pipeline->prologue_offsets[slot];
+    run->ranges[0].offset = run->range_offsets[0] + pipeline->prologue_size;
+
+    run->ranges[1] = driver->buffer;
+    run->range_offsets[1] = 0;
+    run->ranges[1].offset = driver->postamble_offset;
+
+    run->ranges[2] = pipeline->buffer;
+    run->range_offsets[2] = pipeline->epilogue_offset;
+    run->ranges[2].offset = run->range_offsets[2] + pipeline->epilogue_size;
+
+    run->ranges_size = 3;
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    run->is_streaming = false;
 #endif
 
 #ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-    error = tensil_compute_unit_init_sampling(&driver->tcu,
-                                              driver->sample_block_size);
+    tensil_error_t error = set_sample_interval(driver, run_opts);
 
     if (error)
         return error;
 #endif
 
-    return run_config(driver);
+    return submit_run(driver, run, run_opts, callback, context);
 }
 
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
 
+// DRAM1 offset is configured in 64K units, DRAM1 regions are aligned
+// accordingly. Program regions are aligned for the instruction DMA.
+#define RESIDENT_DRAM1_ALIGNMENT (1 << 16)
+#define RESIDENT_BUFFER_ALIGNMENT 64
+
+static size_t align_size(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static tensil_error_t
+append_dram1_offset_instruction(struct tensil_instruction_batch *batch,
+                                uint8_t *dram1_ptr) {
+    return tensil_batch_append_config_instruction(
+        batch, TENSIL_CONFIG_REGISTER_DRAM1_OFFSET,
+        TENSIL_CONFIG_DRAM_OFFSET(dram1_ptr));
+}
+
 tensil_error_t
-tensil_driver_load_program_from_file(struct tensil_driver *driver, size_t size,
-                                     const char *file_name) {
-    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+tensil_driver_init_registry(struct tensil_driver *driver,
+                            struct tensil_model_registry *registry,
+                            size_t buffer_size, size_t dram1_size) {
+    memset(registry, 0, sizeof(struct tensil_model_registry));
 
-    if (error)
-        return error;
+    if (driver->active_run)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_BUSY,
+                                   "Compute unit is busy with another run");
 
-    error = tensil_buffer_append_program_from_file(&driver->buffer, size,
-                                                   file_name);
+    buffer_size = align_size(buffer_size, RESIDENT_BUFFER_ALIGNMENT);
 
-    if (error)
-        return error;
+    if (buffer_size > driver->buffer.size ||
+        ((driver->buffer.size - buffer_size) &
+         ~(size_t)(RESIDENT_BUFFER_ALIGNMENT - 1)) < driver->buffer.offset)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient buffer for resident models");
 
-    error = tensil_driver_setup_buffer_postamble(driver);
+    size_t dram1_end = (size_t)driver->dram1_base_ptr + driver->dram1_size;
+
+    if (dram1_size > driver->dram1_size ||
+        ((dram1_end - dram1_size) &
+         ~(size_t)(RESIDENT_DRAM1_ALIGNMENT - 1)) <
+            (size_t)driver->dram1_base_ptr)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient DRAM1 for resident models");
+
+    size_t buffer_offset = (driver->buffer.size - buffer_size) &
+                           ~(size_t)(RESIDENT_BUFFER_ALIGNMENT - 1);
+
+    registry->buffer.ptr = driver->buffer.ptr + buffer_offset;
+    registry->buffer.size = driver->buffer.size - buffer_offset;
+
+    registry->dram1_ptr = (uint8_t *)((dram1_end - dram1_size) &
+                                      ~(size_t)(RESIDENT_DRAM1_ALIGNMENT - 1));
+    registry->dram1_size = dram1_end - (size_t)registry->dram1_ptr;
+
+    registry->original_buffer_size = driver->buffer.size;
+    registry->original_dram1_size = driver->dram1_size;
+
+    driver->buffer.size = buffer_offset;
+    driver->dram1_size = registry->dram1_ptr - driver->dram1_base_ptr;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t
+tensil_driver_release_registry(struct tensil_driver *driver,
+                               struct tensil_model_registry *registry) {
+    tensil_error_t error = tensil_driver_switch_model(driver, registry, NULL);
 
     if (error)
         return error;
 
+    driver->buffer.size = registry->original_buffer_size;
+    driver->dram1_size = registry->original_dram1_size;
+
+    memset(registry, 0, sizeof(struct tensil_model_registry));
+
     return TENSIL_ERROR_NONE;
 }
 
-tensil_error_t tensil_driver_load_dram_vectors_from_file(
-    struct tensil_driver *driver, enum tensil_dram_bank dram_bank,
-    size_t offset, size_t size, const char *file_name) {
-    uint8_t *bank_ptr = tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
-    size_t bank_size = get_dram_bank_size(driver, dram_bank);
+static tensil_error_t
+append_preload_instructions(struct tensil_driver *driver,
+                            struct tensil_resident_model *resident,
+                            const struct tensil_model *model) {
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, &resident->preload_buffer,
+                              &driver->layout);
 
-    if ((offset + size) * tensil_dram_sizeof_scalar(driver->arch.data_type) *
-            driver->arch.array_size >
-        bank_size)
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
-                                   "Consts data too big in %s", file_name);
+    tensil_error_t error = append_preamble_instructions(driver, &batch);
 
-    return tensil_dram_write_scalars_from_file(
-        bank_ptr, driver->arch.data_type, offset * driver->arch.array_size,
-        size * driver->arch.array_size, file_name);
-}
+    if (error)
+        return error;
 
-static tensil_error_t run_load_consts(struct tensil_driver *driver,
-                                      size_t offset, size_t size) {
-    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+    error = append_dram1_offset_instruction(&batch, resident->dram1_ptr);
 
     if (error)
         return error;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, offset, offset, size - 1);
+    for (size_t i = 0; i < model->consts_size; i++) {
+        if (!model->consts[i].size)
+            continue;
+
+        error = tensil_batch_append_instruction(
+            &batch, TENSIL_OPCODE_DATA_MOVE,
+            TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, model->consts[i].base,
+            model->consts[i].base, model->consts[i].size - 1);
+
+        if (error)
+            return error;
+    }
+
+    error = append_dram1_offset_instruction(&batch, driver->dram1_base_ptr);
 
     if (error)
         return error;
 
-    error = tensil_driver_setup_buffer_postamble(driver);
+    error = append_postamble_instructions(driver, &batch);
 
     if (error)
         return error;
 
-    return tensil_driver_run(driver, NULL);
+    tensil_batch_commit(&batch);
+
+    return TENSIL_ERROR_NONE;
 }
 
-tensil_error_t tensil_driver_load_model(struct tensil_driver *driver,
-                                        const struct tensil_model *model) {
-    if (!tensil_architecture_is_compatible(&driver->arch, &model->arch))
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INCOMPATIBLE_MODEL,
-                                   "Incompatible model");
+// The program is loaded with tensil_driver_load_model into the program
+// region with DRAM1 rebased to the model's DRAM1 region. The region starts
+// with DRAM1 offset config and the fence instructions of the loaded program
+// are replaced with DRAM1 offset reset followed by new postamble.
+tensil_error_t tensil_driver_load_resident_model(
+    struct tensil_driver *driver, struct tensil_model_registry *registry,
+    const struct tensil_model *model,
+    struct tensil_resident_model **resident_model) {
+    if (registry->models_size == TENSIL_MAX_RESIDENT_MODELS)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Registry supports up to %d models",
+                                   TENSIL_MAX_RESIDENT_MODELS);
 
-    tensil_error_t error = TENSIL_ERROR_NONE;
-    char file_name[FF_MAX_LFN];
+    size_t vector_size = driver->arch.array_size *
+                         tensil_dram_sizeof_scalar(driver->arch.data_type);
+    size_t dram1_size = 0;
 
     for (size_t i = 0; i < model->consts_size; i++) {
-        strcpy(file_name, model->path);
-        strcat(file_name, model->consts[i].file_name);
+        size_t consts_end =
+            (model->consts[i].base + model->consts[i].size) * vector_size;
 
-        error = tensil_driver_load_dram_vectors_from_file(
-            driver, TENSIL_DRAM1, model->consts[i].base, model->consts[i].size,
-            file_name);
+        if (consts_end > dram1_size)
+            dram1_size = consts_end;
+    }
 
-        if (error)
-            return error;
+    dram1_size = align_size(dram1_size, RESIDENT_DRAM1_ALIGNMENT);
 
-        if (model->load_consts_to_local) {
-            error = run_load_consts(driver, model->consts[i].base,
-                                    model->consts[i].size);
+    if (dram1_size > registry->dram1_size - registry->dram1_offset)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient DRAM1 for resident model");
 
-            if (error)
-                return error;
-        }
-    }
+    struct tensil_resident_model *resident =
+        &registry->models[registry->models_size];
+    memset(resident, 0, sizeof(struct tensil_resident_model));
 
-    strcpy(file_name, model->path);
-    strcat(file_name, model->prog.file_name);
+    resident->load_consts_to_local = model->load_consts_to_local;
+    resident->dram1_ptr = registry->dram1_ptr + registry->dram1_offset;
+    resident->dram1_size = dram1_size;
+    resident->buffer.ptr = registry->buffer.ptr + registry->buffer.offset;
+    resident->buffer.size = registry->buffer.size - registry->buffer.offset;
+
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, &resident->buffer, &driver->layout);
 
-    error = tensil_driver_load_program_from_file(driver, model->prog.size,
-                                                 file_name);
+    tensil_error_t error =
+        append_dram1_offset_instruction(&batch, resident->dram1_ptr);
 
     if (error)
         return error;
 
-    return TENSIL_ERROR_NONE;
-}
+    error = pad_buffer(driver, &batch);
 
-tensil_error_t tensil_driver_load_model_input_from_file(
-    struct tensil_driver *driver, const struct tensil_model *model,
-    const char *input_name, const char *file_name) {
-    for (size_t i = 0; i < model->inputs_size; i++) {
-        if (strcmp(model->inputs[i].name, input_name) == 0)
-            // TODO: Support non-continuous inputs and outputs
-            return tensil_driver_load_dram_vectors_from_file(
-                driver, TENSIL_DRAM0, model->inputs[i].base,
-                model->inputs[i].size, file_name);
-    }
+    if (error)
+        return error;
 
-    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_INPUT_NAME,
-                               "Unexpected input name %s", input_name);
-}
+    tensil_batch_commit(&batch);
+
+    size_t program_offset = resident->buffer.offset;
+    resident->program_offset = program_offset;
 
+    struct tensil_instruction_buffer saved_buffer = driver->buffer;
+    size_t saved_postamble_offset = driver->postamble_offset;
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    size_t saved_sample_interval_offset = driver->sample_interval_offset;
 #endif
+    uint8_t *saved_dram1_base_ptr = driver->dram1_base_ptr;
+    size_t saved_dram1_size = driver->dram1_size;
+    bool saved_is_streaming = driver->is_streaming;
+    size_t saved_stream_size = driver->stream_size;
+    size_t saved_stream_file_offset = driver->stream_file_offset;
+    char saved_stream_file_name[FF_MAX_LFN];
+    strcpy(saved_stream_file_name, driver->stream_file_name);
+
+    // Consts are moved to local memory by the preload program instead
+    struct tensil_model resident_model_copy = *model;
+    resident_model_copy.load_consts_to_local = false;
+
+    driver->buffer.ptr = resident->buffer.ptr + program_offset;
+    driver->buffer.size = resident->buffer.size - program_offset;
+    driver->buffer.offset = 0;
+    driver->dram1_base_ptr = resident->dram1_ptr;
+    driver->dram1_size = resident->dram1_size;
 
-tensil_error_t tensil_driver_load_model_input_scalars(
-    struct tensil_driver *driver, const struct tensil_model *model,
-    const char *input_name, size_t size, const float *buffer) {
-    for (size_t i = 0; i < model->inputs_size; i++) {
-        if (strcmp(model->inputs[i].name, input_name) == 0) {
-            float *vector_buffer =
-                (float *)malloc(model->inputs[i].size *
-                                driver->arch.array_size * sizeof(float));
-
-            if (!vector_buffer)
-                return TENSIL_DRIVER_ERROR(
-                    TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
-                    "Out of heap memory");
-
-            for (size_t j = 0;
-                 j < model->inputs[i].size * driver->arch.array_size; j++) {
-                if (j < size)
-                    vector_buffer[j] = buffer[j];
-                else
-                    vector_buffer[j] = 0.0;
-            }
+    error = tensil_driver_load_model(driver, &resident_model_copy);
 
-            tensil_driver_write_dram_vectors(
-                driver, TENSIL_DRAM0, model->inputs[i].base, 0,
-                model->inputs[i].size, vector_buffer);
+    bool is_streaming = driver->is_streaming;
+    size_t postamble_offset = program_offset + driver->postamble_offset;
 
-            free(vector_buffer);
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    resident->sample_interval_offset =
+        program_offset + driver->sample_interval_offset;
+    driver->sample_interval_offset = saved_sample_interval_offset;
+#endif
 
-            // TODO: Support non-continuous inputs and outputs
-            return TENSIL_ERROR_NONE;
-        }
-    }
+    driver->buffer = saved_buffer;
+    driver->postamble_offset = saved_postamble_offset;
+    driver->dram1_base_ptr = saved_dram1_base_ptr;
+    driver->dram1_size = saved_dram1_size;
+    driver->is_streaming = saved_is_streaming;
+    driver->stream_size = saved_stream_size;
+    driver->stream_file_offset = saved_stream_file_offset;
+    strcpy(driver->stream_file_name, saved_stream_file_name);
 
-    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_INPUT_NAME,
-                               "Unexpected input name %s", input_name);
-}
+    if (error)
+        return error;
 
-tensil_error_t tensil_driver_load_model_input_vector_scalars(
-    struct tensil_driver *driver, const struct tensil_model *model,
-    const char *input_name, size_t vector_offset, size_t scalars_size,
-    const float *buffer) {
-    for (size_t i = 0; i < model->inputs_size; i++) {
-        if (strcmp(model->inputs[i].name, input_name) == 0) {
-            float *vector_buffer =
-                (float *)malloc(driver->arch.array_size * sizeof(float));
-
-            if (!vector_buffer)
-                return TENSIL_DRIVER_ERROR(
-                    TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
-                    "Out of heap memory");
-
-            for (size_t j = 0; j < driver->arch.array_size; j++) {
-                if (j < scalars_size)
-                    vector_buffer[j] = buffer[j];
-                else
-                    vector_buffer[j] = 0.0;
-            }
+    if (is_streaming)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Insufficient buffer for resident model");
 
-            tensil_driver_write_dram_vectors(
-                driver, TENSIL_DRAM0, model->inputs[i].base + vector_offset, 0,
-                1, vector_buffer);
+    resident->buffer.offset = postamble_offset;
+    tensil_buffer_begin_batch(&batch, &resident->buffer, &driver->layout);
 
-            free(vector_buffer);
+    error = append_dram1_offset_instruction(&batch, driver->dram1_base_ptr);
 
-            // TODO: Support non-continuous inputs and outputs
-            return TENSIL_ERROR_NONE;
-        }
-    }
+    if (error)
+        return error;
 
-    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_INPUT_NAME,
-                               "Unexpected input name %s", input_name);
-}
+    error = pad_buffer(driver, &batch);
 
-tensil_error_t tensil_driver_get_model_output_scalars(
-    const struct tensil_driver *driver, const struct tensil_model *model,
-    const char *output_name, size_t size, float *buffer) {
-    for (size_t i = 0; i < model->outputs_size; i++) {
-        if (strcmp(model->outputs[i].name, output_name) == 0) {
-            size_t output_size_scalars =
-                model->outputs[i].size * driver->arch.array_size;
-            float *vector_buffer =
-                (float *)malloc(output_size_scalars * sizeof(float));
-
-            if (!vector_buffer)
-                return TENSIL_DRIVER_ERROR(
-                    TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
-                    "Out of heap memory");
-
-            tensil_driver_read_dram_vectors(
-                driver, TENSIL_DRAM0, model->outputs[i].base, 0,
-                model->outputs[i].size, vector_buffer);
-
-            for (size_t j = 0; j < size; j++)
-                if (j < output_size_scalars)
-                    buffer[j] = vector_buffer[j];
-
-            free(vector_buffer);
-
-            // TODO: Support non-continuous inputs and outputs
-            return TENSIL_ERROR_NONE;
-        }
-    }
+    if (error)
+        return error;
 
-    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_OUTPUT_NAME,
-                               "Unexpected output name %s", output_name);
-}
+    resident->postamble_offset = resident->buffer.offset;
 
-#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+    error = append_fence_instructions(driver, &batch);
 
-#define MAX_PRINT_OUTPUT_VECTORS 16
+    if (error)
+        return error;
 
-tensil_error_t
-tensil_driver_print_model_output_vectors(const struct tensil_driver *driver,
-                                         const struct tensil_model *model,
-                                         const char *output_name) {
-    for (size_t i = 0; i < model->outputs_size; i++) {
-        if (strcmp(model->outputs[i].name, output_name) == 0) {
-            float *vector_buffer =
-                (float *)malloc(driver->arch.array_size * sizeof(float));
+    error = pad_buffer(driver, &batch);
 
-            if (!vector_buffer)
-                return TENSIL_DRIVER_ERROR(
-                    TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
-                    "Out of heap memory");
+    if (error)
+        return error;
 
-            size_t size = model->outputs[i].size;
+    tensil_batch_commit(&batch);
 
-            if (size > MAX_PRINT_OUTPUT_VECTORS)
-                size = MAX_PRINT_OUTPUT_VECTORS;
+    resident->buffer.size =
+        align_size(resident->buffer.offset, RESIDENT_BUFFER_ALIGNMENT);
 
-            for (size_t j = 0; j < size; j++) {
-                tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
-                                                model->outputs[i].base + j, 0,
-                                                1, vector_buffer);
+    if (resident->load_consts_to_local) {
+        resident->preload_buffer.ptr =
+            resident->buffer.ptr + resident->buffer.size;
+        resident->preload_buffer.size = registry->buffer.size -
+                                        registry->buffer.offset -
+                                        resident->buffer.size;
 
-                printf("%s[%04zu]=", output_name, j);
+        error = append_preload_instructions(driver, resident, model);
 
-                for (size_t k = 0; k < driver->arch.array_size; k++)
-                    printf("%9.4f ", vector_buffer[k]);
+        if (error)
+            return error;
 
-                printf("\n");
-            }
+        resident->preload_buffer.size = align_size(
+            resident->preload_buffer.offset, RESIDENT_BUFFER_ALIGNMENT);
+    }
 
-            free(vector_buffer);
+    registry->buffer.offset +=
+        resident->buffer.size + resident->preload_buffer.size;
+    registry->dram1_offset += resident->dram1_size;
+    registry->models_size++;
 
-            // TODO: Support non-continuous inputs and outputs
-            return TENSIL_ERROR_NONE;
-        }
-    }
+    *resident_model = resident;
 
-    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_OUTPUT_NAME,
-                               "Unexpected output name %s", output_name);
+    return TENSIL_ERROR_NONE;
 }
 
+tensil_error_t
+tensil_driver_switch_model(struct tensil_driver *driver,
+                           struct tensil_model_registry *registry,
+                           const struct tensil_resident_model *resident_model) {
+    if (driver->active_run)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_BUSY,
+                                   "Compute unit is busy with another run");
+
+    if (!resident_model) {
+        if (registry->active_model) {
+            driver->buffer = registry->saved_buffer;
+            driver->postamble_offset = registry->saved_postamble_offset;
+            driver->is_streaming = registry->saved_is_streaming;
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+            driver->sample_interval_offset =
+                registry->saved_sample_interval_offset;
 #endif
+            driver->program_offset = 0;
+            update_program(driver);
+            registry->active_model = NULL;
+        }
 
-tensil_error_t tensil_driver_write_dram_vectors(struct tensil_driver *driver,
-                                                enum tensil_dram_bank dram_bank,
-                                                size_t offset, size_t stride,
-                                                size_t size, float *buffer) {
-    uint8_t *bank_ptr = tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
-    size_t bank_size = get_dram_bank_size(driver, dram_bank);
+        return TENSIL_ERROR_NONE;
+    }
 
-    if ((offset + size * (1 << stride)) *
-            tensil_dram_sizeof_scalar(driver->arch.data_type) *
-            driver->arch.array_size >
-        bank_size)
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
-                                   "Written data too big");
+    // Local memory is shared by all models and has to be preloaded again
+    // on each switch
+    if (resident_model->load_consts_to_local) {
+        struct tensil_run run;
+        memset(&run, 0, sizeof(struct tensil_run));
 
-    if (stride == 0)
-        tensil_dram_write_scalars(bank_ptr, driver->arch.data_type,
-                                  offset * driver->arch.array_size,
-                                  size * driver->arch.array_size, buffer);
-    else
-        for (size_t i = 0; i < size; i++)
-            tensil_dram_write_scalars(
-                bank_ptr, driver->arch.data_type,
-                (offset + i * (1 << stride)) * driver->arch.array_size,
-                driver->arch.array_size, buffer + i * driver->arch.array_size);
+        run.ranges[0] = resident_model->preload_buffer;
+        run.range_offsets[0] = 0;
+        run.ranges_size = 1;
+        run.is_streaming = false;
 
-    return TENSIL_ERROR_NONE;
-}
+        tensil_error_t error = submit_run(driver, &run, NULL, NULL, NULL);
 
-tensil_error_t
-tensil_driver_read_dram_vectors(const struct tensil_driver *driver,
-                                enum tensil_dram_bank dram_bank, size_t offset,
-                                size_t stride, size_t size, float *buffer) {
-    const uint8_t *bank_ptr =
-        tensil_driver_get_dram_bank_base_ptr(driver, dram_bank);
-    size_t bank_size = get_dram_bank_size(driver, dram_bank);
+        if (error)
+            return error;
 
-    if ((offset + size * (1 << stride)) *
-            tensil_dram_sizeof_scalar(driver->arch.data_type) *
-            driver->arch.array_size >
-        bank_size)
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
-                                   "Read data too big");
+        error = tensil_driver_wait(driver, &run);
 
-    if (stride == 0)
-        tensil_dram_read_scalars(bank_ptr, driver->arch.data_type,
-                                 offset * driver->arch.array_size,
-                                 size * driver->arch.array_size, buffer);
+        if (error)
+            return error;
+    }
 
-    else
-        for (size_t i = 0; i < size; i++)
-            tensil_dram_read_scalars(
-                bank_ptr, driver->arch.data_type,
-                (offset + i * (1 << stride)) * driver->arch.array_size,
-                driver->arch.array_size, buffer + i * driver->arch.array_size);
+    if (!registry->active_model) {
+        registry->saved_buffer = driver->buffer;
+        registry->saved_postamble_offset = driver->postamble_offset;
+        registry->saved_is_streaming = driver->is_streaming;
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+        registry->saved_sample_interval_offset = driver->sample_interval_offset;
+#endif
+    }
+
+    driver->buffer = resident_model->buffer;
+    driver->postamble_offset = resident_model->postamble_offset;
+    driver->is_streaming = false;
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    driver->sample_interval_offset = resident_model->sample_interval_offset;
+#endif
+    driver->program_offset = resident_model->program_offset;
+    update_program(driver);
+    registry->active_model = resident_model;
 
     return TENSIL_ERROR_NONE;
 }
+
+#endif
@@ -16,6 +16,8 @@
 
 enum tensil_dram_bank { TENSIL_DRAM0 = 0, TENSIL_DRAM1 = 1 };
 
+struct tensil_run;
+
 struct tensil_driver {
     struct tensil_architecture arch;
 
@@ -33,18 +35,59 @@ struct tensil_driver {
     struct tensil_instruction_buffer buffer;
     struct tensil_instruction_layout layout;
 
+    // Offset of fence instructions appended after the program
+    size_t postamble_offset;
+
+    // Buffer from the preamble on, where program counter zero is. Resident
+    // models precede their preamble with DRAM1 offset config, see
+    // tensil_driver_switch_model. Sample program counters index this view,
+    // which is updated on each submit.
+    size_t program_offset;
+    struct tensil_instruction_buffer program;
+
+    // Run submitted to the compute unit and not yet completed
+    struct tensil_run *active_run;
+
+    // Sequence number of the last submitted run, see tensil_run
+    uint32_t fence_sequence;
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    // Runs not completed within the timeout fail with
+    // TENSIL_ERROR_DRIVER_TIMEOUT. Zero waits indefinitely.
+    size_t run_timeout_us;
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    // Set when the loaded program does not fit the program buffer. Such
+    // program is streamed from the file on each run, see tensil_run.
+    bool is_streaming;
+    size_t stream_size;
+    size_t stream_file_offset;
+    char stream_file_name[FF_MAX_LFN];
+#endif
+
 #ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
     size_t sample_block_size;
     struct tensil_sample_buffer sample_buffer;
+
+    // Interval of the last submitted run and offset of the config
+    // instruction in the preamble that sets it, see tensil_run_opts
+    uint32_t sample_interval_cycles;
+    size_t sample_interval_offset;
 #endif
 };
 
+struct tensil_adaptive_sampling;
 struct tensil_model;
+struct tensil_program_map;
+struct tensil_tensor;
 
 tensil_error_t tensil_driver_init(struct tensil_driver *driver);
 
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
 
+// Programs that do not fit the program buffer are not loaded but streamed
+// from the file on each run.
 tensil_error_t
 tensil_driver_load_program_from_file(struct tensil_driver *driver, size_t size,
                                      const char *file_name);
@@ -54,33 +97,90 @@ tensil_error_t tensil_driver_load_dram_vectors_from_file(
     size_t offset, size_t size, const char *file_name);
 
 tensil_error_t tensil_driver_load_model_input_from_file(
-    struct tensil_driver *driver, const struct tensil_model *model,
-    const char *input_name, const char *file_name);
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    const char *file_name);
 
 tensil_error_t tensil_driver_load_model(struct tensil_driver *driver,
                                         const struct tensil_model *model);
 
 #endif
 
+// View of a model input or output in place in DRAM0. The view points to
+// the first scalar of the first vector in the bank's data type (int16_t for
+// FP16BP8). Vectors are vector_stride scalars apart and only the first
+// vector_size scalars of each vector are meaningful. Bytes past the
+// meaningful scalars are expected to be zero. Getting a view of a tensor
+// made of several segments fails with
+// TENSIL_ERROR_DRIVER_TENSOR_NOT_CONTIGUOUS.
+struct tensil_tensor_view {
+    enum tensil_data_type data_type;
+    void *ptr;
+    size_t vector_stride;
+    size_t vector_size;
+    size_t size;
+};
+
+tensil_error_t
+tensil_driver_get_model_input_view(const struct tensil_driver *driver,
+                                   const struct tensil_tensor *input,
+                                   struct tensil_tensor_view *view);
+
+// Returned view reflects DRAM0 after the last run.
+tensil_error_t
+tensil_driver_get_model_output_view(const struct tensil_driver *driver,
+                                    const struct tensil_tensor *output,
+                                    struct tensil_tensor_view *view);
+
+// Makes scalars written through the view visible to the compute unit.
+// Call once after writing and before running.
+void tensil_tensor_view_commit(const struct tensil_tensor_view *view);
+
+#define TENSIL_MAX_IMAGE_CHANNELS 4
+
+enum tensil_image_layout {
+    // Channels of each pixel are adjacent
+    TENSIL_IMAGE_LAYOUT_HWC = 0,
+    // Each channel is a separate plane of pixels
+    TENSIL_IMAGE_LAYOUT_CHW = 1
+};
+
+// Lookup tables from 8-bit channel value to (value - mean) * scale in the
+// bank's data type (int16_t for FP16BP8).
+struct tensil_image_lut {
+    int16_t values[TENSIL_MAX_IMAGE_CHANNELS][256];
+    size_t channels_size;
+};
+
+tensil_error_t tensil_image_lut_init(struct tensil_image_lut *lut,
+                                     enum tensil_data_type data_type,
+                                     size_t channels_size, const float *mean,
+                                     const float *scale);
+
+// Writes each pixel of the image as a vector of the input, with
+// channels converted through the lookup table and the rest of the vector
+// zero. Vectors of the input past the last pixel are zero.
+tensil_error_t tensil_driver_load_model_input_image(
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    const struct tensil_image_lut *lut, enum tensil_image_layout layout,
+    size_t pixels_size, const uint8_t *image);
+
 tensil_error_t tensil_driver_load_model_input_scalars(
-    struct tensil_driver *driver, const struct tensil_model *model,
-    const char *input_name, size_t size, const float *buffer);
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    size_t size, const float *buffer);
 
 tensil_error_t tensil_driver_load_model_input_vector_scalars(
-    struct tensil_driver *driver, const struct tensil_model *model,
-    const char *input_name, size_t vector_offset, size_t scalars_size,
-    const float *buffer);
+    struct tensil_driver *driver, const struct tensil_tensor *input,
+    size_t vector_offset, size_t scalars_size, const float *buffer);
 
 tensil_error_t tensil_driver_get_model_output_scalars(
-    const struct tensil_driver *driver, const struct tensil_model *model,
-    const char *output_name, size_t size, float *buffer);
+    const struct tensil_driver *driver, const struct tensil_tensor *output,
+    size_t size, float *buffer);
 
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
 
 tensil_error_t
 tensil_driver_print_model_output_vectors(const struct tensil_driver *driver,
-                                         const struct tensil_model *model,
-                                         const char *output_name);
+                                         const struct tensil_tensor *output);
 
 #endif
 
@@ -94,21 +194,261 @@ tensil_driver_read_dram_vectors(const struct tensil_driver *driver,
                                 enum tensil_dram_bank dram_bank, size_t offset,
                                 size_t stride, size_t size, float *buffer);
 
+// In ring sampling mode, see tensil_sample_buffer, both summary and
+// aggregates print the folded aggregates, while listing and sample file are
+// not available. Samples per layer are printed in both modes, although
+// without stalls in ring mode.
 struct tensil_run_opts {
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
     bool print_sampling_summary;
     bool print_sampling_aggregates;
     bool print_sampling_listing;
+
+    // Prints samples per model layer when set, see program_map.h
+    const struct tensil_program_map *program_map;
 #endif
 
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
     const char *sample_file_name;
 #endif
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    // Overrides the driver run timeout when not zero
+    size_t timeout_us;
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    // Overrides TENSIL_SAMPLE_INTERVAL_CYCLES when not zero, submit fails
+    // past TENSIL_SAMPLE_MAX_INTERVAL_CYCLES
+    uint32_t sample_interval_cycles;
+
+    // Takes the interval from adaptive sampling when set and refines it
+    // with the samples of the run, see adaptive_sampling.h. Only refined in
+    // linear mode, since the buffer only keeps the last blocks in ring mode.
+    // Zero maximum number of samples is taken as the buffer capacity.
+    struct tensil_adaptive_sampling *adaptive_sampling;
+#endif
 };
 
 tensil_error_t tensil_driver_run(struct tensil_driver *driver,
                                  const struct tensil_run_opts *run_opts);
 
+// Asynchronous run of the program. The run is submitted to the compute unit
+// and progresses each time it is polled, leaving the CPU free in between.
+// Only one run can be in progress at a time.
+
+#define TENSIL_MAX_RUN_RANGES 3
+
+struct tensil_run;
+
+typedef void (*tensil_run_callback_t)(struct tensil_driver *driver,
+                                      struct tensil_run *run, void *context);
+
+struct tensil_run {
+    const struct tensil_run_opts *run_opts;
+    tensil_run_callback_t callback;
+    void *context;
+
+    // Instruction ranges run one after another. Each range starts at its
+    // range offset and ends at its buffer offset.
+    struct tensil_instruction_buffer ranges[TENSIL_MAX_RUN_RANGES];
+    size_t range_offsets[TENSIL_MAX_RUN_RANGES];
+    size_t ranges_size;
+
+    bool is_running;
+    size_t range_index;
+    size_t run_offset;
+
+    // Fence instructions at the end of the last range copy the sequence
+    // number from the fence source to the fence target vector at the top of
+    // DRAM0. The run is complete once the target holds its own number, so
+    // that a late fence of an earlier run is never mistaken for it.
+    uint32_t fence_sequence;
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    uint64_t start_us;
+    size_t timeout_us;
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    // Streamed program is transferred from the two halves of the program
+    // buffer (ranges 0 and 1) in turns. While one half is transferred the
+    // other one is loaded with the next chunk of the file when polled.
+    bool is_streaming;
+    FIL stream_fil;
+    size_t stream_offset;
+    volatile bool is_half_loaded[2];
+    volatile bool is_stream_loaded;
+    volatile bool is_stream_stalled;
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    // Set from interrupt handlers once the last chunk of instructions has
+    // completed or when a transfer fails.
+    volatile bool is_submitted;
+    tensil_error_t volatile interrupt_error;
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    volatile bool sample_busy;
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    volatile bool is_sampling_stopped;
+#endif
+#endif
+};
+
+// Run options, when not NULL, must remain valid until the run completes.
+// Callback, when not NULL, is called from the poll that completes the run.
+tensil_error_t tensil_driver_submit(struct tensil_driver *driver,
+                                    struct tensil_run *run,
+                                    const struct tensil_run_opts *run_opts,
+                                    tensil_run_callback_t callback,
+                                    void *context);
+
+// Advances the run without blocking and clears is_running once the run
+// completes. With TENSIL_PLATFORM_ENABLE_INTERRUPTS instructions are
+// submitted from the DMA completion interrupt and polling only checks for
+// completion. Run that exceeds its timeout fails and leaves the compute unit
+// in an unknown state.
+tensil_error_t tensil_driver_poll(struct tensil_driver *driver,
+                                  struct tensil_run *run);
+
+// Polls with exponential backoff until the run completes or fails.
+tensil_error_t tensil_driver_wait(struct tensil_driver *driver,
+                                  struct tensil_run *run);
+
+// Pipelined execution of the loaded program over a number of activation
+// slots. Each slot is a separate copy of DRAM0 data (inputs, outputs and
+// intermediate activations) and the program is run against one slot at a
+// time by rebasing DRAM0. While the program runs for one slot the CPU can
+// write inputs to the next slot and read outputs from the previous one.
+
+#define TENSIL_MAX_PIPELINE_SLOTS 8
+
+struct tensil_pipeline {
+    // Placed in the program buffer right after the program. Prologues set
+    // DRAM0 offset to the slot and epilogue sets it back before flushing.
+    struct tensil_instruction_buffer buffer;
+    size_t prologue_offsets[TENSIL_MAX_PIPELINE_SLOTS];
+    size_t prologue_size;
+    size_t epilogue_offset;
+    size_t epilogue_size;
+
+    size_t slots_size;
+    size_t slot_depth;
+    size_t slot_size_bytes;
+};
+
+// Slot depth is the number of DRAM0 vectors used by the loaded program.
+// Must be called after loading the model, loading another model
+// invalidates the pipeline.
+tensil_error_t tensil_driver_init_pipeline(struct tensil_driver *driver,
+                                           struct tensil_pipeline *pipeline,
+                                           size_t slots_size,
+                                           size_t slot_depth);
+
+tensil_error_t tensil_driver_get_pipeline_input_view(
+    const struct tensil_driver *driver, const struct tensil_pipeline *pipeline,
+    size_t slot, const struct tensil_tensor *input,
+    struct tensil_tensor_view *view);
+
+tensil_error_t tensil_driver_get_pipeline_output_view(
+    const struct tensil_driver *driver, const struct tensil_pipeline *pipeline,
+    size_t slot, const struct tensil_tensor *output,
+    struct tensil_tensor_view *view);
+
+// Same as tensil_driver_submit with the program running against the slot.
+tensil_error_t tensil_driver_submit_pipeline(
+    struct tensil_driver *driver, const struct tensil_pipeline *pipeline,
+    size_t slot, struct tensil_run *run,
+    const struct tensil_run_opts *run_opts, tensil_run_callback_t callback,
+    void *context);
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Registry of models kept resident in regions reserved at the end of the
+// program buffer and DRAM1. Each resident model has its consts in its own
+// DRAM1 region and its program in its own program buffer region, so
+// switching between resident models does not read any files. The program of
+// a resident model sets DRAM1 offset to its region and sets it back before
+// flushing. DRAM0 is shared by all models.
+
+#define TENSIL_MAX_RESIDENT_MODELS 4
+
+struct tensil_resident_model {
+    // Program region with DRAM1 offset config, program and postamble
+    struct tensil_instruction_buffer buffer;
+    size_t program_offset;
+    size_t postamble_offset;
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    size_t sample_interval_offset;
+#endif
+
+    // Moves consts to local memory when switching to the model
+    bool load_consts_to_local;
+    struct tensil_instruction_buffer preload_buffer;
+
+    uint8_t *dram1_ptr;
+    size_t dram1_size;
+};
+
+struct tensil_model_registry {
+    struct tensil_resident_model models[TENSIL_MAX_RESIDENT_MODELS];
+    size_t models_size;
+
+    // Reserved regions allocated to resident models from the start
+    struct tensil_instruction_buffer buffer;
+    uint8_t *dram1_ptr;
+    size_t dram1_size;
+    size_t dram1_offset;
+
+    // Program buffer and DRAM1 sizes before reserving the regions
+    size_t original_buffer_size;
+    size_t original_dram1_size;
+
+    // Program loaded with tensil_driver_load_model is saved while a resident
+    // model is active
+    const struct tensil_resident_model *active_model;
+    struct tensil_instruction_buffer saved_buffer;
+    size_t saved_postamble_offset;
+    bool saved_is_streaming;
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    size_t saved_sample_interval_offset;
+#endif
+};
+
+// Reserves buffer_size bytes at the end of the program buffer and
+// dram1_size bytes at the end of DRAM1 for resident models. Fails when the
+// loaded program overlaps the reserved region.
+tensil_error_t
+tensil_driver_init_registry(struct tensil_driver *driver,
+                            struct tensil_model_registry *registry,
+                            size_t buffer_size, size_t dram1_size);
+
+// Switches back to the loaded program and returns reserved regions to the
+// program buffer and DRAM1.
+tensil_error_t
+tensil_driver_release_registry(struct tensil_driver *driver,
+                               struct tensil_model_registry *registry);
+
+// Resident model must fit the remaining regions, its program is never
+// streamed.
+tensil_error_t tensil_driver_load_resident_model(
+    struct tensil_driver *driver, struct tensil_model_registry *registry,
+    const struct tensil_model *model,
+    struct tensil_resident_model **resident_model);
+
+// Makes the resident model the loaded program for tensil_driver_submit. NULL
+// switches back to the program loaded with tensil_driver_load_model, which
+// must be done before loading another model with it.
+tensil_error_t
+tensil_driver_switch_model(struct tensil_driver *driver,
+                           struct tensil_model_registry *registry,
+                           const struct tensil_resident_model *resident_model);
+
+#endif
+
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
 
 tensil_error_t tensil_driver_run_memory_test(struct tensil_driver *driver,
@@ -122,11 +462,67 @@ tensil_error_t tensil_driver_run_array_test(struct tensil_driver *driver,
 tensil_error_t tensil_driver_run_simd_test(struct tensil_driver *driver,
                                            bool verbose);
 
+tensil_error_t tensil_driver_run_conversion_test(struct tensil_driver *driver,
+                                                 bool verbose);
+
+tensil_error_t tensil_driver_run_tensor_view_test(struct tensil_driver *driver,
+                                                  bool verbose);
+
+tensil_error_t tensil_driver_run_image_test(struct tensil_driver *driver,
+                                            bool verbose);
+
+tensil_error_t tensil_driver_run_pipeline_test(struct tensil_driver *driver,
+                                               bool verbose);
+
+tensil_error_t
+tensil_driver_run_segmented_tensor_test(struct tensil_driver *driver,
+                                        bool verbose);
+
+tensil_error_t tensil_driver_run_instruction_test(struct tensil_driver *driver,
+                                                  bool verbose);
+
+tensil_error_t tensil_driver_run_fence_test(struct tensil_driver *driver,
+                                            bool verbose);
+
+tensil_error_t
+tensil_driver_run_sample_aggregates_test(struct tensil_driver *driver,
+                                         bool verbose);
+
+tensil_error_t tensil_driver_run_bottleneck_test(struct tensil_driver *driver,
+                                                 bool verbose);
+
+tensil_error_t
+tensil_driver_run_adaptive_sampling_test(struct tensil_driver *driver,
+                                         bool verbose);
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+tensil_error_t tensil_driver_run_streaming_test(struct tensil_driver *driver,
+                                                bool verbose);
+
+tensil_error_t tensil_driver_run_bundle_test(struct tensil_driver *driver,
+                                             bool verbose);
+
+tensil_error_t tensil_driver_run_residency_test(struct tensil_driver *driver,
+                                                bool verbose);
+
+tensil_error_t tensil_driver_run_model_test(struct tensil_driver *driver,
+                                            bool verbose);
+
+tensil_error_t tensil_driver_run_program_map_test(struct tensil_driver *driver,
+                                                  bool verbose);
+
+#endif
+
 #ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
 
 tensil_error_t tensil_driver_run_sampling_test(struct tensil_driver *driver,
                                                bool verbose);
 
+tensil_error_t
+tensil_driver_run_sampling_ring_test(struct tensil_driver *driver,
+                                     bool verbose);
+
 #endif
 
 #endif
@@ -5,14 +5,21 @@
 
 #include <malloc.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
 #include <stdio.h>
 #endif
 
+#include "adaptive_sampling.h"
+#include "bottleneck.h"
+#include "compression.h"
 #include "dram.h"
+#include "instruction.h"
 #include "instruction_buffer.h"
+#include "model.h"
+#include "program_map.h"
 #include "sample_buffer.h"
 
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
@@ -91,44 +98,47 @@ do_memory_test(struct tensil_driver *driver, enum tensil_dram_bank from_bank,
     if (error)
         return error;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE, from_flags,
-        tensil_instruction_make_operand0(&driver->layout, from_offset, stride0),
-        tensil_instruction_make_operand1(&driver->layout, from_offset, stride1),
+    const struct tensil_instruction_layout *layout = &driver->layout;
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, &driver->buffer, layout);
+
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, from_flags,
+        tensil_instruction_make_operand0(layout, from_offset, stride0),
+        tensil_instruction_make_operand1(layout, from_offset, stride1),
         size - 1);
 
     if (error)
         return error;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC,
-        tensil_instruction_make_operand0(&driver->layout, from_offset, stride0),
-        tensil_instruction_make_operand1(&driver->layout, from_offset, stride1),
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC,
+        tensil_instruction_make_operand0(layout, from_offset, stride0),
+        tensil_instruction_make_operand1(layout, from_offset, stride1),
         size - 1);
 
     if (error)
         return error;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL,
-        tensil_instruction_make_operand0(&driver->layout, to_offset, stride0),
-        tensil_instruction_make_operand1(&driver->layout, from_offset, stride1),
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL,
+        tensil_instruction_make_operand0(layout, to_offset, stride0),
+        tensil_instruction_make_operand1(layout, from_offset, stride1),
         size - 1);
 
     if (error)
         return error;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE, to_flags,
-        tensil_instruction_make_operand0(&driver->layout, to_offset, stride0),
-        tensil_instruction_make_operand1(&driver->layout, to_offset, stride1),
-        size - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, to_flags,
+        tensil_instruction_make_operand0(layout, to_offset, stride0),
+        tensil_instruction_make_operand1(layout, to_offset, stride1), size - 1);
 
     if (error)
         return error;
 
+    tensil_batch_commit(&batch);
+
     error = tensil_driver_setup_buffer_postamble(driver);
 
     if (error)
@@ -301,6 +311,7 @@ tensil_error_t tensil_driver_run_array_test(struct tensil_driver *driver,
     tensil_error_t error = TENSIL_ERROR_NONE;
     size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
     size_t bad_indexes_size = 0;
+    struct tensil_instruction_batch batch;
 
     float *from_buffer = (float *)malloc(
         ARRAY_TEST_SIZE * driver->arch.array_size * sizeof(float));
@@ -348,53 +359,56 @@ tensil_error_t tensil_driver_run_array_test(struct tensil_driver *driver,
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, ARRAY_TEST_WEIGHTS_LOCAL_ADDRESS,
-        ARRAY_TEST_WEIGHTS_DRAM1_ADDRESS, driver->arch.array_size);
+    tensil_buffer_begin_batch(&batch, &driver->buffer, &driver->layout);
+
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL,
+        ARRAY_TEST_WEIGHTS_LOCAL_ADDRESS, ARRAY_TEST_WEIGHTS_DRAM1_ADDRESS,
+        driver->arch.array_size);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_LOAD_WEIGHT, 0,
-        ARRAY_TEST_WEIGHTS_LOCAL_ADDRESS, driver->arch.array_size, 0);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_LOAD_WEIGHT, 0, ARRAY_TEST_WEIGHTS_LOCAL_ADDRESS,
+        driver->arch.array_size, 0);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, ARRAY_TEST_INPUT_LOCAL_ADDRESS,
-        ARRAY_TEST_INPUT_DRAM0_ADDRESS, ARRAY_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL,
+        ARRAY_TEST_INPUT_LOCAL_ADDRESS, ARRAY_TEST_INPUT_DRAM0_ADDRESS,
+        ARRAY_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_MAT_MUL, 0,
-        ARRAY_TEST_INPUT_LOCAL_ADDRESS, ARRAY_TEST_OUTPUT_ACC_ADDRESS,
-        ARRAY_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_MAT_MUL, 0, ARRAY_TEST_INPUT_LOCAL_ADDRESS,
+        ARRAY_TEST_OUTPUT_ACC_ADDRESS, ARRAY_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL, ARRAY_TEST_OUTPUT_LOCAL_ADDRESS,
-        ARRAY_TEST_OUTPUT_ACC_ADDRESS, ARRAY_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL,
+        ARRAY_TEST_OUTPUT_LOCAL_ADDRESS, ARRAY_TEST_OUTPUT_ACC_ADDRESS,
+        ARRAY_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, ARRAY_TEST_OUTPUT_LOCAL_ADDRESS,
-        ARRAY_TEST_OUTPUT_DRAM0_ADDRESS, ARRAY_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0,
+        ARRAY_TEST_OUTPUT_LOCAL_ADDRESS, ARRAY_TEST_OUTPUT_DRAM0_ADDRESS,
+        ARRAY_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
+    tensil_batch_commit(&batch);
+
     error = tensil_driver_setup_buffer_postamble(driver);
 
     if (error)
@@ -467,6 +481,7 @@ tensil_error_t tensil_driver_run_simd_test(struct tensil_driver *driver,
     tensil_error_t error = TENSIL_ERROR_NONE;
     size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
     size_t bad_indexes_size = 0;
+    struct tensil_instruction_batch batch;
 
     float *from_buffer = (float *)malloc(
         SIMD_TEST_SIZE * driver->arch.array_size * sizeof(float));
@@ -510,102 +525,108 @@ tensil_error_t tensil_driver_run_simd_test(struct tensil_driver *driver,
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, SIMD_TEST_MULS_LOCAL_ADDRESS,
-        SIMD_TEST_MULS_DRAM1_ADDRESS, SIMD_TEST_SIZE - 1);
+    tensil_buffer_begin_batch(&batch, &driver->buffer, &driver->layout);
+
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL,
+        SIMD_TEST_MULS_LOCAL_ADDRESS, SIMD_TEST_MULS_DRAM1_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, SIMD_TEST_ADDS_LOCAL_ADDRESS,
-        SIMD_TEST_ADDS_DRAM1_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL,
+        SIMD_TEST_ADDS_LOCAL_ADDRESS, SIMD_TEST_ADDS_DRAM1_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC, SIMD_TEST_MULS_LOCAL_ADDRESS,
-        SIMD_TEST_MULS_ACC_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC,
+        SIMD_TEST_MULS_LOCAL_ADDRESS, SIMD_TEST_MULS_ACC_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC, SIMD_TEST_ADDS_LOCAL_ADDRESS,
-        SIMD_TEST_ADDS_ACC_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC,
+        SIMD_TEST_ADDS_LOCAL_ADDRESS, SIMD_TEST_ADDS_ACC_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, SIMD_TEST_INPUT_LOCAL_ADDRESS,
-        SIMD_TEST_INPUT_DRAM0_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL,
+        SIMD_TEST_INPUT_LOCAL_ADDRESS, SIMD_TEST_INPUT_DRAM0_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC, SIMD_TEST_INPUT_LOCAL_ADDRESS,
-        SIMD_TEST_INPUT_ACC_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC,
+        SIMD_TEST_INPUT_LOCAL_ADDRESS, SIMD_TEST_INPUT_ACC_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
     for (size_t i = 0; i < SIMD_TEST_SIZE; i++) {
-        // TODO: need to respect SIMD op layout from arch
         // TODO: need to test SIMD ops other than Move, Multiply and Add
         // TODO: need to specialize the test when >1 SIMD registers are
         // available
 
-        error = tensil_buffer_append_instruction(
-            &driver->buffer, &driver->layout, TENSIL_OPCODE_SIMD,
-            TENSIL_SIMD_FLAG_READ, 0, SIMD_TEST_INPUT_ACC_ADDRESS + i,
-            (TENSIL_SIMD_OPCODE_MOVE << 3) | 0b001);
+        error = tensil_batch_append_instruction(
+            &batch, TENSIL_OPCODE_SIMD, TENSIL_SIMD_FLAG_READ, 0,
+            SIMD_TEST_INPUT_ACC_ADDRESS + i,
+            tensil_instruction_make_simd_operand2(
+                &driver->layout, TENSIL_SIMD_OPCODE_MOVE, 0, 0, 1));
 
         if (error)
             goto cleanup;
 
-        error = tensil_buffer_append_instruction(
-            &driver->buffer, &driver->layout, TENSIL_OPCODE_SIMD,
-            TENSIL_SIMD_FLAG_READ, 0, SIMD_TEST_MULS_ACC_ADDRESS + i,
-            (TENSIL_SIMD_OPCODE_MUL << 3) | 0b101);
+        error = tensil_batch_append_instruction(
+            &batch, TENSIL_OPCODE_SIMD, TENSIL_SIMD_FLAG_READ, 0,
+            SIMD_TEST_MULS_ACC_ADDRESS + i,
+            tensil_instruction_make_simd_operand2(
+                &driver->layout, TENSIL_SIMD_OPCODE_MUL, 1, 0, 1));
 
         if (error)
             goto cleanup;
 
-        error = tensil_buffer_append_instruction(
-            &driver->buffer, &driver->layout, TENSIL_OPCODE_SIMD,
+        error = tensil_batch_append_instruction(
+            &batch, TENSIL_OPCODE_SIMD,
             TENSIL_SIMD_FLAG_READ | TENSIL_SIMD_FLAG_WRITE,
             SIMD_TEST_OUTPUT_ACC_ADDRESS + i, SIMD_TEST_ADDS_ACC_ADDRESS + i,
-            (TENSIL_SIMD_OPCODE_ADD << 3) | 0b100);
+            tensil_instruction_make_simd_operand2(
+                &driver->layout, TENSIL_SIMD_OPCODE_ADD, 1, 0, 0));
 
         if (error)
             goto cleanup;
     }
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL, SIMD_TEST_OUTPUT_LOCAL_ADDRESS,
-        SIMD_TEST_OUTPUT_ACC_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL,
+        SIMD_TEST_OUTPUT_LOCAL_ADDRESS, SIMD_TEST_OUTPUT_ACC_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
-    error = tensil_buffer_append_instruction(
-        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, SIMD_TEST_OUTPUT_LOCAL_ADDRESS,
-        SIMD_TEST_OUTPUT_DRAM0_ADDRESS, SIMD_TEST_SIZE - 1);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0,
+        SIMD_TEST_OUTPUT_LOCAL_ADDRESS, SIMD_TEST_OUTPUT_DRAM0_ADDRESS,
+        SIMD_TEST_SIZE - 1);
 
     if (error)
         goto cleanup;
 
+    tensil_batch_commit(&batch);
+
     error = tensil_driver_setup_buffer_postamble(driver);
 
     if (error)
@@ -653,83 +674,2874 @@ cleanup:
     return error;
 }
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+#define CONVERSION_TEST_BITS_SIZE (1 << 16)
+#define CONVERSION_TEST_SPECIALS_SIZE 6
+#define CONVERSION_TEST_SIZE                                                   \
+    (CONVERSION_TEST_BITS_SIZE * 2 + CONVERSION_TEST_SPECIALS_SIZE)
 
-#define SAMPLING_TEST_SIZE (64 * 1024 * 1024)
+#define CONVERSION_TEST_DRAM0_ADDRESS 0
+#define CONVERSION_TEST_REFERENCE_DRAM0_ADDRESS CONVERSION_TEST_SIZE
 
-tensil_error_t tensil_driver_run_sampling_test(struct tensil_driver *driver,
-                                               bool verbose) {
+static bool compare_scalars_exact(float expected, float actual) {
+    return memcmp(&expected, &actual, sizeof(float)) != 0;
+}
+
+static void print_conversion_test_result(size_t test_count,
+                                         size_t failure_count,
+                                         const float *expected,
+                                         const float *actual, bool verbose) {
+    printf("%s: %zu tests, %zu failures\n", failure_count ? failed : ok,
+           test_count, failure_count);
+
+    if (verbose)
+        for (size_t k = 0, printed = 0;
+             k < test_count && printed < TEST_MAX_BAD_INDEXES_SIZE; k++)
+            if (compare_scalars_exact(expected[k], actual[k])) {
+                printf("\t at %zu expected=%f, actual=%f\n", k, expected[k],
+                       actual[k]);
+                printed++;
+            }
+}
+
+tensil_error_t tensil_driver_run_conversion_test(struct tensil_driver *driver,
+                                                 bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t failure_count = 0;
+    uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM0);
+    enum tensil_data_type type = driver->arch.data_type;
+
+    float *from_buffer = (float *)malloc(CONVERSION_TEST_SIZE * sizeof(float));
+    float *to_buffer = (float *)malloc(CONVERSION_TEST_SIZE * sizeof(float));
+    float *reference_buffer =
+        (float *)malloc(CONVERSION_TEST_SIZE * sizeof(float));
+
+    if (!from_buffer || !to_buffer || !reference_buffer) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    // Read every bit pattern with vectorized and reference conversions
+    uint8_t *base_ptr = bank_ptr + CONVERSION_TEST_DRAM0_ADDRESS *
+                                       tensil_dram_sizeof_scalar(type);
+
+    for (size_t i = 0; i < CONVERSION_TEST_BITS_SIZE; i++) {
+        base_ptr[i * 2] = i & 0xff;
+        base_ptr[i * 2 + 1] = (i >> 8) & 0xff;
+    }
+
+    printf("\tRead test ");
+
+    tensil_dram_read_scalars(bank_ptr, type, CONVERSION_TEST_DRAM0_ADDRESS,
+                             CONVERSION_TEST_BITS_SIZE, to_buffer);
+    tensil_dram_read_scalars_reference(
+        bank_ptr, type, CONVERSION_TEST_DRAM0_ADDRESS,
+        CONVERSION_TEST_BITS_SIZE, reference_buffer);
+
+    for (size_t k = 0; k < CONVERSION_TEST_BITS_SIZE; k++)
+        if (compare_scalars_exact(reference_buffer[k], to_buffer[k]))
+            failure_count++;
+
+    print_conversion_test_result(CONVERSION_TEST_BITS_SIZE, failure_count,
+                                 reference_buffer, to_buffer, verbose);
+
+    // Write every representable value, every value halfway between
+    // representable values and values out of range. Representable values
+    // are expected to make the round trip unchanged.
+    float half_step = (reference_buffer[1] - reference_buffer[0]) / 2;
+
+    for (size_t k = 0; k < CONVERSION_TEST_BITS_SIZE; k++) {
+        from_buffer[k] = reference_buffer[k];
+        from_buffer[CONVERSION_TEST_BITS_SIZE + k] =
+            reference_buffer[k] + half_step;
+    }
+
+    float *specials = from_buffer + CONVERSION_TEST_BITS_SIZE * 2;
+    specials[0] = tensil_dram_max_scalar(type) * 2;
+    specials[1] = tensil_dram_min_scalar(type) * 2;
+    specials[2] = INFINITY;
+    specials[3] = -INFINITY;
+    specials[4] = NAN;
+    specials[5] = -0.0;
+
+    printf("\tWrite test ");
+
+    tensil_dram_write_scalars(bank_ptr, type, CONVERSION_TEST_DRAM0_ADDRESS,
+                              CONVERSION_TEST_SIZE, from_buffer);
+    tensil_dram_write_scalars_reference(
+        bank_ptr, type, CONVERSION_TEST_REFERENCE_DRAM0_ADDRESS,
+        CONVERSION_TEST_SIZE, from_buffer);
+
+    tensil_dram_read_scalars_reference(bank_ptr, type,
+                                       CONVERSION_TEST_DRAM0_ADDRESS,
+                                       CONVERSION_TEST_SIZE, to_buffer);
+    tensil_dram_read_scalars_reference(
+        bank_ptr, type, CONVERSION_TEST_REFERENCE_DRAM0_ADDRESS,
+        CONVERSION_TEST_SIZE, reference_buffer);
+
+    failure_count = 0;
+
+    for (size_t k = 0; k < CONVERSION_TEST_SIZE; k++)
+        if (compare_scalars_exact(reference_buffer[k], to_buffer[k]) ||
+            (k < CONVERSION_TEST_BITS_SIZE &&
+             compare_scalars_exact(from_buffer[k], reference_buffer[k])))
+            failure_count++;
+
+    print_conversion_test_result(CONVERSION_TEST_SIZE, failure_count,
+                                 reference_buffer, to_buffer, verbose);
+
+cleanup:
+    free(from_buffer);
+    free(to_buffer);
+    free(reference_buffer);
+
+    return error;
+}
+
+#define TENSOR_VIEW_TEST_SIZE 8
+
+static const char *tensor_view_test_json =
+    "{\"inputs\":[{\"name\":\"x\",\"base\":16,\"size\":8}],"
+    "\"outputs\":[{\"name\":\"y\",\"base\":32,\"size\":8}]}";
+
+static void write_tensor_view_test_scalars(struct tensil_tensor_view *view,
+                                           const float *buffer) {
+    int16_t *vector = (int16_t *)view->ptr;
+
+    for (size_t i = 0; i < view->size; i++) {
+        for (size_t j = 0; j < view->vector_size; j++)
+            vector[j] = tensil_dram_fp16bp8_from_float(
+                buffer[i * view->vector_size + j]);
+
+        vector += view->vector_stride;
+    }
+}
+
+static void read_tensor_view_test_scalars(const struct tensil_tensor_view *view,
+                                          float *buffer) {
+    const int16_t *vector = (const int16_t *)view->ptr;
+
+    for (size_t i = 0; i < view->size; i++) {
+        for (size_t j = 0; j < view->vector_size; j++)
+            buffer[i * view->vector_size + j] =
+                tensil_dram_fp16bp8_to_float(vector[j]);
+
+        vector += view->vector_stride;
+    }
+}
+
+// Copies input x to output y through local memory.
+static tensil_error_t
+setup_tensor_view_test_program(struct tensil_driver *driver,
+                               const struct tensil_tensor *x,
+                               const struct tensil_tensor *y) {
     tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
 
     if (error)
         return error;
 
-    error = tensil_buffer_append_noop_instructions(
-        &driver->buffer, &driver->layout, SAMPLING_TEST_SIZE);
+    const struct tensil_instruction_layout *layout = &driver->layout;
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, &driver->buffer, layout);
+
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL,
+        tensil_instruction_make_operand0(layout, 0, 0),
+        tensil_instruction_make_operand1(layout, x->base, 0), x->size - 1);
 
     if (error)
         return error;
 
-    error = tensil_driver_setup_buffer_postamble(driver);
+    error = tensil_batch_append_instruction(
+        &batch, TENSIL_OPCODE_DATA_MOVE, TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0,
+        tensil_instruction_make_operand0(layout, 0, 0),
+        tensil_instruction_make_operand1(layout, y->base, 0), y->size - 1);
 
     if (error)
         return error;
 
+    tensil_batch_commit(&batch);
+
+    return tensil_driver_setup_buffer_postamble(driver);
+}
+
+// Runs the same copy program with the input written through a view and
+// the output read through a view, then with the scalar load and read, and
+// expects both to return the written scalars.
+tensil_error_t tensil_driver_run_tensor_view_test(struct tensil_driver *driver,
+                                                  bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t array_size = driver->arch.array_size;
+    size_t scalars_size = TENSOR_VIEW_TEST_SIZE * array_size;
+    struct tensil_model model;
+    const struct tensil_tensor *x = NULL;
+    const struct tensil_tensor *y = NULL;
+    struct tensil_tensor_view input_view;
+    struct tensil_tensor_view output_view;
+    bool is_valid = false;
+
+    memset(&model, 0, sizeof(struct tensil_model));
+
+    float *from_buffer = (float *)malloc(scalars_size * sizeof(float));
+    float *view_buffer = (float *)malloc(scalars_size * sizeof(float));
+    float *scalar_buffer = (float *)malloc(scalars_size * sizeof(float));
+    cJSON *json = cJSON_Parse(tensor_view_test_json);
+    cJSON *arch = json ? cJSON_AddObjectToObject(json, "arch") : NULL;
+
+    if (!from_buffer || !view_buffer || !scalar_buffer || !arch ||
+        !cJSON_AddNumberToObject(arch, "array_size", (double)array_size) ||
+        !cJSON_AddStringToObject(arch, "data_type", "FP16BP8")) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    error = tensil_model_parse(&model, json);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_input(&model, "x", &x);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&model, "y", &y);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_get_model_input_view(driver, x, &input_view);
+
+    if (error)
+        goto cleanup;
+
+    is_valid = input_view.size == TENSOR_VIEW_TEST_SIZE &&
+               input_view.vector_size == array_size &&
+               input_view.vector_stride >= array_size;
+
+    if (!is_valid)
+        goto report;
+
+    // Random scalars are taken from a scratch area past both tensors
+    fill_dram_with_random_vectors(driver, TENSIL_DRAM0, 0, 0,
+                                  y->end_bytes / y->vector_size_bytes +
+                                      TENSOR_VIEW_TEST_SIZE);
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                    y->end_bytes / y->vector_size_bytes, 0,
+                                    TENSOR_VIEW_TEST_SIZE, from_buffer);
+
+    error = setup_tensor_view_test_program(driver, x, y);
+
+    if (error)
+        goto cleanup;
+
+    write_tensor_view_test_scalars(&input_view, from_buffer);
+    tensil_tensor_view_commit(&input_view);
+
     error = tensil_driver_run(driver, NULL);
 
     if (error)
-        return error;
+        goto cleanup;
 
-    size_t samples_count =
-        driver->sample_buffer.offset / TENSIL_SAMPLE_SIZE_BYTES;
+    error = tensil_driver_get_model_output_view(driver, y, &output_view);
 
-    size_t valid_samples_count = 0;
-    size_t valid_samples_base = 0;
+    if (error)
+        goto cleanup;
 
-    size_t stalling_samples_count = 0;
-    size_t missing_samples_count = 0;
+    read_tensor_view_test_scalars(&output_view, view_buffer);
 
-    const uint8_t *sample_ptr =
-        tensil_sample_buffer_find_valid_samples_ptr(&driver->sample_buffer);
+    fill_dram_with_random_vectors(driver, TENSIL_DRAM0, y->base, 0, y->size);
 
-    uint32_t prev_program_counter = 0;
-    uint32_t next_program_counter = 0;
-    uint32_t instruction_offset = 0;
+    error = tensil_driver_load_model_input_scalars(driver, x, scalars_size,
+                                                   from_buffer);
 
-    while (tensil_sample_buffer_get_next_samples_ptr(
-        &driver->sample_buffer, &driver->buffer, &driver->layout, &sample_ptr,
-        &next_program_counter, &instruction_offset)) {
-        valid_samples_count++;
+    if (error)
+        goto cleanup;
 
-        if (!prev_program_counter) {
-            prev_program_counter = next_program_counter;
-        } else {
-            if (prev_program_counter == next_program_counter)
-                stalling_samples_count++;
-            else {
-                if (next_program_counter >
-                    prev_program_counter + TENSIL_SAMPLE_INTERVAL_CYCLES) {
-                    if (verbose)
-                        printf("Offset %u -> %u\n",
-                               (unsigned int)prev_program_counter,
-                               (unsigned int)next_program_counter);
+    error = tensil_driver_run(driver, NULL);
 
-                    missing_samples_count++;
-                }
-                prev_program_counter = next_program_counter;
-            }
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_get_model_output_scalars(driver, y, scalars_size,
+                                                   scalar_buffer);
+
+    if (error)
+        goto cleanup;
+
+    for (size_t j = 0; j < scalars_size; j++)
+        if (from_buffer[j] != view_buffer[j] ||
+            from_buffer[j] != scalar_buffer[j]) {
+            bad_indexes[bad_indexes_size++] = j;
+
+            if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                break;
+        }
+
+report:
+    printf("%s\n", (bad_indexes_size || !is_valid) ? failed : ok);
+
+    if (!is_valid && verbose)
+        printf("\t unexpected view\n");
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t bad_index = bad_indexes[k];
+
+            printf("\t at %zu expected=%f, view=%f, scalar=%f\n", bad_index,
+                   from_buffer[bad_index], view_buffer[bad_index],
+                   scalar_buffer[bad_index]);
         }
+
+cleanup:
+    tensil_model_free(&model);
+    cJSON_Delete(json);
+
+    free(from_buffer);
+    free(view_buffer);
+    free(scalar_buffer);
+
+    return error;
+}
+
+#define IMAGE_TEST_PIXELS_SIZE 4
+#define IMAGE_TEST_CHANNELS_SIZE 3
+#define IMAGE_TEST_CIFAR_PIXELS_SIZE (32 * 32)
+
+// Pixels spill into the second segment and the input has vectors past the
+// image in both cases. Second case is a CIFAR image as the board loads it.
+static const char *image_test_json =
+    "{\"inputs\":[{\"name\":\"x\",\"base\":40,\"size\":3},"
+    "{\"name\":\"x\",\"base\":20,\"size\":3}],"
+    "\"outputs\":[{\"name\":\"y\",\"base\":40,\"size\":3},"
+    "{\"name\":\"y\",\"base\":20,\"size\":3}]}";
+
+static const char *image_test_cifar_json =
+    "{\"inputs\":[{\"name\":\"x\",\"base\":600,\"size\":512},"
+    "{\"name\":\"x\",\"base\":0,\"size\":514}],"
+    "\"outputs\":[{\"name\":\"y\",\"base\":600,\"size\":512},"
+    "{\"name\":\"y\",\"base\":0,\"size\":514}]}";
+
+static const uint8_t image_test_hwc[] = {0,   128, 255, 10, 20,  30,
+                                         200, 100, 50,  1,  254, 127};
+
+// Loads the image in both layouts over stale DRAM0 and reads it back as
+// scalars. The vectors past the image as well as the lanes past the
+// channels have to be zero.
+static tensil_error_t
+run_image_test_case(struct tensil_driver *driver, const char *json_text,
+                    size_t pixels_size, const uint8_t *image_hwc,
+                    const float *mean, const float *scale, bool verbose,
+                    bool *is_loaded) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes_size = 0;
+    size_t array_size = driver->arch.array_size;
+    struct tensil_image_lut lut;
+    struct tensil_model model;
+    const struct tensil_tensor *x = NULL;
+    const struct tensil_tensor *y = NULL;
+    size_t scalars_size = 0;
+    float *expected_buffer = NULL;
+    float *to_buffer = NULL;
+
+    memset(&model, 0, sizeof(struct tensil_model));
+
+    uint8_t *image_chw =
+        (uint8_t *)malloc(pixels_size * IMAGE_TEST_CHANNELS_SIZE);
+    cJSON *json = cJSON_Parse(json_text);
+    cJSON *arch = json ? cJSON_AddObjectToObject(json, "arch") : NULL;
+
+    if (!image_chw || !arch ||
+        !cJSON_AddNumberToObject(arch, "array_size", (double)array_size) ||
+        !cJSON_AddStringToObject(arch, "data_type", "FP16BP8")) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
     }
 
-    printf("%s: collected %lu samples, %lu "
-           "valid with %lu stalling and %lu missing, %lu head-invalid, %lu "
-           "tail-invalid\n",
-           missing_samples_count ? failed : ok, samples_count,
-           valid_samples_count, stalling_samples_count, missing_samples_count,
-           valid_samples_base,
-           samples_count - valid_samples_base - valid_samples_count);
+    error = tensil_model_parse(&model, json);
 
-    return TENSIL_ERROR_NONE;
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_input(&model, "x", &x);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&model, "y", &y);
+
+    if (error)
+        goto cleanup;
+
+    scalars_size = x->size * array_size;
+    expected_buffer = (float *)malloc(scalars_size * sizeof(float));
+    to_buffer = (float *)malloc(scalars_size * sizeof(float));
+
+    if (!expected_buffer || !to_buffer) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    error = tensil_image_lut_init(&lut, driver->arch.data_type,
+                                  IMAGE_TEST_CHANNELS_SIZE, mean, scale);
+
+    if (error)
+        goto cleanup;
+
+    memset(expected_buffer, 0, scalars_size * sizeof(float));
+
+    for (size_t i = 0; i < pixels_size; i++)
+        for (size_t c = 0; c < IMAGE_TEST_CHANNELS_SIZE; c++) {
+            uint8_t value = image_hwc[i * IMAGE_TEST_CHANNELS_SIZE + c];
+
+            image_chw[c * pixels_size + i] = value;
+            expected_buffer[i * array_size + c] = tensil_dram_fp16bp8_to_float(
+                tensil_dram_fp16bp8_from_float(((float)value - mean[c]) *
+                                               scale[c]));
+        }
+
+    for (size_t l = 0; l < 2; l++) {
+        enum tensil_image_layout layout =
+            l == 0 ? TENSIL_IMAGE_LAYOUT_HWC : TENSIL_IMAGE_LAYOUT_CHW;
+
+        fill_dram_with_random_vectors(driver, TENSIL_DRAM0, 0, 0,
+                                      x->end_bytes / x->vector_size_bytes);
+
+        error = tensil_driver_load_model_input_image(
+            driver, x, &lut, layout, pixels_size,
+            l == 0 ? image_hwc : image_chw);
+
+        if (error)
+            goto cleanup;
+
+        error = tensil_driver_get_model_output_scalars(driver, y, scalars_size,
+                                                       to_buffer);
+
+        if (error)
+            goto cleanup;
+
+        for (size_t j = 0; j < scalars_size; j++)
+            if (expected_buffer[j] != to_buffer[j]) {
+                if (verbose)
+                    printf("\t %zu pixels %s at %zu expected=%f, "
+                           "actual=%f\n",
+                           pixels_size, l == 0 ? "HWC" : "CHW", j,
+                           expected_buffer[j], to_buffer[j]);
+
+                if (++bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                    break;
+            }
+    }
+
+    *is_loaded = bad_indexes_size == 0;
+
+cleanup:
+    tensil_model_free(&model);
+    cJSON_Delete(json);
+
+    free(image_chw);
+    free(expected_buffer);
+    free(to_buffer);
+
+    return error;
+}
+
+tensil_error_t tensil_driver_run_image_test(struct tensil_driver *driver,
+                                            bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    float mean[IMAGE_TEST_CHANNELS_SIZE] = {0.0f, 128.0f, 100.0f};
+    float scale[IMAGE_TEST_CHANNELS_SIZE] = {1.0f / 255.0f, 1.0f / 64.0f,
+                                             0.5f};
+    float cifar_mean[IMAGE_TEST_CHANNELS_SIZE] = {0.0f, 0.0f, 0.0f};
+    float cifar_scale[IMAGE_TEST_CHANNELS_SIZE] = {
+        1.0f / 255.0f, 1.0f / 255.0f, 1.0f / 255.0f};
+    bool is_loaded = false;
+    bool is_cifar_loaded = false;
+
+    uint8_t *cifar_hwc = (uint8_t *)malloc(IMAGE_TEST_CIFAR_PIXELS_SIZE *
+                                           IMAGE_TEST_CHANNELS_SIZE);
+
+    if (!cifar_hwc)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    // Random image centered on its channel means
+    for (size_t i = 0; i < IMAGE_TEST_CIFAR_PIXELS_SIZE; i++)
+        for (size_t c = 0; c < IMAGE_TEST_CHANNELS_SIZE; c++) {
+            uint8_t value = (uint8_t)rand();
+
+            cifar_hwc[i * IMAGE_TEST_CHANNELS_SIZE + c] = value;
+            cifar_mean[c] += (float)value / IMAGE_TEST_CIFAR_PIXELS_SIZE;
+        }
+
+    error = run_image_test_case(driver, image_test_json,
+                                IMAGE_TEST_PIXELS_SIZE, image_test_hwc, mean,
+                                scale, verbose, &is_loaded);
+
+    if (error)
+        goto cleanup;
+
+    error = run_image_test_case(driver, image_test_cifar_json,
+                                IMAGE_TEST_CIFAR_PIXELS_SIZE, cifar_hwc,
+                                cifar_mean, cifar_scale, verbose,
+                                &is_cifar_loaded);
+
+    if (error)
+        goto cleanup;
+
+    printf("%s\n", (is_loaded && is_cifar_loaded) ? ok : failed);
+
+cleanup:
+    free(cifar_hwc);
+
+    return error;
+}
+
+#define PIPELINE_TEST_SIZE (driver->arch.local_depth / 4)
+#define PIPELINE_TEST_SLOTS_SIZE 3
+
+#define PIPELINE_TEST_INPUT_DRAM0_ADDRESS 0
+#define PIPELINE_TEST_OUTPUT_DRAM0_ADDRESS PIPELINE_TEST_SIZE
+#define PIPELINE_TEST_LOCAL_ADDRESS 0
+
+static void count_completed_runs(struct tensil_driver *driver,
+                                 struct tensil_run *run, void *context) {
+    (*(size_t *)context)++;
+}
+
+tensil_error_t tensil_driver_run_pipeline_test(struct tensil_driver *driver,
+                                               bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t bad_slot = 0;
+    struct tensil_pipeline pipeline;
+    struct tensil_run run;
+    size_t completed_runs_size = 0;
+    size_t scalars_size = PIPELINE_TEST_SIZE * driver->arch.array_size;
+
+    float *from_buffer = (float *)malloc(PIPELINE_TEST_SLOTS_SIZE *
+                                         scalars_size * sizeof(float));
+    float *to_buffer = (float *)malloc(scalars_size * sizeof(float));
+
+    if (!from_buffer || !to_buffer) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, PIPELINE_TEST_LOCAL_ADDRESS,
+        PIPELINE_TEST_INPUT_DRAM0_ADDRESS, PIPELINE_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, PIPELINE_TEST_LOCAL_ADDRESS,
+        PIPELINE_TEST_OUTPUT_DRAM0_ADDRESS, PIPELINE_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_init_pipeline(driver, &pipeline,
+                                        PIPELINE_TEST_SLOTS_SIZE,
+                                        PIPELINE_TEST_SIZE * 2);
+
+    if (error)
+        goto cleanup;
+
+    // Fill all slots upfront and then run them back to back so that each
+    // slot can only see its own inputs if DRAM0 is rebased correctly.
+    for (size_t i = 0; i < PIPELINE_TEST_SLOTS_SIZE; i++) {
+        uint8_t *slot_ptr =
+            driver->dram0_base_ptr + i * pipeline.slot_size_bytes;
+
+        tensil_dram_fill_random(slot_ptr, driver->arch.data_type,
+                                PIPELINE_TEST_INPUT_DRAM0_ADDRESS *
+                                    driver->arch.array_size,
+                                scalars_size);
+        tensil_dram_fill_bytes(slot_ptr, driver->arch.data_type,
+                               PIPELINE_TEST_OUTPUT_DRAM0_ADDRESS *
+                                   driver->arch.array_size,
+                               0, scalars_size);
+        tensil_dram_read_scalars(slot_ptr, driver->arch.data_type,
+                                 PIPELINE_TEST_INPUT_DRAM0_ADDRESS *
+                                     driver->arch.array_size,
+                                 scalars_size, from_buffer + i * scalars_size);
+    }
+
+    for (size_t i = 0; i < PIPELINE_TEST_SLOTS_SIZE; i++) {
+        error = tensil_driver_submit_pipeline(driver, &pipeline, i, &run, NULL,
+                                              count_completed_runs,
+                                              &completed_runs_size);
+
+        if (error)
+            goto cleanup;
+
+        error = tensil_driver_wait(driver, &run);
+
+        if (error)
+            goto cleanup;
+    }
+
+    for (size_t i = 0; i < PIPELINE_TEST_SLOTS_SIZE && !bad_indexes_size;
+         i++) {
+        uint8_t *slot_ptr =
+            driver->dram0_base_ptr + i * pipeline.slot_size_bytes;
+
+        tensil_dram_read_scalars(slot_ptr, driver->arch.data_type,
+                                 PIPELINE_TEST_OUTPUT_DRAM0_ADDRESS *
+                                     driver->arch.array_size,
+                                 scalars_size, to_buffer);
+
+        for (size_t k = 0; k < scalars_size; k++)
+            if (from_buffer[i * scalars_size + k] != to_buffer[k]) {
+                bad_indexes[bad_indexes_size++] = k;
+                bad_slot = i;
+
+                if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                    break;
+            }
+    }
+
+    bool is_failed =
+        bad_indexes_size || completed_runs_size != PIPELINE_TEST_SLOTS_SIZE;
+
+    printf("%s\n", is_failed ? failed : ok);
+
+    if (completed_runs_size != PIPELINE_TEST_SLOTS_SIZE && verbose)
+        printf("\t completed %zu runs, expected %d\n", completed_runs_size,
+               PIPELINE_TEST_SLOTS_SIZE);
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t bad_index = bad_indexes[k];
+
+            printf("\t in slot %zu at %zu expected=%f, actual=%f\n", bad_slot,
+                   bad_index, from_buffer[bad_slot * scalars_size + bad_index],
+                   to_buffer[bad_index]);
+        }
+
+cleanup:
+    free(from_buffer);
+    free(to_buffer);
+
+    return error;
+}
+
+// Input x and output y share two segments listed in the order of the
+// tensor's vectors rather than by base, with input z in between.
+#define SEGMENTED_TEST_SIZE 7
+#define SEGMENTED_TEST_SCRATCH_DRAM0_ADDRESS 64
+#define SEGMENTED_TEST_VECTOR_OFFSET 4
+#define SEGMENTED_TEST_VECTOR_DRAM0_ADDRESS 21
+
+static const char *segmented_test_json =
+    "{\"inputs\":[{\"name\":\"x\",\"base\":40,\"size\":3},"
+    "{\"name\":\"z\",\"base\":0,\"size\":1},"
+    "{\"name\":\"x\",\"base\":20,\"size\":4}],"
+    "\"outputs\":[{\"name\":\"y\",\"base\":40,\"size\":3},"
+    "{\"name\":\"y\",\"base\":20,\"size\":4}]}";
+
+static bool is_segmented_test_model_valid(const struct tensil_model *model,
+                                          size_t vector_size_bytes) {
+    const struct tensil_tensor *x = &model->input_tensors[0];
+
+    return model->input_tensors_size == 2 && model->output_tensors_size == 1 &&
+           strcmp(x->name, "x") == 0 && x->segments_size == 2 &&
+           x->size == SEGMENTED_TEST_SIZE && x->segments[0].base == 40 &&
+           x->segments[1].base == 20 && x->base == 40 &&
+           x->offset_bytes == 40 * vector_size_bytes &&
+           x->size_bytes == SEGMENTED_TEST_SIZE * vector_size_bytes &&
+           x->end_bytes == 43 * vector_size_bytes &&
+           strcmp(model->input_tensors[1].name, "z") == 0;
+}
+
+tensil_error_t
+tensil_driver_run_segmented_tensor_test(struct tensil_driver *driver,
+                                        bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t array_size = driver->arch.array_size;
+    size_t scalars_size = SEGMENTED_TEST_SIZE * array_size;
+    // Last vector is partially written and has to be zero filled
+    size_t written_size = scalars_size - array_size / 2;
+    size_t vector_size_bytes =
+        array_size * tensil_dram_sizeof_scalar(driver->arch.data_type);
+    struct tensil_model model;
+    const struct tensil_tensor *x = NULL;
+    const struct tensil_tensor *y = NULL;
+    const struct tensil_tensor *w = NULL;
+    struct tensil_tensor_view view;
+    bool is_valid = false;
+
+    memset(&model, 0, sizeof(struct tensil_model));
+
+    float *from_buffer = (float *)malloc(scalars_size * sizeof(float));
+    float *to_buffer = (float *)malloc(scalars_size * sizeof(float));
+    cJSON *json = cJSON_Parse(segmented_test_json);
+    // Tensor byte offsets are computed from the model architecture
+    cJSON *arch = json ? cJSON_AddObjectToObject(json, "arch") : NULL;
+
+    if (!from_buffer || !to_buffer || !arch ||
+        !cJSON_AddNumberToObject(arch, "array_size", (double)array_size) ||
+        !cJSON_AddStringToObject(arch, "data_type", "FP16BP8")) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    error = tensil_model_parse(&model, json);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_input(&model, "x", &x);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_model_find_output(&model, "y", &y);
+
+    if (error)
+        goto cleanup;
+
+    is_valid =
+        is_segmented_test_model_valid(&model, vector_size_bytes) &&
+        x == &model.input_tensors[0] && y == &model.output_tensors[0] &&
+        tensil_model_find_input(&model, "w", &w) != TENSIL_ERROR_NONE && !w;
+
+    if (!is_valid)
+        goto report;
+
+    error = tensil_driver_get_model_input_view(driver, x, &view);
+    is_valid = error && error->type == TENSIL_ERROR_DRIVER &&
+               error->code.code == TENSIL_ERROR_DRIVER_TENSOR_NOT_CONTIGUOUS;
+    error = TENSIL_ERROR_NONE;
+
+    if (!is_valid)
+        goto report;
+
+    fill_dram_with_random_vectors(driver, TENSIL_DRAM0, 0, 0,
+                                  SEGMENTED_TEST_SCRATCH_DRAM0_ADDRESS +
+                                      SEGMENTED_TEST_SIZE);
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                    SEGMENTED_TEST_SCRATCH_DRAM0_ADDRESS, 0,
+                                    SEGMENTED_TEST_SIZE, from_buffer);
+    memset(from_buffer + written_size, 0,
+           (scalars_size - written_size) * sizeof(float));
+
+    error = tensil_driver_load_model_input_scalars(driver, x, written_size,
+                                                   from_buffer);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_get_model_output_scalars(driver, y, scalars_size,
+                                                   to_buffer);
+
+    if (error)
+        goto cleanup;
+
+    for (size_t j = 0; j < scalars_size; j++)
+        if (from_buffer[j] != to_buffer[j]) {
+            bad_indexes[bad_indexes_size++] = j;
+
+            if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                break;
+        }
+
+    // Single vector lands in the second segment
+    error = tensil_driver_load_model_input_vector_scalars(
+        driver, x, SEGMENTED_TEST_VECTOR_OFFSET, array_size, from_buffer);
+
+    if (error)
+        goto cleanup;
+
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                    SEGMENTED_TEST_VECTOR_DRAM0_ADDRESS, 0, 1,
+                                    to_buffer);
+
+    for (size_t j = 0; j < array_size && !bad_indexes_size; j++)
+        if (from_buffer[j] != to_buffer[j])
+            bad_indexes[bad_indexes_size++] = j;
+
+report:
+    printf("%s\n", (bad_indexes_size || !is_valid) ? failed : ok);
+
+    if (!is_valid && verbose)
+        printf("\t unexpected tensors\n");
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t bad_index = bad_indexes[k];
+
+            printf("\t at %zu expected=%f, actual=%f\n", bad_index,
+                   from_buffer[bad_index], to_buffer[bad_index]);
+        }
+
+cleanup:
+    tensil_model_free(&model);
+    cJSON_Delete(json);
+
+    free(from_buffer);
+    free(to_buffer);
+
+    return error;
+}
+
+#define INSTRUCTION_TEST_SIZE 1024
+
+static uint64_t random_word() {
+    return ((uint64_t)rand() << 48) ^ ((uint64_t)rand() << 32) ^
+           ((uint64_t)rand() << 16) ^ (uint64_t)rand();
+}
+
+// SIMD operation takes 4 bits past the three register fields of operand2,
+// see InstructionLayout.scala. A 3-bit field would cut Add and the following
+// operations down to Move and below.
+static bool check_simd_layout(const struct tensil_instruction_layout *layout,
+                              uint8_t *buffer) {
+    size_t size_bits = layout->simd_operand_size_bits;
+    size_t operand2_offset =
+        layout->operand0_size_bytes + layout->operand1_size_bytes;
+    uint64_t expected_operand2 =
+        ((uint64_t)TENSIL_SIMD_OPCODE_MAX << (size_bits * 3)) |
+        ((uint64_t)1 << (size_bits * 2)) | ((uint64_t)1 << size_bits) | 1;
+    uint64_t operand2 = tensil_instruction_make_simd_operand2(
+        layout, TENSIL_SIMD_OPCODE_MAX, 1, 1, 1);
+    uint64_t encoded_operand2 = 0;
+
+    if (layout->simd_op_size_bits != 4 || operand2 != expected_operand2 ||
+        (size_bits * 3 + 4 + 7) / 8 > layout->operand2_size_bytes)
+        return false;
+
+    tensil_instruction_set(layout, buffer, 0, TENSIL_OPCODE_SIMD,
+                           TENSIL_SIMD_FLAG_READ, 0, 0, operand2);
+
+    for (size_t i = 0; i < layout->operand2_size_bytes; i++)
+        encoded_operand2 |= (uint64_t)buffer[operand2_offset + i] << (i * 8);
+
+    return encoded_operand2 == expected_operand2 &&
+           buffer[layout->instruction_size_bytes - 1] ==
+               ((TENSIL_OPCODE_SIMD << 4) | TENSIL_SIMD_FLAG_READ);
+}
+
+// Encodes random instructions with the specialized layout of the driver and
+// with the same layout using the generic encoder and compares the bytes.
+// Also checks the SIMD operand2 layout.
+tensil_error_t tensil_driver_run_instruction_test(struct tensil_driver *driver,
+                                                  bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    const struct tensil_instruction_layout *layout = &driver->layout;
+    struct tensil_instruction_layout generic_layout = driver->layout;
+    size_t instruction_size_bytes = layout->instruction_size_bytes;
+    size_t buffer_size = INSTRUCTION_TEST_SIZE * instruction_size_bytes;
+
+    generic_layout.is_specialized = false;
+
+    uint8_t *specialized_buffer = (uint8_t *)malloc(buffer_size);
+    uint8_t *generic_buffer = (uint8_t *)malloc(buffer_size);
+
+    if (!specialized_buffer || !generic_buffer) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < INSTRUCTION_TEST_SIZE; i++) {
+        size_t offset = i * instruction_size_bytes;
+        uint8_t opcode = rand() & 0xf;
+        uint8_t flags = rand() & 0xf;
+        bool is_bad = false;
+
+        if (i % 3 == 0) {
+            uint64_t operands = random_word();
+
+            tensil_instruction_set_all(layout, specialized_buffer, offset,
+                                       opcode, flags, operands);
+            tensil_instruction_set_all(&generic_layout, generic_buffer, offset,
+                                       opcode, flags, operands);
+        } else {
+            uint64_t operand0 = random_word();
+            uint64_t operand1 = random_word();
+            uint64_t operand2 = random_word();
+
+            // Every other instruction has operands past their sizes
+            if (i % 3 == 1) {
+                uint64_t stride0 = random_word();
+                uint64_t stride1 = random_word();
+
+                is_bad = tensil_instruction_make_operand0(layout, operand0,
+                                                          stride0) !=
+                             tensil_instruction_make_operand0(
+                                 &generic_layout, operand0, stride0) ||
+                         tensil_instruction_make_operand1(layout, operand1,
+                                                          stride1) !=
+                             tensil_instruction_make_operand1(
+                                 &generic_layout, operand1, stride1);
+
+                operand0 =
+                    tensil_instruction_make_operand0(layout, operand0, stride0);
+                operand1 =
+                    tensil_instruction_make_operand1(layout, operand1, stride1);
+            }
+
+            tensil_instruction_set(layout, specialized_buffer, offset, opcode,
+                                   flags, operand0, operand1, operand2);
+            tensil_instruction_set(&generic_layout, generic_buffer, offset,
+                                   opcode, flags, operand0, operand1,
+                                   operand2);
+        }
+
+        if (is_bad || memcmp(specialized_buffer + offset,
+                             generic_buffer + offset,
+                             instruction_size_bytes) != 0) {
+            bad_indexes[bad_indexes_size++] = i;
+
+            if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                break;
+        }
+    }
+
+    bool is_simd_layout_ok = check_simd_layout(layout, specialized_buffer) &&
+                             check_simd_layout(&generic_layout, generic_buffer);
+
+    printf("%s\n", (bad_indexes_size || !layout->is_specialized ||
+                    !is_simd_layout_ok)
+                       ? failed
+                       : ok);
+
+    if (!layout->is_specialized && verbose)
+        printf("\t driver layout is not specialized\n");
+
+    if (!is_simd_layout_ok && verbose)
+        printf("\t unexpected SIMD operand2 layout\n");
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t offset = bad_indexes[k] * instruction_size_bytes;
+
+            printf("\t at %zu expected=", bad_indexes[k]);
+
+            for (size_t j = 0; j < instruction_size_bytes; j++)
+                printf("%02x", generic_buffer[offset + j]);
+
+            printf(", actual=");
+
+            for (size_t j = 0; j < instruction_size_bytes; j++)
+                printf("%02x", specialized_buffer[offset + j]);
+
+            printf("\n");
+        }
+
+cleanup:
+    free(specialized_buffer);
+    free(generic_buffer);
+
+    return error;
+}
+
+#define FENCE_TEST_RUNS 4
+#define FENCE_TEST_TIMEOUT_US 1000
+
+tensil_error_t tensil_driver_run_fence_test(struct tensil_driver *driver,
+                                            bool verbose) {
+    size_t completed_runs = 0;
+    bool is_timed_out = true;
+    uint8_t *target_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM0) +
+        (driver->arch.dram0_depth - 2) * driver->arch.array_size *
+            tensil_dram_sizeof_scalar(driver->arch.data_type);
+
+    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        return error;
+
+    error = tensil_buffer_append_noop_instructions(&driver->buffer,
+                                                   &driver->layout, 1);
+
+    if (error)
+        return error;
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+    if (error)
+        return error;
+
+    // Each run completes on its own sequence number
+    for (size_t i = 0; i < FENCE_TEST_RUNS; i++) {
+        uint32_t sequence;
+
+        error = tensil_driver_run(driver, NULL);
+
+        if (error)
+            return error;
+
+        memcpy(&sequence, target_ptr, sizeof(uint32_t));
+
+        if (sequence == driver->fence_sequence)
+            completed_runs++;
+    }
+
+#ifdef TENSIL_PLATFORM_RUN_TIMEOUT_US
+    // Without fence instructions the run never completes
+    struct tensil_run_opts run_opts;
+    memset(&run_opts, 0, sizeof(struct tensil_run_opts));
+    run_opts.timeout_us = FENCE_TEST_TIMEOUT_US;
+
+    driver->buffer.offset = driver->postamble_offset;
+
+    error = tensil_driver_run(driver, &run_opts);
+
+    is_timed_out = error && error->type == TENSIL_ERROR_DRIVER &&
+                   error->code.code == TENSIL_ERROR_DRIVER_TIMEOUT;
+
+    if (error && !is_timed_out)
+        return error;
+
+    error = TENSIL_ERROR_NONE;
+#endif
+
+    printf("%s\n",
+           (completed_runs == FENCE_TEST_RUNS && is_timed_out) ? ok : failed);
+
+    if (completed_runs != FENCE_TEST_RUNS && verbose)
+        printf("\t %zu of %d runs completed on their sequence number\n",
+               completed_runs, FENCE_TEST_RUNS);
+
+    if (!is_timed_out && verbose)
+        printf("\t run without fence did not time out\n");
+
+    return error;
+}
+
+#define SAMPLE_AGGREGATES_TEST_PROGRAM_SIZE 8
+#define SAMPLE_AGGREGATES_TEST_PROGRAM_COUNTERS_SIZE 10
+#define SAMPLE_AGGREGATES_TEST_COUNTS_SIZE 4
+#define SAMPLE_AGGREGATES_TEST_BLOCK_SIZE 16
+#define SAMPLE_AGGREGATES_TEST_RING_BLOCKS 2
+#define SAMPLE_AGGREGATES_TEST_BLOCKS 5
+
+// Program counters past the program are sampled as well
+static const uint8_t
+    sample_aggregates_test_opcodes[SAMPLE_AGGREGATES_TEST_PROGRAM_SIZE] = {
+        TENSIL_OPCODE_CONFIG,    TENSIL_OPCODE_CONFIG,
+        TENSIL_OPCODE_MAT_MUL,   TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_OPCODE_MAT_MUL,   TENSIL_OPCODE_SIMD,
+        TENSIL_OPCODE_NOOP,      TENSIL_OPCODE_DATA_MOVE};
+
+static void write_sample_aggregates_test_block(uint8_t *ptr,
+                                               size_t block_index) {
+    for (size_t i = 0; i < SAMPLE_AGGREGATES_TEST_BLOCK_SIZE; i++) {
+        size_t index = block_index * SAMPLE_AGGREGATES_TEST_BLOCK_SIZE + i;
+        uint32_t program_counter =
+            index % SAMPLE_AGGREGATES_TEST_PROGRAM_COUNTERS_SIZE;
+        uint16_t flags =
+            index % 4 == 0 ? 1 << (2 * TENSIL_UNIT_DRAM0) : 0;
+        uint8_t *sample_ptr = ptr + i * TENSIL_SAMPLE_SIZE_BYTES;
+
+        memset(sample_ptr, 0, TENSIL_SAMPLE_SIZE_BYTES);
+        memcpy(sample_ptr, &program_counter, sizeof(uint32_t));
+        memcpy(sample_ptr + TENSIL_SAMPLE_FLAGS_OFFSET, &flags,
+               sizeof(uint16_t));
+    }
+}
+
+// Transfers sample blocks the way the sample DMA does into a ring of two
+// blocks and checks where blocks wrap and what they are folded into.
+tensil_error_t
+tensil_driver_run_sample_aggregates_test(struct tensil_driver *driver,
+                                         bool verbose) {
+    struct tensil_instruction_buffer instruction_buffer;
+    struct tensil_instruction_batch batch;
+    struct tensil_sample_buffer sample_buffer;
+    struct tensil_sample_aggregates aggregates;
+    uint32_t counts[SAMPLE_AGGREGATES_TEST_COUNTS_SIZE];
+    uint32_t expected_opcode_counts[TENSIL_SAMPLE_OPCODE_COUNTS_SIZE];
+    uint32_t expected_counts[SAMPLE_AGGREGATES_TEST_COUNTS_SIZE];
+    size_t expected_valid_count = 0;
+    size_t expected_backpressured_count = 0;
+    size_t block_size_bytes =
+        SAMPLE_AGGREGATES_TEST_BLOCK_SIZE * TENSIL_SAMPLE_SIZE_BYTES;
+    bool is_wrapped = true;
+    uint8_t *block_ptr;
+
+    memset(&instruction_buffer, 0, sizeof(struct tensil_instruction_buffer));
+    memset(&sample_buffer, 0, sizeof(struct tensil_sample_buffer));
+    memset(expected_opcode_counts, 0, sizeof(expected_opcode_counts));
+    memset(expected_counts, 0, sizeof(expected_counts));
+
+    instruction_buffer.size =
+        SAMPLE_AGGREGATES_TEST_PROGRAM_SIZE *
+        driver->layout.instruction_size_bytes;
+    instruction_buffer.ptr = (uint8_t *)malloc(instruction_buffer.size);
+    sample_buffer.size = SAMPLE_AGGREGATES_TEST_RING_BLOCKS * block_size_bytes;
+    sample_buffer.ptr = (uint8_t *)malloc(sample_buffer.size);
+
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    if (!instruction_buffer.ptr || !sample_buffer.ptr) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    tensil_buffer_begin_batch(&batch, &instruction_buffer, &driver->layout);
+
+    for (size_t i = 0; i < SAMPLE_AGGREGATES_TEST_PROGRAM_SIZE; i++) {
+        error = tensil_batch_append_instruction(
+            &batch, sample_aggregates_test_opcodes[i], 0, 0, 0, 0);
+
+        if (error)
+            goto cleanup;
+    }
+
+    tensil_batch_commit(&batch);
+
+    // Linear mode runs out of the buffer past the last block
+    for (size_t i = 0; i < SAMPLE_AGGREGATES_TEST_RING_BLOCKS; i++) {
+        error = tensil_sample_buffer_begin_block(&sample_buffer,
+                                                 block_size_bytes, &block_ptr);
+
+        if (error)
+            goto cleanup;
+
+        tensil_sample_buffer_complete_block(&sample_buffer, block_size_bytes);
+    }
+
+    bool is_out_of_buffer = tensil_sample_buffer_begin_block(
+                                &sample_buffer, block_size_bytes,
+                                &block_ptr) != TENSIL_ERROR_NONE;
+
+    tensil_sample_aggregates_init(&aggregates, &instruction_buffer,
+                                  &driver->layout, counts,
+                                  SAMPLE_AGGREGATES_TEST_COUNTS_SIZE);
+    tensil_sample_buffer_set_aggregates(&sample_buffer, &aggregates);
+
+    for (size_t i = 0; i < SAMPLE_AGGREGATES_TEST_BLOCKS; i++) {
+        error = tensil_sample_buffer_begin_block(&sample_buffer,
+                                                 block_size_bytes, &block_ptr);
+
+        if (error)
+            goto cleanup;
+
+        if (block_ptr != sample_buffer.ptr +
+                             (i % SAMPLE_AGGREGATES_TEST_RING_BLOCKS) *
+                                 block_size_bytes) {
+            is_wrapped = false;
+
+            if (verbose)
+                printf("\t block %zu at offset %zu\n", i,
+                       (size_t)(block_ptr - sample_buffer.ptr));
+        }
+
+        write_sample_aggregates_test_block(block_ptr, i);
+        tensil_sample_buffer_complete_block(&sample_buffer, block_size_bytes);
+    }
+
+    for (size_t i = 0;
+         i < SAMPLE_AGGREGATES_TEST_BLOCKS * SAMPLE_AGGREGATES_TEST_BLOCK_SIZE;
+         i++) {
+        size_t program_counter =
+            i % SAMPLE_AGGREGATES_TEST_PROGRAM_COUNTERS_SIZE;
+
+        if (program_counter >= SAMPLE_AGGREGATES_TEST_PROGRAM_SIZE)
+            continue;
+
+        expected_valid_count++;
+        expected_opcode_counts[sample_aggregates_test_opcodes
+                                   [program_counter]]++;
+
+        if (program_counter < SAMPLE_AGGREGATES_TEST_COUNTS_SIZE)
+            expected_counts[program_counter]++;
+
+        if (i % 4 == 0)
+            expected_backpressured_count++;
+    }
+
+    bool is_counted =
+        aggregates.blocks_count == SAMPLE_AGGREGATES_TEST_BLOCKS &&
+        aggregates.valid_samples_count == expected_valid_count &&
+        aggregates.invalid_samples_count ==
+            SAMPLE_AGGREGATES_TEST_BLOCKS *
+                    SAMPLE_AGGREGATES_TEST_BLOCK_SIZE -
+                expected_valid_count &&
+        memcmp(aggregates.opcode_counts, expected_opcode_counts,
+               sizeof(expected_opcode_counts)) == 0 &&
+        memcmp(counts, expected_counts, sizeof(expected_counts)) == 0;
+    bool is_stall_counted =
+        aggregates.bottleneck.samples_count == expected_valid_count &&
+        aggregates.bottleneck.units[TENSIL_UNIT_DRAM0].backpressured_count ==
+            expected_backpressured_count &&
+        aggregates.bottleneck.bound_counts[TENSIL_BOUND_DRAM] ==
+            expected_backpressured_count;
+
+    printf("%s\n", (is_out_of_buffer && is_wrapped && is_counted &&
+                    is_stall_counted)
+                       ? ok
+                       : failed);
+
+    if (verbose) {
+        if (!is_out_of_buffer)
+            printf("\t linear mode did not run out of buffer\n");
+
+        if (!is_counted)
+            printf("\t unexpected opcode or program counter counts\n");
+
+        if (!is_stall_counted)
+            printf("\t unexpected stall counts\n");
+
+        // Test program starts with two config instructions like the preamble
+        tensil_sample_aggregates_print(&aggregates, 4,
+                                       TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+    }
+
+cleanup:
+    free(instruction_buffer.ptr);
+    free(sample_buffer.ptr);
+
+    return error;
+}
+
+#define BOTTLENECK_TEST_CASES_SIZE 5
+#define BOTTLENECK_TEST_SAMPLES_SIZE 4
+
+#define BUSY(unit) (3 << (2 * TENSIL_UNIT_##unit))
+#define BACKPRESSURED(unit) (1 << (2 * TENSIL_UNIT_##unit))
+#define STARVED(unit) (2 << (2 * TENSIL_UNIT_##unit))
+
+// Three of four samples of each case show the expected bound
+static const uint16_t bottleneck_test_flags[BOTTLENECK_TEST_CASES_SIZE]
+                                           [BOTTLENECK_TEST_SAMPLES_SIZE] = {
+    {BUSY(ARRAY) | BUSY(INSTRUCTION), BUSY(ARRAY) | BUSY(MEM_PORT_A),
+     BACKPRESSURED(ACC), BUSY(DRAM0)},
+    {BACKPRESSURED(DRAM0) | BUSY(ARRAY), BACKPRESSURED(DRAM1),
+     BACKPRESSURED(DRAM0) | BUSY(INSTRUCTION), BUSY(DRAM0)},
+    {BACKPRESSURED(MEM_PORT_A), BACKPRESSURED(MEM_PORT_B) | BUSY(DRAM0),
+     BACKPRESSURED(MEM_PORT_A) | BUSY(DATAFLOW), STARVED(INSTRUCTION)},
+    {STARVED(INSTRUCTION), STARVED(INSTRUCTION) | STARVED(ARRAY),
+     STARVED(INSTRUCTION), BUSY(INSTRUCTION)},
+    {0, STARVED(ARRAY), BUSY(INSTRUCTION), BUSY(MEM_PORT_A)}};
+
+#undef BUSY
+#undef BACKPRESSURED
+#undef STARVED
+
+static const enum tensil_bound
+    bottleneck_test_bounds[BOTTLENECK_TEST_CASES_SIZE] = {
+        TENSIL_BOUND_COMPUTE, TENSIL_BOUND_DRAM, TENSIL_BOUND_LOCAL_MEMORY,
+        TENSIL_BOUND_INSTRUCTION_FETCH, TENSIL_BOUND_NONE};
+
+tensil_error_t tensil_driver_run_bottleneck_test(struct tensil_driver *driver,
+                                                 bool verbose) {
+    struct tensil_program_map_layer layers[BOTTLENECK_TEST_CASES_SIZE];
+    struct tensil_program_map map;
+    struct tensil_layer_profile profile;
+    struct tensil_bottleneck_counts bottleneck;
+    size_t classified_size = 0;
+
+    memset(&bottleneck, 0, sizeof(struct tensil_bottleneck_counts));
+
+    // Each case is a layer of a single instruction
+    for (size_t i = 0; i < BOTTLENECK_TEST_CASES_SIZE; i++) {
+        layers[i].name = tensil_bound_to_string(bottleneck_test_bounds[i]);
+        layers[i].begin = i;
+        layers[i].end = i + 1;
+    }
+
+    map.layers = layers;
+    map.layers_size = BOTTLENECK_TEST_CASES_SIZE;
+    map.arena = NULL;
+
+    tensil_error_t error = tensil_layer_profile_init(&profile, &map);
+
+    if (error)
+        return error;
+
+    for (size_t i = 0; i < BOTTLENECK_TEST_CASES_SIZE; i++)
+        for (size_t j = 0; j < BOTTLENECK_TEST_SAMPLES_SIZE; j++)
+            tensil_layer_profile_add(&profile, i, bottleneck_test_flags[i][j],
+                                     1);
+
+    for (size_t i = 0; i < BOTTLENECK_TEST_CASES_SIZE; i++) {
+        if (tensil_bottleneck_classify(&profile.counts[i].bottleneck) ==
+            bottleneck_test_bounds[i])
+            classified_size++;
+        else if (verbose)
+            printf("\t expected %s bound, got %s\n",
+                   tensil_bound_to_string(bottleneck_test_bounds[i]),
+                   tensil_bound_to_string(tensil_bottleneck_classify(
+                       &profile.counts[i].bottleneck)));
+
+        tensil_bottleneck_counts_merge(&bottleneck,
+                                       &profile.counts[i].bottleneck);
+    }
+
+    const struct tensil_unit_counts *instruction =
+        &bottleneck.units[TENSIL_UNIT_INSTRUCTION];
+    bool is_counted =
+        bottleneck.samples_count ==
+            BOTTLENECK_TEST_CASES_SIZE * BOTTLENECK_TEST_SAMPLES_SIZE &&
+        bottleneck.units[TENSIL_UNIT_DRAM0].backpressured_count == 2 &&
+        bottleneck.units[TENSIL_UNIT_DRAM0].busy_count == 3 &&
+        instruction->busy_count == 4 && instruction->starved_count == 4 &&
+        instruction->backpressured_count == 0;
+
+    printf("%s\n", (classified_size == BOTTLENECK_TEST_CASES_SIZE &&
+                    is_counted)
+                       ? ok
+                       : failed);
+
+    if (!is_counted && verbose)
+        printf("\t unexpected port counts\n");
+
+    if (verbose) {
+        tensil_layer_profile_print(&profile);
+        tensil_bottleneck_counts_print(&bottleneck);
+    }
+
+    tensil_layer_profile_free(&profile);
+
+    return TENSIL_ERROR_NONE;
+}
+
+#define ADAPTIVE_SAMPLING_TEST_PROGRAM_SIZE 4096
+#define ADAPTIVE_SAMPLING_TEST_HOT_BEGIN 3000
+#define ADAPTIVE_SAMPLING_TEST_HOT_END 3008
+#define ADAPTIVE_SAMPLING_TEST_COLD_CYCLES 10
+#define ADAPTIVE_SAMPLING_TEST_HOT_CYCLES 10000
+#define ADAPTIVE_SAMPLING_TEST_MAX_SAMPLES 1024
+#define ADAPTIVE_SAMPLING_TEST_MAX_RUNS 8
+
+static uint32_t get_adaptive_sampling_test_cycles(uint32_t program_counter) {
+    return program_counter >= ADAPTIVE_SAMPLING_TEST_HOT_BEGIN &&
+                   program_counter < ADAPTIVE_SAMPLING_TEST_HOT_END
+               ? ADAPTIVE_SAMPLING_TEST_HOT_CYCLES
+               : ADAPTIVE_SAMPLING_TEST_COLD_CYCLES;
+}
+
+// Samples the run of the program every interval the way the compute unit
+// does and returns the number of samples taken.
+static size_t run_adaptive_sampling_test_program(uint8_t *ptr,
+                                                 size_t samples_size,
+                                                 uint32_t interval_cycles) {
+    uint32_t program_counter = 0;
+    uint64_t instruction_end = get_adaptive_sampling_test_cycles(0);
+    size_t size = 0;
+
+    for (uint64_t cycle = interval_cycles; size < samples_size;
+         cycle += interval_cycles) {
+        while (cycle >= instruction_end) {
+            if (++program_counter == ADAPTIVE_SAMPLING_TEST_PROGRAM_SIZE)
+                return size;
+
+            instruction_end +=
+                get_adaptive_sampling_test_cycles(program_counter);
+        }
+
+        uint32_t sampled_program_counter =
+            program_counter + TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT;
+        uint8_t *sample_ptr = ptr + size * TENSIL_SAMPLE_SIZE_BYTES;
+
+        memset(sample_ptr, 0, TENSIL_SAMPLE_SIZE_BYTES);
+        memcpy(sample_ptr, &sampled_program_counter, sizeof(uint32_t));
+        size++;
+    }
+
+    return size;
+}
+
+tensil_error_t
+tensil_driver_run_adaptive_sampling_test(struct tensil_driver *driver,
+                                         bool verbose) {
+    struct tensil_adaptive_sampling sampling;
+    bool is_within_budget = true;
+    size_t samples_size = 2 * ADAPTIVE_SAMPLING_TEST_MAX_SAMPLES;
+    uint8_t *ptr = (uint8_t *)malloc(samples_size * TENSIL_SAMPLE_SIZE_BYTES);
+
+    if (!ptr)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    // Intervals past the 16-bit register would wrap around
+    tensil_adaptive_sampling_init(&sampling,
+                                  TENSIL_SAMPLE_MAX_INTERVAL_CYCLES + 1, 0, 1,
+                                  1);
+
+    bool is_clamped =
+        sampling.interval_cycles == TENSIL_SAMPLE_MAX_INTERVAL_CYCLES &&
+        sampling.min_interval_cycles == 1;
+
+    tensil_adaptive_sampling_init(&sampling, TENSIL_SAMPLE_INTERVAL_CYCLES, 1,
+                                  ADAPTIVE_SAMPLING_TEST_MAX_SAMPLES,
+                                  ADAPTIVE_SAMPLING_TEST_MAX_SAMPLES);
+
+    while (sampling.runs_count < ADAPTIVE_SAMPLING_TEST_MAX_RUNS &&
+           !tensil_adaptive_sampling_is_converged(&sampling)) {
+        size_t size = run_adaptive_sampling_test_program(
+            ptr, samples_size, sampling.interval_cycles);
+
+        if (size > ADAPTIVE_SAMPLING_TEST_MAX_SAMPLES)
+            is_within_budget = false;
+
+        tensil_adaptive_sampling_update(&sampling, ptr,
+                                        size * TENSIL_SAMPLE_SIZE_BYTES,
+                                        TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+
+        if (verbose)
+            tensil_adaptive_sampling_print(&sampling);
+    }
+
+    bool is_converged = tensil_adaptive_sampling_is_converged(&sampling) &&
+                        sampling.begin <= ADAPTIVE_SAMPLING_TEST_HOT_BEGIN &&
+                        sampling.end >= ADAPTIVE_SAMPLING_TEST_HOT_END;
+    bool is_refined = sampling.interval_cycles < TENSIL_SAMPLE_INTERVAL_CYCLES;
+
+    printf("%s\n", (is_clamped && is_converged && is_refined &&
+                    is_within_budget)
+                       ? ok
+                       : failed);
+
+    if (verbose) {
+        if (!is_clamped)
+            printf("\t interval was not clamped to %u cycles\n",
+                   (unsigned int)TENSIL_SAMPLE_MAX_INTERVAL_CYCLES);
+
+        if (!is_converged)
+            printf("\t range did not converge onto [%u, %u)\n",
+                   (unsigned int)ADAPTIVE_SAMPLING_TEST_HOT_BEGIN,
+                   (unsigned int)ADAPTIVE_SAMPLING_TEST_HOT_END);
+
+        if (!is_refined)
+            printf("\t interval was not refined\n");
+
+        if (!is_within_budget)
+            printf("\t run exceeded %u samples\n",
+                   (unsigned int)ADAPTIVE_SAMPLING_TEST_MAX_SAMPLES);
+    }
+
+    free(ptr);
+
+    return TENSIL_ERROR_NONE;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+#define STREAMING_TEST_SIZE (driver->arch.local_depth / 4)
+#define STREAMING_TEST_BUFFER_SIZE 4096
+#define STREAMING_TEST_FILE_NAME "streaming_test.tprog"
+
+#define STREAMING_TEST_INPUT_DRAM0_ADDRESS 0
+#define STREAMING_TEST_OUTPUT_DRAM0_ADDRESS STREAMING_TEST_SIZE
+
+static tensil_error_t write_bytes_to_file(const void *ptr, size_t size,
+                                          const char *file_name) {
+    FIL fil;
+    FRESULT res;
+    UINT bytes_written;
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_write(&fil, ptr, size, &bytes_written);
+
+    f_close(&fil);
+
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t
+write_program_to_file(const struct tensil_instruction_buffer *buffer,
+                      const char *file_name) {
+    return write_bytes_to_file(buffer->ptr, buffer->offset, file_name);
+}
+
+tensil_error_t tensil_driver_run_streaming_test(struct tensil_driver *driver,
+                                                bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t buffer_size = driver->buffer.size;
+    size_t scalars_size = STREAMING_TEST_SIZE * driver->arch.array_size;
+
+    float *from_buffer = (float *)malloc(scalars_size * sizeof(float));
+    float *to_buffer = (float *)malloc(scalars_size * sizeof(float));
+
+    if (!from_buffer || !to_buffer) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    // Moving one vector per instruction makes the program long enough to
+    // stream through the reduced program buffer below.
+    tensil_buffer_reset(&driver->buffer);
+
+    for (size_t i = 0; i < STREAMING_TEST_SIZE; i++) {
+        error = tensil_buffer_append_instruction(
+            &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+            TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, i,
+            STREAMING_TEST_INPUT_DRAM0_ADDRESS + i, 0);
+
+        if (error)
+            goto cleanup;
+
+        error = tensil_buffer_append_instruction(
+            &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+            TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, i,
+            STREAMING_TEST_OUTPUT_DRAM0_ADDRESS + i, 0);
+
+        if (error)
+            goto cleanup;
+    }
+
+    error = write_program_to_file(&driver->buffer, STREAMING_TEST_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    fill_dram_with_random_vectors(driver, TENSIL_DRAM0,
+                                  STREAMING_TEST_INPUT_DRAM0_ADDRESS, 0,
+                                  STREAMING_TEST_SIZE);
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                    STREAMING_TEST_INPUT_DRAM0_ADDRESS, 0,
+                                    STREAMING_TEST_SIZE, from_buffer);
+
+    uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM0);
+    tensil_dram_fill_bytes(bank_ptr, driver->arch.data_type,
+                           STREAMING_TEST_OUTPUT_DRAM0_ADDRESS *
+                               driver->arch.array_size,
+                           0, scalars_size);
+
+    driver->buffer.size = STREAMING_TEST_BUFFER_SIZE;
+
+    error = tensil_driver_load_program_from_file(driver, 0,
+                                                 STREAMING_TEST_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    if (!driver->is_streaming) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                    "Test program is expected to stream");
+        goto cleanup;
+    }
+
+    error = tensil_driver_run(driver, NULL);
+
+    if (error)
+        goto cleanup;
+
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                    STREAMING_TEST_OUTPUT_DRAM0_ADDRESS, 0,
+                                    STREAMING_TEST_SIZE, to_buffer);
+
+    for (size_t k = 0; k < scalars_size; k++)
+        if (from_buffer[k] != to_buffer[k]) {
+            bad_indexes[bad_indexes_size++] = k;
+
+            if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                break;
+        }
+
+    printf("%s\n", bad_indexes_size ? failed : ok);
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t bad_index = bad_indexes[k];
+
+            printf("\t at %zu expected=%f, actual=%f\n", bad_index,
+                   from_buffer[bad_index], to_buffer[bad_index]);
+        }
+
+cleanup:
+    driver->buffer.size = buffer_size;
+    driver->is_streaming = false;
+    f_unlink(STREAMING_TEST_FILE_NAME);
+
+    free(from_buffer);
+    free(to_buffer);
+
+    return error;
+}
+
+#define BUNDLE_TEST_SIZE (driver->arch.local_depth / 4)
+#define BUNDLE_TEST_REPEATS 64
+#define BUNDLE_TEST_FILE_NAME "bundle_test.tbundle"
+
+#define BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS BUNDLE_TEST_SIZE
+
+// Mirrors the layout written by ModelBundle.scala
+#define BUNDLE_TEST_HEADER_SIZE 128
+#define BUNDLE_TEST_ENTRY_SIZE 64
+#define BUNDLE_TEST_ENTRY_NAME_SIZE 56
+#define BUNDLE_TEST_SECTOR_SIZE 512
+#define BUNDLE_TEST_FLAG_LOAD_CONSTS_TO_LOCAL 0x1
+#define BUNDLE_TEST_FLAG_COMPRESSED 0x2
+
+struct bundle_test_section {
+    uint8_t *ptr;
+    size_t size;
+    size_t decoded_size;
+};
+
+static void write_bundle_word(uint8_t *ptr, size_t index, size_t value) {
+    ptr += index * 4;
+    ptr[0] = value & 0xff;
+    ptr[1] = (value >> 8) & 0xff;
+    ptr[2] = (value >> 16) & 0xff;
+    ptr[3] = (value >> 24) & 0xff;
+}
+
+static void write_bundle_entry(uint8_t *ptr, const char *name, size_t base,
+                               size_t size) {
+    strcpy((char *)ptr, name);
+    write_bundle_word(ptr, BUNDLE_TEST_ENTRY_NAME_SIZE / 4, base);
+    write_bundle_word(ptr, BUNDLE_TEST_ENTRY_NAME_SIZE / 4 + 1, size);
+}
+
+static uint8_t *write_lz4_length(uint8_t *ptr, size_t length) {
+    for (; length >= 255; length -= 255)
+        *ptr++ = 255;
+
+    *ptr++ = length;
+
+    return ptr;
+}
+
+static uint8_t *write_compressed_block_header(uint8_t *ptr, size_t stored_size,
+                                              size_t decoded_size) {
+    write_bundle_word(ptr, 0, stored_size);
+    write_bundle_word(ptr, 1, decoded_size);
+
+    return ptr + TENSIL_COMPRESSION_BLOCK_HEADER_SIZE;
+}
+
+// Stores consts as uncompressed blocks.
+static void compress_test_consts(const uint8_t *ptr, size_t size,
+                                 struct bundle_test_section *section) {
+    uint8_t *block_ptr = section->ptr;
+
+    for (size_t offset = 0; offset < size;
+         offset += TENSIL_COMPRESSION_BLOCK_SIZE) {
+        size_t block_size = MIN(size - offset, TENSIL_COMPRESSION_BLOCK_SIZE);
+
+        block_ptr =
+            write_compressed_block_header(block_ptr, block_size, block_size);
+        memcpy(block_ptr, ptr + offset, block_size);
+        block_ptr += block_size;
+    }
+
+    section->size = block_ptr - section->ptr;
+    section->decoded_size = size;
+}
+
+// Encodes the program of repeated instruction followed by the last
+// instruction as a single LZ4 block: the first instruction as literals,
+// repeats as an overlapping match and the last instruction as literals.
+static void compress_test_program(const uint8_t *ptr, size_t size,
+                                  size_t instruction_size,
+                                  struct bundle_test_section *section) {
+    size_t match_size = size - 2 * instruction_size;
+    uint8_t *block_ptr =
+        section->ptr + TENSIL_COMPRESSION_BLOCK_HEADER_SIZE;
+
+    *block_ptr++ = (MIN(instruction_size, 15) << 4) | MIN(match_size - 4, 15);
+
+    if (instruction_size >= 15)
+        block_ptr = write_lz4_length(block_ptr, instruction_size - 15);
+
+    memcpy(block_ptr, ptr, instruction_size);
+    block_ptr += instruction_size;
+
+    *block_ptr++ = instruction_size & 0xff;
+    *block_ptr++ = instruction_size >> 8;
+
+    if (match_size - 4 >= 15)
+        block_ptr = write_lz4_length(block_ptr, match_size - 4 - 15);
+
+    *block_ptr++ = MIN(instruction_size, 15) << 4;
+
+    if (instruction_size >= 15)
+        block_ptr = write_lz4_length(block_ptr, instruction_size - 15);
+
+    memcpy(block_ptr, ptr + size - instruction_size, instruction_size);
+    block_ptr += instruction_size;
+
+    write_compressed_block_header(
+        section->ptr,
+        block_ptr - section->ptr - TENSIL_COMPRESSION_BLOCK_HEADER_SIZE, size);
+
+    section->size = block_ptr - section->ptr;
+    section->decoded_size = size;
+}
+
+static tensil_error_t
+write_bundle_to_file(struct tensil_driver *driver, const char *file_name,
+                     size_t flags, size_t consts_size,
+                     const struct bundle_test_section *consts,
+                     const struct bundle_test_section *prog) {
+    uint8_t sector[BUNDLE_TEST_SECTOR_SIZE];
+    const struct tensil_architecture *arch = &driver->arch;
+    size_t consts_offset = BUNDLE_TEST_SECTOR_SIZE;
+    size_t prog_offset =
+        (consts_offset + consts->size + BUNDLE_TEST_SECTOR_SIZE - 1) /
+        BUNDLE_TEST_SECTOR_SIZE * BUNDLE_TEST_SECTOR_SIZE;
+    FIL fil;
+    FRESULT res;
+    UINT bytes_written;
+
+    memset(sector, 0, BUNDLE_TEST_SECTOR_SIZE);
+    memcpy(sector, "TBND", 4);
+    write_bundle_word(sector, 1, 1);
+    write_bundle_word(sector, 2, flags);
+    write_bundle_word(sector, 3, 1);
+    write_bundle_word(sector, 4, 1);
+    write_bundle_word(sector, 5, 0);
+    write_bundle_word(sector, 6, consts_size);
+    write_bundle_word(sector, 7, consts_offset);
+    write_bundle_word(sector, 8, prog->decoded_size);
+    write_bundle_word(sector, 9, prog_offset);
+
+    write_bundle_word(sector, 16, arch->data_type);
+    write_bundle_word(sector, 17, arch->array_size);
+    write_bundle_word(sector, 18, arch->dram0_depth);
+    write_bundle_word(sector, 19, arch->dram1_depth);
+    write_bundle_word(sector, 20, arch->local_depth);
+    write_bundle_word(sector, 21, arch->accumulator_depth);
+    write_bundle_word(sector, 22, arch->simd_registers_depth);
+    write_bundle_word(sector, 23, arch->stride0_depth);
+    write_bundle_word(sector, 24, arch->stride1_depth);
+
+    write_bundle_entry(sector + BUNDLE_TEST_HEADER_SIZE, "x", 0,
+                       BUNDLE_TEST_SIZE);
+    write_bundle_entry(sector + BUNDLE_TEST_HEADER_SIZE +
+                           BUNDLE_TEST_ENTRY_SIZE,
+                       "y", BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS, BUNDLE_TEST_SIZE);
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_write(&fil, sector, BUNDLE_TEST_SECTOR_SIZE, &bytes_written);
+
+    if (!res)
+        res = f_write(&fil, consts->ptr, consts->size, &bytes_written);
+
+    memset(sector, 0, BUNDLE_TEST_SECTOR_SIZE);
+
+    if (!res)
+        res = f_write(&fil, sector, prog_offset - consts_offset - consts->size,
+                      &bytes_written);
+
+    if (!res)
+        res = f_write(&fil, prog->ptr, prog->size, &bytes_written);
+
+    f_close(&fil);
+
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    return TENSIL_ERROR_NONE;
+}
+
+// Overwrites a header word of the bundle file in place.
+static tensil_error_t patch_bundle_word(const char *file_name, size_t index,
+                                        size_t value) {
+    uint8_t word[4];
+    FIL fil;
+    FRESULT res;
+    UINT bytes_written;
+
+    write_bundle_word(word, 0, value);
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_WRITE);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_lseek(&fil, index * 4);
+
+    if (!res)
+        res = f_write(&fil, word, 4, &bytes_written);
+
+    f_close(&fil);
+
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    return TENSIL_ERROR_NONE;
+}
+
+// Entry counts that do not fit the I/O table are rejected before they
+// size any allocation.
+static tensil_error_t
+run_bundle_test_invalid_case(struct tensil_driver *driver,
+                             const struct bundle_test_section *consts,
+                             const struct bundle_test_section *prog,
+                             bool *is_rejected) {
+    struct tensil_model model;
+    tensil_error_t error = write_bundle_to_file(
+        driver, BUNDLE_TEST_FILE_NAME, 0, BUNDLE_TEST_SIZE, consts, prog);
+
+    if (error)
+        return error;
+
+    error = patch_bundle_word(BUNDLE_TEST_FILE_NAME, 3, 0xffffffff);
+
+    if (error)
+        return error;
+
+    error = tensil_model_from_bundle_file(&model, BUNDLE_TEST_FILE_NAME);
+    *is_rejected = error && error->type == TENSIL_ERROR_DRIVER &&
+                   error->code.code == TENSIL_ERROR_DRIVER_INVALID_MODEL;
+
+    if (!error)
+        tensil_model_free(&model);
+
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t
+run_bundle_test_case(struct tensil_driver *driver, size_t flags,
+                     size_t consts_size,
+                     const struct bundle_test_section *consts,
+                     const struct bundle_test_section *prog, float *to_buffer) {
+    struct tensil_model model;
+    uint8_t *dram0_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM0);
+    uint8_t *dram1_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM1);
+
+    tensil_error_t error = write_bundle_to_file(
+        driver, BUNDLE_TEST_FILE_NAME, flags, consts_size, consts, prog);
+
+    if (error)
+        return error;
+
+    tensil_dram_fill_bytes(dram1_ptr, driver->arch.data_type, 0, 0,
+                           consts_size * driver->arch.array_size);
+    tensil_dram_fill_bytes(dram0_ptr, driver->arch.data_type,
+                           BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS *
+                               driver->arch.array_size,
+                           0, consts_size * driver->arch.array_size);
+
+    error = tensil_model_from_bundle_file(&model, BUNDLE_TEST_FILE_NAME);
+
+    if (error)
+        return error;
+
+    error = tensil_driver_load_model(driver, &model);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_run(driver, NULL);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                            model.outputs[0].base, 0,
+                                            model.outputs[0].size, to_buffer);
+
+cleanup:
+    tensil_model_free(&model);
+
+    return error;
+}
+
+tensil_error_t tensil_driver_run_bundle_test(struct tensil_driver *driver,
+                                             bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t scalars_size = BUNDLE_TEST_SIZE * driver->arch.array_size;
+    size_t consts_bytes =
+        scalars_size * tensil_dram_sizeof_scalar(driver->arch.data_type);
+    size_t instruction_size = driver->layout.instruction_size_bytes;
+    size_t prog_bytes = (BUNDLE_TEST_REPEATS + 1) * instruction_size;
+    uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM1);
+    struct bundle_test_section consts;
+    struct bundle_test_section prog;
+    struct bundle_test_section compressed_consts;
+    struct bundle_test_section compressed_prog;
+    struct bundle_test_section preload_prog;
+
+    float *from_buffer = (float *)malloc(scalars_size * sizeof(float));
+    float *to_buffer = (float *)malloc(scalars_size * sizeof(float));
+    uint8_t *consts_ptr = (uint8_t *)malloc(consts_bytes);
+    uint8_t *decoded_ptr = (uint8_t *)malloc(prog_bytes);
+    size_t consts_blocks = (consts_bytes + TENSIL_COMPRESSION_BLOCK_SIZE - 1) /
+                           TENSIL_COMPRESSION_BLOCK_SIZE;
+    uint8_t *compressed_ptr = (uint8_t *)malloc(
+        consts_bytes + prog_bytes +
+        (consts_blocks + 1) * TENSIL_COMPRESSION_BLOCK_HEADER_SIZE);
+
+    if (!from_buffer || !to_buffer || !consts_ptr || !decoded_ptr ||
+        !compressed_ptr) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    // Moving the same consts to local memory repeatedly makes the program
+    // compressible.
+    tensil_buffer_reset(&driver->buffer);
+
+    for (size_t i = 0; i < BUNDLE_TEST_REPEATS; i++) {
+        error = tensil_buffer_append_instruction(
+            &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+            TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, 0, 0, BUNDLE_TEST_SIZE - 1);
+
+        if (error)
+            goto cleanup;
+    }
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, 0,
+        BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS, BUNDLE_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    fill_dram_with_random_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                  BUNDLE_TEST_SIZE);
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                    BUNDLE_TEST_SIZE, from_buffer);
+    memcpy(consts_ptr, bank_ptr, consts_bytes);
+
+    consts.ptr = consts_ptr;
+    consts.size = consts_bytes;
+    consts.decoded_size = consts_bytes;
+
+    prog.ptr = driver->buffer.ptr;
+    prog.size = prog_bytes;
+    prog.decoded_size = prog_bytes;
+
+    compressed_consts.ptr = compressed_ptr;
+    compress_test_consts(consts_ptr, consts_bytes, &compressed_consts);
+
+    // Program buffer is reset by loading the model, so both encodings of the
+    // program are prepared upfront.
+    compressed_prog.ptr = compressed_ptr + compressed_consts.size;
+    compress_test_program(driver->buffer.ptr, prog_bytes, instruction_size,
+                          &compressed_prog);
+
+    // Output does not depend on the number of repeated moves, so decoded
+    // program is also compared directly.
+    error = tensil_compression_decode_block(
+        compressed_prog.ptr + TENSIL_COMPRESSION_BLOCK_HEADER_SIZE,
+        compressed_prog.size - TENSIL_COMPRESSION_BLOCK_HEADER_SIZE,
+        decoded_ptr, prog_bytes);
+
+    if (error)
+        goto cleanup;
+
+    bool is_decoded = memcmp(decoded_ptr, driver->buffer.ptr, prog_bytes) == 0;
+
+    preload_prog.ptr = decoded_ptr + prog_bytes - instruction_size;
+    preload_prog.size = instruction_size;
+    preload_prog.decoded_size = instruction_size;
+
+    // Plain, compressed and plain with consts preloaded to local memory by
+    // the driver, in which case the program only moves local memory to DRAM0.
+    for (size_t k = 0; k < 3; k++) {
+        const struct bundle_test_section *case_consts = &consts;
+        const struct bundle_test_section *case_prog = &prog;
+        size_t flags = 0;
+
+        if (k == 1) {
+            flags = BUNDLE_TEST_FLAG_COMPRESSED;
+            case_consts = &compressed_consts;
+            case_prog = &compressed_prog;
+        } else if (k == 2) {
+            flags = BUNDLE_TEST_FLAG_LOAD_CONSTS_TO_LOCAL;
+            case_prog = &preload_prog;
+
+            // New consts tell preloaded local memory from the previous case
+            fill_dram_with_random_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                          BUNDLE_TEST_SIZE);
+            tensil_driver_read_dram_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                            BUNDLE_TEST_SIZE, from_buffer);
+            memcpy(consts_ptr, bank_ptr, consts_bytes);
+        }
+
+        error = run_bundle_test_case(driver, flags, BUNDLE_TEST_SIZE,
+                                     case_consts, case_prog, to_buffer);
+
+        if (error)
+            goto cleanup;
+
+        for (size_t j = 0; j < scalars_size; j++)
+            if (from_buffer[j] != to_buffer[j]) {
+                bad_indexes[bad_indexes_size++] = j;
+
+                if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                    break;
+            }
+
+        if (bad_indexes_size)
+            break;
+    }
+
+    bool is_rejected = false;
+
+    error = run_bundle_test_invalid_case(driver, &consts, &prog, &is_rejected);
+
+    if (error)
+        goto cleanup;
+
+    printf("%s\n",
+           (bad_indexes_size || !is_decoded || !is_rejected) ? failed : ok);
+
+    if (!is_decoded && verbose)
+        printf("\t decoded program does not match\n");
+
+    if (!is_rejected && verbose)
+        printf("\t invalid I/O table size is not rejected\n");
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t bad_index = bad_indexes[k];
+
+            printf("\t at %zu expected=%f, actual=%f\n", bad_index,
+                   from_buffer[bad_index], to_buffer[bad_index]);
+        }
+
+cleanup:
+    f_unlink(BUNDLE_TEST_FILE_NAME);
+
+    free(from_buffer);
+    free(to_buffer);
+    free(consts_ptr);
+    free(decoded_ptr);
+    free(compressed_ptr);
+
+    return error;
+}
+
+#define RESIDENCY_TEST_MODELS_SIZE 2
+#define RESIDENCY_TEST_BUFFER_SIZE (64 * 1024)
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+#define RESIDENCY_TEST_PREAMBLE_SIZE TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT
+#else
+#define RESIDENCY_TEST_PREAMBLE_SIZE 0
+#endif
+
+#define RESIDENCY_TEST_MAX_PROGRAM_COUNTERS_SIZE                               \
+    (RESIDENCY_TEST_PREAMBLE_SIZE + RESIDENCY_TEST_MODELS_SIZE)
+
+static const char *residency_test_file_names[RESIDENCY_TEST_MODELS_SIZE] = {
+    "residency_test_0.tbundle", "residency_test_1.tbundle"};
+
+// Program counters of a resident model start at its preamble, which follows
+// the DRAM1 offset config in the model region. Checks that samples of each
+// program counter of the preamble and the data moves of the program are
+// looked up in the driver program view as such.
+static bool is_residency_test_program_decoded(struct tensil_driver *driver,
+                                              size_t program_size) {
+    struct tensil_sample_aggregates aggregates;
+    uint32_t counts[RESIDENCY_TEST_MAX_PROGRAM_COUNTERS_SIZE];
+    uint8_t samples[RESIDENCY_TEST_MAX_PROGRAM_COUNTERS_SIZE *
+                    TENSIL_SAMPLE_SIZE_BYTES];
+    size_t samples_size = RESIDENCY_TEST_PREAMBLE_SIZE + program_size;
+
+    memset(samples, 0, sizeof(samples));
+
+    for (uint32_t i = 0; i < samples_size; i++)
+        memcpy(samples + i * TENSIL_SAMPLE_SIZE_BYTES, &i, sizeof(uint32_t));
+
+    tensil_sample_aggregates_init(&aggregates, &driver->program,
+                                  &driver->layout, counts,
+                                  RESIDENCY_TEST_MAX_PROGRAM_COUNTERS_SIZE);
+    tensil_sample_aggregates_fold(&aggregates, samples,
+                                  samples_size * TENSIL_SAMPLE_SIZE_BYTES);
+
+    bool is_decoded = aggregates.opcode_counts[TENSIL_OPCODE_CONFIG] ==
+                          RESIDENCY_TEST_PREAMBLE_SIZE &&
+                      aggregates.opcode_counts[TENSIL_OPCODE_DATA_MOVE] ==
+                          program_size;
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    // Samples taken by the run on each cycle land on the data moves
+    size_t data_move_samples_count = 0;
+    uint32_t program_counter = 0;
+    uint32_t instruction_offset = 0;
+    const uint8_t *sample_ptr =
+        tensil_sample_buffer_find_valid_samples_ptr(&driver->sample_buffer);
+
+    while (tensil_sample_buffer_get_next_samples_ptr(
+        &driver->sample_buffer, &driver->program, &driver->layout, &sample_ptr,
+        &program_counter, &instruction_offset)) {
+        const uint8_t *instruction_ptr =
+            driver->program.ptr + instruction_offset;
+
+        if (instruction_ptr[driver->layout.instruction_size_bytes - 1] >> 4 ==
+            TENSIL_OPCODE_DATA_MOVE)
+            data_move_samples_count++;
+    }
+
+    if (!data_move_samples_count)
+        is_decoded = false;
+#endif
+
+    return is_decoded;
+}
+
+static tensil_error_t
+run_residency_test_case(struct tensil_driver *driver,
+                        struct tensil_model_registry *registry,
+                        const struct tensil_resident_model *resident_model,
+                        size_t program_size, float *to_buffer,
+                        bool *is_decoded) {
+    uint8_t *dram0_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM0);
+    struct tensil_run_opts run_opts;
+
+    memset(&run_opts, 0, sizeof(struct tensil_run_opts));
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    run_opts.sample_interval_cycles = 1;
+#endif
+
+    tensil_error_t error =
+        tensil_driver_switch_model(driver, registry, resident_model);
+
+    if (error)
+        return error;
+
+    tensil_dram_fill_bytes(dram0_ptr, driver->arch.data_type,
+                           BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS *
+                               driver->arch.array_size,
+                           0, BUNDLE_TEST_SIZE * driver->arch.array_size);
+
+    error = tensil_driver_run(driver, &run_opts);
+
+    if (error)
+        return error;
+
+    *is_decoded = is_residency_test_program_decoded(driver, program_size);
+
+    return tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                           BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS, 0,
+                                           BUNDLE_TEST_SIZE, to_buffer);
+}
+
+tensil_error_t tensil_driver_run_residency_test(struct tensil_driver *driver,
+                                                bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t scalars_size = BUNDLE_TEST_SIZE * driver->arch.array_size;
+    size_t consts_bytes =
+        scalars_size * tensil_dram_sizeof_scalar(driver->arch.data_type);
+    size_t instruction_size = driver->layout.instruction_size_bytes;
+    uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM1);
+    struct tensil_model_registry registry;
+    struct tensil_resident_model *resident_models[RESIDENCY_TEST_MODELS_SIZE];
+    struct tensil_model model;
+    struct bundle_test_section consts;
+    struct bundle_test_section prog;
+    bool is_registry_init = false;
+    bool is_decoded = true;
+
+    float *from_buffers[RESIDENCY_TEST_MODELS_SIZE] = {NULL, NULL};
+    float *to_buffer = (float *)malloc(scalars_size * sizeof(float));
+    uint8_t *consts_ptr = (uint8_t *)malloc(consts_bytes);
+
+    for (size_t i = 0; i < RESIDENCY_TEST_MODELS_SIZE; i++)
+        from_buffers[i] = (float *)malloc(scalars_size * sizeof(float));
+
+    if (!from_buffers[0] || !from_buffers[1] || !to_buffer || !consts_ptr) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    // First model moves consts from DRAM1 to local memory and then to
+    // DRAM0. Second model has consts preloaded to local memory on switch
+    // and only moves local memory to DRAM0.
+    tensil_buffer_reset(&driver->buffer);
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, 0, 0, BUNDLE_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, 0,
+        BUNDLE_TEST_OUTPUT_DRAM0_ADDRESS, BUNDLE_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    for (size_t i = 0; i < RESIDENCY_TEST_MODELS_SIZE; i++) {
+        fill_dram_with_random_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                      BUNDLE_TEST_SIZE);
+        tensil_driver_read_dram_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                        BUNDLE_TEST_SIZE, from_buffers[i]);
+        memcpy(consts_ptr, bank_ptr, consts_bytes);
+
+        consts.ptr = consts_ptr;
+        consts.size = consts_bytes;
+        consts.decoded_size = consts_bytes;
+
+        prog.ptr = driver->buffer.ptr + i * instruction_size;
+        prog.size = (RESIDENCY_TEST_MODELS_SIZE - i) * instruction_size;
+        prog.decoded_size = prog.size;
+
+        error = write_bundle_to_file(
+            driver, residency_test_file_names[i],
+            i ? BUNDLE_TEST_FLAG_LOAD_CONSTS_TO_LOCAL : 0, BUNDLE_TEST_SIZE,
+            &consts, &prog);
+
+        if (error)
+            goto cleanup;
+    }
+
+    tensil_buffer_reset(&driver->buffer);
+
+    error = tensil_driver_init_registry(driver, &registry,
+                                        RESIDENCY_TEST_BUFFER_SIZE,
+                                        RESIDENCY_TEST_MODELS_SIZE *
+                                            consts_bytes);
+
+    if (error)
+        goto cleanup;
+
+    is_registry_init = true;
+
+    for (size_t i = 0; i < RESIDENCY_TEST_MODELS_SIZE; i++) {
+        error = tensil_model_from_bundle_file(&model,
+                                              residency_test_file_names[i]);
+
+        if (error)
+            goto cleanup;
+
+        error = tensil_driver_load_resident_model(driver, &registry, &model,
+                                                  &resident_models[i]);
+        tensil_model_free(&model);
+
+        if (error)
+            goto cleanup;
+    }
+
+    // Consts left at the start of DRAM1 must not be used by resident models
+    tensil_dram_fill_bytes(bank_ptr, driver->arch.data_type, 0, 0,
+                           scalars_size);
+
+    // Switch back and forth to check that each switch restores the model
+    for (size_t k = 0; k < 2 * RESIDENCY_TEST_MODELS_SIZE - 1; k++) {
+        size_t i = k % RESIDENCY_TEST_MODELS_SIZE;
+
+        error = run_residency_test_case(driver, &registry, resident_models[i],
+                                        RESIDENCY_TEST_MODELS_SIZE - i,
+                                        to_buffer, &is_decoded);
+
+        if (error)
+            goto cleanup;
+
+        if (!is_decoded) {
+            if (verbose)
+                printf("\t model %zu samples do not match its program\n", i);
+
+            break;
+        }
+
+        for (size_t j = 0; j < scalars_size; j++)
+            if (from_buffers[i][j] != to_buffer[j]) {
+                bad_indexes[bad_indexes_size++] = j;
+
+                if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                    break;
+            }
+
+        if (bad_indexes_size) {
+            if (verbose)
+                printf("\t model %zu after %zu switches\n", i, k);
+
+            for (size_t l = 0; l < bad_indexes_size && verbose; l++) {
+                size_t bad_index = bad_indexes[l];
+
+                printf("\t at %zu expected=%f, actual=%f\n", bad_index,
+                       from_buffers[i][bad_index], to_buffer[bad_index]);
+            }
+
+            break;
+        }
+    }
+
+    printf("%s\n", (bad_indexes_size || !is_decoded) ? failed : ok);
+
+cleanup:
+    if (is_registry_init) {
+        tensil_error_t release_error =
+            tensil_driver_release_registry(driver, &registry);
+
+        if (!error)
+            error = release_error;
+    }
+
+    for (size_t i = 0; i < RESIDENCY_TEST_MODELS_SIZE; i++) {
+        f_unlink(residency_test_file_names[i]);
+        free(from_buffers[i]);
+    }
+
+    free(to_buffer);
+    free(consts_ptr);
+
+    return error;
+}
+
+#define MODEL_TEST_SIZE (driver->arch.local_depth / 4)
+#define MODEL_TEST_CONSTS_SIZE 2
+#define MODEL_TEST_INPUTS_SIZE 5
+#define MODEL_TEST_JSON_SIZE 2048
+#define MODEL_TEST_FILE_NAME "model_test.tmodel"
+#define MODEL_TEST_PROG_FILE_NAME "model_test.tprog"
+
+#define MODEL_TEST_OUTPUT_DRAM0_ADDRESS MODEL_TEST_SIZE
+
+static const char *model_test_consts_file_names[MODEL_TEST_CONSTS_SIZE] = {
+    "model_test_0.tdata", "model_test_1.tdata"};
+
+// Writes the manifest with consts split in segments and the input split in
+// more entries than the model used to hold.
+static tensil_error_t write_model_test_manifest(struct tensil_driver *driver,
+                                                size_t prog_size) {
+    const struct tensil_architecture *arch = &driver->arch;
+    size_t segment_size = MODEL_TEST_SIZE / MODEL_TEST_CONSTS_SIZE;
+    char json[MODEL_TEST_JSON_SIZE];
+    int length = snprintf(
+        json, MODEL_TEST_JSON_SIZE,
+        "{\"prog\":{\"file_name\":\"%s\",\"size\":%zu},\"consts\":[",
+        MODEL_TEST_PROG_FILE_NAME, prog_size);
+
+    for (size_t i = 0; i < MODEL_TEST_CONSTS_SIZE; i++)
+        length += snprintf(
+            json + length, MODEL_TEST_JSON_SIZE - length,
+            "%s{\"file_name\":\"%s\",\"base\":%zu,\"size\":%zu}",
+            i ? "," : "", model_test_consts_file_names[i], i * segment_size,
+            segment_size);
+
+    length += snprintf(json + length, MODEL_TEST_JSON_SIZE - length,
+                       "],\"inputs\":[");
+
+    for (size_t i = 0; i < MODEL_TEST_INPUTS_SIZE; i++)
+        length += snprintf(json + length, MODEL_TEST_JSON_SIZE - length,
+                           "%s{\"name\":\"x\",\"base\":%zu,\"size\":1}",
+                           i ? "," : "", 2 * i);
+
+    length += snprintf(
+        json + length, MODEL_TEST_JSON_SIZE - length,
+        "],\"outputs\":[{\"name\":\"y\",\"base\":%zu,\"size\":%zu}],"
+        "\"arch\":{\"data_type\":\"FP16BP8\",\"array_size\":%zu,"
+        "\"dram0_depth\":%zu,\"dram1_depth\":%zu,\"local_depth\":%zu,"
+        "\"accumulator_depth\":%zu,\"simd_registers_depth\":%zu,"
+        "\"stride0_depth\":%zu,\"stride1_depth\":%zu},"
+        "\"load_consts_to_local\":false}",
+        MODEL_TEST_OUTPUT_DRAM0_ADDRESS, MODEL_TEST_SIZE, arch->array_size,
+        arch->dram0_depth, arch->dram1_depth, arch->local_depth,
+        arch->accumulator_depth, arch->simd_registers_depth,
+        arch->stride0_depth, arch->stride1_depth);
+
+    if (length >= MODEL_TEST_JSON_SIZE)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Model test manifest is too long");
+
+    return write_bytes_to_file(json, length, MODEL_TEST_FILE_NAME);
+}
+
+tensil_error_t tensil_driver_run_model_test(struct tensil_driver *driver,
+                                            bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    size_t bad_indexes[TEST_MAX_BAD_INDEXES_SIZE];
+    size_t bad_indexes_size = 0;
+    size_t scalars_size = MODEL_TEST_SIZE * driver->arch.array_size;
+    size_t segment_bytes = scalars_size / MODEL_TEST_CONSTS_SIZE *
+                           tensil_dram_sizeof_scalar(driver->arch.data_type);
+    uint8_t *bank_ptr =
+        tensil_driver_get_dram_bank_base_ptr(driver, TENSIL_DRAM1);
+    struct tensil_model model;
+    bool is_interned = false;
+
+    memset(&model, 0, sizeof(struct tensil_model));
+
+    float *from_buffer = (float *)malloc(scalars_size * sizeof(float));
+    float *to_buffer = (float *)malloc(scalars_size * sizeof(float));
+
+    if (!from_buffer || !to_buffer) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    tensil_buffer_reset(&driver->buffer);
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL, 0, 0, MODEL_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_buffer_append_instruction(
+        &driver->buffer, &driver->layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, 0,
+        MODEL_TEST_OUTPUT_DRAM0_ADDRESS, MODEL_TEST_SIZE - 1);
+
+    if (error)
+        goto cleanup;
+
+    error = write_program_to_file(&driver->buffer, MODEL_TEST_PROG_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    error = write_model_test_manifest(driver, driver->buffer.offset);
+
+    if (error)
+        goto cleanup;
+
+    fill_dram_with_random_vectors(driver, TENSIL_DRAM1, 0, 0, MODEL_TEST_SIZE);
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM1, 0, 0,
+                                    MODEL_TEST_SIZE, from_buffer);
+
+    for (size_t i = 0; i < MODEL_TEST_CONSTS_SIZE; i++) {
+        error = write_bytes_to_file(bank_ptr + i * segment_bytes,
+                                    segment_bytes,
+                                    model_test_consts_file_names[i]);
+
+        if (error)
+            goto cleanup;
+    }
+
+    tensil_dram_fill_bytes(bank_ptr, driver->arch.data_type, 0, 0,
+                           scalars_size);
+
+    error = tensil_model_from_file(&model, MODEL_TEST_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    // Split input entries share the interned name
+    is_interned = model.inputs_size == MODEL_TEST_INPUTS_SIZE &&
+                  model.consts_size == MODEL_TEST_CONSTS_SIZE &&
+                  model.inputs[0].name ==
+                      model.inputs[MODEL_TEST_INPUTS_SIZE - 1].name &&
+                  strcmp(model.outputs[0].name, "y") == 0;
+
+    error = tensil_driver_load_model(driver, &model);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_run(driver, NULL);
+
+    if (error)
+        goto cleanup;
+
+    tensil_driver_read_dram_vectors(driver, TENSIL_DRAM0,
+                                    MODEL_TEST_OUTPUT_DRAM0_ADDRESS, 0,
+                                    MODEL_TEST_SIZE, to_buffer);
+
+    for (size_t j = 0; j < scalars_size; j++)
+        if (from_buffer[j] != to_buffer[j]) {
+            bad_indexes[bad_indexes_size++] = j;
+
+            if (bad_indexes_size == TEST_MAX_BAD_INDEXES_SIZE)
+                break;
+        }
+
+    printf("%s\n", (bad_indexes_size || !is_interned) ? failed : ok);
+
+    if (!is_interned && verbose)
+        printf("\t unexpected model entries\n");
+
+    if (bad_indexes_size && verbose)
+        for (size_t k = 0; k < bad_indexes_size; k++) {
+            size_t bad_index = bad_indexes[k];
+
+            printf("\t at %zu expected=%f, actual=%f\n", bad_index,
+                   from_buffer[bad_index], to_buffer[bad_index]);
+        }
+
+cleanup:
+    tensil_model_free(&model);
+
+    f_unlink(MODEL_TEST_FILE_NAME);
+    f_unlink(MODEL_TEST_PROG_FILE_NAME);
+
+    for (size_t i = 0; i < MODEL_TEST_CONSTS_SIZE; i++)
+        f_unlink(model_test_consts_file_names[i]);
+
+    free(from_buffer);
+    free(to_buffer);
+
+    return error;
+}
+
+#define PROGRAM_MAP_TEST_LAYERS_SIZE 3
+#define PROGRAM_MAP_TEST_MAP_SIZE 128
+#define PROGRAM_MAP_TEST_PROGRAM_SIZE 24
+#define PROGRAM_MAP_TEST_SAMPLES_SIZE 1500
+#define PROGRAM_MAP_TEST_FILE_NAME "program_map_test.tmap"
+#define PROGRAM_MAP_TEST_SAMPLE_FILE_NAME "program_map_test.tsample"
+
+// Layers leave a gap of program counters that belong to no layer
+static const char
+    *program_map_test_names[PROGRAM_MAP_TEST_LAYERS_SIZE] = {"conv", "relu",
+                                                             "dense"};
+static const uint32_t
+    program_map_test_ranges[PROGRAM_MAP_TEST_LAYERS_SIZE][2] = {
+        {0, 4}, {4, 10}, {12, 20}};
+
+static tensil_error_t write_program_map_test_map(void) {
+    uint8_t map[PROGRAM_MAP_TEST_MAP_SIZE];
+    size_t names_offset = 16 + PROGRAM_MAP_TEST_LAYERS_SIZE * 12;
+    size_t names_size = 0;
+
+    memset(map, 0, PROGRAM_MAP_TEST_MAP_SIZE);
+
+    for (size_t i = 0; i < PROGRAM_MAP_TEST_LAYERS_SIZE; i++) {
+        write_bundle_word(map, 4 + i * 3, program_map_test_ranges[i][0]);
+        write_bundle_word(map, 5 + i * 3, program_map_test_ranges[i][1]);
+        write_bundle_word(map, 6 + i * 3, names_size);
+
+        strcpy((char *)map + names_offset + names_size,
+               program_map_test_names[i]);
+        names_size += strlen(program_map_test_names[i]) + 1;
+    }
+
+    write_bundle_word(map, 0, 0x50414d54);
+    write_bundle_word(map, 1, 1);
+    write_bundle_word(map, 2, PROGRAM_MAP_TEST_LAYERS_SIZE);
+    write_bundle_word(map, 3, names_size);
+
+    return write_bytes_to_file(map, names_offset + names_size,
+                               PROGRAM_MAP_TEST_FILE_NAME);
+}
+
+tensil_error_t tensil_driver_run_program_map_test(struct tensil_driver *driver,
+                                                  bool verbose) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    struct tensil_program_map map;
+    struct tensil_layer_profile profile;
+    struct tensil_layer_counts
+        expected_counts[PROGRAM_MAP_TEST_LAYERS_SIZE + 1];
+    bool is_mapped = true;
+    bool is_counted = true;
+
+    memset(&map, 0, sizeof(struct tensil_program_map));
+    memset(&profile, 0, sizeof(struct tensil_layer_profile));
+    memset(expected_counts, 0, sizeof(expected_counts));
+
+    uint8_t *samples = (uint8_t *)malloc(PROGRAM_MAP_TEST_SAMPLES_SIZE *
+                                         TENSIL_SAMPLE_SIZE_BYTES);
+
+    if (!samples) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    // Every third sample is stalled and every seventh is of the driver
+    // instruction preceding the program. Samples are counted as expected
+    // for the last entry, which is unmapped, unless a layer holds them.
+    for (size_t i = 0; i < PROGRAM_MAP_TEST_SAMPLES_SIZE; i++) {
+        uint8_t *sample_ptr = samples + i * TENSIL_SAMPLE_SIZE_BYTES;
+        uint32_t program_counter = i % PROGRAM_MAP_TEST_PROGRAM_SIZE;
+        bool is_driver = i % 7 == 0;
+        bool is_stalled = i % 3 == 0;
+        uint16_t flags =
+            is_stalled ? TENSIL_SAMPLE_FLAG_INSTRUCTION_VALID
+                       : TENSIL_SAMPLE_FLAG_INSTRUCTION_VALID |
+                             TENSIL_SAMPLE_FLAG_INSTRUCTION_READY;
+        size_t k = PROGRAM_MAP_TEST_LAYERS_SIZE;
+
+        for (size_t j = 0; j < PROGRAM_MAP_TEST_LAYERS_SIZE && !is_driver; j++)
+            if (program_counter >= program_map_test_ranges[j][0] &&
+                program_counter < program_map_test_ranges[j][1])
+                k = j;
+
+        expected_counts[k].samples_count++;
+
+        if (is_stalled)
+            expected_counts[k].stalls_count++;
+
+        write_bundle_word(sample_ptr, 0,
+                          is_driver ? 0
+                                    : program_counter +
+                                          TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+        write_bundle_word(sample_ptr, 1, flags);
+    }
+
+    error = write_program_map_test_map();
+
+    if (error)
+        goto cleanup;
+
+    error = write_bytes_to_file(samples,
+                                PROGRAM_MAP_TEST_SAMPLES_SIZE *
+                                    TENSIL_SAMPLE_SIZE_BYTES,
+                                PROGRAM_MAP_TEST_SAMPLE_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_program_map_from_file(&map, PROGRAM_MAP_TEST_FILE_NAME);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_layer_profile_init(&profile, &map);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_layer_profile_fold_file(&profile,
+                                           PROGRAM_MAP_TEST_SAMPLE_FILE_NAME,
+                                           TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT);
+
+    if (error)
+        goto cleanup;
+
+    is_mapped = map.layers_size == PROGRAM_MAP_TEST_LAYERS_SIZE;
+
+    for (size_t i = 0; i < map.layers_size && is_mapped; i++)
+        is_mapped = strcmp(map.layers[i].name, program_map_test_names[i]) ==
+                        0 &&
+                    map.layers[i].begin == program_map_test_ranges[i][0] &&
+                    map.layers[i].end == program_map_test_ranges[i][1];
+
+    for (size_t i = 0; i <= PROGRAM_MAP_TEST_LAYERS_SIZE && is_mapped; i++) {
+        const struct tensil_layer_counts *counts =
+            i < PROGRAM_MAP_TEST_LAYERS_SIZE ? &profile.counts[i]
+                                             : &profile.unmapped_counts;
+
+        if (counts->samples_count != expected_counts[i].samples_count ||
+            counts->stalls_count != expected_counts[i].stalls_count)
+            is_counted = false;
+    }
+
+    printf("%s\n", (is_mapped && is_counted) ? ok : failed);
+
+    if (!is_mapped && verbose)
+        printf("\t unexpected program map layers\n");
+
+    if (is_mapped && verbose)
+        tensil_layer_profile_print(&profile);
+
+cleanup:
+    tensil_layer_profile_free(&profile);
+    tensil_program_map_free(&map);
+
+    f_unlink(PROGRAM_MAP_TEST_FILE_NAME);
+    f_unlink(PROGRAM_MAP_TEST_SAMPLE_FILE_NAME);
+
+    free(samples);
+
+    return error;
+}
+
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+
+#define SAMPLING_TEST_SIZE (64 * 1024 * 1024)
+
+tensil_error_t tensil_driver_run_sampling_test(struct tensil_driver *driver,
+                                               bool verbose) {
+    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        return error;
+
+    error = tensil_buffer_append_noop_instructions(
+        &driver->buffer, &driver->layout, SAMPLING_TEST_SIZE);
+
+    if (error)
+        return error;
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+    if (error)
+        return error;
+
+    error = tensil_driver_run(driver, NULL);
+
+    if (error)
+        return error;
+
+    size_t samples_count =
+        driver->sample_buffer.offset / TENSIL_SAMPLE_SIZE_BYTES;
+
+    size_t valid_samples_count = 0;
+    size_t valid_samples_base = 0;
+
+    size_t stalling_samples_count = 0;
+    size_t missing_samples_count = 0;
+
+    const uint8_t *sample_ptr =
+        tensil_sample_buffer_find_valid_samples_ptr(&driver->sample_buffer);
+
+    uint32_t prev_program_counter = 0;
+    uint32_t next_program_counter = 0;
+    uint32_t instruction_offset = 0;
+
+    while (tensil_sample_buffer_get_next_samples_ptr(
+        &driver->sample_buffer, &driver->program, &driver->layout, &sample_ptr,
+        &next_program_counter, &instruction_offset)) {
+        valid_samples_count++;
+
+        if (!prev_program_counter) {
+            prev_program_counter = next_program_counter;
+        } else {
+            if (prev_program_counter == next_program_counter)
+                stalling_samples_count++;
+            else {
+                if (next_program_counter >
+                    prev_program_counter + driver->sample_interval_cycles) {
+                    if (verbose)
+                        printf("Offset %u -> %u\n",
+                               (unsigned int)prev_program_counter,
+                               (unsigned int)next_program_counter);
+
+                    missing_samples_count++;
+                }
+                prev_program_counter = next_program_counter;
+            }
+        }
+    }
+
+    printf("%s: collected %lu samples, %lu "
+           "valid with %lu stalling and %lu missing, %lu head-invalid, %lu "
+           "tail-invalid\n",
+           missing_samples_count ? failed : ok, samples_count,
+           valid_samples_count, stalling_samples_count, missing_samples_count,
+           valid_samples_base,
+           samples_count - valid_samples_base - valid_samples_count);
+
+    return TENSIL_ERROR_NONE;
+}
+
+#define SAMPLING_RING_TEST_SIZE (16 * 1024 * 1024)
+#define SAMPLING_RING_TEST_BLOCKS 4
+#define SAMPLING_RING_TEST_COUNTS_SIZE 4096
+
+tensil_error_t
+tensil_driver_run_sampling_ring_test(struct tensil_driver *driver,
+                                     bool verbose) {
+    struct tensil_sample_aggregates aggregates;
+    size_t sample_buffer_size = driver->sample_buffer.size;
+    uint32_t *counts =
+        (uint32_t *)malloc(SAMPLING_RING_TEST_COUNTS_SIZE * sizeof(uint32_t));
+
+    if (!counts)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    tensil_error_t error = tensil_driver_setup_buffer_preamble(driver);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_buffer_append_noop_instructions(
+        &driver->buffer, &driver->layout, SAMPLING_RING_TEST_SIZE);
+
+    if (error)
+        goto cleanup;
+
+    error = tensil_driver_setup_buffer_postamble(driver);
+
+    if (error)
+        goto cleanup;
+
+    // Ring much smaller than the samples of the run
+    driver->sample_buffer.size = SAMPLING_RING_TEST_BLOCKS *
+                                 driver->sample_block_size *
+                                 TENSIL_SAMPLE_SIZE_BYTES;
+
+    tensil_sample_aggregates_init(&aggregates, &driver->program,
+                                  &driver->layout, counts,
+                                  SAMPLING_RING_TEST_COUNTS_SIZE);
+    tensil_sample_buffer_set_aggregates(&driver->sample_buffer, &aggregates);
+
+    error = tensil_driver_run(driver, NULL);
+
+    if (error)
+        goto cleanup;
+
+    size_t opcode_samples_count = 0;
+    size_t counted_samples_count = 0;
+
+    for (size_t i = 0; i < TENSIL_SAMPLE_OPCODE_COUNTS_SIZE; i++)
+        opcode_samples_count += aggregates.opcode_counts[i];
+
+    for (size_t i = 0; i < SAMPLING_RING_TEST_COUNTS_SIZE; i++)
+        counted_samples_count += counts[i];
+
+    bool is_wrapped = aggregates.blocks_count > SAMPLING_RING_TEST_BLOCKS;
+    bool is_consistent =
+        opcode_samples_count == aggregates.valid_samples_count &&
+        counted_samples_count <= aggregates.valid_samples_count &&
+        aggregates.opcode_counts[TENSIL_OPCODE_NOOP] * 2 >
+            aggregates.valid_samples_count;
+
+    printf("%s: folded %zu blocks with %zu valid and %zu invalid samples\n",
+           (is_wrapped && is_consistent) ? ok : failed,
+           aggregates.blocks_count, aggregates.valid_samples_count,
+           aggregates.invalid_samples_count);
+
+    if (verbose)
+        tensil_sample_aggregates_print(&aggregates, 8, 0);
+
+cleanup:
+    tensil_sample_buffer_set_aggregates(&driver->sample_buffer, NULL);
+    driver->sample_buffer.size = sample_buffer_size;
+
+    free(counts);
+
+    return error;
 }
 
 #endif
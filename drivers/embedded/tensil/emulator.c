@@ -0,0 +1,636 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "emulator.h"
+
+#ifdef TENSIL_PLATFORM_EMULATOR
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define FP16BP8_BASE_POINT 8
+#define FP16BP8_ONE (1 << FP16BP8_BASE_POINT)
+
+typedef int16_t fp16bp8_bits;
+
+static fp16bp8_bits saturate(int64_t x) {
+    return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : x;
+}
+
+// Same as FixedBase.doMAC: (x * y + z) with round-to-nearest-even and
+// saturation, so that results match the Scala emulator bit for bit.
+static fp16bp8_bits mac(int64_t x, int64_t y, int64_t z) {
+    int64_t mac = x * y + z * FP16BP8_ONE;
+    int64_t half = 1 << (FP16BP8_BASE_POINT - 1);
+    int64_t adj =
+        ((mac & half) && ((mac & (half - 1)) || (mac & FP16BP8_ONE))) ? 1 : 0;
+
+    return saturate((mac >> FP16BP8_BASE_POINT) + adj);
+}
+
+static fp16bp8_bits plus(int64_t x, int64_t y) {
+    return mac(x, FP16BP8_ONE, y);
+}
+
+static fp16bp8_bits minus(int64_t x, int64_t y) {
+    return mac(x, FP16BP8_ONE, -y);
+}
+
+static fp16bp8_bits times(int64_t x, int64_t y) { return mac(x, y, 0); }
+
+static fp16bp8_bits *local_vector(struct tensil_emulator *emulator,
+                                  size_t address) {
+    return emulator->local +
+           (address % emulator->arch.local_depth) * emulator->arch.array_size;
+}
+
+static fp16bp8_bits *accumulator_vector(struct tensil_emulator *emulator,
+                                        size_t address) {
+    return emulator->accumulators +
+           (address % emulator->arch.accumulator_depth) *
+               emulator->arch.array_size;
+}
+
+static fp16bp8_bits *dram_vector(struct tensil_emulator *emulator,
+                                 uint8_t *dram_ptr, size_t dram_depth,
+                                 size_t address) {
+    return (fp16bp8_bits *)dram_ptr +
+           (address % dram_depth) * emulator->arch.array_size;
+}
+
+static uint64_t read_bytes(const uint8_t *ptr, size_t size) {
+    uint64_t value = 0;
+
+    if (size > sizeof(uint64_t))
+        size = sizeof(uint64_t);
+
+    for (size_t i = 0; i < size; i++)
+        value |= ((uint64_t)ptr[i]) << (i * 8);
+
+    return value;
+}
+
+static uint64_t mask(size_t size_bits) {
+    return size_bits >= 64 ? UINT64_MAX : (((uint64_t)1) << size_bits) - 1;
+}
+
+static void decode_address(uint64_t operand, size_t address_size_bits,
+                           size_t stride_size_bits, size_t *address,
+                           size_t *step) {
+    *address = operand & mask(address_size_bits);
+    *step = ((size_t)1)
+            << ((operand >> address_size_bits) & mask(stride_size_bits));
+}
+
+static tensil_error_t execute_data_move(struct tensil_emulator *emulator,
+                                        uint8_t flags, uint64_t operand0,
+                                        uint64_t operand1, uint64_t size) {
+    size_t local_address, local_step, address, step;
+    size_t vector_size_bytes =
+        emulator->arch.array_size * sizeof(fp16bp8_bits);
+
+    decode_address(operand0, emulator->layout.operand0_address_size_bits,
+                   emulator->layout.stride0_size_bits, &local_address,
+                   &local_step);
+    decode_address(operand1, emulator->layout.operand1_address_size_bits,
+                   emulator->layout.stride1_size_bits, &address, &step);
+
+    uint8_t *dram_ptr = NULL;
+    size_t dram_depth = 0;
+
+    switch (flags) {
+    case TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL:
+    case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0:
+        dram_ptr = emulator->dram0_ptr;
+        dram_depth = emulator->arch.dram0_depth;
+        break;
+
+    case TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL:
+    case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM1:
+        dram_ptr = emulator->dram1_ptr;
+        dram_depth = emulator->arch.dram1_depth;
+        break;
+
+    case TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL:
+    case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC:
+    case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC_WITH_ACC:
+        break;
+
+    default:
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_INSTRUCTION,
+                                   "Unexpected DataMove flags %d at %u", flags,
+                                   (unsigned int)emulator->program_counter);
+    }
+
+    if (dram_depth && !dram_ptr)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_INSTRUCTION,
+                                   "DRAM offset is not configured at %u",
+                                   (unsigned int)emulator->program_counter);
+
+    for (size_t i = 0; i <= size; i++) {
+        fp16bp8_bits *local =
+            local_vector(emulator, local_address + i * local_step);
+        fp16bp8_bits *other;
+
+        if (dram_depth)
+            other = dram_vector(emulator, dram_ptr, dram_depth,
+                                address + i * step);
+        else
+            other = accumulator_vector(emulator, address + i * step);
+
+        switch (flags) {
+        case TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL:
+        case TENSIL_DATA_MOVE_FLAG_DRAM1_TO_LOCAL:
+        case TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL:
+            memcpy(local, other, vector_size_bytes);
+            break;
+
+        case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0:
+        case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM1:
+        case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC:
+            memcpy(other, local, vector_size_bytes);
+            break;
+
+        case TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC_WITH_ACC:
+            for (size_t j = 0; j < emulator->arch.array_size; j++)
+                other[j] = plus(other[j], local[j]);
+            break;
+        }
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+static void execute_load_weight(struct tensil_emulator *emulator,
+                                uint8_t flags, uint64_t operand0,
+                                uint64_t size) {
+    size_t local_address, local_step;
+    size_t array_size = emulator->arch.array_size;
+    size_t vector_size_bytes = array_size * sizeof(fp16bp8_bits);
+    size_t rows_size = array_size + 1;
+
+    decode_address(operand0, emulator->layout.operand0_address_size_bits,
+                   emulator->layout.stride0_size_bits, &local_address,
+                   &local_step);
+
+    // Vectors are pushed from the last to the first, each push shifting
+    // previously loaded rows down by one. Instead of shifting on every
+    // push, shift once by the number of pushed rows and then fill the
+    // vacated rows in order.
+    size_t pushed_size = size + 1 < rows_size ? size + 1 : rows_size;
+
+    memmove(emulator->weights + pushed_size * array_size, emulator->weights,
+            (rows_size - pushed_size) * vector_size_bytes);
+
+    for (size_t i = 0; i < pushed_size; i++)
+        if (flags & TENSIL_LOAD_WEIGHT_FLAG_ZEROES)
+            memset(emulator->weights + i * array_size, 0, vector_size_bytes);
+        else
+            memcpy(emulator->weights + i * array_size,
+                   local_vector(emulator, local_address + i * local_step),
+                   vector_size_bytes);
+}
+
+#ifdef __AVX2__
+
+// Same as mac() for 8 lanes. The products and the shifted accumulator fit
+// in 32 bits, so rounding to nearest even is done by adding 127 plus the
+// lowest bit of the integer part before the arithmetic shift.
+static inline __m256i mac_avx2(__m256i x, __m256i y, __m256i z) {
+    __m256i mac =
+        _mm256_add_epi32(_mm256_mullo_epi32(x, y),
+                         _mm256_slli_epi32(z, FP16BP8_BASE_POINT));
+    __m256i odd = _mm256_and_si256(_mm256_srli_epi32(mac, FP16BP8_BASE_POINT),
+                                   _mm256_set1_epi32(1));
+    __m256i rounded = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            mac, _mm256_add_epi32(
+                     _mm256_set1_epi32((1 << (FP16BP8_BASE_POINT - 1)) - 1),
+                     odd)),
+        FP16BP8_BASE_POINT);
+
+    return _mm256_min_epi32(_mm256_max_epi32(rounded,
+                                             _mm256_set1_epi32(INT16_MIN)),
+                            _mm256_set1_epi32(INT16_MAX));
+}
+
+#endif
+
+#define MAC_TEST_SIZE (64 * 1024)
+#define MAC_TEST_LANES 8
+#define MAC_TEST_EDGE_CASES_SIZE 8
+
+static const char *ok = "\033[38;2;0;255;00mOK\033[39m";
+
+#ifdef __AVX2__
+
+static const char *failed = "\033[38;2;255;0;00mFAILED\033[39m";
+
+// Saturating products and accumulators and products with remainders of
+// exactly one half, which round to even
+static const fp16bp8_bits mac_test_edge_cases[MAC_TEST_EDGE_CASES_SIZE][3] = {
+    {INT16_MIN, INT16_MIN, INT16_MAX},
+    {INT16_MAX, INT16_MAX, INT16_MAX},
+    {INT16_MIN, INT16_MAX, INT16_MIN},
+    {0, 0, INT16_MIN},
+    {1, 128, 0},
+    {3, 128, 0},
+    {-1, 128, 0},
+    {-3, 128, -1}};
+
+// Half of the operands are small so that random cases cover rounding as
+// well as saturation.
+static fp16bp8_bits random_mac_test_operand(void) {
+    int16_t x = (int16_t)rand();
+
+    return rand() % 2 ? x : x >> 6;
+}
+
+#endif
+
+tensil_error_t tensil_emulator_run_mac_test(bool verbose) {
+#ifdef __AVX2__
+    size_t bad_count = 0;
+
+    for (size_t i = 0; i < MAC_TEST_SIZE; i += MAC_TEST_LANES) {
+        int32_t x[MAC_TEST_LANES];
+        int32_t y[MAC_TEST_LANES];
+        int32_t z[MAC_TEST_LANES];
+        int32_t r[MAC_TEST_LANES];
+
+        for (size_t l = 0; l < MAC_TEST_LANES; l++) {
+            size_t k = i + l;
+
+            if (k < MAC_TEST_EDGE_CASES_SIZE) {
+                x[l] = mac_test_edge_cases[k][0];
+                y[l] = mac_test_edge_cases[k][1];
+                z[l] = mac_test_edge_cases[k][2];
+            } else {
+                x[l] = random_mac_test_operand();
+                y[l] = random_mac_test_operand();
+                z[l] = random_mac_test_operand();
+            }
+        }
+
+        _mm256_storeu_si256(
+            (__m256i *)r,
+            mac_avx2(_mm256_loadu_si256((const __m256i *)x),
+                     _mm256_loadu_si256((const __m256i *)y),
+                     _mm256_loadu_si256((const __m256i *)z)));
+
+        for (size_t l = 0; l < MAC_TEST_LANES; l++) {
+            fp16bp8_bits expected = mac(x[l], y[l], z[l]);
+
+            if (r[l] == expected)
+                continue;
+
+            if (verbose)
+                printf("\t %d * %d + %d expected=%d, actual=%d\n", x[l],
+                       y[l], z[l], expected, r[l]);
+
+            bad_count++;
+        }
+    }
+
+    printf("%s\n", bad_count ? failed : ok);
+#else
+    (void)verbose;
+
+    printf("%s: built without AVX2\n", ok);
+#endif
+
+    return TENSIL_ERROR_NONE;
+}
+
+// Computes y = W^T * [1, x] for one input vector. The MAC chain for each
+// column is sequential with rounding and saturation at every step, so the
+// columns are what is vectorized.
+static void mat_mul_vector(const fp16bp8_bits *weights, size_t array_size,
+                           const fp16bp8_bits *x, fp16bp8_bits *y) {
+    size_t j = 0;
+
+#ifdef __AVX2__
+    for (; j + 8 <= array_size; j += 8) {
+        __m256i r = _mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(weights + j)));
+
+        for (size_t k = 0; k < array_size; k++) {
+            __m256i w = _mm256_cvtepi16_epi32(_mm_loadu_si128(
+                (const __m128i *)(weights + (k + 1) * array_size + j)));
+
+            r = mac_avx2(_mm256_set1_epi32(x[k]), w, r);
+        }
+
+        _mm_storeu_si128((__m128i *)(y + j),
+                         _mm_packs_epi32(_mm256_castsi256_si128(r),
+                                         _mm256_extracti128_si256(r, 1)));
+    }
+#endif
+
+    if (j == array_size)
+        return;
+
+    memcpy(y + j, weights + j, (array_size - j) * sizeof(fp16bp8_bits));
+
+    for (size_t k = 0; k < array_size; k++) {
+        fp16bp8_bits x_k = x[k];
+        const fp16bp8_bits *w = weights + (k + 1) * array_size;
+
+        for (size_t l = j; l < array_size; l++)
+            y[l] = mac(x_k, w[l], y[l]);
+    }
+}
+
+static void execute_mat_mul(struct tensil_emulator *emulator, uint8_t flags,
+                            uint64_t operand0, uint64_t operand1,
+                            uint64_t size) {
+    size_t local_address, local_step, accumulator_address, accumulator_step;
+    size_t array_size = emulator->arch.array_size;
+    fp16bp8_bits *r = emulator->scratch;
+
+    decode_address(operand0, emulator->layout.operand0_address_size_bits,
+                   emulator->layout.stride0_size_bits, &local_address,
+                   &local_step);
+    decode_address(operand1, emulator->layout.operand1_address_size_bits,
+                   emulator->layout.stride1_size_bits, &accumulator_address,
+                   &accumulator_step);
+
+    for (size_t i = 0; i <= size; i++) {
+        fp16bp8_bits *y = accumulator_vector(
+            emulator, accumulator_address + i * accumulator_step);
+
+        // With zeroes as input only the bias row remains
+        if (flags & TENSIL_MAT_MUL_FLAG_ZEROES)
+            memcpy(r, emulator->weights, array_size * sizeof(fp16bp8_bits));
+        else
+            mat_mul_vector(
+                emulator->weights, array_size,
+                local_vector(emulator, local_address + i * local_step), r);
+
+        if (!(flags & TENSIL_MAT_MUL_FLAG_ACC)) {
+            memcpy(y, r, array_size * sizeof(fp16bp8_bits));
+            continue;
+        }
+
+        size_t j = 0;
+
+#ifdef __AVX2__
+        for (; j + 8 <= array_size; j += 8)
+            _mm_storeu_si128(
+                (__m128i *)(y + j),
+                _mm_adds_epi16(_mm_loadu_si128((const __m128i *)(y + j)),
+                               _mm_loadu_si128((const __m128i *)(r + j))));
+#endif
+
+        for (; j < array_size; j++)
+            y[j] = plus(y[j], r[j]);
+    }
+}
+
+static fp16bp8_bits simd_op(uint8_t op, fp16bp8_bits input,
+                            fp16bp8_bits left, fp16bp8_bits right) {
+    switch (op) {
+    case TENSIL_SIMD_OPCODE_NOOP:
+    default:
+        return input;
+    case TENSIL_SIMD_OPCODE_ZERO:
+        return 0;
+    case TENSIL_SIMD_OPCODE_MOVE:
+        return left;
+    case TENSIL_SIMD_OPCODE_NOT:
+        return left ? 0 : FP16BP8_ONE;
+    case TENSIL_SIMD_OPCODE_AND:
+        return (left && right) ? FP16BP8_ONE : 0;
+    case TENSIL_SIMD_OPCODE_OR:
+        return (left || right) ? FP16BP8_ONE : 0;
+    case TENSIL_SIMD_OPCODE_INCREMENT:
+        return plus(left, FP16BP8_ONE);
+    case TENSIL_SIMD_OPCODE_DECREMENT:
+        return minus(left, FP16BP8_ONE);
+    case TENSIL_SIMD_OPCODE_ADD:
+        return plus(left, right);
+    case TENSIL_SIMD_OPCODE_SUB:
+        return minus(left, right);
+    case TENSIL_SIMD_OPCODE_MUL:
+        return times(left, right);
+    case TENSIL_SIMD_OPCODE_ABS:
+        return saturate(left < 0 ? -(int64_t)left : left);
+    case TENSIL_SIMD_OPCODE_GT:
+        return left > right ? FP16BP8_ONE : 0;
+    case TENSIL_SIMD_OPCODE_GTE:
+        return left >= right ? FP16BP8_ONE : 0;
+    case TENSIL_SIMD_OPCODE_MIN:
+        return left < right ? left : right;
+    case TENSIL_SIMD_OPCODE_MAX:
+        return left > right ? left : right;
+    }
+}
+
+static void execute_simd(struct tensil_emulator *emulator, uint8_t flags,
+                         uint64_t operand0, uint64_t operand1,
+                         uint64_t operand2) {
+    size_t array_size = emulator->arch.array_size;
+    size_t operand_size_bits = emulator->layout.simd_operand_size_bits;
+    size_t write_address =
+        operand0 & mask(emulator->layout.operand0_address_size_bits);
+    size_t read_address =
+        operand1 & mask(emulator->layout.operand1_address_size_bits);
+
+    size_t dest = operand2 & mask(operand_size_bits);
+    size_t source_right = (operand2 >> operand_size_bits) &
+                          mask(operand_size_bits);
+    size_t source_left = (operand2 >> (operand_size_bits * 2)) &
+                         mask(operand_size_bits);
+    uint8_t op = (operand2 >> (operand_size_bits * 3)) &
+                 mask(emulator->layout.simd_op_size_bits);
+
+    const fp16bp8_bits *input =
+        (flags & TENSIL_SIMD_FLAG_READ)
+            ? accumulator_vector(emulator, read_address)
+            : emulator->zeroes;
+    const fp16bp8_bits *left =
+        source_left ? emulator->simd_registers +
+                          ((source_left - 1) %
+                           emulator->arch.simd_registers_depth) *
+                              array_size
+                    : input;
+    const fp16bp8_bits *right =
+        source_right ? emulator->simd_registers +
+                           ((source_right - 1) %
+                            emulator->arch.simd_registers_depth) *
+                               array_size
+                     : input;
+
+    fp16bp8_bits *output = emulator->scratch;
+
+    for (size_t j = 0; j < array_size; j++)
+        output[j] = simd_op(op, input[j], left[j], right[j]);
+
+    if (dest && op != TENSIL_SIMD_OPCODE_NOOP)
+        memcpy(emulator->simd_registers +
+                   ((dest - 1) % emulator->arch.simd_registers_depth) *
+                       array_size,
+               output, array_size * sizeof(fp16bp8_bits));
+
+    if (flags & TENSIL_SIMD_FLAG_WRITE) {
+        fp16bp8_bits *y = accumulator_vector(emulator, write_address);
+
+        for (size_t j = 0; j < array_size; j++)
+            y[j] = (flags & TENSIL_SIMD_FLAG_ACC) ? plus(y[j], output[j])
+                                                  : output[j];
+    }
+}
+
+static void execute_config(struct tensil_emulator *emulator,
+                           uint64_t operands) {
+    uint8_t reg = operands & 0xf;
+    uint64_t value = operands >> 4;
+
+    switch (reg) {
+    case TENSIL_CONFIG_REGISTER_DRAM0_OFFSET:
+        emulator->dram0_ptr = (uint8_t *)(uintptr_t)(value << 16);
+        break;
+
+    case TENSIL_CONFIG_REGISTER_DRAM1_OFFSET:
+        emulator->dram1_ptr = (uint8_t *)(uintptr_t)(value << 16);
+        break;
+
+    case TENSIL_CONFIG_REGISTER_PROGRAM_COUNTER:
+        emulator->program_counter = value;
+        break;
+
+    default:
+        break;
+    }
+}
+
+tensil_error_t tensil_emulator_init(struct tensil_emulator *emulator,
+                                    const struct tensil_architecture *arch) {
+    memset(emulator, 0, sizeof(struct tensil_emulator));
+
+    if (arch->data_type != TENSIL_DATA_TYPE_FP16BP8)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_ARCH,
+                                   "Emulator only supports FP16BP8");
+
+    emulator->arch = *arch;
+    tensil_instruction_layout_init(&emulator->layout, &emulator->arch);
+
+    size_t vector_size_bytes = arch->array_size * sizeof(fp16bp8_bits);
+
+    emulator->local = (fp16bp8_bits *)calloc(arch->local_depth,
+                                             vector_size_bytes);
+    emulator->accumulators = (fp16bp8_bits *)calloc(arch->accumulator_depth,
+                                                    vector_size_bytes);
+    emulator->simd_registers = (fp16bp8_bits *)calloc(
+        arch->simd_registers_depth, vector_size_bytes);
+    emulator->weights =
+        (fp16bp8_bits *)calloc(arch->array_size + 1, vector_size_bytes);
+    emulator->zeroes = (fp16bp8_bits *)calloc(1, vector_size_bytes);
+    emulator->scratch = (fp16bp8_bits *)calloc(1, vector_size_bytes);
+
+    if (!emulator->local || !emulator->accumulators ||
+        !emulator->simd_registers || !emulator->weights ||
+        !emulator->zeroes || !emulator->scratch) {
+        tensil_emulator_free(emulator);
+
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+void tensil_emulator_free(struct tensil_emulator *emulator) {
+    free(emulator->local);
+    free(emulator->accumulators);
+    free(emulator->simd_registers);
+    free(emulator->weights);
+    free(emulator->zeroes);
+    free(emulator->scratch);
+
+    emulator->local = NULL;
+    emulator->accumulators = NULL;
+    emulator->simd_registers = NULL;
+    emulator->weights = NULL;
+    emulator->zeroes = NULL;
+    emulator->scratch = NULL;
+}
+
+tensil_error_t tensil_emulator_run(struct tensil_emulator *emulator,
+                                   const uint8_t *ptr, size_t size) {
+    const struct tensil_instruction_layout *layout = &emulator->layout;
+    size_t operand1_offset = layout->operand0_size_bytes;
+    size_t operand2_offset = operand1_offset + layout->operand1_size_bytes;
+    size_t header_offset = operand2_offset + layout->operand2_size_bytes;
+
+    for (size_t offset = 0; offset + layout->instruction_size_bytes <= size;
+         offset += layout->instruction_size_bytes) {
+        const uint8_t *instruction_ptr = ptr + offset;
+        uint8_t header = instruction_ptr[header_offset];
+        uint8_t opcode = header >> 4;
+        uint8_t flags = header & 0xf;
+
+        uint64_t operand0 =
+            read_bytes(instruction_ptr, layout->operand0_size_bytes);
+        uint64_t operand1 = read_bytes(instruction_ptr + operand1_offset,
+                                       layout->operand1_size_bytes);
+        uint64_t operand2 = read_bytes(instruction_ptr + operand2_offset,
+                                       layout->operand2_size_bytes);
+
+        tensil_error_t error = TENSIL_ERROR_NONE;
+
+        switch (opcode) {
+        case TENSIL_OPCODE_NOOP:
+            break;
+
+        case TENSIL_OPCODE_MAT_MUL:
+            execute_mat_mul(emulator, flags, operand0, operand1, operand2);
+            break;
+
+        case TENSIL_OPCODE_DATA_MOVE:
+            error = execute_data_move(emulator, flags, operand0, operand1,
+                                      operand2);
+            break;
+
+        case TENSIL_OPCODE_LOAD_WEIGHT:
+            execute_load_weight(emulator, flags, operand0, operand1);
+            break;
+
+        case TENSIL_OPCODE_SIMD:
+            execute_simd(emulator, flags, operand0, operand1, operand2);
+            break;
+
+        case TENSIL_OPCODE_CONFIG: {
+            uint64_t operands = read_bytes(instruction_ptr, header_offset);
+            execute_config(emulator, operands);
+
+            // Setting program counter does not advance it
+            if ((operands & 0xf) == TENSIL_CONFIG_REGISTER_PROGRAM_COUNTER)
+                continue;
+            break;
+        }
+
+        default:
+            error = TENSIL_DRIVER_ERROR(
+                TENSIL_ERROR_DRIVER_INVALID_INSTRUCTION,
+                "Unexpected opcode %d at %u", opcode,
+                (unsigned int)emulator->program_counter);
+            break;
+        }
+
+        if (error)
+            return error;
+
+        emulator->program_counter++;
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+#endif
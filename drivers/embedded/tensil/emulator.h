@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include "platform.h"
+
+#ifdef TENSIL_PLATFORM_EMULATOR
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "architecture.h"
+#include "error.h"
+#include "instruction.h"
+
+struct tensil_emulator {
+    struct tensil_architecture arch;
+    struct tensil_instruction_layout layout;
+
+    int16_t *local;
+    int16_t *accumulators;
+    int16_t *simd_registers;
+
+    // Rows 1..array_size are multiplied by the input vector, row 0 is
+    // multiplied by implicit 1 and acts as the bias.
+    int16_t *weights;
+
+    int16_t *zeroes;
+    int16_t *scratch;
+
+    uint8_t *dram0_ptr;
+    uint8_t *dram1_ptr;
+
+    uint32_t program_counter;
+};
+
+tensil_error_t tensil_emulator_init(struct tensil_emulator *emulator,
+                                    const struct tensil_architecture *arch);
+
+void tensil_emulator_free(struct tensil_emulator *emulator);
+
+tensil_error_t tensil_emulator_run(struct tensil_emulator *emulator,
+                                   const uint8_t *ptr, size_t size);
+
+// Compares the AVX2 MAC kernel with the scalar MAC on the same operands bit
+// for bit. Passes trivially when built without AVX2.
+tensil_error_t tensil_emulator_run_mac_test(bool verbose);
+
+#endif
@@ -4,11 +4,16 @@
 #pragma once
 
 #include "platform.h"
+
+#ifdef TENSIL_PLATFORM_HOST
+#include "host.h"
+#else
 #include "xstatus.h"
 
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
 #include "ff.h"
 #endif
+#endif
 
 #define TENSIL_ERROR_MAX_MESSAGE_SIZE 256
 #define TENSIL_ERROR_NONE NULL
@@ -33,7 +38,14 @@ enum tensil_error_code {
     TENSIL_ERROR_DRIVER_UNEXPECTED_INPUT_NAME,
     TENSIL_ERROR_DRIVER_UNEXPECTED_OUTPUT_NAME,
     TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
-    TENSIL_ERROR_DRIVER_OUT_OF_SAMPLE_BUFFER
+    TENSIL_ERROR_DRIVER_OUT_OF_SAMPLE_BUFFER,
+    TENSIL_ERROR_DRIVER_INVALID_INSTRUCTION,
+    TENSIL_ERROR_DRIVER_BUSY,
+    TENSIL_ERROR_DRIVER_INTC_DEVICE_NOT_FOUND,
+    TENSIL_ERROR_DRIVER_INVALID_COMPRESSED_DATA,
+    TENSIL_ERROR_DRIVER_TENSOR_NOT_CONTIGUOUS,
+    TENSIL_ERROR_DRIVER_TIMEOUT,
+    TENSIL_ERROR_DRIVER_INVALID_ARGUMENT
 };
 
 struct tensil_error {
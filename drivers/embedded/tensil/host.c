@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "host.h"
+
+#ifdef TENSIL_PLATFORM_HOST
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#define MAX_MAPPED_BUFFERS 8
+
+struct mapped_buffer {
+    size_t base;
+    size_t high;
+};
+
+static struct mapped_buffer mapped_buffers[MAX_MAPPED_BUFFERS];
+static size_t mapped_buffers_size = 0;
+
+int tensil_host_map_buffer(size_t base, size_t high) {
+    for (size_t i = 0; i < mapped_buffers_size; i++)
+        if (mapped_buffers[i].base == base && mapped_buffers[i].high == high)
+            return 0;
+
+    if (mapped_buffers_size == MAX_MAPPED_BUFFERS)
+        return ENOMEM;
+
+    void *ptr = mmap((void *)base, high - base, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                         MAP_FIXED_NOREPLACE,
+                     -1, 0);
+
+    if (ptr == MAP_FAILED)
+        return errno;
+
+    // Kernels before 4.17 treat the address as a hint
+    if ((size_t)ptr != base) {
+        munmap(ptr, high - base);
+        return EEXIST;
+    }
+
+    mapped_buffers[mapped_buffers_size].base = base;
+    mapped_buffers[mapped_buffers_size].high = high;
+    mapped_buffers_size++;
+
+    return 0;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+FRESULT f_stat(const char *path, FILINFO *fno) {
+    struct stat st;
+
+    if (stat(path, &st))
+        return errno;
+
+    fno->fsize = st.st_size;
+
+    return FR_OK;
+}
+
+FRESULT f_open(FIL *fp, const char *path, unsigned char mode) {
+    int flags = (mode & FA_WRITE) ? ((mode & FA_READ) ? O_RDWR : O_WRONLY)
+                                  : O_RDONLY;
+
+    if (mode & FA_CREATE_ALWAYS)
+        flags |= O_CREAT | O_TRUNC;
+
+    fp->fd = open(path, flags, 0644);
+
+    if (fp->fd < 0)
+        return errno;
+
+    return FR_OK;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+    *br = 0;
+
+    while (*br < btr) {
+        ssize_t n = read(fp->fd, (uint8_t *)buff + *br, btr - *br);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return errno;
+        }
+
+        if (n == 0)
+            break;
+
+        *br += n;
+    }
+
+    return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+    *bw = 0;
+
+    while (*bw < btw) {
+        ssize_t n = write(fp->fd, (const uint8_t *)buff + *bw, btw - *bw);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return errno;
+        }
+
+        *bw += n;
+    }
+
+    return FR_OK;
+}
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs) {
+    if (lseek(fp->fd, (off_t)ofs, SEEK_SET) < 0)
+        return errno;
+
+    return FR_OK;
+}
+
+FRESULT f_close(FIL *fp) {
+    if (close(fp->fd))
+        return errno;
+
+    return FR_OK;
+}
+
+FRESULT f_unlink(const char *path) {
+    if (unlink(path))
+        return errno;
+
+    return FR_OK;
+}
+
+#endif
+
+#endif
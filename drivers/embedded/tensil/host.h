@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include "platform.h"
+
+#ifdef TENSIL_PLATFORM_HOST
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Stand-ins for the subset of Xilinx standalone BSP used by the driver.
+
+typedef uintptr_t UINTPTR;
+
+#define XST_SUCCESS 0L
+#define XST_FAILURE 1L
+#define XST_DMA_ERROR 9L
+
+static inline void Xil_DCacheFlushRange(UINTPTR adr, size_t len) {
+    (void)adr;
+    (void)len;
+}
+
+static inline void Xil_DCacheInvalidateRange(UINTPTR adr, size_t len) {
+    (void)adr;
+    (void)len;
+}
+
+typedef uint64_t XTime;
+
+#define COUNTS_PER_SECOND 1000000000ULL
+
+static inline void XTime_GetTime(XTime *xtime) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    *xtime = (XTime)ts.tv_sec * COUNTS_PER_SECOND + (XTime)ts.tv_nsec;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Subset of FatFs API implemented with POSIX I/O. FRESULT carries errno.
+
+#define FF_MAX_LFN 255
+
+typedef int FRESULT;
+typedef unsigned int UINT;
+typedef size_t FSIZE_t;
+
+#define FR_OK 0
+
+#define FA_READ 0x01
+#define FA_WRITE 0x02
+#define FA_CREATE_ALWAYS 0x08
+
+typedef struct {
+    int fd;
+} FIL;
+
+typedef struct {
+    size_t fsize;
+} FILINFO;
+
+FRESULT f_stat(const char *path, FILINFO *fno);
+
+FRESULT f_open(FIL *fp, const char *path, unsigned char mode);
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+
+FRESULT f_close(FIL *fp);
+
+FRESULT f_unlink(const char *path);
+
+#endif
+
+// Maps anonymous memory at [base, high). Returns 0 or errno.
+int tensil_host_map_buffer(size_t base, size_t high);
+
+#endif
@@ -7,6 +7,62 @@
 
 #include "architecture.h"
 
+#include "../architecture_params.h"
+
+// Layout of the architecture in architecture_params.h computed by the
+// preprocessor the same way as in tensil_instruction_layout_init.
+#define LOG2_8(x)                                                              \
+    ((x) >= 0x80   ? 7                                                         \
+     : (x) >= 0x40 ? 6                                                         \
+     : (x) >= 0x20 ? 5                                                         \
+     : (x) >= 0x10 ? 4                                                         \
+     : (x) >= 0x8  ? 3                                                         \
+     : (x) >= 0x4  ? 2                                                         \
+     : (x) >= 0x2  ? 1                                                         \
+                   : 0)
+#define LOG2_16(x) ((x) >= 0x100 ? 8 + LOG2_8((x) >> 8) : LOG2_8(x))
+#define LOG2_32(x) ((x) >= 0x10000 ? 16 + LOG2_16((x) >> 16) : LOG2_16(x))
+
+#define MAX_BITS(x0, x1) ((x0) > (x1) ? (x0) : (x1))
+#define MIN_BITS(x0, x1) ((x0) < (x1) ? (x0) : (x1))
+
+#define LOCAL_OPERAND_SIZE_BITS LOG2_32(TENSIL_ARCHITECTURE_LOCAL_DEPTH)
+#define ACCUMULATOR_OPERAND_SIZE_BITS                                          \
+    LOG2_32(TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH)
+#define DRAM0_OPERAND_SIZE_BITS LOG2_32(TENSIL_ARCHITECTURE_DRAM0_DEPTH)
+#define DRAM1_OPERAND_SIZE_BITS LOG2_32(TENSIL_ARCHITECTURE_DRAM1_DEPTH)
+
+#define STRIDE0_SIZE_BITS LOG2_32(TENSIL_ARCHITECTURE_STRIDE0_DEPTH)
+#define STRIDE1_SIZE_BITS LOG2_32(TENSIL_ARCHITECTURE_STRIDE1_DEPTH)
+
+#define SIMD_INSTRUCTION_SIZE_BITS                                             \
+    (LOG2_32(TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH + 1) * 3 +               \
+     TENSIL_SIMD_OP_SIZE_BITS)
+
+#define OPERAND0_ADDRESS_SIZE_BITS                                             \
+    MAX_BITS(LOCAL_OPERAND_SIZE_BITS, ACCUMULATOR_OPERAND_SIZE_BITS)
+#define OPERAND1_ADDRESS_SIZE_BITS                                             \
+    MAX_BITS(MAX_BITS(LOCAL_OPERAND_SIZE_BITS, DRAM0_OPERAND_SIZE_BITS),       \
+             MAX_BITS(DRAM1_OPERAND_SIZE_BITS, ACCUMULATOR_OPERAND_SIZE_BITS))
+#define OPERAND2_SIZE_BITS                                                     \
+    MAX_BITS(                                                                  \
+        MAX_BITS(                                                              \
+            MIN_BITS(LOCAL_OPERAND_SIZE_BITS, ACCUMULATOR_OPERAND_SIZE_BITS),  \
+            MIN_BITS(LOCAL_OPERAND_SIZE_BITS, DRAM0_OPERAND_SIZE_BITS)),       \
+        MAX_BITS(MIN_BITS(LOCAL_OPERAND_SIZE_BITS, DRAM1_OPERAND_SIZE_BITS),   \
+                 SIMD_INSTRUCTION_SIZE_BITS))
+
+#define OPERAND0_SIZE_BYTES                                                    \
+    ((OPERAND0_ADDRESS_SIZE_BITS + STRIDE0_SIZE_BITS + 7) / 8)
+#define OPERAND1_SIZE_BYTES                                                    \
+    ((OPERAND1_ADDRESS_SIZE_BITS + STRIDE1_SIZE_BITS + 7) / 8)
+#define OPERAND2_SIZE_BYTES ((OPERAND2_SIZE_BITS + 7) / 8)
+#define OPERANDS_SIZE_BYTES                                                    \
+    (OPERAND0_SIZE_BYTES + OPERAND1_SIZE_BYTES + OPERAND2_SIZE_BYTES)
+
+#define MASK_BITS(size) (((uint64_t)1 << (size)) - 1)
+#define MASK_BYTES(size) ((((uint64_t)1 << ((size) * 8 - 1)) << 1) - 1)
+
 static void set_header(const struct tensil_instruction_layout *layout,
                        uint8_t *buffer, size_t offset, uint8_t opcode,
                        uint8_t flags) {
@@ -52,6 +108,42 @@ static void set_operand2(const struct tensil_instruction_layout *layout,
         buffer[operand2_offset + i] = (operand2 >> (i * 8)) & 0xff;
 }
 
+// Size is a compile-time constant, so the copy becomes a few word-sized
+// stores.
+static inline void store_bytes(uint8_t *ptr, uint64_t value, size_t size) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(ptr, &value, size);
+#else
+    for (size_t i = 0; i < size; i++)
+        ptr[i] = (value >> (i * 8)) & 0xff;
+#endif
+}
+
+static void set_specialized(uint8_t *buffer, size_t offset, uint8_t opcode,
+                            uint8_t flags, uint64_t operand0,
+                            uint64_t operand1, uint64_t operand2) {
+    uint8_t *ptr = buffer + offset;
+
+#if OPERANDS_SIZE_BYTES <= 8
+    // Operands are packed in a single word, bits of the last operand past
+    // its size are beyond the stored bytes
+    store_bytes(ptr,
+                (operand0 & MASK_BYTES(OPERAND0_SIZE_BYTES)) |
+                    ((operand1 & MASK_BYTES(OPERAND1_SIZE_BYTES))
+                     << (OPERAND0_SIZE_BYTES * 8)) |
+                    (operand2
+                     << ((OPERAND0_SIZE_BYTES + OPERAND1_SIZE_BYTES) * 8)),
+                OPERANDS_SIZE_BYTES);
+#else
+    store_bytes(ptr, operand0, OPERAND0_SIZE_BYTES);
+    store_bytes(ptr + OPERAND0_SIZE_BYTES, operand1, OPERAND1_SIZE_BYTES);
+    store_bytes(ptr + OPERAND0_SIZE_BYTES + OPERAND1_SIZE_BYTES, operand2,
+                OPERAND2_SIZE_BYTES);
+#endif
+
+    ptr[OPERANDS_SIZE_BYTES] = (opcode << 4) | flags;
+}
+
 static size_t log2_ceil(size_t x) {
     int y = 0;
 
@@ -97,10 +189,11 @@ void tensil_instruction_layout_init(struct tensil_instruction_layout *layout,
     layout->stride0_size_bits = log2_ceil(arch->stride0_depth);
     layout->stride1_size_bits = log2_ceil(arch->stride1_depth);
 
-    size_t simd_op_size_bits = log2_ceil(15);
-    size_t simd_operand_size_bits = log2_ceil(arch->simd_registers_depth + 1);
+    layout->simd_op_size_bits = TENSIL_SIMD_OP_SIZE_BITS;
+    layout->simd_operand_size_bits =
+        log2_ceil(arch->simd_registers_depth + 1);
     size_t simd_instruction_size_bits =
-        simd_operand_size_bits * 3 + simd_op_size_bits;
+        layout->simd_operand_size_bits * 3 + layout->simd_op_size_bits;
 
     layout->operand0_address_size_bits =
         max_size(local_operand_size_bits,      // MatMul, DataMove, LoadWeights
@@ -132,12 +225,27 @@ void tensil_instruction_layout_init(struct tensil_instruction_layout *layout,
     layout->instruction_size_bytes =
         layout->header_size_bytes + layout->operand0_size_bytes +
         layout->operand1_size_bytes + layout->operand2_size_bytes;
+
+    layout->is_specialized =
+        layout->operand0_size_bytes == OPERAND0_SIZE_BYTES &&
+        layout->operand1_size_bytes == OPERAND1_SIZE_BYTES &&
+        layout->operand2_size_bytes == OPERAND2_SIZE_BYTES &&
+        layout->operand0_address_size_bits == OPERAND0_ADDRESS_SIZE_BITS &&
+        layout->operand1_address_size_bits == OPERAND1_ADDRESS_SIZE_BITS &&
+        layout->stride0_size_bits == STRIDE0_SIZE_BITS &&
+        layout->stride1_size_bits == STRIDE1_SIZE_BITS;
 }
 
 void tensil_instruction_set(const struct tensil_instruction_layout *layout,
                             uint8_t *buffer, size_t offset, uint8_t opcode,
                             uint8_t flags, uint64_t operand0, uint64_t operand1,
                             uint64_t operand2) {
+    if (layout->is_specialized) {
+        set_specialized(buffer, offset, opcode, flags, operand0, operand1,
+                        operand2);
+        return;
+    }
+
     set_header(layout, buffer, offset, opcode, flags);
     set_operand0(layout, buffer, offset, operand0);
     set_operand1(layout, buffer, offset, operand1);
@@ -147,6 +255,14 @@ void tensil_instruction_set(const struct tensil_instruction_layout *layout,
 void tensil_instruction_set_all(const struct tensil_instruction_layout *layout,
                                 uint8_t *buffer, size_t offset, uint8_t opcode,
                                 uint8_t flags, uint64_t operands) {
+#if OPERANDS_SIZE_BYTES <= 8
+    if (layout->is_specialized) {
+        store_bytes(buffer + offset, operands, OPERANDS_SIZE_BYTES);
+        buffer[offset + OPERANDS_SIZE_BYTES] = (opcode << 4) | flags;
+        return;
+    }
+#endif
+
     set_header(layout, buffer, offset, opcode, flags);
     set_all_operands(layout, buffer, offset, operands);
 }
@@ -154,6 +270,11 @@ void tensil_instruction_set_all(const struct tensil_instruction_layout *layout,
 uint64_t
 tensil_instruction_make_operand0(const struct tensil_instruction_layout *layout,
                                  uint64_t offset, uint64_t stride) {
+    if (layout->is_specialized)
+        return ((stride & MASK_BITS(STRIDE0_SIZE_BITS))
+                << OPERAND0_ADDRESS_SIZE_BITS) |
+               (offset & MASK_BITS(OPERAND0_ADDRESS_SIZE_BITS));
+
     return ((stride & ((1 << layout->stride0_size_bits) - 1))
             << layout->operand0_address_size_bits) |
            (offset & ((1 << layout->operand0_address_size_bits) - 1));
@@ -162,7 +283,24 @@ tensil_instruction_make_operand0(const struct tensil_instruction_layout *layout,
 uint64_t
 tensil_instruction_make_operand1(const struct tensil_instruction_layout *layout,
                                  uint64_t offset, uint64_t stride) {
+    if (layout->is_specialized)
+        return ((stride & MASK_BITS(STRIDE1_SIZE_BITS))
+                << OPERAND1_ADDRESS_SIZE_BITS) |
+               (offset & MASK_BITS(OPERAND1_ADDRESS_SIZE_BITS));
+
     return ((stride & ((1 << layout->stride1_size_bits) - 1))
             << layout->operand1_address_size_bits) |
            (offset & ((1 << layout->operand1_address_size_bits) - 1));
 }
+
+uint64_t tensil_instruction_make_simd_operand2(
+    const struct tensil_instruction_layout *layout, uint8_t op,
+    uint64_t source_left, uint64_t source_right, uint64_t dest) {
+    size_t size_bits = layout->simd_operand_size_bits;
+    uint64_t mask = ((uint64_t)1 << size_bits) - 1;
+
+    return ((uint64_t)(op & ((1 << layout->simd_op_size_bits) - 1))
+            << (size_bits * 3)) |
+           ((source_left & mask) << (size_bits * 2)) |
+           ((source_right & mask) << size_bits) | (dest & mask);
+}
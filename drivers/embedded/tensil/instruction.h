@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -31,10 +32,27 @@
 #define TENSIL_SIMD_FLAG_WRITE 0b010
 #define TENSIL_SIMD_FLAG_ACC 0b100
 
+// SIMD operand2 holds destination, right source and left source registers
+// followed by the operation, which takes 4 bits for operations up to
+// TENSIL_SIMD_OPCODE_MAX as simdOpSizeBits in InstructionLayout.scala.
+#define TENSIL_SIMD_OP_SIZE_BITS 4
+
+#define TENSIL_SIMD_OPCODE_NOOP 0x0
+#define TENSIL_SIMD_OPCODE_ZERO 0x1
 #define TENSIL_SIMD_OPCODE_MOVE 0x2
+#define TENSIL_SIMD_OPCODE_NOT 0x3
+#define TENSIL_SIMD_OPCODE_AND 0x4
+#define TENSIL_SIMD_OPCODE_OR 0x5
+#define TENSIL_SIMD_OPCODE_INCREMENT 0x6
+#define TENSIL_SIMD_OPCODE_DECREMENT 0x7
 #define TENSIL_SIMD_OPCODE_ADD 0x8
+#define TENSIL_SIMD_OPCODE_SUB 0x9
 #define TENSIL_SIMD_OPCODE_MUL 0xa
-// TODO: add remaining SIMD opcodes
+#define TENSIL_SIMD_OPCODE_ABS 0xb
+#define TENSIL_SIMD_OPCODE_GT 0xc
+#define TENSIL_SIMD_OPCODE_GTE 0xd
+#define TENSIL_SIMD_OPCODE_MIN 0xe
+#define TENSIL_SIMD_OPCODE_MAX 0xf
 
 #define TENSIL_CONFIG_REGISTER_DRAM0_OFFSET 0x0
 #define TENSIL_CONFIG_REGISTER_DRAM1_OFFSET 0x4
@@ -55,6 +73,13 @@ struct tensil_instruction_layout {
     size_t stride1_size_bits;
     size_t operand0_address_size_bits;
     size_t operand1_address_size_bits;
+
+    size_t simd_op_size_bits;
+    size_t simd_operand_size_bits;
+
+    // Layout is the one of the architecture in architecture_params.h.
+    // Instructions are then encoded with field widths known at compile time.
+    bool is_specialized;
 };
 
 struct tensil_architecture;
@@ -77,4 +102,9 @@ tensil_instruction_make_operand0(const struct tensil_instruction_layout *layout,
 
 uint64_t
 tensil_instruction_make_operand1(const struct tensil_instruction_layout *layout,
-                                 uint64_t offset, uint64_t stride);
\ No newline at end of file
+                                 uint64_t offset, uint64_t stride);
+
+// Registers are numbered from 1, zero stands for the input or output.
+uint64_t tensil_instruction_make_simd_operand2(
+    const struct tensil_instruction_layout *layout, uint8_t op,
+    uint64_t source_left, uint64_t source_right, uint64_t dest);
\ No newline at end of file
@@ -5,42 +5,140 @@
 
 #include <string.h>
 
+#ifdef TENSIL_PLATFORM_HOST
+#include "host.h"
+#else
 #include "xil_cache.h"
 #include "xstatus.h"
+#endif
 
+#include "compression.h"
 #include "instruction.h"
 
-#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+#if defined(TENSIL_PLATFORM_ENABLE_FILE_SYSTEM) &&                             \
+    !defined(TENSIL_PLATFORM_HOST)
 #include "ff.h"
 #endif
 
-static tensil_error_t
-move_to_next_instruction(struct tensil_instruction_buffer *buffer,
-                         const struct tensil_instruction_layout *layout) {
-    if (layout->instruction_size_bytes > buffer->size - buffer->offset)
+static tensil_error_t reserve(struct tensil_instruction_buffer *buffer,
+                              size_t size) {
+    if (size > buffer->size - buffer->offset)
         return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
                                    "Program is too big");
 
-    buffer->offset += layout->instruction_size_bytes;
+    return TENSIL_ERROR_NONE;
+}
+
+void tensil_buffer_begin_batch(struct tensil_instruction_batch *batch,
+                               struct tensil_instruction_buffer *buffer,
+                               const struct tensil_instruction_layout *layout) {
+    batch->buffer = buffer;
+    batch->layout = layout;
+    batch->begin_offset = buffer->offset;
+}
+
+tensil_error_t
+tensil_batch_append_instruction(struct tensil_instruction_batch *batch,
+                                uint8_t opcode, uint8_t flags,
+                                uint64_t operand0, uint64_t operand1,
+                                uint64_t operand2) {
+    struct tensil_instruction_buffer *buffer = batch->buffer;
+    tensil_error_t error =
+        reserve(buffer, batch->layout->instruction_size_bytes);
+
+    if (error)
+        return error;
+
+    tensil_instruction_set(batch->layout, buffer->ptr, buffer->offset, opcode,
+                           flags, operand0, operand1, operand2);
+
+    buffer->offset += batch->layout->instruction_size_bytes;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t
+tensil_batch_append_config_instruction(struct tensil_instruction_batch *batch,
+                                       uint8_t reg, uint64_t value) {
+    struct tensil_instruction_buffer *buffer = batch->buffer;
+    tensil_error_t error =
+        reserve(buffer, batch->layout->instruction_size_bytes);
+
+    if (error)
+        return error;
+
+    // BUG: need to update documentation for config opcode to have special
+    // operand alignment
+    tensil_instruction_set_all(batch->layout, buffer->ptr, buffer->offset,
+                               TENSIL_OPCODE_CONFIG, 0, (value << 4) | reg);
+
+    buffer->offset += batch->layout->instruction_size_bytes;
 
     return TENSIL_ERROR_NONE;
 }
 
+tensil_error_t
+tensil_batch_append_noop_instructions(struct tensil_instruction_batch *batch,
+                                      size_t count) {
+    struct tensil_instruction_buffer *buffer = batch->buffer;
+    size_t size = count * batch->layout->instruction_size_bytes;
+    tensil_error_t error = reserve(buffer, size);
+
+    if (error)
+        return error;
+
+    memset(buffer->ptr + buffer->offset, 0, size);
+
+    buffer->offset += size;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t
+tensil_batch_pad_to_alignment(struct tensil_instruction_batch *batch,
+                              int alignment_bytes) {
+    size_t count = 0;
+    size_t offset = batch->buffer->offset;
+
+    // Padding longer than the alignment never reaches it
+    while ((offset & (alignment_bytes - 1)) &&
+           count < (size_t)alignment_bytes) {
+        offset += batch->layout->instruction_size_bytes;
+        count++;
+    }
+
+    if (offset & (alignment_bytes - 1))
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_INSTRUCTION,
+                                   "Instructions cannot be aligned to %d",
+                                   alignment_bytes);
+
+    return tensil_batch_append_noop_instructions(batch, count);
+}
+
+void tensil_batch_commit(struct tensil_instruction_batch *batch) {
+    struct tensil_instruction_buffer *buffer = batch->buffer;
+
+    if (buffer->offset > batch->begin_offset)
+        Xil_DCacheFlushRange((UINTPTR)buffer->ptr + batch->begin_offset,
+                             buffer->offset - batch->begin_offset);
+
+    batch->begin_offset = buffer->offset;
+}
+
 tensil_error_t tensil_buffer_append_instruction(
     struct tensil_instruction_buffer *buffer,
     const struct tensil_instruction_layout *layout, uint8_t opcode,
     uint8_t flags, uint64_t operand0, uint64_t operand1, uint64_t operand2) {
-    size_t curr_offset = buffer->offset;
-    tensil_error_t error = move_to_next_instruction(buffer, layout);
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, buffer, layout);
+
+    tensil_error_t error = tensil_batch_append_instruction(
+        &batch, opcode, flags, operand0, operand1, operand2);
 
     if (error)
         return error;
 
-    tensil_instruction_set(layout, buffer->ptr, curr_offset, opcode, flags,
-                           operand0, operand1, operand2);
-
-    Xil_DCacheFlushRange((UINTPTR)buffer->ptr + curr_offset,
-                         layout->instruction_size_bytes);
+    tensil_batch_commit(&batch);
 
     return TENSIL_ERROR_NONE;
 }
@@ -49,19 +147,16 @@ tensil_error_t tensil_buffer_append_config_instruction(
     struct tensil_instruction_buffer *buffer,
     const struct tensil_instruction_layout *layout, uint8_t reg,
     uint64_t value) {
-    size_t curr_offset = buffer->offset;
-    tensil_error_t error = move_to_next_instruction(buffer, layout);
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, buffer, layout);
+
+    tensil_error_t error =
+        tensil_batch_append_config_instruction(&batch, reg, value);
 
     if (error)
         return error;
 
-    // BUG: need to update documentation for config opcode to have special
-    // operand alignment
-    tensil_instruction_set_all(layout, buffer->ptr, curr_offset,
-                               TENSIL_OPCODE_CONFIG, 0, (value << 4) | reg);
-
-    Xil_DCacheFlushRange((UINTPTR)buffer->ptr + curr_offset,
-                         layout->instruction_size_bytes);
+    tensil_batch_commit(&batch);
 
     return TENSIL_ERROR_NONE;
 }
@@ -69,16 +164,15 @@ tensil_error_t tensil_buffer_append_config_instruction(
 tensil_error_t tensil_buffer_append_noop_instructions(
     struct tensil_instruction_buffer *buffer,
     const struct tensil_instruction_layout *layout, size_t count) {
-    size_t size = count * layout->instruction_size_bytes;
-    if (size > buffer->size - buffer->offset)
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
-                                   "Program is too big");
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, buffer, layout);
 
-    memset(buffer->ptr + buffer->offset, 0, size);
+    tensil_error_t error = tensil_batch_append_noop_instructions(&batch, count);
 
-    Xil_DCacheFlushRange((UINTPTR)buffer->ptr + buffer->offset, size);
+    if (error)
+        return error;
 
-    buffer->offset += size;
+    tensil_batch_commit(&batch);
 
     return TENSIL_ERROR_NONE;
 }
@@ -142,19 +236,68 @@ tensil_buffer_append_program_from_file(struct tensil_instruction_buffer *buffer,
     return TENSIL_ERROR_NONE;
 }
 
+tensil_error_t
+tensil_buffer_append_program_from_fil(struct tensil_instruction_buffer *buffer,
+                                      FIL *fil, size_t size) {
+    FRESULT res;
+    UINT bytes_read;
+
+    if (size > buffer->size - buffer->offset)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Program is too big");
+
+    res = f_read(fil, (void *)(buffer->ptr + buffer->offset), size,
+                 &bytes_read);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    if (bytes_read != size)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_PROGRAM_SIZE,
+                                   "Unexpected end of program");
+
+    Xil_DCacheFlushRange((UINTPTR)buffer->ptr + buffer->offset, size);
+
+    buffer->offset += size;
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_buffer_append_compressed_program_from_fil(
+    struct tensil_instruction_buffer *buffer, FIL *fil, size_t size) {
+    if (size > buffer->size - buffer->offset)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INSUFFICIENT_BUFFER,
+                                   "Program is too big");
+
+    tensil_error_t error = tensil_compression_read_from_fil(
+        fil, buffer->ptr + buffer->offset, size);
+
+    if (error)
+        return error;
+
+    Xil_DCacheFlushRange((UINTPTR)buffer->ptr + buffer->offset, size);
+
+    buffer->offset += size;
+
+    return TENSIL_ERROR_NONE;
+}
+
 #endif
 
 tensil_error_t
 tensil_buffer_pad_to_alignment(struct tensil_instruction_buffer *buffer,
                                const struct tensil_instruction_layout *layout,
                                int alignment_bytes) {
-    while (buffer->offset & (alignment_bytes - 1)) {
-        tensil_error_t error = tensil_buffer_append_instruction(
-            buffer, layout, TENSIL_OPCODE_NOOP, 0, 0, 0, 0);
+    struct tensil_instruction_batch batch;
+    tensil_buffer_begin_batch(&batch, buffer, layout);
+
+    tensil_error_t error =
+        tensil_batch_pad_to_alignment(&batch, alignment_bytes);
+
+    if (error)
+        return error;
+
+    tensil_batch_commit(&batch);
 
-        if (error)
-            return error;
-    }
     return TENSIL_ERROR_NONE;
 }
 
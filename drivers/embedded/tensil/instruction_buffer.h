@@ -16,6 +16,41 @@ struct tensil_instruction_buffer {
 
 struct tensil_instruction_layout;
 
+// Instructions appended to a batch are encoded in place without cache
+// maintenance. Committing the batch flushes everything appended since the
+// batch began as one range. If appending fails the batch is abandoned
+// without commit, same as the program it was building.
+struct tensil_instruction_batch {
+    struct tensil_instruction_buffer *buffer;
+    const struct tensil_instruction_layout *layout;
+    size_t begin_offset;
+};
+
+void tensil_buffer_begin_batch(struct tensil_instruction_batch *batch,
+                               struct tensil_instruction_buffer *buffer,
+                               const struct tensil_instruction_layout *layout);
+
+tensil_error_t
+tensil_batch_append_instruction(struct tensil_instruction_batch *batch,
+                                uint8_t opcode, uint8_t flags,
+                                uint64_t operand0, uint64_t operand1,
+                                uint64_t operand2);
+
+tensil_error_t
+tensil_batch_append_config_instruction(struct tensil_instruction_batch *batch,
+                                       uint8_t reg, uint64_t value);
+
+tensil_error_t
+tensil_batch_append_noop_instructions(struct tensil_instruction_batch *batch,
+                                      size_t count);
+
+// NoOps up to the alignment are written with a single memset.
+tensil_error_t
+tensil_batch_pad_to_alignment(struct tensil_instruction_batch *batch,
+                              int alignment_bytes);
+
+void tensil_batch_commit(struct tensil_instruction_batch *batch);
+
 tensil_error_t tensil_buffer_append_instruction(
     struct tensil_instruction_buffer *buffer,
     const struct tensil_instruction_layout *layout, uint8_t opcode,
@@ -40,6 +75,16 @@ tensil_error_t
 tensil_buffer_append_program_from_file(struct tensil_instruction_buffer *buffer,
                                        size_t size, const char *file_name);
 
+// Appends next size bytes of the program from already open file.
+tensil_error_t
+tensil_buffer_append_program_from_fil(struct tensil_instruction_buffer *buffer,
+                                      FIL *fil, size_t size);
+
+// Appends next size bytes of the program from compressed section of already
+// open file.
+tensil_error_t tensil_buffer_append_compressed_program_from_fil(
+    struct tensil_instruction_buffer *buffer, FIL *fil, size_t size);
+
 #endif
 
 tensil_error_t
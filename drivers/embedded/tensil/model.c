@@ -4,6 +4,7 @@
 #include "model.h"
 
 #include "config.h"
+#include "dram.h"
 #include <malloc.h>
 #include <string.h>
 
@@ -14,10 +15,205 @@
 
 #define JSMN_TOKEN_POOL_SIZE 256
 
-#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+#if defined(TENSIL_PLATFORM_ENABLE_FILE_SYSTEM) &&                             \
+    !defined(TENSIL_PLATFORM_HOST)
 #include "ff.h"
 #endif
 
+// Entries and strings of the model are placed in a single heap block sized
+// upfront. Strings are interned, so entries split by the compiler share the
+// name and bundle sections share the file name.
+struct model_arena {
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+};
+
+static tensil_error_t alloc_model(struct tensil_model *model,
+                                  struct model_arena *arena, size_t consts_size,
+                                  size_t inputs_size, size_t outputs_size,
+                                  size_t strings_capacity) {
+    size_t consts_bytes = consts_size * sizeof(struct tensil_consts_entry);
+    size_t entries_bytes =
+        (inputs_size + outputs_size) * sizeof(struct tensil_input_output_entry);
+    size_t tensors_bytes =
+        (inputs_size + outputs_size) * sizeof(struct tensil_tensor);
+    size_t fixed_bytes = consts_bytes + entries_bytes + tensors_bytes;
+    uint8_t *ptr = (uint8_t *)malloc(fixed_bytes + strings_capacity + 1);
+
+    if (!ptr)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    memset(ptr, 0, fixed_bytes);
+
+    model->arena = ptr;
+    model->consts = (struct tensil_consts_entry *)ptr;
+    model->consts_size = consts_size;
+    model->inputs = (struct tensil_input_output_entry *)(ptr + consts_bytes);
+    model->inputs_size = inputs_size;
+    model->outputs = model->inputs + inputs_size;
+    model->outputs_size = outputs_size;
+    model->input_tensors =
+        (struct tensil_tensor *)(ptr + consts_bytes + entries_bytes);
+    model->output_tensors = model->input_tensors + inputs_size;
+
+    // Empty string is always interned first
+    arena->strings = (char *)(ptr + fixed_bytes);
+    arena->strings[0] = 0;
+    arena->strings_size = 1;
+    arena->strings_capacity = strings_capacity + 1;
+
+    return TENSIL_ERROR_NONE;
+}
+
+static const char *intern_string(struct model_arena *arena, const char *str,
+                                 size_t length) {
+    char *ptr = arena->strings;
+
+    while (ptr < arena->strings + arena->strings_size) {
+        size_t interned_length = strlen(ptr);
+
+        if (interned_length == length && memcmp(ptr, str, length) == 0)
+            return ptr;
+
+        ptr += interned_length + 1;
+    }
+
+    // Capacity is computed upfront from the same strings
+    if (arena->strings_size + length + 1 > arena->strings_capacity)
+        return arena->strings;
+
+    memcpy(ptr, str, length);
+    ptr[length] = 0;
+    arena->strings_size += length + 1;
+
+    return ptr;
+}
+
+static void init_model_strings(struct tensil_model *model,
+                               struct model_arena *arena) {
+    for (size_t i = 0; i < model->inputs_size; i++)
+        model->inputs[i].name = arena->strings;
+
+    for (size_t i = 0; i < model->outputs_size; i++)
+        model->outputs[i].name = arena->strings;
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    for (size_t i = 0; i < model->consts_size; i++)
+        model->consts[i].file_name = arena->strings;
+
+    model->prog.file_name = arena->strings;
+    model->path = arena->strings;
+#endif
+}
+
+static void init_tensor_geometry(struct tensil_tensor *tensor,
+                                 const struct tensil_architecture *arch) {
+    tensor->vector_size_bytes =
+        arch->array_size * tensil_dram_sizeof_scalar(arch->data_type);
+    tensor->base = tensor->segments_size ? tensor->segments[0].base : 0;
+    tensor->offset_bytes = tensor->base * tensor->vector_size_bytes;
+    tensor->size_bytes = tensor->size * tensor->vector_size_bytes;
+    tensor->end_bytes = 0;
+
+    for (size_t i = 0; i < tensor->segments_size; i++) {
+        size_t segment_end_bytes =
+            (tensor->segments[i].base + tensor->segments[i].size) *
+            tensor->vector_size_bytes;
+
+        if (segment_end_bytes > tensor->end_bytes)
+            tensor->end_bytes = segment_end_bytes;
+    }
+}
+
+// Moves entries with the same interned name next to each other preserving
+// their order and describes each group as a tensor.
+static size_t group_tensors(struct tensil_input_output_entry *entries,
+                            size_t entries_size,
+                            const struct tensil_architecture *arch,
+                            struct tensil_tensor *tensors) {
+    size_t tensors_size = 0;
+    size_t grouped_size = 0;
+
+    while (grouped_size < entries_size) {
+        struct tensil_tensor *tensor = &tensors[tensors_size++];
+        size_t segments_end = grouped_size;
+
+        tensor->name = entries[grouped_size].name;
+        tensor->segments = &entries[grouped_size];
+        tensor->size = 0;
+
+        for (size_t i = grouped_size; i < entries_size; i++)
+            if (entries[i].name == tensor->name) {
+                struct tensil_input_output_entry entry = entries[i];
+
+                memmove(&entries[segments_end + 1], &entries[segments_end],
+                        (i - segments_end) *
+                            sizeof(struct tensil_input_output_entry));
+                entries[segments_end++] = entry;
+                tensor->size += entry.size;
+            }
+
+        tensor->segments_size = segments_end - grouped_size;
+        grouped_size = segments_end;
+
+        init_tensor_geometry(tensor, arch);
+    }
+
+    return tensors_size;
+}
+
+static void init_model_tensors(struct tensil_model *model) {
+    model->input_tensors_size =
+        group_tensors(model->inputs, model->inputs_size, &model->arch,
+                      model->input_tensors);
+    model->output_tensors_size =
+        group_tensors(model->outputs, model->outputs_size, &model->arch,
+                      model->output_tensors);
+}
+
+static const struct tensil_tensor *
+find_tensor(const struct tensil_tensor *tensors, size_t tensors_size,
+            const char *name) {
+    for (size_t i = 0; i < tensors_size; i++)
+        if (strcmp(tensors[i].name, name) == 0)
+            return &tensors[i];
+
+    return NULL;
+}
+
+tensil_error_t tensil_model_find_input(const struct tensil_model *model,
+                                       const char *name,
+                                       const struct tensil_tensor **tensor) {
+    *tensor =
+        find_tensor(model->input_tensors, model->input_tensors_size, name);
+
+    if (!*tensor)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_INPUT_NAME,
+                                   "Unexpected input name %s", name);
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_model_find_output(const struct tensil_model *model,
+                                        const char *name,
+                                        const struct tensil_tensor **tensor) {
+    *tensor =
+        find_tensor(model->output_tensors, model->output_tensors_size, name);
+
+    if (!*tensor)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_UNEXPECTED_OUTPUT_NAME,
+                                   "Unexpected output name %s", name);
+
+    return TENSIL_ERROR_NONE;
+}
+
+void tensil_model_free(struct tensil_model *model) {
+    free(model->arena);
+    memset(model, 0, sizeof(struct tensil_model));
+}
+
 static bool
 is_input_output_entry_valid(const struct tensil_input_output_entry *entry) {
     return (strlen(entry->name) > 0 && entry->size > 0);
@@ -58,79 +254,110 @@ bool tensil_model_is_valid(const struct tensil_model *model) {
 
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
 
-static void parse_prog(struct tensil_program *program, const cJSON *json) {
-    memset(program, 0, sizeof(struct tensil_program));
+static size_t measure_string(const cJSON *json, const char *name) {
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+
+    return cJSON_IsString(item) ? strlen(item->valuestring) + 1 : 0;
+}
+
+static size_t measure_entries_strings(const cJSON *json, const char *name) {
+    size_t size = 0;
+    const cJSON *item;
+
+    cJSON_ArrayForEach(item, json) size += measure_string(item, name);
+
+    return size;
+}
+
+static size_t get_array_size(const cJSON *json) {
+    return cJSON_IsArray(json) ? cJSON_GetArraySize(json) : 0;
+}
 
+static const char *parse_string(struct model_arena *arena, const cJSON *json,
+                                const char *name) {
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+
+    if (!cJSON_IsString(item))
+        return arena->strings;
+
+    return intern_string(arena, item->valuestring, strlen(item->valuestring));
+}
+
+static void parse_prog(struct tensil_program *program,
+                       struct model_arena *arena, const cJSON *json) {
     if (cJSON_IsObject(json)) {
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
-        tensil_config_parse_object_item_as_string(json, "file_name",
-                                                  program->file_name);
+        program->file_name = parse_string(arena, json, "file_name");
 #endif
         tensil_config_parse_object_item_as_size(json, "size", &program->size);
     }
 }
 
 static void parse_consts_entry(struct tensil_consts_entry *entry,
-                               const cJSON *json) {
-    memset(entry, 0, sizeof(struct tensil_consts_entry));
-
+                               struct model_arena *arena, const cJSON *json) {
     if (cJSON_IsObject(json)) {
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
-        tensil_config_parse_object_item_as_string(json, "file_name",
-                                                  entry->file_name);
+        entry->file_name = parse_string(arena, json, "file_name");
 #endif
         tensil_config_parse_object_item_as_size(json, "base", &entry->base);
         tensil_config_parse_object_item_as_size(json, "size", &entry->size);
     }
 }
 
-static void parse_consts(struct tensil_model *model, const cJSON *json) {
-    if (cJSON_IsArray(json) && cJSON_GetArraySize(json) <= TENSIL_MAX_CONSTS) {
-        model->consts_size = cJSON_GetArraySize(json);
-        for (size_t i = 0; i < TENSIL_MAX_CONSTS; i++)
-            parse_consts_entry(&model->consts[i], cJSON_GetArrayItem(json, i));
-    }
-}
-
 static void parse_input_output_entry(struct tensil_input_output_entry *entry,
+                                     struct model_arena *arena,
                                      const cJSON *json) {
-    memset(entry, 0, sizeof(struct tensil_input_output_entry));
-
     if (cJSON_IsObject(json)) {
-        tensil_config_parse_object_item_as_string(json, "name", entry->name);
+        entry->name = parse_string(arena, json, "name");
         tensil_config_parse_object_item_as_size(json, "base", &entry->base);
         tensil_config_parse_object_item_as_size(json, "size", &entry->size);
     }
 }
 
-static void parse_inputs(struct tensil_model *model, const cJSON *json) {
+// Allocates the model with strings capacity for the JSON strings and extra
+// strings of given size.
+static tensil_error_t parse_model(struct tensil_model *model,
+                                  struct model_arena *arena, const cJSON *json,
+                                  size_t extra_strings_size) {
+    memset((void *)model, 0, sizeof(struct tensil_model));
 
-    if (cJSON_IsArray(json) && cJSON_GetArraySize(json) <= TENSIL_MAX_INPUTS) {
-        model->inputs_size = cJSON_GetArraySize(json);
-        for (size_t i = 0; i < TENSIL_MAX_INPUTS; i++)
-            parse_input_output_entry(&model->inputs[i],
-                                     cJSON_GetArrayItem(json, i));
-    }
-}
+    const cJSON *prog = cJSON_GetObjectItemCaseSensitive(json, "prog");
+    const cJSON *consts = cJSON_GetObjectItemCaseSensitive(json, "consts");
+    const cJSON *inputs = cJSON_GetObjectItemCaseSensitive(json, "inputs");
+    const cJSON *outputs = cJSON_GetObjectItemCaseSensitive(json, "outputs");
 
-static void parse_outputs(struct tensil_model *model, const cJSON *json) {
-    if (cJSON_IsArray(json) && cJSON_GetArraySize(json) <= TENSIL_MAX_OUTPUTS) {
-        model->outputs_size = cJSON_GetArraySize(json);
-        for (size_t i = 0; i < TENSIL_MAX_OUTPUTS; i++)
-            parse_input_output_entry(&model->outputs[i],
-                                     cJSON_GetArrayItem(json, i));
-    }
-}
+    size_t strings_size = extra_strings_size +
+                          measure_entries_strings(inputs, "name") +
+                          measure_entries_strings(outputs, "name");
 
-void tensil_model_parse(struct tensil_model *model, const cJSON *json) {
-    memset((void *)model, 0, sizeof(struct tensil_model));
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+    strings_size += measure_string(prog, "file_name") +
+                    measure_entries_strings(consts, "file_name");
+#endif
+
+    tensil_error_t error = alloc_model(
+        model, arena, get_array_size(consts), get_array_size(inputs),
+        get_array_size(outputs), strings_size);
+
+    if (error)
+        return error;
+
+    init_model_strings(model, arena);
 
     if (cJSON_IsObject(json)) {
-        parse_prog(&model->prog,
-                   cJSON_GetObjectItemCaseSensitive(json, "prog"));
-        parse_consts(model, cJSON_GetObjectItemCaseSensitive(json, "consts"));
-        parse_inputs(model, cJSON_GetObjectItemCaseSensitive(json, "inputs"));
-        parse_outputs(model, cJSON_GetObjectItemCaseSensitive(json, "outputs"));
+        parse_prog(&model->prog, arena, prog);
+
+        for (size_t i = 0; i < model->consts_size; i++)
+            parse_consts_entry(&model->consts[i], arena,
+                               cJSON_GetArrayItem(consts, i));
+
+        for (size_t i = 0; i < model->inputs_size; i++)
+            parse_input_output_entry(&model->inputs[i], arena,
+                                     cJSON_GetArrayItem(inputs, i));
+
+        for (size_t i = 0; i < model->outputs_size; i++)
+            parse_input_output_entry(&model->outputs[i], arena,
+                                     cJSON_GetArrayItem(outputs, i));
 
         tensil_architecture_parse(
             &model->arch, cJSON_GetObjectItemCaseSensitive(json, "arch"));
@@ -138,6 +365,34 @@ void tensil_model_parse(struct tensil_model *model, const cJSON *json) {
         tensil_config_parse_object_item_as_bool(json, "load_consts_to_local",
                                                 &model->load_consts_to_local);
     }
+
+    init_model_tensors(model);
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_model_parse(struct tensil_model *model,
+                                  const cJSON *json) {
+    struct model_arena arena;
+
+    return parse_model(model, &arena, json, 0);
+}
+
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Interns the directory of the file as the model path and returns the base
+// name of the file.
+static const char *set_model_path(struct tensil_model *model,
+                                  struct model_arena *arena,
+                                  const char *file_name) {
+    const char *slash_ptr = strrchr(file_name, '/');
+    const char *base_name = slash_ptr ? slash_ptr + 1 : file_name;
+
+    model->path = intern_string(arena, file_name, base_name - file_name);
+
+    return base_name;
 }
 
 #endif
@@ -154,6 +409,9 @@ tensil_error_t tensil_model_from_file(struct tensil_model *model,
     tensil_error_t error = TENSIL_ERROR_NONE;
     char *buffer = NULL;
     cJSON *json = NULL;
+    struct model_arena arena;
+
+    memset(model, 0, sizeof(struct tensil_model));
 
     memset(&fno, 0, sizeof(FILINFO));
     res = f_stat(file_name, &fno);
@@ -181,32 +439,29 @@ tensil_error_t tensil_model_from_file(struct tensil_model *model,
 
     json = cJSON_ParseWithLength(buffer, fno.fsize);
 
-    if (json) {
-        tensil_model_parse(model, json);
-    } else {
+    if (!json) {
         error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_JSON,
                                     "Invalid JSON in %s", file_name);
         goto cleanup;
     }
 
+    error = parse_model(model, &arena, json, strlen(file_name) + 1);
+
+    if (error)
+        goto cleanup;
+
     if (!tensil_model_is_valid(model)) {
         error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
                                     "Invalid model in %s", file_name);
         goto cleanup;
     }
 
-    const char *file_name_ptr = file_name;
-    const char *file_name_slash_ptr = NULL;
-    size_t i = 0;
-    while ((file_name_slash_ptr = strchr(file_name_ptr, '/'))) {
-        while (file_name_ptr <= file_name_slash_ptr) {
-            model->path[i] = *file_name_ptr;
-            i++;
-            file_name_ptr++;
-        }
-    }
+    set_model_path(model, &arena, file_name);
 
 cleanup:
+    if (error)
+        tensil_model_free(model);
+
     cJSON_Delete(json);
     free(buffer);
 
@@ -214,3 +469,210 @@ cleanup:
 }
 
 #endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Bundle layout, see tools/src/tensil/tools/model/ModelBundle.scala. All
+// fields are little-endian 32-bit words.
+#define BUNDLE_MAGIC 0x444e4254 // "TBND"
+#define BUNDLE_VERSION 1
+#define BUNDLE_HEADER_SIZE 128
+#define BUNDLE_ENTRY_SIZE 64
+#define BUNDLE_ENTRY_NAME_SIZE 56
+#define BUNDLE_FLAG_LOAD_CONSTS_TO_LOCAL 0x1
+#define BUNDLE_FLAG_COMPRESSED 0x2
+
+// Entries, their tensors and names for which model arena size fits in half
+// of size_t
+#define BUNDLE_MAX_ENTRIES_SIZE                                                \
+    (SIZE_MAX / 2 /                                                            \
+     (BUNDLE_ENTRY_NAME_SIZE + sizeof(struct tensil_input_output_entry) +      \
+      sizeof(struct tensil_tensor)))
+
+enum bundle_header_word {
+    BUNDLE_WORD_MAGIC = 0,
+    BUNDLE_WORD_VERSION,
+    BUNDLE_WORD_FLAGS,
+    BUNDLE_WORD_INPUTS_SIZE,
+    BUNDLE_WORD_OUTPUTS_SIZE,
+    BUNDLE_WORD_CONSTS_BASE,
+    BUNDLE_WORD_CONSTS_SIZE,
+    BUNDLE_WORD_CONSTS_OFFSET,
+    BUNDLE_WORD_PROG_SIZE,
+    BUNDLE_WORD_PROG_OFFSET,
+    BUNDLE_WORD_DATA_TYPE = 16,
+    BUNDLE_WORD_ARRAY_SIZE,
+    BUNDLE_WORD_DRAM0_DEPTH,
+    BUNDLE_WORD_DRAM1_DEPTH,
+    BUNDLE_WORD_LOCAL_DEPTH,
+    BUNDLE_WORD_ACCUMULATOR_DEPTH,
+    BUNDLE_WORD_SIMD_REGISTERS_DEPTH,
+    BUNDLE_WORD_STRIDE0_DEPTH,
+    BUNDLE_WORD_STRIDE1_DEPTH
+};
+
+static size_t read_bundle_word(const uint8_t *ptr, size_t index) {
+    ptr += index * 4;
+
+    return (size_t)ptr[0] | ((size_t)ptr[1] << 8) | ((size_t)ptr[2] << 16) |
+           ((size_t)ptr[3] << 24);
+}
+
+static void parse_bundle_entry(struct tensil_input_output_entry *entry,
+                               struct model_arena *arena, const uint8_t *ptr) {
+    const uint8_t *name_end = memchr(ptr, 0, BUNDLE_ENTRY_NAME_SIZE - 1);
+
+    entry->name = intern_string(arena, (const char *)ptr,
+                                name_end ? name_end - ptr
+                                         : BUNDLE_ENTRY_NAME_SIZE - 1);
+    entry->base = read_bundle_word(ptr, BUNDLE_ENTRY_NAME_SIZE / 4);
+    entry->size = read_bundle_word(ptr, BUNDLE_ENTRY_NAME_SIZE / 4 + 1);
+}
+
+static void parse_bundle_header(struct tensil_model *model,
+                                const uint8_t *ptr) {
+    struct tensil_architecture *arch = &model->arch;
+
+    model->load_consts_to_local = read_bundle_word(ptr, BUNDLE_WORD_FLAGS) &
+                                  BUNDLE_FLAG_LOAD_CONSTS_TO_LOCAL;
+    model->is_compressed =
+        read_bundle_word(ptr, BUNDLE_WORD_FLAGS) & BUNDLE_FLAG_COMPRESSED;
+
+    model->consts[0].base = read_bundle_word(ptr, BUNDLE_WORD_CONSTS_BASE);
+    model->consts[0].size = read_bundle_word(ptr, BUNDLE_WORD_CONSTS_SIZE);
+    model->consts[0].file_offset =
+        read_bundle_word(ptr, BUNDLE_WORD_CONSTS_OFFSET);
+
+    model->prog.size = read_bundle_word(ptr, BUNDLE_WORD_PROG_SIZE);
+    model->prog.file_offset = read_bundle_word(ptr, BUNDLE_WORD_PROG_OFFSET);
+
+    arch->data_type = read_bundle_word(ptr, BUNDLE_WORD_DATA_TYPE) ==
+                              TENSIL_DATA_TYPE_FP16BP8
+                          ? TENSIL_DATA_TYPE_FP16BP8
+                          : TENSIL_DATA_TYPE_INVALID;
+    arch->array_size = read_bundle_word(ptr, BUNDLE_WORD_ARRAY_SIZE);
+    arch->dram0_depth = read_bundle_word(ptr, BUNDLE_WORD_DRAM0_DEPTH);
+    arch->dram1_depth = read_bundle_word(ptr, BUNDLE_WORD_DRAM1_DEPTH);
+    arch->local_depth = read_bundle_word(ptr, BUNDLE_WORD_LOCAL_DEPTH);
+    arch->accumulator_depth =
+        read_bundle_word(ptr, BUNDLE_WORD_ACCUMULATOR_DEPTH);
+    arch->simd_registers_depth =
+        read_bundle_word(ptr, BUNDLE_WORD_SIMD_REGISTERS_DEPTH);
+    arch->stride0_depth = read_bundle_word(ptr, BUNDLE_WORD_STRIDE0_DEPTH);
+    arch->stride1_depth = read_bundle_word(ptr, BUNDLE_WORD_STRIDE1_DEPTH);
+}
+
+tensil_error_t tensil_model_from_bundle_file(struct tensil_model *model,
+                                             const char *file_name) {
+    FIL fil;
+    FRESULT res;
+    UINT bytes_read;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    uint8_t header[BUNDLE_HEADER_SIZE];
+    uint8_t entry[BUNDLE_ENTRY_SIZE];
+    struct model_arena arena;
+    FILINFO fno;
+
+    memset(model, 0, sizeof(struct tensil_model));
+
+    res = f_stat(file_name, &fno);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_READ);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_read(&fil, (void *)header, BUNDLE_HEADER_SIZE, &bytes_read);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (bytes_read != BUNDLE_HEADER_SIZE ||
+        read_bundle_word(header, BUNDLE_WORD_MAGIC) != BUNDLE_MAGIC ||
+        read_bundle_word(header, BUNDLE_WORD_VERSION) != BUNDLE_VERSION) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                    "Invalid bundle header in %s", file_name);
+        goto cleanup;
+    }
+
+    size_t inputs_size = read_bundle_word(header, BUNDLE_WORD_INPUTS_SIZE);
+    size_t outputs_size = read_bundle_word(header, BUNDLE_WORD_OUTPUTS_SIZE);
+    size_t consts_offset = read_bundle_word(header, BUNDLE_WORD_CONSTS_OFFSET);
+    size_t max_entries_size = 0;
+
+    // I/O table lies between the header and the consts section within the
+    // file, which bounds entry counts before they size the model arena
+    if (consts_offset >= BUNDLE_HEADER_SIZE && consts_offset <= fno.fsize)
+        max_entries_size =
+            (consts_offset - BUNDLE_HEADER_SIZE) / BUNDLE_ENTRY_SIZE;
+
+    if (max_entries_size > BUNDLE_MAX_ENTRIES_SIZE)
+        max_entries_size = BUNDLE_MAX_ENTRIES_SIZE;
+
+    if (inputs_size > max_entries_size ||
+        outputs_size > max_entries_size - inputs_size) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                    "Invalid bundle I/O table in %s",
+                                    file_name);
+        goto cleanup;
+    }
+
+    // Entry names, model path and bundle base name
+    error = alloc_model(model, &arena, 1, inputs_size, outputs_size,
+                        (inputs_size + outputs_size) * BUNDLE_ENTRY_NAME_SIZE +
+                            strlen(file_name) + 2);
+
+    if (error)
+        goto cleanup;
+
+    init_model_strings(model, &arena);
+    parse_bundle_header(model, header);
+
+    for (size_t i = 0; i < model->inputs_size + model->outputs_size; i++) {
+        res = f_read(&fil, (void *)entry, BUNDLE_ENTRY_SIZE, &bytes_read);
+        if (res) {
+            error = TENSIL_FS_ERROR(res);
+            goto cleanup;
+        }
+
+        if (bytes_read != BUNDLE_ENTRY_SIZE) {
+            error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                        "Truncated bundle in %s", file_name);
+            goto cleanup;
+        }
+
+        if (i < model->inputs_size)
+            parse_bundle_entry(&model->inputs[i], &arena, entry);
+        else
+            parse_bundle_entry(&model->outputs[i - model->inputs_size], &arena,
+                               entry);
+    }
+
+    init_model_tensors(model);
+
+    const char *base_name = set_model_path(model, &arena, file_name);
+
+    model->prog.file_name =
+        intern_string(&arena, base_name, strlen(base_name));
+    model->consts[0].file_name = model->prog.file_name;
+    model->is_bundle = true;
+
+    if (!tensil_model_is_valid(model)) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                    "Invalid model in %s", file_name);
+        goto cleanup;
+    }
+
+cleanup:
+    if (error)
+        tensil_model_free(model);
+
+    f_close(&fil);
+
+    return error;
+}
+
+#endif
@@ -13,56 +13,110 @@
 #include "config.h"
 #include "error.h"
 
-#define TENSIL_MAX_CONSTS 1
-#define TENSIL_MAX_INPUTS 4
-#define TENSIL_MAX_OUTPUTS 4
-
 struct tensil_program {
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
-    char file_name[TENSIL_MAX_STRING_SIZE];
+    const char *file_name;
+    size_t file_offset;
 #endif
     size_t size;
 };
 
 struct tensil_consts_entry {
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
-    char file_name[TENSIL_MAX_STRING_SIZE];
+    const char *file_name;
+    size_t file_offset;
 #endif
     size_t base;
     size_t size;
 };
 
+// Compiler emits multiple entries with the same name for inputs and outputs
+// that are not contiguous in DRAM0.
 struct tensil_input_output_entry {
-    char name[TENSIL_MAX_STRING_SIZE];
+    const char *name;
     size_t base;
     size_t size;
 };
 
+// Input or output made of all entries with the same name in the order of
+// the tensor's vectors. Each entry is a contiguous segment in DRAM0.
+//
+// Tensors are resolved by name once with tensil_model_find_input or
+// tensil_model_find_output and passed to driver accessors as handles. Byte
+// offsets and sizes are precomputed from the model architecture.
+struct tensil_tensor {
+    const char *name;
+    const struct tensil_input_output_entry *segments;
+    size_t segments_size;
+    size_t size;
+
+    // Base of the first segment
+    size_t base;
+
+    size_t vector_size_bytes;
+    size_t offset_bytes;
+    size_t size_bytes;
+
+    // End of the segment furthest into DRAM0
+    size_t end_bytes;
+};
+
+// Entries are allocated together with interned names and file names in a
+// single heap block that is released by tensil_model_free.
 struct tensil_model {
-    struct tensil_consts_entry consts[TENSIL_MAX_CONSTS];
+    struct tensil_consts_entry *consts;
     size_t consts_size;
 
-    struct tensil_input_output_entry inputs[TENSIL_MAX_INPUTS];
+    struct tensil_input_output_entry *inputs;
     size_t inputs_size;
 
-    struct tensil_input_output_entry outputs[TENSIL_MAX_OUTPUTS];
+    struct tensil_input_output_entry *outputs;
     size_t outputs_size;
 
+    // Entries with the same name are grouped in inputs and outputs and
+    // described as one tensor
+    struct tensil_tensor *input_tensors;
+    size_t input_tensors_size;
+
+    struct tensil_tensor *output_tensors;
+    size_t output_tensors_size;
+
     struct tensil_program prog;
     struct tensil_architecture arch;
 
     bool load_consts_to_local;
 
 #ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
-    char path[FF_MAX_LFN];
+    const char *path;
+
+    // Consts and program are sections of a single .tbundle file at their
+    // file offsets rather than separate files.
+    bool is_bundle;
+
+    // Bundle sections are compressed, see compression.h
+    bool is_compressed;
 #endif
+
+    void *arena;
 };
 
 bool tensil_model_is_valid(const struct tensil_model *model);
 
+void tensil_model_free(struct tensil_model *model);
+
+// Tensor stays valid until the model is freed.
+tensil_error_t tensil_model_find_input(const struct tensil_model *model,
+                                       const char *name,
+                                       const struct tensil_tensor **tensor);
+
+tensil_error_t tensil_model_find_output(const struct tensil_model *model,
+                                        const char *name,
+                                        const struct tensil_tensor **tensor);
+
 #ifdef TENSIL_PLATFORM_ENABLE_STDIO
 
-void tensil_model_parse(struct tensil_model *model, const cJSON *json);
+tensil_error_t tensil_model_parse(struct tensil_model *model,
+                                  const cJSON *json);
 
 #endif
 
@@ -73,3 +127,13 @@ tensil_error_t tensil_model_from_file(struct tensil_model *model,
                                       const char *file_name);
 
 #endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Reads the header and I/O table of a .tbundle file emitted by the compiler
+// next to the .tmodel manifest with --write-bundle. Does not need a JSON
+// parser.
+tensil_error_t tensil_model_from_bundle_file(struct tensil_model *model,
+                                             const char *file_name);
+
+#endif
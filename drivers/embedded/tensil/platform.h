@@ -5,7 +5,10 @@
 
 #ifdef TENSIL_TARGET_ZCU104
 
+#include "xparameters.h"
+
 #define TENSIL_PLATFORM_DECODER_TIMEOUT 100
+#define TENSIL_PLATFORM_RUN_TIMEOUT_US 10000000
 #define TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE 1024
 
 #define TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
@@ -14,6 +17,13 @@
 #define TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID XPAR_AXIDMA_0_DEVICE_ID
 #define TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID XPAR_AXIDMA_1_DEVICE_ID
 
+// Completion interrupts need AXI DMA interrupts connected to the processing
+// system in the hardware design
+// #define TENSIL_PLATFORM_ENABLE_INTERRUPTS
+// #define TENSIL_PLATFORM_INTC_DEVICE_ID XPAR_SCUGIC_SINGLE_DEVICE_ID
+// #define TENSIL_PLATFORM_INSTRUCTION_IRQ_ID XPAR_FABRIC_AXIDMA_0_VEC_ID
+// #define TENSIL_PLATFORM_SAMPLE_IRQ_ID XPAR_FABRIC_AXIDMA_1_VEC_ID
+
 #define TENSIL_PLATFORM_PROG_BUFFER_BASE 0x10000000
 #define TENSIL_PLATFORM_PROG_BUFFER_HIGH 0x40000000
 
@@ -23,11 +33,21 @@
 #define TENSIL_PLATFORM_SAMPLE_BUFFER_BASE TENSIL_PLATFORM_DRAM_BUFFER_HIGH
 #define TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH 0x60000000
 
+// Scatter-gather mode is built when the instruction AXI DMA has the SG
+// engine in the hardware design, simple mode otherwise
+#if XPAR_AXIDMA_0_INCLUDE_SG
+#define TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE 0x60000000
+#define TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_HIGH 0x60010000
+#endif
+
 #endif
 
 #ifdef TENSIL_TARGET_ULTRA96_V2
 
+#include "xparameters.h"
+
 #define TENSIL_PLATFORM_DECODER_TIMEOUT 100
+#define TENSIL_PLATFORM_RUN_TIMEOUT_US 10000000
 #define TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE 1024
 
 #define TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
@@ -36,6 +56,13 @@
 #define TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID XPAR_AXIDMA_0_DEVICE_ID
 #define TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID XPAR_AXIDMA_1_DEVICE_ID
 
+// Completion interrupts need AXI DMA interrupts connected to the processing
+// system in the hardware design
+// #define TENSIL_PLATFORM_ENABLE_INTERRUPTS
+// #define TENSIL_PLATFORM_INTC_DEVICE_ID XPAR_SCUGIC_SINGLE_DEVICE_ID
+// #define TENSIL_PLATFORM_INSTRUCTION_IRQ_ID XPAR_FABRIC_AXIDMA_0_VEC_ID
+// #define TENSIL_PLATFORM_SAMPLE_IRQ_ID XPAR_FABRIC_AXIDMA_1_VEC_ID
+
 #define TENSIL_PLATFORM_PROG_BUFFER_BASE 0x10000000
 #define TENSIL_PLATFORM_PROG_BUFFER_HIGH 0x40000000
 
@@ -45,11 +72,21 @@
 #define TENSIL_PLATFORM_SAMPLE_BUFFER_BASE TENSIL_PLATFORM_DRAM_BUFFER_HIGH
 #define TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH 0x60000000
 
+// Scatter-gather mode is built when the instruction AXI DMA has the SG
+// engine in the hardware design, simple mode otherwise
+#if XPAR_AXIDMA_0_INCLUDE_SG
+#define TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE 0x60000000
+#define TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_HIGH 0x60010000
+#endif
+
 #endif
 
 #ifdef TENSIL_TARGET_PYNQ_Z1
 
+#include "xparameters.h"
+
 #define TENSIL_PLATFORM_DECODER_TIMEOUT 100
+#define TENSIL_PLATFORM_RUN_TIMEOUT_US 10000000
 #define TENSIL_PLATFORM_SAMPLE_BLOCK_SIZE 1024
 
 #define TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
@@ -60,6 +97,13 @@
 #define TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID XPAR_AXIDMA_1_DEVICE_ID
 #define TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID XPAR_AXIDMA_0_DEVICE_ID
 
+// Completion interrupts need AXI DMA interrupts connected to the processing
+// system in the hardware design
+// #define TENSIL_PLATFORM_ENABLE_INTERRUPTS
+// #define TENSIL_PLATFORM_INTC_DEVICE_ID XPAR_SCUGIC_SINGLE_DEVICE_ID
+// #define TENSIL_PLATFORM_INSTRUCTION_IRQ_ID XPAR_FABRIC_AXIDMA_1_VEC_ID
+// #define TENSIL_PLATFORM_SAMPLE_IRQ_ID XPAR_FABRIC_AXIDMA_0_VEC_ID
+
 #define TENSIL_PLATFORM_PROG_BUFFER_BASE 0x00400000
 #define TENSIL_PLATFORM_PROG_BUFFER_HIGH 0x08000000
 
@@ -69,6 +113,13 @@
 #define TENSIL_PLATFORM_SAMPLE_BUFFER_BASE TENSIL_PLATFORM_DRAM_BUFFER_HIGH
 #define TENSIL_PLATFORM_SAMPLE_BUFFER_HIGH 0x0fffffff
 
+// Scatter-gather mode is built when the instruction AXI DMA has the SG
+// engine in the hardware design, simple mode otherwise
+#if XPAR_AXIDMA_1_INCLUDE_SG
+#define TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE 0x10000000
+#define TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_HIGH 0x10010000
+#endif
+
 #endif
 
 #ifdef TENSIL_TARGET_ARTY_A7_100T
@@ -100,3 +151,24 @@
 #define TENSIL_PLATFORM_DRAM_BUFFER_HIGH 0x60080000
 
 #endif
+
+#ifdef TENSIL_TARGET_LINUX_HOST
+
+#define TENSIL_PLATFORM_HOST
+#define TENSIL_PLATFORM_EMULATOR
+
+#define TENSIL_PLATFORM_DECODER_TIMEOUT 100
+#define TENSIL_PLATFORM_RUN_TIMEOUT_US 10000000
+
+#define TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+#define TENSIL_PLATFORM_ENABLE_STDIO
+
+// On host the buffers are backed by anonymous mappings at fixed virtual
+// addresses, so that DRAM offset configuration works the same as on boards.
+#define TENSIL_PLATFORM_PROG_BUFFER_BASE 0x1000000000
+#define TENSIL_PLATFORM_PROG_BUFFER_HIGH 0x1040000000
+
+#define TENSIL_PLATFORM_DRAM_BUFFER_BASE TENSIL_PLATFORM_PROG_BUFFER_HIGH
+#define TENSIL_PLATFORM_DRAM_BUFFER_HIGH 0x1050000000
+
+#endif
@@ -0,0 +1,305 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "program_map.h"
+
+#include <malloc.h>
+#include <string.h>
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+#include <stdio.h>
+#endif
+
+#include "sample_buffer.h"
+
+// Map layout, see tools/src/tensil/tools/model/ProgramMap.scala. All fields
+// are little-endian 32-bit words.
+#define MAP_MAGIC 0x50414d54 // "TMAP"
+#define MAP_VERSION 1
+#define MAP_HEADER_SIZE 16
+#define MAP_LAYER_SIZE 12
+
+// Samples read from file at a time
+#define SAMPLES_CHUNK_SIZE 512
+
+enum map_header_word {
+    MAP_WORD_MAGIC = 0,
+    MAP_WORD_VERSION,
+    MAP_WORD_LAYERS_SIZE,
+    MAP_WORD_NAMES_SIZE
+};
+
+enum map_layer_word { MAP_WORD_BEGIN = 0, MAP_WORD_END, MAP_WORD_NAME_OFFSET };
+
+static uint32_t read_word(const uint8_t *ptr, size_t index) {
+    ptr += index * 4;
+
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+           ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+void tensil_program_map_free(struct tensil_program_map *map) {
+    free(map->arena);
+    memset(map, 0, sizeof(struct tensil_program_map));
+}
+
+const struct tensil_program_map_layer *
+tensil_program_map_find(const struct tensil_program_map *map,
+                        uint32_t program_counter) {
+    size_t low = 0;
+    size_t high = map->layers_size;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const struct tensil_program_map_layer *layer = &map->layers[middle];
+
+        if (program_counter < layer->begin)
+            high = middle;
+        else if (program_counter >= layer->end)
+            low = middle + 1;
+        else
+            return layer;
+    }
+
+    return NULL;
+}
+
+tensil_error_t tensil_layer_profile_init(struct tensil_layer_profile *profile,
+                                         const struct tensil_program_map *map) {
+    memset(profile, 0, sizeof(struct tensil_layer_profile));
+
+    profile->map = map;
+    profile->interval_cycles = TENSIL_SAMPLE_INTERVAL_CYCLES;
+    profile->counts = (struct tensil_layer_counts *)calloc(
+        map->layers_size + 1, sizeof(struct tensil_layer_counts));
+
+    if (!profile->counts)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    return TENSIL_ERROR_NONE;
+}
+
+void tensil_layer_profile_free(struct tensil_layer_profile *profile) {
+    free(profile->counts);
+    profile->counts = NULL;
+}
+
+void tensil_layer_profile_add(struct tensil_layer_profile *profile,
+                              uint32_t program_counter, uint16_t flags,
+                              uint32_t count) {
+    const struct tensil_program_map_layer *layer =
+        tensil_program_map_find(profile->map, program_counter);
+    struct tensil_layer_counts *counts =
+        layer ? &profile->counts[layer - profile->map->layers]
+              : &profile->unmapped_counts;
+
+    counts->samples_count += count;
+
+    if ((flags & TENSIL_SAMPLE_FLAG_INSTRUCTION_VALID) &&
+        !(flags & TENSIL_SAMPLE_FLAG_INSTRUCTION_READY))
+        counts->stalls_count += count;
+
+    tensil_bottleneck_counts_add(&counts->bottleneck, flags, count);
+}
+
+void tensil_layer_profile_fold(struct tensil_layer_profile *profile,
+                               const uint8_t *ptr, size_t size,
+                               uint32_t program_counter_shift) {
+    for (size_t i = 0; i < size / TENSIL_SAMPLE_SIZE_BYTES; i++) {
+        const uint8_t *sample_ptr = ptr + i * TENSIL_SAMPLE_SIZE_BYTES;
+        uint32_t program_counter = read_word(sample_ptr, 0);
+        uint16_t flags =
+            (uint16_t)sample_ptr[TENSIL_SAMPLE_FLAGS_OFFSET] |
+            ((uint16_t)sample_ptr[TENSIL_SAMPLE_FLAGS_OFFSET + 1] << 8);
+
+        // Driver instructions preceding the program are never mapped
+        if (program_counter < program_counter_shift)
+            program_counter = UINT32_MAX;
+        else
+            program_counter -= program_counter_shift;
+
+        tensil_layer_profile_add(profile, program_counter, flags, 1);
+    }
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+static void print_layer_counts(const struct tensil_layer_counts *counts,
+                               size_t total_count, uint32_t interval_cycles,
+                               const char *name) {
+    size_t share = total_count ? (size_t)counts->samples_count * 1000 /
+                                     total_count
+                               : 0;
+
+    printf("%10u %14llu %4u.%u%% %10u %-17s  %s\n",
+           (unsigned int)counts->samples_count,
+           (unsigned long long)counts->samples_count * interval_cycles,
+           (unsigned int)share / 10, (unsigned int)share % 10,
+           (unsigned int)counts->stalls_count,
+           tensil_bound_to_string(
+               tensil_bottleneck_classify(&counts->bottleneck)),
+           name);
+}
+
+void tensil_layer_profile_print(const struct tensil_layer_profile *profile) {
+    size_t total_count = profile->unmapped_counts.samples_count;
+
+    for (size_t i = 0; i < profile->map->layers_size; i++)
+        total_count += profile->counts[i].samples_count;
+
+    printf("Samples per layer ---------------------------------------\n");
+    printf("%10s %14s %7s %10s %-17s  %s\n", "Samples", "Cycles", "Share",
+           "Stalls", "Bound", "Layer");
+
+    for (size_t i = 0; i < profile->map->layers_size; i++)
+        print_layer_counts(&profile->counts[i], total_count,
+                           profile->interval_cycles,
+                           profile->map->layers[i].name);
+
+    print_layer_counts(&profile->unmapped_counts, total_count,
+                       profile->interval_cycles, "(unmapped)");
+}
+
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+tensil_error_t tensil_program_map_from_file(struct tensil_program_map *map,
+                                            const char *file_name) {
+    FIL fil;
+    FRESULT res;
+    UINT bytes_read;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    uint8_t header[MAP_HEADER_SIZE];
+    uint8_t *ptr = NULL;
+
+    memset(map, 0, sizeof(struct tensil_program_map));
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_READ);
+    if (res)
+        return TENSIL_FS_ERROR(res);
+
+    res = f_read(&fil, (void *)header, MAP_HEADER_SIZE, &bytes_read);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (bytes_read != MAP_HEADER_SIZE ||
+        read_word(header, MAP_WORD_MAGIC) != MAP_MAGIC ||
+        read_word(header, MAP_WORD_VERSION) != MAP_VERSION) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                    "Invalid program map header in %s",
+                                    file_name);
+        goto cleanup;
+    }
+
+    size_t layers_size = read_word(header, MAP_WORD_LAYERS_SIZE);
+    size_t names_size = read_word(header, MAP_WORD_NAMES_SIZE);
+    size_t layers_bytes = layers_size * sizeof(struct tensil_program_map_layer);
+    size_t entries_bytes = layers_size * MAP_LAYER_SIZE;
+
+    // Entries and names are read past the layers. Names stay in the arena
+    // and are terminated in case the file is not.
+    map->arena = malloc(layers_bytes + entries_bytes + names_size + 1);
+
+    if (!map->arena) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                    "Out of heap memory");
+        goto cleanup;
+    }
+
+    map->layers = (struct tensil_program_map_layer *)map->arena;
+    map->layers_size = layers_size;
+    ptr = (uint8_t *)map->arena + layers_bytes;
+
+    res = f_read(&fil, (void *)ptr, entries_bytes + names_size, &bytes_read);
+    if (res) {
+        error = TENSIL_FS_ERROR(res);
+        goto cleanup;
+    }
+
+    if (bytes_read != entries_bytes + names_size) {
+        error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                    "Truncated program map in %s", file_name);
+        goto cleanup;
+    }
+
+    char *names = (char *)ptr + entries_bytes;
+    names[names_size] = 0;
+
+    for (size_t i = 0; i < layers_size; i++) {
+        const uint8_t *entry = ptr + i * MAP_LAYER_SIZE;
+        size_t name_offset = read_word(entry, MAP_WORD_NAME_OFFSET);
+        struct tensil_program_map_layer layer;
+
+        layer.begin = read_word(entry, MAP_WORD_BEGIN);
+        layer.end = read_word(entry, MAP_WORD_END);
+        layer.name = names + (name_offset < names_size ? name_offset
+                                                       : names_size);
+
+        if (layer.begin > layer.end ||
+            (i && layer.begin < map->layers[i - 1].end)) {
+            error = TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_MODEL,
+                                        "Unsorted program map in %s",
+                                        file_name);
+            goto cleanup;
+        }
+
+        map->layers[i] = layer;
+    }
+
+cleanup:
+    if (error)
+        tensil_program_map_free(map);
+
+    f_close(&fil);
+
+    return error;
+}
+
+tensil_error_t
+tensil_layer_profile_fold_file(struct tensil_layer_profile *profile,
+                               const char *file_name,
+                               uint32_t program_counter_shift) {
+    FIL fil;
+    FRESULT res;
+    UINT bytes_read;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+    uint8_t *chunk =
+        (uint8_t *)malloc(SAMPLES_CHUNK_SIZE * TENSIL_SAMPLE_SIZE_BYTES);
+
+    if (!chunk)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_HEAP_MEMORY,
+                                   "Out of heap memory");
+
+    memset(&fil, 0, sizeof(FIL));
+    res = f_open(&fil, file_name, FA_READ);
+    if (res) {
+        free(chunk);
+        return TENSIL_FS_ERROR(res);
+    }
+
+    do {
+        res = f_read(&fil, (void *)chunk,
+                     SAMPLES_CHUNK_SIZE * TENSIL_SAMPLE_SIZE_BYTES,
+                     &bytes_read);
+        if (res) {
+            error = TENSIL_FS_ERROR(res);
+            goto cleanup;
+        }
+
+        tensil_layer_profile_fold(profile, chunk, bytes_read,
+                                  program_counter_shift);
+    } while (bytes_read == SAMPLES_CHUNK_SIZE * TENSIL_SAMPLE_SIZE_BYTES);
+
+cleanup:
+    f_close(&fil);
+    free(chunk);
+
+    return error;
+}
+
+#endif
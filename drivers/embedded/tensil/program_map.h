@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include "platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bottleneck.h"
+#include "error.h"
+
+// Model layer and the range of program counters of the instructions that
+// the compiler emitted for it. Program counters are counted from the start
+// of the program and the end is exclusive.
+struct tensil_program_map_layer {
+    const char *name;
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Layers are sorted by program counter and do not overlap. Layers are
+// allocated together with their names in a single heap block that is
+// released by tensil_program_map_free.
+struct tensil_program_map {
+    struct tensil_program_map_layer *layers;
+    size_t layers_size;
+
+    void *arena;
+};
+
+void tensil_program_map_free(struct tensil_program_map *map);
+
+// Returns the layer holding the program counter or NULL when there is none.
+const struct tensil_program_map_layer *
+tensil_program_map_find(const struct tensil_program_map *map,
+                        uint32_t program_counter);
+
+// Stalls are samples where the next instruction is valid but not yet
+// accepted, so the layer is held up by executing instructions rather than by
+// fetching them. Bottleneck counts break the samples down further by port.
+struct tensil_layer_counts {
+    uint32_t samples_count;
+    uint32_t stalls_count;
+    struct tensil_bottleneck_counts bottleneck;
+};
+
+// Counts of samples per layer of the program map. Samples of program
+// counters outside of all layers, such as driver instructions around the
+// program, are counted as unmapped.
+struct tensil_layer_profile {
+    const struct tensil_program_map *map;
+    struct tensil_layer_counts *counts;
+    struct tensil_layer_counts unmapped_counts;
+
+    // Interval the samples were taken at, TENSIL_SAMPLE_INTERVAL_CYCLES
+    // unless set otherwise after init
+    uint32_t interval_cycles;
+};
+
+tensil_error_t tensil_layer_profile_init(struct tensil_layer_profile *profile,
+                                         const struct tensil_program_map *map);
+
+void tensil_layer_profile_free(struct tensil_layer_profile *profile);
+
+void tensil_layer_profile_add(struct tensil_layer_profile *profile,
+                              uint32_t program_counter, uint16_t flags,
+                              uint32_t count);
+
+// Folds samples in the format described in sample_buffer.h. Program
+// counter shift is the program counter of the first program instruction.
+void tensil_layer_profile_fold(struct tensil_layer_profile *profile,
+                               const uint8_t *ptr, size_t size,
+                               uint32_t program_counter_shift);
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+// Prints samples, estimated cycles, stalls and bound per layer in program
+// order.
+void tensil_layer_profile_print(const struct tensil_layer_profile *profile);
+
+#endif
+
+#ifdef TENSIL_PLATFORM_ENABLE_FILE_SYSTEM
+
+// Reads the .tmap file the compiler emits next to the .tprog file.
+tensil_error_t tensil_program_map_from_file(struct tensil_program_map *map,
+                                            const char *file_name);
+
+// Folds samples saved by tensil_sample_buffer_to_file.
+tensil_error_t
+tensil_layer_profile_fold_file(struct tensil_layer_profile *profile,
+                               const char *file_name,
+                               uint32_t program_counter_shift);
+
+#endif
@@ -3,8 +3,6 @@
 
 #include "sample_buffer.h"
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-
 #include <malloc.h>
 #include <string.h>
 
@@ -12,7 +10,11 @@
 #include <stdio.h>
 #endif
 
+#ifdef TENSIL_PLATFORM_HOST
+#include "host.h"
+#else
 #include "xil_cache.h"
+#endif
 
 #include "instruction.h"
 #include "instruction_buffer.h"
@@ -25,6 +27,208 @@ void tensil_sample_buffer_reset(struct tensil_sample_buffer *sample_buffer) {
     sample_buffer->offset = 0;
 }
 
+void tensil_sample_buffer_set_aggregates(
+    struct tensil_sample_buffer *sample_buffer,
+    struct tensil_sample_aggregates *aggregates) {
+    sample_buffer->aggregates = aggregates;
+    sample_buffer->offset = 0;
+}
+
+void tensil_sample_aggregates_init(
+    struct tensil_sample_aggregates *aggregates,
+    const struct tensil_instruction_buffer *instruction_buffer,
+    const struct tensil_instruction_layout *layout,
+    uint32_t *program_counter_counts, size_t program_counter_counts_size) {
+    aggregates->instruction_buffer = instruction_buffer;
+    aggregates->layout = layout;
+    aggregates->program_counter_counts = program_counter_counts;
+    aggregates->program_counter_counts_size = program_counter_counts_size;
+
+    tensil_sample_aggregates_reset(aggregates);
+}
+
+void tensil_sample_aggregates_reset(
+    struct tensil_sample_aggregates *aggregates) {
+    memset(aggregates->program_counter_counts, 0,
+           aggregates->program_counter_counts_size * sizeof(uint32_t));
+    memset(aggregates->opcode_counts, 0,
+           TENSIL_SAMPLE_OPCODE_COUNTS_SIZE * sizeof(uint32_t));
+    memset(&aggregates->bottleneck, 0,
+           sizeof(struct tensil_bottleneck_counts));
+
+    aggregates->valid_samples_count = 0;
+    aggregates->invalid_samples_count = 0;
+    aggregates->blocks_count = 0;
+}
+
+void tensil_sample_aggregates_fold(struct tensil_sample_aggregates *aggregates,
+                                   const uint8_t *ptr, size_t size) {
+    const struct tensil_instruction_buffer *instruction_buffer =
+        aggregates->instruction_buffer;
+    size_t instruction_size_bytes = aggregates->layout->instruction_size_bytes;
+
+    Xil_DCacheFlushRange((UINTPTR)ptr, size);
+
+    for (size_t i = 0; i < size / TENSIL_SAMPLE_SIZE_BYTES; i++) {
+        const uint8_t *sample_ptr = ptr + i * TENSIL_SAMPLE_SIZE_BYTES;
+        uint32_t program_counter = *((uint32_t *)sample_ptr);
+        uint16_t flags =
+            *((uint16_t *)(sample_ptr + TENSIL_SAMPLE_FLAGS_OFFSET));
+        size_t instruction_offset =
+            (size_t)program_counter * instruction_size_bytes;
+
+        if (instruction_offset >= instruction_buffer->offset) {
+            aggregates->invalid_samples_count++;
+            continue;
+        }
+
+        const uint8_t *instruction_ptr =
+            instruction_buffer->ptr + instruction_offset;
+        uint8_t opcode = instruction_ptr[instruction_size_bytes - 1] >> 4;
+
+        aggregates->valid_samples_count++;
+        aggregates->opcode_counts[opcode]++;
+        tensil_bottleneck_counts_add(&aggregates->bottleneck, flags, 1);
+
+        if (program_counter < aggregates->program_counter_counts_size)
+            aggregates->program_counter_counts[program_counter]++;
+    }
+
+    aggregates->blocks_count++;
+}
+
+tensil_error_t
+tensil_sample_buffer_begin_block(struct tensil_sample_buffer *sample_buffer,
+                                 size_t size, uint8_t **ptr) {
+    // In ring mode the completed blocks are already folded into aggregates
+    if (size > sample_buffer->size - sample_buffer->offset &&
+        sample_buffer->aggregates)
+        sample_buffer->offset = 0;
+
+    if (size > sample_buffer->size - sample_buffer->offset)
+        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_SAMPLE_BUFFER,
+                                   "Out of sample buffer");
+
+    *ptr = sample_buffer->ptr + sample_buffer->offset;
+
+    return TENSIL_ERROR_NONE;
+}
+
+void tensil_sample_buffer_complete_block(
+    struct tensil_sample_buffer *sample_buffer, size_t size) {
+    if (sample_buffer->aggregates)
+        tensil_sample_aggregates_fold(sample_buffer->aggregates,
+                                      sample_buffer->ptr +
+                                          sample_buffer->offset,
+                                      size);
+
+    sample_buffer->offset += size;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+static const char *opcode_to_string(uint8_t opcode) {
+    switch (opcode) {
+    case TENSIL_OPCODE_NOOP:
+        return "NoOp";
+    case TENSIL_OPCODE_MAT_MUL:
+        return "MatMul";
+    case TENSIL_OPCODE_DATA_MOVE:
+        return "DataMove";
+    case TENSIL_OPCODE_LOAD_WEIGHT:
+        return "LoadWeight";
+    case TENSIL_OPCODE_SIMD:
+        return "SIMD";
+    case TENSIL_OPCODE_CONFIG:
+        return "Config";
+    default:
+        return "???";
+    }
+}
+
+// Program counters past the end of the instruction buffer are reported as
+// unknown opcode.
+static uint8_t get_opcode(const struct tensil_sample_aggregates *aggregates,
+                          size_t program_counter) {
+    size_t instruction_size_bytes = aggregates->layout->instruction_size_bytes;
+    size_t instruction_offset = program_counter * instruction_size_bytes;
+
+    if (instruction_offset >= aggregates->instruction_buffer->offset)
+        return TENSIL_SAMPLE_OPCODE_COUNTS_SIZE;
+
+    const uint8_t *instruction_ptr =
+        aggregates->instruction_buffer->ptr + instruction_offset;
+
+    return instruction_ptr[instruction_size_bytes - 1] >> 4;
+}
+
+// Driver instructions preceding the program have program counters below the
+// shift and are printed as preamble.
+static void print_program_counter(uint32_t program_counter,
+                                  uint32_t program_counter_shift) {
+    if (program_counter < program_counter_shift)
+        printf("[preamble] ");
+    else
+        printf("[%08u] ",
+               (unsigned int)(program_counter - program_counter_shift));
+}
+
+void tensil_sample_aggregates_print(
+    const struct tensil_sample_aggregates *aggregates, size_t top_size,
+    uint32_t program_counter_shift) {
+    const uint32_t *counts = aggregates->program_counter_counts;
+
+    printf("Folded %zu blocks with %zu valid and %zu invalid samples\n",
+           aggregates->blocks_count, aggregates->valid_samples_count,
+           aggregates->invalid_samples_count);
+
+    printf("Samples per opcode ---------------------------------------\n");
+    for (size_t i = 0; i < TENSIL_SAMPLE_OPCODE_COUNTS_SIZE; i++)
+        if (aggregates->opcode_counts[i])
+            printf("%s: %u\n", opcode_to_string(i),
+                   (unsigned int)aggregates->opcode_counts[i]);
+
+    printf("Top program counters ---------------------------------------\n");
+
+    // Selects counts in descending order and program counters in ascending
+    // order among equal counts, one pass per printed program counter.
+    uint32_t prev_count = 0;
+    size_t prev_program_counter = 0;
+
+    for (size_t k = 0; k < top_size; k++) {
+        uint32_t best_count = 0;
+        size_t best_program_counter = 0;
+
+        for (size_t i = 0; i < aggregates->program_counter_counts_size; i++) {
+            bool is_next =
+                k == 0 || counts[i] < prev_count ||
+                (counts[i] == prev_count && i > prev_program_counter);
+
+            if (is_next && counts[i] > best_count) {
+                best_count = counts[i];
+                best_program_counter = i;
+            }
+        }
+
+        if (!best_count)
+            break;
+
+        print_program_counter(best_program_counter, program_counter_shift);
+        printf("%s: %u\n",
+               opcode_to_string(get_opcode(aggregates, best_program_counter)),
+               (unsigned int)best_count);
+
+        prev_count = best_count;
+        prev_program_counter = best_program_counter;
+    }
+
+    tensil_bottleneck_counts_print(&aggregates->bottleneck);
+}
+
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+
 const uint8_t *tensil_sample_buffer_find_valid_samples_ptr(
     const struct tensil_sample_buffer *sample_buffer) {
     Xil_DCacheFlushRange((UINTPTR)sample_buffer->ptr, sample_buffer->offset);
@@ -125,25 +329,6 @@ static void print_flags_counts(const counter_t *flags_counts) {
     }
 }
 
-static const char *opcode_to_string(uint8_t opcode) {
-    switch (opcode) {
-    case TENSIL_OPCODE_NOOP:
-        return "NoOp";
-    case TENSIL_OPCODE_MAT_MUL:
-        return "MatMul";
-    case TENSIL_OPCODE_DATA_MOVE:
-        return "DataMove";
-    case TENSIL_OPCODE_LOAD_WEIGHT:
-        return "LoadWeight";
-    case TENSIL_OPCODE_SIMD:
-        return "SIMD";
-    case TENSIL_OPCODE_CONFIG:
-        return "Config";
-    default:
-        return "???";
-    }
-}
-
 tensil_error_t tensil_sample_buffer_print_analysis(
     const struct tensil_sample_buffer *sample_buffer,
     const struct tensil_instruction_buffer *instruction_buffer,
@@ -153,10 +338,14 @@ tensil_error_t tensil_sample_buffer_print_analysis(
 
     counter_t opcode_counts[OPCODE_COUNTS_SIZE];
 
+    struct tensil_bottleneck_counts opcode_bottlenecks[OPCODE_COUNTS_SIZE];
+
     memset(header_counts, 0, HEADER_COUNTS_SIZE * sizeof(counter_t));
 
     memset(opcode_counts, 0, OPCODE_COUNTS_SIZE * sizeof(counter_t));
 
+    memset(opcode_bottlenecks, 0, sizeof(opcode_bottlenecks));
+
     counter_t *matmul_flags_counts =
         (counter_t *)malloc(FLAGS_COUNTS_SIZE * sizeof(counter_t));
     counter_t *data_move_flags_counts =
@@ -197,6 +386,7 @@ tensil_error_t tensil_sample_buffer_print_analysis(
 
         header_counts[header]++;
         opcode_counts[opcode]++;
+        tensil_bottleneck_counts_add(&opcode_bottlenecks[opcode], flags, 1);
 
         switch (opcode) {
         case TENSIL_OPCODE_MAT_MUL:
@@ -219,9 +409,8 @@ tensil_error_t tensil_sample_buffer_print_analysis(
         }
 
         if (print_listing) {
-            printf("[%08u] %s: ",
-                   (unsigned int)program_counter - program_counter_shift,
-                   opcode_to_string(opcode));
+            print_program_counter(program_counter, program_counter_shift);
+            printf("%s: ", opcode_to_string(opcode));
             print_flags(flags);
             printf("\n");
         }
@@ -260,6 +449,25 @@ tensil_error_t tensil_sample_buffer_print_analysis(
         printf("Local->Accumulator(Acc): %u\n",
                header_counts[TENSIL_OPCODE_DATA_MOVE << 4 |
                              TENSIL_DATA_MOVE_FLAG_LOCAL_TO_ACC_WITH_ACC]);
+
+        struct tensil_bottleneck_counts bottleneck;
+
+        memset(&bottleneck, 0, sizeof(struct tensil_bottleneck_counts));
+
+        printf("Bound per opcode ---------------------------------------\n");
+        for (size_t i = 0; i < OPCODE_COUNTS_SIZE; i++) {
+            if (!opcode_counts[i])
+                continue;
+
+            printf("%-11s %s\n", opcode_to_string(i),
+                   tensil_bound_to_string(
+                       tensil_bottleneck_classify(&opcode_bottlenecks[i])));
+
+            tensil_bottleneck_counts_merge(&bottleneck,
+                                           &opcode_bottlenecks[i]);
+        }
+
+        tensil_bottleneck_counts_print(&bottleneck);
     }
 
     if (print_aggregates) {
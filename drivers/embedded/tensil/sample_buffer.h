@@ -5,28 +5,119 @@
 
 #include "platform.h"
 
-#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
-
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "bottleneck.h"
 #include "error.h"
 
-#define TENSIL_SAMPLE_SIZE_BYTES 8
+// Default interval, runs can override it with tensil_run_opts up to the
+// maximum the 16-bit interval register holds
 #define TENSIL_SAMPLE_INTERVAL_CYCLES 1000
+#define TENSIL_SAMPLE_MAX_INTERVAL_CYCLES 0xffff
+
+// Each sample holds the 32-bit program counter followed by 16-bit flags with
+// a valid and a ready bit for each port. The format does not depend on the
+// platform, so that samples saved on the board can be analyzed elsewhere.
+#define TENSIL_SAMPLE_SIZE_BYTES 8
+#define TENSIL_SAMPLE_FLAGS_OFFSET 4
+#define TENSIL_SAMPLE_FLAG_INSTRUCTION_VALID (1 << 14)
+#define TENSIL_SAMPLE_FLAG_INSTRUCTION_READY (1 << 15)
+
+// Program counter of the first program instruction, which is also its index
+// in the program buffer. Driver sets the sample interval and then the
+// program counter with config instructions that precede the program in the
+// buffer, and checks that their count matches.
+#define TENSIL_SAMPLE_PROGRAM_COUNTER_SHIFT 2
+
+#define TENSIL_SAMPLE_OPCODE_COUNTS_SIZE (1 << 4)
+
+struct tensil_instruction_buffer;
+struct tensil_instruction_layout;
+
+// Counters that completed sample blocks are folded into in ring mode.
+// Samples of program counters past the end of the counts are only counted
+// per opcode.
+//
+// Opcodes are looked up by program counter in the instruction buffer given
+// at init. Given the driver program view, lookup follows the loaded or the
+// active resident model, see tensil_driver. Aggregates do not follow the
+// program of a run otherwise: samples of a streamed program or of the
+// prologue and epilogue of a pipeline slot are charged to whatever
+// instruction the buffer holds at their program counter.
+struct tensil_sample_aggregates {
+    const struct tensil_instruction_buffer *instruction_buffer;
+    const struct tensil_instruction_layout *layout;
+
+    uint32_t *program_counter_counts;
+    size_t program_counter_counts_size;
+
+    uint32_t opcode_counts[TENSIL_SAMPLE_OPCODE_COUNTS_SIZE];
+
+    // Flags of valid samples
+    struct tensil_bottleneck_counts bottleneck;
+
+    size_t valid_samples_count;
+    size_t invalid_samples_count;
+    size_t blocks_count;
+};
+
+void tensil_sample_aggregates_init(
+    struct tensil_sample_aggregates *aggregates,
+    const struct tensil_instruction_buffer *instruction_buffer,
+    const struct tensil_instruction_layout *layout,
+    uint32_t *program_counter_counts, size_t program_counter_counts_size);
+
+void tensil_sample_aggregates_reset(
+    struct tensil_sample_aggregates *aggregates);
 
+void tensil_sample_aggregates_fold(struct tensil_sample_aggregates *aggregates,
+                                   const uint8_t *ptr, size_t size);
+
+// In linear mode samples are collected until the buffer is full. In ring
+// mode, when aggregates are set, the buffer only needs to hold a single
+// sample block. Blocks wrap around to the start of the buffer and are folded
+// into the aggregates as they complete, so that sampling never runs out of
+// the buffer. Aggregates accumulate across runs until reset.
 struct tensil_sample_buffer {
     uint8_t *ptr;
     size_t size;
     size_t offset;
-};
 
-struct tensil_instruction_buffer;
-struct tensil_instruction_layout;
+    struct tensil_sample_aggregates *aggregates;
+};
 
 void tensil_sample_buffer_reset(struct tensil_sample_buffer *sample_buffer);
 
+void tensil_sample_buffer_set_aggregates(
+    struct tensil_sample_buffer *sample_buffer,
+    struct tensil_sample_aggregates *aggregates);
+
+// Returns the pointer the next block of size bytes is transferred to. In
+// ring mode the block wraps around to the start of the buffer when it does
+// not fit past the offset.
+tensil_error_t
+tensil_sample_buffer_begin_block(struct tensil_sample_buffer *sample_buffer,
+                                 size_t size, uint8_t **ptr);
+
+// Advances the offset past size bytes transferred to the block and folds
+// them into aggregates in ring mode.
+void tensil_sample_buffer_complete_block(
+    struct tensil_sample_buffer *sample_buffer, size_t size);
+
+#ifdef TENSIL_PLATFORM_ENABLE_STDIO
+
+// Prints samples per opcode, the program counters with most samples and the
+// bottleneck report of the run.
+void tensil_sample_aggregates_print(
+    const struct tensil_sample_aggregates *aggregates, size_t top_size,
+    uint32_t program_counter_shift);
+
+#endif
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+
 const uint8_t *tensil_sample_buffer_find_valid_samples_ptr(
     const struct tensil_sample_buffer *sample_buffer);
 
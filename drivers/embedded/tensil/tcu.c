@@ -7,6 +7,11 @@
 #include "platform.h"
 #include "sample_buffer.h"
 
+#if defined(TENSIL_PLATFORM_ENABLE_INTERRUPTS) &&                              \
+    defined(TENSIL_PLATFORM_INTC_DEVICE_ID)
+#include "xil_exception.h"
+#endif
+
 #if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
     defined(TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID)
 
@@ -56,6 +61,160 @@ tensil_compute_unit_init_sampling(struct tensil_compute_unit *tcu,
 
 #ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
 
+#if defined(TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE) !=                     \
+    defined(TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_HIGH)
+#error "Scatter-gather mode needs both BD buffer base and high, see platform.h"
+#endif
+
+#if defined(TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE) &&                     \
+    defined(TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_HIGH)
+
+// Scatter-gather mode. Each call to start instructions queues descriptors
+// for the whole range, so that the DMA streams instructions without waiting
+// for the CPU between chunks of MaxTransferLen.
+
+static tensil_error_t init_instruction_bd_ring(XAxiDma *axi_dma) {
+    if (!XAxiDma_HasSg(axi_dma))
+        return TENSIL_DRIVER_ERROR(
+            TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+            "Instruction AXI DMA must have scatter-gather engine enabled");
+
+    XAxiDma_BdRing *ring = XAxiDma_GetTxRing(axi_dma);
+
+    int bd_count = XAxiDma_BdRingCntCalc(
+        XAXIDMA_BD_MINIMUM_ALIGNMENT,
+        TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_HIGH -
+            TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE);
+
+    int status = XAxiDma_BdRingCreate(
+        ring, TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE,
+        TENSIL_PLATFORM_INSTRUCTION_BD_BUFFER_BASE,
+        XAXIDMA_BD_MINIMUM_ALIGNMENT, bd_count);
+    if (status != XST_SUCCESS)
+        return TENSIL_XILINX_ERROR(status);
+
+    XAxiDma_Bd template_bd;
+    XAxiDma_BdClear(&template_bd);
+
+    status = XAxiDma_BdRingClone(ring, &template_bd);
+    if (status != XST_SUCCESS)
+        return TENSIL_XILINX_ERROR(status);
+
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t free_completed_bds(XAxiDma_BdRing *ring) {
+    XAxiDma_Bd *bd_ptr;
+    int bd_count = XAxiDma_BdRingFromHw(ring, XAXIDMA_ALL_BDS, &bd_ptr);
+
+    if (bd_count > 0) {
+        int status = XAxiDma_BdRingFree(ring, bd_count, bd_ptr);
+        if (status != XST_SUCCESS)
+            return TENSIL_XILINX_ERROR(status);
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+tensil_error_t tensil_compute_unit_init(struct tensil_compute_unit *tcu) {
+    tensil_error_t error =
+        init_axi_dma(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID,
+                     &tcu->instruction_axi_dma);
+
+    if (error)
+        return error;
+
+    return init_instruction_bd_ring(&tcu->instruction_axi_dma);
+}
+
+tensil_error_t tensil_compute_unit_start_instructions(
+    struct tensil_compute_unit *tcu,
+    const struct tensil_instruction_buffer *buffer, size_t *run_offset) {
+    XAxiDma_BdRing *ring = XAxiDma_GetTxRing(&tcu->instruction_axi_dma);
+    size_t max_transfer_size =
+        ring->MaxTransferLen & ~((size_t)ring->DataWidth - 1);
+
+    tensil_error_t error = free_completed_bds(ring);
+
+    if (error)
+        return error;
+
+    // When the range needs more descriptors than the ring has free, queue
+    // what fits and leave the rest for the next call.
+    size_t range_size = buffer->offset - *run_offset;
+    int bd_count =
+        (int)((range_size + max_transfer_size - 1) / max_transfer_size);
+
+    if (bd_count > XAxiDma_BdRingGetFreeCnt(ring))
+        bd_count = XAxiDma_BdRingGetFreeCnt(ring);
+
+    if (bd_count == 0)
+        return TENSIL_ERROR_NONE;
+
+    XAxiDma_Bd *first_bd_ptr;
+    int status = XAxiDma_BdRingAlloc(ring, bd_count, &first_bd_ptr);
+    if (status != XST_SUCCESS)
+        return TENSIL_XILINX_ERROR(status);
+
+    XAxiDma_Bd *bd_ptr = first_bd_ptr;
+    size_t transfer_offset = *run_offset;
+
+    for (int i = 0; i < bd_count; i++) {
+        size_t transfer_size = buffer->offset - transfer_offset;
+
+        if (transfer_size > max_transfer_size)
+            transfer_size = max_transfer_size;
+
+        status = XAxiDma_BdSetBufAddr(
+            bd_ptr, (UINTPTR)(buffer->ptr + transfer_offset));
+        if (status != XST_SUCCESS)
+            goto cleanup;
+
+        status = XAxiDma_BdSetLength(bd_ptr, transfer_size,
+                                     ring->MaxTransferLen);
+        if (status != XST_SUCCESS)
+            goto cleanup;
+
+        // Whole range is sent as a single packet
+        uint32_t control = 0;
+
+        if (i == 0)
+            control |= XAXIDMA_BD_CTRL_TXSOF_MASK;
+
+        if (i == bd_count - 1)
+            control |= XAXIDMA_BD_CTRL_TXEOF_MASK;
+
+        XAxiDma_BdSetCtrl(bd_ptr, control);
+        XAxiDma_BdSetId(bd_ptr, transfer_offset);
+
+        transfer_offset += transfer_size;
+        bd_ptr = (XAxiDma_Bd *)XAxiDma_BdRingNext(ring, bd_ptr);
+    }
+
+    status = XAxiDma_BdRingToHw(ring, bd_count, first_bd_ptr);
+    if (status != XST_SUCCESS)
+        goto cleanup;
+
+    if (ring->RunState != AXIDMA_CHANNEL_NOT_HALTED) {
+        status = XAxiDma_BdRingStart(ring);
+        if (status != XST_SUCCESS)
+            return TENSIL_XILINX_ERROR(status);
+    }
+
+    *run_offset = transfer_offset;
+
+    return TENSIL_ERROR_NONE;
+
+cleanup:
+    // Descriptors not handed to hardware go back to the free list, otherwise
+    // the ring runs out of them after a few failed calls.
+    XAxiDma_BdRingUnAlloc(ring, bd_count, first_bd_ptr);
+
+    return TENSIL_XILINX_ERROR(status);
+}
+
+#else
+
 tensil_error_t tensil_compute_unit_init(struct tensil_compute_unit *tcu) {
     tensil_error_t error =
         init_axi_dma(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID,
@@ -91,6 +250,8 @@ tensil_error_t tensil_compute_unit_start_instructions(
     return TENSIL_ERROR_NONE;
 }
 
+#endif
+
 bool tensil_compute_unit_is_instructions_busy(struct tensil_compute_unit *tcu) {
     return XAxiDma_Busy(&tcu->instruction_axi_dma, XAXIDMA_DMA_TO_DEVICE);
 }
@@ -102,17 +263,205 @@ int tensil_compute_unit_get_instructions_data_width_bytes(
 
 #endif
 
+#if defined(TENSIL_PLATFORM_ENABLE_INTERRUPTS) &&                              \
+    defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID)
+
+#define AXI_DMA_INTERRUPT_PRIORITY 0xa0
+#define AXI_DMA_INTERRUPT_RISING_EDGE 0x3
+
+static void handle_axi_dma_interrupt(XAxiDma *axi_dma, int direction,
+                                     tensil_compute_unit_handler_t handler,
+                                     void *context) {
+    uint32_t irq_status = XAxiDma_IntrGetIrq(axi_dma, direction);
+
+    XAxiDma_IntrAckIrq(axi_dma, irq_status, direction);
+
+    if (irq_status & (XAXIDMA_IRQ_IOC_MASK | XAXIDMA_IRQ_ERROR_MASK))
+        handler(context, (irq_status & XAXIDMA_IRQ_ERROR_MASK) != 0);
+}
+
+static void instructions_interrupt_handler(void *callback_ref) {
+    struct tensil_compute_unit *tcu =
+        (struct tensil_compute_unit *)callback_ref;
+
+    handle_axi_dma_interrupt(&tcu->instruction_axi_dma, XAXIDMA_DMA_TO_DEVICE,
+                             tcu->instructions_handler, tcu->handler_context);
+}
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+static void sample_interrupt_handler(void *callback_ref) {
+    struct tensil_compute_unit *tcu =
+        (struct tensil_compute_unit *)callback_ref;
+
+    handle_axi_dma_interrupt(&tcu->sample_axi_dma, XAXIDMA_DEVICE_TO_DMA,
+                             tcu->sample_handler, tcu->handler_context);
+}
+#endif
+
+#ifdef TENSIL_PLATFORM_INTC_DEVICE_ID
+static tensil_error_t connect_interrupt(XScuGic *intc, uint32_t irq_id,
+                                        Xil_InterruptHandler handler,
+                                        void *callback_ref) {
+    XScuGic_SetPriorityTriggerType(intc, irq_id, AXI_DMA_INTERRUPT_PRIORITY,
+                                   AXI_DMA_INTERRUPT_RISING_EDGE);
+
+    int status = XScuGic_Connect(intc, irq_id, handler, callback_ref);
+    if (status != XST_SUCCESS)
+        return TENSIL_XILINX_ERROR(status);
+
+    XScuGic_Enable(intc, irq_id);
+
+    return TENSIL_ERROR_NONE;
+}
+#endif
+
+tensil_error_t tensil_compute_unit_init_interrupts(
+    struct tensil_compute_unit *tcu,
+    tensil_compute_unit_handler_t instructions_handler,
+    tensil_compute_unit_handler_t sample_handler, void *context) {
+#if defined(TENSIL_PLATFORM_INTC_DEVICE_ID) &&                                 \
+    defined(TENSIL_PLATFORM_INSTRUCTION_IRQ_ID)
+    tcu->instructions_handler = instructions_handler;
+    tcu->sample_handler = sample_handler;
+    tcu->handler_context = context;
+
+    XScuGic_Config *config =
+        XScuGic_LookupConfig(TENSIL_PLATFORM_INTC_DEVICE_ID);
+    if (!config)
+        return TENSIL_DRIVER_ERROR(
+            TENSIL_ERROR_DRIVER_INTC_DEVICE_NOT_FOUND,
+            "Interrupt controller device %d not found",
+            TENSIL_PLATFORM_INTC_DEVICE_ID);
+
+    int status =
+        XScuGic_CfgInitialize(&tcu->intc, config, config->CpuBaseAddress);
+    if (status != XST_SUCCESS)
+        return TENSIL_XILINX_ERROR(status);
+
+    tensil_error_t error = connect_interrupt(
+        &tcu->intc, TENSIL_PLATFORM_INSTRUCTION_IRQ_ID,
+        instructions_interrupt_handler, tcu);
+
+    if (error)
+        return error;
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+#ifdef TENSIL_PLATFORM_SAMPLE_IRQ_ID
+    error = connect_interrupt(&tcu->intc, TENSIL_PLATFORM_SAMPLE_IRQ_ID,
+                              sample_interrupt_handler, tcu);
+
+    if (error)
+        return error;
+#else
+    return TENSIL_DRIVER_ERROR(
+        TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+        "Target must specify sample AXI DMA interrupt, see platform.h");
+#endif
+#endif
+
+    Xil_ExceptionInit();
+    Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_INT,
+                                 (Xil_ExceptionHandler)XScuGic_InterruptHandler,
+                                 &tcu->intc);
+    Xil_ExceptionEnable();
+
+    XAxiDma_IntrEnable(&tcu->instruction_axi_dma,
+                       XAXIDMA_IRQ_IOC_MASK | XAXIDMA_IRQ_ERROR_MASK,
+                       XAXIDMA_DMA_TO_DEVICE);
+
+#ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
+    XAxiDma_IntrEnable(&tcu->sample_axi_dma,
+                       XAXIDMA_IRQ_IOC_MASK | XAXIDMA_IRQ_ERROR_MASK,
+                       XAXIDMA_DEVICE_TO_DMA);
+#endif
+
+    return TENSIL_ERROR_NONE;
+#else
+    return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_INVALID_PLATFORM,
+                               "Target must specify interrupt controller and "
+                               "instruction AXI DMA interrupt, see platform.h");
+#endif
+}
+
+#endif
+
+#ifdef TENSIL_PLATFORM_EMULATOR
+
+#include "../architecture_params.h"
+
+tensil_error_t tensil_compute_unit_init(struct tensil_compute_unit *tcu) {
+    struct tensil_architecture arch = {
+        .array_size = TENSIL_ARCHITECTURE_ARRAY_SIZE,
+        .data_type = TENSIL_ARCHITECTURE_DATA_TYPE,
+        .local_depth = TENSIL_ARCHITECTURE_LOCAL_DEPTH,
+        .accumulator_depth = TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH,
+        .dram0_depth = TENSIL_ARCHITECTURE_DRAM0_DEPTH,
+        .dram1_depth = TENSIL_ARCHITECTURE_DRAM1_DEPTH,
+        .stride0_depth = TENSIL_ARCHITECTURE_STRIDE0_DEPTH,
+        .stride1_depth = TENSIL_ARCHITECTURE_STRIDE1_DEPTH,
+        .simd_registers_depth = TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH};
+
+    return tensil_emulator_init(&tcu->emulator, &arch);
+}
+
+tensil_error_t tensil_compute_unit_start_instructions(
+    struct tensil_compute_unit *tcu,
+    const struct tensil_instruction_buffer *buffer, size_t *run_offset) {
+    const uint8_t *run_ptr = buffer->ptr + *run_offset;
+    size_t run_size = buffer->offset - *run_offset;
+
+    (*run_offset) += run_size;
+
+    tensil_error_t error =
+        tensil_emulator_run(&tcu->emulator, run_ptr, run_size);
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+    // Emulator runs instructions synchronously, so the completion interrupt
+    // is delivered before returning.
+    if (!error && tcu->instructions_handler)
+        tcu->instructions_handler(tcu->handler_context, false);
+#endif
+
+    return error;
+}
+
+bool tensil_compute_unit_is_instructions_busy(struct tensil_compute_unit *tcu) {
+    return false;
+}
+
+int tensil_compute_unit_get_instructions_data_width_bytes(
+    struct tensil_compute_unit *tcu) {
+    return 1;
+}
+
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+tensil_error_t tensil_compute_unit_init_interrupts(
+    struct tensil_compute_unit *tcu,
+    tensil_compute_unit_handler_t instructions_handler,
+    tensil_compute_unit_handler_t sample_handler, void *context) {
+    tcu->instructions_handler = instructions_handler;
+    tcu->sample_handler = sample_handler;
+    tcu->handler_context = context;
+
+    return TENSIL_ERROR_NONE;
+}
+#endif
+
+#endif
+
 #ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
 
 tensil_error_t
 tensil_compute_unit_start_sampling(struct tensil_compute_unit *tcu,
                                    struct tensil_sample_buffer *buffer) {
-    uint8_t *transfer_ptr = buffer->ptr + buffer->offset;
     size_t transfer_size = tcu->sample_block_size * TENSIL_SAMPLE_SIZE_BYTES;
+    uint8_t *transfer_ptr;
 
-    if (transfer_size > buffer->size - buffer->offset)
-        return TENSIL_DRIVER_ERROR(TENSIL_ERROR_DRIVER_OUT_OF_SAMPLE_BUFFER,
-                                   "Out of sample buffer");
+    tensil_error_t error =
+        tensil_sample_buffer_begin_block(buffer, transfer_size, &transfer_ptr);
+
+    if (error)
+        return error;
 
     int status;
 
@@ -130,7 +479,7 @@ void tensil_compute_unit_complete_sampling(
     size_t transfered_size = XAxiDma_ReadReg(
         tcu->sample_axi_dma.RxBdRing[0].ChanBase, XAXIDMA_BUFFLEN_OFFSET);
 
-    buffer->offset += transfered_size;
+    tensil_sample_buffer_complete_block(buffer, transfered_size);
 }
 
 bool tensil_compute_unit_is_sample_busy(struct tensil_compute_unit *tcu) {
@@ -14,22 +14,50 @@
 #include "xaxidma.h"
 #endif
 
+#ifdef TENSIL_PLATFORM_EMULATOR
+#include "emulator.h"
+#endif
+
+#if defined(TENSIL_PLATFORM_ENABLE_INTERRUPTS) &&                              \
+    defined(TENSIL_PLATFORM_INTC_DEVICE_ID)
+#include "xscugic.h"
+#endif
+
 #include "error.h"
 
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+
+// Called from interrupt context when the DMA transfer completes or fails.
+typedef void (*tensil_compute_unit_handler_t)(void *context, bool is_error);
+
+#endif
+
 struct tensil_compute_unit {
 #ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
     XAxiDma instruction_axi_dma;
 #endif
+#ifdef TENSIL_PLATFORM_EMULATOR
+    struct tensil_emulator emulator;
+#endif
 #ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
     XAxiDma sample_axi_dma;
     size_t sample_block_size;
 #endif
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+#ifdef TENSIL_PLATFORM_INTC_DEVICE_ID
+    XScuGic intc;
+#endif
+    tensil_compute_unit_handler_t instructions_handler;
+    tensil_compute_unit_handler_t sample_handler;
+    void *handler_context;
+#endif
 };
 
 struct tensil_sample_buffer;
 struct tensil_instruction_buffer;
 
-#ifdef TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID
+#if defined(TENSIL_PLATFORM_INSTRUCTION_AXI_DMA_DEVICE_ID) ||                  \
+    defined(TENSIL_PLATFORM_EMULATOR)
 
 tensil_error_t tensil_compute_unit_init(struct tensil_compute_unit *tcu);
 
@@ -44,6 +72,17 @@ int tensil_compute_unit_get_instructions_data_width_bytes(
 
 #endif
 
+#ifdef TENSIL_PLATFORM_ENABLE_INTERRUPTS
+
+// Enables completion interrupts of instruction and sample DMA. Sample
+// handler is only called when sampling is enabled.
+tensil_error_t tensil_compute_unit_init_interrupts(
+    struct tensil_compute_unit *tcu,
+    tensil_compute_unit_handler_t instructions_handler,
+    tensil_compute_unit_handler_t sample_handler, void *context);
+
+#endif
+
 #ifdef TENSIL_PLATFORM_SAMPLE_AXI_DMA_DEVICE_ID
 
 tensil_error_t
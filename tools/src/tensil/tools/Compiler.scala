@@ -14,7 +14,15 @@ import tensil.{
   TableLine,
   InstructionLayout
 }
-import tensil.tools.model.{Model, Program, ConstsEntry, InputOutputEntry}
+import tensil.tools.model.{
+  Model,
+  ModelBundle,
+  Program,
+  ProgramMap,
+  ProgramMapLayer,
+  ConstsEntry,
+  InputOutputEntry
+}
 import tensil.tools.compiler.{
   Backend,
   Frontend,
@@ -67,7 +75,8 @@ case class CompilerResult(
     arch: Architecture,
     inputObjects: Seq[MemoryObject],
     outputObjects: Seq[MemoryObject],
-    stats: CompilerStats
+    stats: CompilerStats,
+    programMap: Seq[ProgramMapLayer] = Nil
 ) {}
 
 object CompilerSourceType {
@@ -125,6 +134,8 @@ object Compiler {
     val constsFilePath   = s"${prefix}${constsFileName}"
     val programFilePath  = s"${prefix}${programFileName}"
     val manifestFilePath = s"${prefix}${modelName}.tmodel"
+    val bundleFilePath   = s"${prefix}${modelName}.tbundle"
+    val mapFilePath      = s"${prefix}${modelName}.tmap"
     val graphFilePath =
       if (options.printGraph) Some(s"${prefix}${modelName}.dot") else None
     val programAssemblyFilePath =
@@ -179,12 +190,13 @@ object Compiler {
       entries.toSeq
     }
 
+    // Segments of each object stay in the order of its span, which is the
+    // order the driver reads and writes tensor vectors in.
     def objectsToEntries(objs: Seq[MemoryObject]) =
       objs
         .map(objectToEntries(_))
+        .sortBy(_.head.base)
         .flatten
-        .toArray
-        .sortBy(_.base)
         .toSeq
 
     val model = Model(
@@ -213,12 +225,35 @@ object Compiler {
     upickle.default.writeToOutputStream(model, manifestStream)
     manifestStream.close()
 
+    val bundleArtifacts =
+      if (options.writeBundle)
+        ModelBundle.unsupportedReason(model) match {
+          case Some(reason) =>
+            println(s"Warning: skipped model bundle, ${reason}")
+            Nil
+
+          case None =>
+            ModelBundle.write(
+              model,
+              constsFilePath,
+              programFilePath,
+              bundleFilePath,
+              options.compressBundle
+            )
+            Seq(CompilerArtifact("Bundle", bundleFilePath))
+        }
+      else Nil
+
+    ProgramMap.write(result.programMap, mapFilePath)
+
     CompilerArtifactsAndResult(
       result = result,
       artifacts = Seq(
         CompilerArtifact("Manifest", manifestFilePath),
         CompilerArtifact("Program", programFilePath),
         CompilerArtifact("Constants", constsFilePath)
+      ) ++ bundleArtifacts ++ Seq(
+        CompilerArtifact("Program map", mapFilePath)
       ) ++ (if (graphFilePath.isDefined)
               Seq(
                 CompilerArtifact(
@@ -293,6 +328,7 @@ object Compiler {
       InstructionLayout(options.arch)
 
     var layerSchedulerResults = mutable.ArrayBuffer.empty[SchedulerResult]
+    var layerNodeNames        = mutable.ArrayBuffer.empty[Seq[String]]
     var macs                  = 0L
     var macEfficiency         = 0f
     val backendStats          = new Stats()
@@ -488,6 +524,7 @@ object Compiler {
       if (r.numberOfStages != 0) {
         nextLayerIndex += 1
         layerSchedulerResults += r
+        layerNodeNames += frontend.nodeNames(emitter)
       }
     }
 
@@ -498,12 +535,28 @@ object Compiler {
 
     require(freeableAllocator.isEmpty)
 
-    backend.writeSegments(
+    val layerRanges = backend.writeSegments(
       programStream,
       programAssemblyFilePath,
       Some(backendStats)
     )
 
+    /**
+      * Layers are named after their first named node, which for fused
+      * layers is the convolution or matrix multiplication, and by index
+      * otherwise.
+      */
+    val programMap = layerRanges.map {
+      case (layer, begin, end) =>
+        ProgramMapLayer(
+          name = layerNodeNames(layer)
+            .find(!_.isEmpty)
+            .getOrElse(s"layer_${layer}"),
+          begin = begin,
+          end = end
+        )
+    }
+
     macs = layerSchedulerResults.map(_.macs).sum
     macEfficiency = Stats.macEfficiency(backendStats, options.arch, macs)
 
@@ -783,7 +836,8 @@ object Compiler {
       arch = options.arch,
       inputObjects = mmPass2.inputObjects,
       outputObjects = mmPass2.outputObjects,
-      stats = stats
+      stats = stats,
+      programMap = programMap
     )
   }
 }
@@ -29,6 +29,8 @@ case class CompilerOptions(
     printProgramWithComments: Boolean = false,
     printProgramAssembly: Boolean = false,
     printGraph: Boolean = false,
+    writeBundle: Boolean = false,
+    compressBundle: Boolean = false,
     tracepointConditions: Seq[TracepointCondition] = Nil,
     targetPath: Option[String] = None
 )
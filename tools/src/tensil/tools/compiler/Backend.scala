@@ -38,11 +38,13 @@ class Backend(
   def emitSegment(segment: BackendSegment): Unit =
     segments(segment.key) = segment
 
+  // Returns ranges of instructions emitted for each layer as tuples of
+  // layer index, begin and end (exclusive).
   def writeSegments(
       programStream: OutputStream,
       programAssemblyFilePath: Option[String] = None,
       stats: Option[Stats] = None
-  ): Unit = {
+  ): Seq[(Int, InstructionAddress, InstructionAddress)] = {
     var instructionOffset: Long = 0
     val writingLir = new lir.InstructionAddressInjector(
       new lir.Broadcast(
@@ -86,6 +88,7 @@ class Backend(
 
     case class ThreadedPartition(
         tid: Int,
+        layer: Option[Int] = None,
         init: Option[BackendSegment] = None,
         load: Option[BackendSegment] = None,
         compute: Option[BackendSegment] = None,
@@ -139,6 +142,7 @@ class Backend(
       case (segmentsByKind, i) =>
         ThreadedPartition(
           tid = i % layout.arch.numberOfThreads,
+          layer = segmentsByKind.values.headOption.map(_.key.layer),
           init = segmentsByKind.get(BackendSegmentKey.Init),
           load = segmentsByKind.get(BackendSegmentKey.Load),
           compute = segmentsByKind.get(BackendSegmentKey.Compute),
@@ -212,8 +216,34 @@ class Backend(
       parallelizer.emit(parsersByTid, writingLir)
     }
 
+    /**
+      * Padding between layers ensures that each window holds partitions
+      * of a single layer, so instructions emitted for the window are
+      * attributed to it. Ranges of consecutive windows of the same layer
+      * are merged.
+      */
+    val layerRanges =
+      mutable.ArrayBuffer.empty[(Int, InstructionAddress, InstructionAddress)]
+
     for (i <- 0 until partitions.size - (windowSize - 1)) {
-      parallelizePartitions(threadedPartitions.slice(i, i + windowSize))
+      val window = threadedPartitions.slice(i, i + windowSize)
+      val begin  = writingLir.instructionsCount
+
+      parallelizePartitions(window)
+
+      val end   = writingLir.instructionsCount
+      val layer = window.flatMap(_.layer).headOption
+
+      if (layer.isDefined && end > begin) {
+        if (
+          !layerRanges.isEmpty && layerRanges.last._1 == layer.get &&
+          layerRanges.last._3 == begin
+        )
+          layerRanges(layerRanges.size - 1) =
+            (layer.get, layerRanges.last._2, end)
+        else
+          layerRanges += ((layer.get, begin, end))
+      }
     }
 
     writingLir.endEmit()
@@ -222,6 +252,8 @@ class Backend(
 
     for (file <- filesToDelete)
       file.delete()
+
+    layerRanges.toSeq
   }
 
   def instructionsCount = segments.values.map(_.instructionsCount).sum
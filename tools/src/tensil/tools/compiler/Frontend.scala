@@ -3,12 +3,28 @@
 
 package tensil.tools.compiler
 
+import scala.collection.mutable
 import tensil.tools.data.Shape
 
 abstract class Frontend {
+  private val nodeNamesByEmitter = mutable.Map.empty[Emitter, Seq[String]]
+
   def traverse(outputNames: Seq[String]): Seq[String]
   def rewrite(program: Seq[String]): Seq[Emitter]
 
+  /**
+    * Names of the model nodes that were rewritten into the emitter, with
+    * the node that defines the layer first. Used to attribute the program
+    * emitted for the layer back to the model.
+    */
+  def nodeNames(emitter: Emitter): Seq[String] =
+    nodeNamesByEmitter.getOrElse(emitter, Nil)
+
+  protected def named(emitter: Emitter, nodeNames: Seq[String]): Emitter = {
+    nodeNamesByEmitter(emitter) = nodeNames
+    emitter
+  }
+
   def mkConstsDimensions(
       shape: Shape,
       groupSize: Option[Int],
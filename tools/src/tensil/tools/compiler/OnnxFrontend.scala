@@ -394,69 +394,49 @@ class OnnxFrontend(
           case "MatMul" | "Gemm" | "Conv" =>
             rewriteLayer(remainingProtos, nodeProto, emitters)
           case "Reshape" =>
-            rewriteSimple(remainingProtos, emitReshape(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitReshape, emitters)
           case "Flatten" =>
-            rewriteSimple(remainingProtos, emitFlatten(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitFlatten, emitters)
           case "Split" =>
-            rewriteSimple(remainingProtos, emitSplit(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitSplit, emitters)
           case "Concat" =>
-            rewriteSimple(remainingProtos, emitConcat(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitConcat, emitters)
           case "Resize" =>
-            rewriteSimple(
-              remainingProtos,
-              emitResize(_, nodeProto),
-              emitters
-            )
+            rewriteSimple(remainingProtos, nodeProto, emitResize, emitters)
           case "MaxPool" | "AveragePool" =>
-            rewriteSimple(remainingProtos, emitPool(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitPool, emitters)
           case "BatchNormalization" =>
-            rewriteSimple(remainingProtos, emitNorm(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitNorm, emitters)
           case "Relu" | "Softmax" | "LeakyRelu" | "Clip" =>
-            rewriteSimple(remainingProtos, emitActivate(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitActivate, emitters)
           case "Add" =>
-            rewriteSimple(remainingProtos, emitAdd(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitAdd, emitters)
           case "Sub" =>
-            rewriteSimple(remainingProtos, emitSub(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitSub, emitters)
           case "Mul" =>
-            rewriteSimple(remainingProtos, emitMul(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitMul, emitters)
           case "Transpose" =>
-            rewriteSimple(
-              remainingProtos,
-              emitTranspose(_, nodeProto),
-              emitters
-            )
+            rewriteSimple(remainingProtos, nodeProto, emitTranspose, emitters)
           case "Squeeze" =>
-            rewriteSimple(
-              remainingProtos,
-              emitSqueeze(_, nodeProto),
-              emitters
-            )
+            rewriteSimple(remainingProtos, nodeProto, emitSqueeze, emitters)
           case "Shape" =>
-            rewriteSimple(remainingProtos, emitShape(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitShape, emitters)
           case "Slice" =>
-            rewriteSimple(remainingProtos, emitSlice(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitSlice, emitters)
           case "Cast" =>
-            rewriteSimple(remainingProtos, emitCast(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitCast, emitters)
           case "Div" =>
-            rewriteSimple(remainingProtos, emitDiv(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitDiv, emitters)
           case "Pad" =>
-            rewriteSimple(remainingProtos, emitPad(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitPad, emitters)
           case "Constant" =>
-            rewriteSimple(remainingProtos, emitConstant(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitConstant, emitters)
           case "GlobalAveragePool" =>
-            rewriteSimple(
-              remainingProtos,
-              emitGlobalPool(_, nodeProto),
-              emitters
-            )
+            rewriteSimple(remainingProtos, nodeProto, emitGlobalPool, emitters)
           case "Gather" =>
-            rewriteSimple(remainingProtos, emitGather(_, nodeProto), emitters)
+            rewriteSimple(remainingProtos, nodeProto, emitGather, emitters)
           case "Unsqueeze" =>
-            rewriteSimple(
-              remainingProtos,
-              emitUnsqueeze(_, nodeProto),
-              emitters
-            )
+            rewriteSimple(remainingProtos, nodeProto, emitUnsqueeze, emitters)
           case op =>
             throw new CompilerException(
               s"Unsupported op ${op} (${nodeProto.name.get})"
@@ -505,12 +485,16 @@ class OnnxFrontend(
       val (poolProto :: activateProto :: normProto :: addProto :: nodeProto :: Nil) =
         Seq.fill[Option[NodeProto]](5 - layerProtos.size)(None) ++ layerProtos
 
-      val emitter = doRewriteLayer(
-        nodeProto.get,
-        addProto,
-        normProto,
-        activateProto,
-        poolProto
+      val emitter = named(
+        doRewriteLayer(
+          nodeProto.get,
+          addProto,
+          normProto,
+          activateProto,
+          poolProto
+        ),
+        Seq(nodeProto, addProto, normProto, activateProto, poolProto).flatten
+          .map(_.name.get)
       )
 
       recursiveRewrite(protos, emitter +: emitters)
@@ -549,10 +533,14 @@ class OnnxFrontend(
 
   private def rewriteSimple(
       protos: Seq[NodeProto],
-      emitter: Emitter,
+      nodeProto: NodeProto,
+      emit: (EmitContext, NodeProto) => Unit,
       emitters: Seq[Emitter]
   ): Seq[Emitter] =
-    recursiveRewrite(protos, emitter +: emitters)
+    recursiveRewrite(
+      protos,
+      named(emit(_, nodeProto), Seq(nodeProto.name.get)) +: emitters
+    )
 
   private def doRewriteLayer(
       nodeProto: NodeProto,
@@ -342,45 +342,41 @@ class TfFrontend(
           case "MatMul" | "Conv2D" =>
             rewriteLayer(remainingDefs, nodeDef, emitters)
           case "Const" =>
-            rewriteSimple(remainingDefs, emitConst(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitConst, emitters)
           case "Placeholder" =>
-            rewriteSimple(remainingDefs, emitPlaceholder(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitPlaceholder, emitters)
           case "Reshape" =>
-            rewriteSimple(remainingDefs, emitReshape(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitReshape, emitters)
           case "Shape" =>
-            rewriteSimple(remainingDefs, emitShape(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitShape, emitters)
           case "StridedSlice" =>
-            rewriteSimple(remainingDefs, emitStridedSlice(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitStridedSlice, emitters)
           case "Pack" =>
-            rewriteSimple(remainingDefs, emitPack(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitPack, emitters)
           case "Tile" =>
-            rewriteSimple(remainingDefs, emitTile(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitTile, emitters)
           case "Cast" =>
-            rewriteSimple(remainingDefs, emitCast(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitCast, emitters)
           case "Pad" =>
-            rewriteSimple(remainingDefs, emitPad(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitPad, emitters)
           case "Split" | "SplitV" =>
-            rewriteSimple(remainingDefs, emitSplit(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitSplit, emitters)
           case "ConcatV2" =>
-            rewriteSimple(remainingDefs, emitConcat(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitConcat, emitters)
           case "ResizeBilinear" =>
-            rewriteSimple(
-              remainingDefs,
-              emitResizeBilinear(_, nodeDef),
-              emitters
-            )
+            rewriteSimple(remainingDefs, nodeDef, emitResizeBilinear, emitters)
           case "MaxPool" | "AvgPool" =>
-            rewriteSimple(remainingDefs, emitPool(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitPool, emitters)
           case "FusedBatchNormV3" =>
-            rewriteSimple(remainingDefs, emitNorm(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitNorm, emitters)
           case "Relu" | "Softmax" | "LeakyRelu" =>
-            rewriteSimple(remainingDefs, emitActivate(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitActivate, emitters)
           case "AddV2" =>
-            rewriteSimple(remainingDefs, emitAdd(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitAdd, emitters)
           case "Mean" =>
-            rewriteSimple(remainingDefs, emitMean(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitMean, emitters)
           case "Identity" =>
-            rewriteSimple(remainingDefs, emitIdentity(_, nodeDef), emitters)
+            rewriteSimple(remainingDefs, nodeDef, emitIdentity, emitters)
           case op =>
             throw new CompilerException(
               s"Unsupported op ${op} (${nodeDef.name})"
@@ -430,13 +426,17 @@ class TfFrontend(
       val (poolDef :: activateDef :: normDef :: addDef :: biasDef :: nodeDef :: Nil) =
         Seq.fill[Option[NodeDef]](6 - layerDefs.size)(None) ++ layerDefs
 
-      val emitter = doRewriteLayer(
-        nodeDef.get,
-        biasDef,
-        addDef,
-        normDef,
-        activateDef,
-        poolDef
+      val emitter = named(
+        doRewriteLayer(
+          nodeDef.get,
+          biasDef,
+          addDef,
+          normDef,
+          activateDef,
+          poolDef
+        ),
+        Seq(nodeDef, biasDef, addDef, normDef, activateDef, poolDef).flatten
+          .map(_.name)
       )
 
       recursiveRewrite(defs, emitter +: emitters)
@@ -475,10 +475,14 @@ class TfFrontend(
 
   private def rewriteSimple(
       defs: Seq[NodeDef],
-      emitter: Emitter,
+      nodeDef: NodeDef,
+      emit: (EmitContext, NodeDef) => Unit,
       emitters: Seq[Emitter]
   ): Seq[Emitter] =
-    recursiveRewrite(defs, emitter +: emitters)
+    recursiveRewrite(
+      defs,
+      named(emit(_, nodeDef), Seq(nodeDef.name)) +: emitters
+    )
 
   private def doRewriteLayer(
       nodeDef: NodeDef,
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+package tensil.tools.model
+
+import java.io.ByteArrayOutputStream
+
+/**
+  * Greedy encoder for the LZ4 block format. Decoded by
+  * drivers/embedded/tensil/compression.c.
+  */
+object Lz4Block {
+  val MinMatch  = 4
+  val MaxOffset = 65535
+
+  // The format requires last 5 bytes to be literals and the last match to
+  // start at least 12 bytes before the end of the block.
+  private val LastLiterals   = 5
+  private val MatchStartSlop = 12
+
+  private val HashLog = 16
+
+  private def read32(src: Array[Byte], i: Int): Int =
+    (src(i) & 0xff) | ((src(i + 1) & 0xff) << 8) |
+      ((src(i + 2) & 0xff) << 16) | ((src(i + 3) & 0xff) << 24)
+
+  private def hash(value: Int): Int =
+    (value * -1640531535) >>> (32 - HashLog)
+
+  private def writeLength(out: ByteArrayOutputStream, length: Int): Unit = {
+    var remaining = length
+
+    while (remaining >= 255) {
+      out.write(255)
+      remaining -= 255
+    }
+
+    out.write(remaining)
+  }
+
+  private def writeLiterals(
+      out: ByteArrayOutputStream,
+      src: Array[Byte],
+      from: Int,
+      length: Int,
+      matchToken: Int
+  ): Unit = {
+    out.write((Math.min(length, 15) << 4) | matchToken)
+
+    if (length >= 15)
+      writeLength(out, length - 15)
+
+    out.write(src, from, length)
+  }
+
+  def compress(src: Array[Byte], from: Int, until: Int): Array[Byte] = {
+    val out        = new ByteArrayOutputStream()
+    val table      = Array.fill(1 << HashLog)(-1)
+    val matchLimit = until - MatchStartSlop
+    var anchor     = from
+    var i          = from
+
+    while (i < matchLimit) {
+      val h         = hash(read32(src, i))
+      val candidate = table(h)
+
+      table(h) = i
+
+      if (
+        candidate >= from && i - candidate <= MaxOffset &&
+        read32(src, candidate) == read32(src, i)
+      ) {
+        var length = MinMatch
+
+        while (
+          i + length < until - LastLiterals &&
+          src(candidate + length) == src(i + length)
+        )
+          length += 1
+
+        writeLiterals(
+          out,
+          src,
+          anchor,
+          i - anchor,
+          Math.min(length - MinMatch, 15)
+        )
+
+        out.write((i - candidate) & 0xff)
+        out.write((i - candidate) >> 8)
+
+        if (length - MinMatch >= 15)
+          writeLength(out, length - MinMatch - 15)
+
+        i += length
+        anchor = i
+      } else
+        i += 1
+    }
+
+    writeLiterals(out, src, anchor, until - anchor, 0)
+
+    out.toByteArray()
+  }
+}
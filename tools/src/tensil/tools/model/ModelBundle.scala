@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+package tensil.tools.model
+
+import java.io.{ByteArrayOutputStream, FileOutputStream}
+import java.nio.{ByteBuffer, ByteOrder}
+import java.nio.file.{Files, Paths}
+import java.nio.charset.StandardCharsets
+import tensil.ArchitectureDataType
+
+/**
+  * Single-file binary model bundle (.tbundle) read by the embedded driver
+  * without a JSON parser. All fields are little-endian 32-bit words.
+  *
+  *   [0, 128)     header: magic, version, flags, I/O table size, consts and
+  *                program section locations; architecture block at word 16
+  *   [128, ...)   I/O table: inputs followed by outputs, 64 bytes per entry
+  *                holding a NUL-padded name and base and size in vectors
+  *   consts       DRAM1 image, starts at a sector boundary
+  *   program      instruction stream, starts at a sector boundary
+  *
+  * With the compressed flag set both sections are sequences of blocks of up
+  * to BlockSize decoded bytes. Each block starts with its stored and decoded
+  * sizes. Block is LZ4 encoded when stored size is less than decoded size and
+  * is stored as is otherwise.
+  */
+object ModelBundle {
+  val Magic   = 0x444e4254 // "TBND"
+  val Version = 1
+
+  val HeaderSize     = 128
+  val EntrySize      = 64
+  val EntryNameSize  = 56
+  val SectorSize     = 512
+  val ArchWordOffset = 16
+
+  val FlagLoadConstsToLocal = 0x1
+  val FlagCompressed        = 0x2
+
+  val BlockSize = 1 << 16
+
+  private def dataTypeCode(dataType: ArchitectureDataType): Int =
+    dataType match {
+      case ArchitectureDataType.FP16BP8 => 1
+      case _                            => 0
+    }
+
+  private def alignToSector(offset: Long): Long =
+    (offset + SectorSize - 1) / SectorSize * SectorSize
+
+  private def putWord(buffer: ByteBuffer, value: Long): Unit = {
+    require(value >= 0 && value <= 0xffffffffL)
+    buffer.putInt(value.toInt)
+  }
+
+  private def compressSection(data: Array[Byte]): Array[Byte] = {
+    val out = new ByteArrayOutputStream()
+
+    for (from <- 0 until data.size by BlockSize) {
+      val until      = Math.min(from + BlockSize, data.size)
+      val compressed = Lz4Block.compress(data, from, until)
+      val isStored   = compressed.size >= until - from
+      val block = ByteBuffer
+        .allocate(8)
+        .order(ByteOrder.LITTLE_ENDIAN)
+
+      putWord(block, if (isStored) until - from else compressed.size)
+      putWord(block, until - from)
+      out.write(block.array())
+
+      if (isStored)
+        out.write(data, from, until - from)
+      else
+        out.write(compressed)
+    }
+
+    out.toByteArray()
+  }
+
+  private def readSection(filePath: String, compress: Boolean): Array[Byte] = {
+    val data = Files.readAllBytes(Paths.get(filePath))
+
+    if (compress) compressSection(data) else data
+  }
+
+  /**
+    * Returns why the model cannot be written as a bundle or None when it
+    * can. The bundle holds a single consts entry and names shorter than
+    * EntryNameSize bytes.
+    */
+  def unsupportedReason(model: Model): Option[String] =
+    if (model.consts.size != 1)
+      Some(s"model has ${model.consts.size} consts entries, expected 1")
+    else
+      (model.inputs ++ model.outputs)
+        .find(_.name.getBytes(StandardCharsets.UTF_8).size >= EntryNameSize)
+        .map(entry =>
+          s"name ${entry.name} is longer than ${EntryNameSize - 1} bytes"
+        )
+
+  def write(
+      model: Model,
+      constsFilePath: String,
+      programFilePath: String,
+      bundleFilePath: String,
+      compress: Boolean = false
+  ): Unit = {
+    require(model.consts.size == 1)
+
+    val consts  = readSection(constsFilePath, compress)
+    val program = readSection(programFilePath, compress)
+
+    val entries     = model.inputs ++ model.outputs
+    val tableSize   = HeaderSize + entries.size * EntrySize
+    val constsStart = alignToSector(tableSize)
+    val progStart   = alignToSector(constsStart + consts.size)
+
+    val header = ByteBuffer
+      .allocate(tableSize)
+      .order(ByteOrder.LITTLE_ENDIAN)
+
+    putWord(header, Magic)
+    putWord(header, Version)
+    putWord(
+      header,
+      (if (model.loadConstsToLocal) FlagLoadConstsToLocal else 0) |
+        (if (compress) FlagCompressed else 0)
+    )
+    putWord(header, model.inputs.size)
+    putWord(header, model.outputs.size)
+    putWord(header, model.consts.head.base)
+    putWord(header, model.consts.head.size)
+    putWord(header, constsStart)
+    putWord(header, model.program.size)
+    putWord(header, progStart)
+
+    header.position(ArchWordOffset * 4)
+    putWord(header, dataTypeCode(model.arch.dataType))
+    putWord(header, model.arch.arraySize)
+    putWord(header, model.arch.dram0Depth)
+    putWord(header, model.arch.dram1Depth)
+    putWord(header, model.arch.localDepth)
+    putWord(header, model.arch.accumulatorDepth)
+    putWord(header, model.arch.simdRegistersDepth)
+    putWord(header, model.arch.stride0Depth)
+    putWord(header, model.arch.stride1Depth)
+
+    for ((entry, i) <- entries.zipWithIndex) {
+      val name = entry.name.getBytes(StandardCharsets.UTF_8)
+
+      require(
+        name.size < EntryNameSize,
+        s"Name ${entry.name} is too long for model bundle"
+      )
+
+      header.position(HeaderSize + i * EntrySize)
+      header.put(name)
+      header.position(HeaderSize + i * EntrySize + EntryNameSize)
+      putWord(header, entry.base)
+      putWord(header, entry.size)
+    }
+
+    val stream = new FileOutputStream(bundleFilePath)
+
+    def pad(from: Long, to: Long): Unit =
+      stream.write(new Array[Byte]((to - from).toInt))
+
+    stream.write(header.array())
+    pad(tableSize, constsStart)
+    stream.write(consts)
+    pad(constsStart + consts.size, progStart)
+    stream.write(program)
+    stream.close()
+  }
+}
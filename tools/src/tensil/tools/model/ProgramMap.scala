@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+package tensil.tools.model
+
+import java.io.FileOutputStream
+import java.nio.{ByteBuffer, ByteOrder}
+import java.nio.charset.StandardCharsets
+
+case class ProgramMapLayer(
+    name: String,
+    begin: Long,
+    end: Long
+) {}
+
+/**
+  * Program map (.tmap) emitted next to the program for the embedded driver
+  * to attribute sampled program counters to model layers. All fields are
+  * little-endian 32-bit words.
+  *
+  *   [0, 16)      header: magic, version, number of layers and size of names
+  *   [16, ...)    layers: begin and end instruction (exclusive) counted from
+  *                the start of the program and offset of the name, 12 bytes
+  *                per layer, sorted by begin
+  *   names        NUL-terminated layer names
+  */
+object ProgramMap {
+  val Magic   = 0x50414d54 // "TMAP"
+  val Version = 1
+
+  val HeaderSize = 16
+  val LayerSize  = 12
+
+  private def putWord(buffer: ByteBuffer, value: Long): Unit = {
+    require(value >= 0 && value <= 0xffffffffL)
+    buffer.putInt(value.toInt)
+  }
+
+  def write(layers: Seq[ProgramMapLayer], mapFilePath: String): Unit = {
+    val names =
+      layers.map(_.name.getBytes(StandardCharsets.UTF_8) :+ 0.toByte)
+    val namesSize = names.map(_.size).sum
+    val buffer = ByteBuffer
+      .allocate(HeaderSize + layers.size * LayerSize + namesSize)
+      .order(ByteOrder.LITTLE_ENDIAN)
+
+    putWord(buffer, Magic)
+    putWord(buffer, Version)
+    putWord(buffer, layers.size)
+    putWord(buffer, namesSize)
+
+    var nameOffset = 0L
+    for ((layer, name) <- layers.zip(names)) {
+      putWord(buffer, layer.begin)
+      putWord(buffer, layer.end)
+      putWord(buffer, nameOffset)
+      nameOffset += name.size
+    }
+
+    for (name <- names)
+      buffer.put(name)
+
+    val stream = new FileOutputStream(mapFilePath)
+
+    stream.write(buffer.array())
+    stream.close()
+  }
+}
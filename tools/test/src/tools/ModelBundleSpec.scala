@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+package tensil.tools
+
+import java.io._
+import java.nio.{ByteBuffer, ByteOrder}
+import java.nio.charset.StandardCharsets
+import java.nio.file.Files
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import tensil.{Architecture, ArchitectureDataType}
+import tensil.tools.model.{
+  ConstsEntry,
+  InputOutputEntry,
+  Model,
+  ModelBundle,
+  Program
+}
+
+class ModelBundleSpec extends AnyFlatSpec {
+  behavior of "ModelBundle"
+
+  val Arch = Architecture.mkWithDefaults(
+    dataType = ArchitectureDataType.FP16BP8,
+    arraySize = 8,
+    dram1Depth = 1024,
+    dram0Depth = 2048,
+    accumulatorDepth = 256,
+    localDepth = 512,
+  )
+
+  val ConstsBytes  = Array.tabulate[Byte](1000)(i => (i * 7).toByte)
+  val ProgramBytes = Array.tabulate[Byte](3000)(i => (i * 13 + 1).toByte)
+
+  def mkModel(
+      inputs: Seq[InputOutputEntry] = Seq(
+        InputOutputEntry("x", 40, 3),
+        InputOutputEntry("x", 20, 4)
+      ),
+      consts: Seq[ConstsEntry] = Seq(ConstsEntry("m.tdata", 0, 100))
+  ) =
+    Model(
+      name = "m",
+      program = Program("m.tprog", ProgramBytes.size),
+      consts = consts,
+      inputs = inputs,
+      outputs = Seq(InputOutputEntry("Identity", 0, 2)),
+      arch = Arch,
+      loadConstsToLocal = true
+    )
+
+  def writeBytes(file: File, bytes: Array[Byte]): Unit = {
+    val stream = new FileOutputStream(file)
+    stream.write(bytes)
+    stream.close()
+  }
+
+  def word(buffer: ByteBuffer, index: Int): Long =
+    buffer.getInt(index * 4) & 0xffffffffL
+
+  it should "write header, I/O table and sections read back by offset" in {
+    val dir    = Files.createTempDirectory("bundle").toFile()
+    val consts = new File(dir, "m.tdata")
+    val prog   = new File(dir, "m.tprog")
+    val bundle = new File(dir, "m.tbundle")
+    val model  = mkModel()
+
+    writeBytes(consts, ConstsBytes)
+    writeBytes(prog, ProgramBytes)
+
+    assert(ModelBundle.unsupportedReason(model).isEmpty)
+
+    ModelBundle.write(
+      model,
+      consts.getPath(),
+      prog.getPath(),
+      bundle.getPath()
+    )
+
+    val bytes  = Files.readAllBytes(bundle.toPath())
+    val buffer = ByteBuffer.wrap(bytes).order(ByteOrder.LITTLE_ENDIAN)
+
+    assert(word(buffer, 0) == ModelBundle.Magic)
+    assert(word(buffer, 1) == ModelBundle.Version)
+    assert(word(buffer, 2) == ModelBundle.FlagLoadConstsToLocal)
+    assert(word(buffer, 3) == 2)
+    assert(word(buffer, 4) == 1)
+    assert(word(buffer, 5) == 0)
+    assert(word(buffer, 6) == 100)
+    assert(word(buffer, 8) == ProgramBytes.size)
+
+    val constsStart = word(buffer, 7).toInt
+    val progStart   = word(buffer, 9).toInt
+
+    assert(constsStart % ModelBundle.SectorSize == 0)
+    assert(progStart % ModelBundle.SectorSize == 0)
+    assert(progStart >= constsStart + ConstsBytes.size)
+    assert(bytes.size == progStart + ProgramBytes.size)
+    assert(
+      bytes
+        .slice(constsStart, constsStart + ConstsBytes.size)
+        .sameElements(ConstsBytes)
+    )
+    assert(bytes.slice(progStart, bytes.size).sameElements(ProgramBytes))
+
+    val archWords = Seq[Long](
+      1,
+      Arch.arraySize,
+      Arch.dram0Depth,
+      Arch.dram1Depth,
+      Arch.localDepth,
+      Arch.accumulatorDepth,
+      Arch.simdRegistersDepth,
+      Arch.stride0Depth,
+      Arch.stride1Depth
+    )
+
+    for ((value, i) <- archWords.zipWithIndex)
+      assert(word(buffer, ModelBundle.ArchWordOffset + i) == value)
+
+    val entries = model.inputs ++ model.outputs
+
+    for ((entry, i) <- entries.zipWithIndex) {
+      val offset    = ModelBundle.HeaderSize + i * ModelBundle.EntrySize
+      val wordIndex = (offset + ModelBundle.EntryNameSize) / 4
+      val name = new String(
+        bytes.slice(offset, offset + ModelBundle.EntryNameSize),
+        StandardCharsets.UTF_8
+      ).takeWhile(_ != 0)
+
+      assert(name == entry.name)
+      assert(word(buffer, wordIndex) == entry.base)
+      assert(word(buffer, wordIndex + 1) == entry.size)
+    }
+  }
+
+  it should "report models it cannot hold instead of failing" in {
+    val longName    = "x" * ModelBundle.EntryNameSize
+    val longestName = longName.drop(1)
+    val twoConsts =
+      Seq(ConstsEntry("a.tdata", 0, 10), ConstsEntry("b.tdata", 10, 10))
+
+    assert(
+      ModelBundle
+        .unsupportedReason(
+          mkModel(inputs = Seq(InputOutputEntry(longName, 0, 1)))
+        )
+        .isDefined
+    )
+    assert(
+      ModelBundle
+        .unsupportedReason(
+          mkModel(inputs = Seq(InputOutputEntry(longestName, 0, 1)))
+        )
+        .isEmpty
+    )
+    assert(ModelBundle.unsupportedReason(mkModel(consts = twoConsts)).isDefined)
+  }
+}